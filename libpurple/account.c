@@ -848,6 +848,8 @@ purple_account_set_protocol_id(PurpleAccount *account, const char *protocol_id)
 	g_free(priv->protocol_id);
 	priv->protocol_id = g_strdup(protocol_id);
 
+	purple_normalize_clear_cache(account);
+
 	g_object_notify_by_pspec(G_OBJECT(account), properties[PROP_PROTOCOL_ID]);
 
 	purple_accounts_schedule_save();
@@ -863,6 +865,8 @@ purple_account_set_connection(PurpleAccount *account, PurpleConnection *gc)
 	priv = PURPLE_ACCOUNT_GET_PRIVATE(account);
 	priv->gc = gc;
 
+	purple_normalize_clear_cache(account);
+
 	g_object_notify_by_pspec(G_OBJECT(account), properties[PROP_CONNECTION]);
 }
 
@@ -65,6 +65,53 @@ static guint          save_timer = 0;
 static gboolean       blist_loaded = FALSE;
 static gchar *localized_default_group_name = NULL;
 
+/*
+ * The buddy list journal.
+ *
+ * When "/purple/buddies/journal" is set, changed nodes are appended to
+ * blist.journal.<n>, one record per line, instead of rewriting all of
+ * blist.xml.  Every group, contact, buddy and chat has an id that is kept
+ * in blist.xml and in the journal, so records stay valid however the
+ * snapshot is laid out.  Snapshots name the first journal that applies on
+ * top of them, and loading replays that one and every later one.
+ *
+ * Once the journals grow too large they are folded into a new snapshot.
+ * New records go to the next journal while a thread writes the snapshot,
+ * and the older journals are removed once it is in place.
+ */
+#define BLIST_JOURNAL_FILE      "blist.journal"
+#define BLIST_JOURNAL_MAX_SIZE  (256 * 1024)
+
+typedef struct {
+	PurpleXmlNode *node;
+	gchar *filename;
+	guint generation;
+	guint serial;
+	gchar *error;
+} PurpleBlistSnapshot;
+
+static GQuark journal_id_quark = 0;
+static GQuark journal_dirty_quark = 0;
+static guint journal_next_id = 1;
+static guint journal_generation = 0;
+static guint journal_first_generation = 0;
+static gsize journal_size = 0;
+static gsize journal_snapshot_size = 0;
+static gboolean journal_loading = FALSE;
+static gboolean journal_nodes_dirty = FALSE;
+static gboolean journal_compact = FALSE;
+static GString *journal_pending = NULL;
+static GThread *snapshot_thread = NULL;
+static guint snapshot_serial = 0;
+
+static void _purple_blist_schedule_save(void);
+
+/* PurpleAccount* => PurpleAccount*, accounts whose privacy data changed. */
+static GHashTable *journal_accounts = NULL;
+
+/* id => PurpleBlistNode*, only valid while loading. */
+static GHashTable *journal_nodes = NULL;
+
 /*********************************************************************
  * Private utility functions                                         *
  *********************************************************************/
@@ -151,6 +198,37 @@ purple_blist_buddies_cache_remove_account(const PurpleAccount *account)
  * Writing to disk                                                   *
  *********************************************************************/
 
+static guint
+blist_journal_get_id(PurpleBlistNode *node)
+{
+	return GPOINTER_TO_UINT(g_object_get_qdata(G_OBJECT(node), journal_id_quark));
+}
+
+static void
+blist_journal_set_id(PurpleBlistNode *node, guint id)
+{
+	g_object_set_qdata(G_OBJECT(node), journal_id_quark, GUINT_TO_POINTER(id));
+
+	if (journal_nodes != NULL)
+		g_hash_table_insert(journal_nodes, GUINT_TO_POINTER(id), node);
+
+	if (id >= journal_next_id)
+		journal_next_id = id + 1;
+}
+
+/* Writes the node's id, giving it one first if it doesn't have one yet. */
+static void
+blist_journal_set_id_attrib(PurpleXmlNode *xml, PurpleBlistNode *node)
+{
+	char buf[11];
+
+	if (blist_journal_get_id(node) == 0)
+		blist_journal_set_id(node, journal_next_id);
+
+	g_snprintf(buf, sizeof(buf), "%u", blist_journal_get_id(node));
+	purple_xmlnode_set_attrib(xml, "id", buf);
+}
+
 static void
 value_to_xmlnode(gpointer key, gpointer hvalue, gpointer user_data)
 {
@@ -210,6 +288,7 @@ buddy_to_xmlnode(PurpleBuddy *buddy)
 	const char *alias = purple_buddy_get_local_alias(buddy);
 
 	node = purple_xmlnode_new("buddy");
+	blist_journal_set_id_attrib(node, PURPLE_BLIST_NODE(buddy));
 	purple_xmlnode_set_attrib(node, "account", purple_account_get_username(account));
 	purple_xmlnode_set_attrib(node, "proto", purple_account_get_protocol_id(account));
 
@@ -237,6 +316,7 @@ contact_to_xmlnode(PurpleContact *contact)
 	gchar *alias;
 
 	node = purple_xmlnode_new("contact");
+	blist_journal_set_id_attrib(node, PURPLE_BLIST_NODE(contact));
 	g_object_get(contact, "alias", &alias, NULL);
 
 	if (alias != NULL)
@@ -274,6 +354,7 @@ chat_to_xmlnode(PurpleChat *chat)
 	g_object_get(chat, "alias", &alias, NULL);
 
 	node = purple_xmlnode_new("chat");
+	blist_journal_set_id_attrib(node, PURPLE_BLIST_NODE(chat));
 	purple_xmlnode_set_attrib(node, "proto", purple_account_get_protocol_id(account));
 	purple_xmlnode_set_attrib(node, "account", purple_account_get_username(account));
 
@@ -302,6 +383,7 @@ group_to_xmlnode(PurpleGroup *group)
 	PurpleBlistNode *cnode;
 
 	node = purple_xmlnode_new("group");
+	blist_journal_set_id_attrib(node, PURPLE_BLIST_NODE(group));
 	if (group != purple_blist_get_default_group())
 		purple_xmlnode_set_attrib(node, "name", purple_group_get_name(group));
 
@@ -357,13 +439,15 @@ accountprivacy_to_xmlnode(PurpleAccount *account)
 	return node;
 }
 
+/* The snapshot is the base for journal number generation and later ones. */
 static PurpleXmlNode *
-blist_to_xmlnode(void)
+blist_to_xmlnode(guint generation)
 {
 	PurpleXmlNode *node, *child, *grandchild;
 	PurpleBlistNode *gnode;
 	GList *cur;
 	const gchar *localized_default;
+	char buf[11];
 
 	node = purple_xmlnode_new("purple");
 	purple_xmlnode_set_attrib(node, "version", "1.0");
@@ -379,6 +463,9 @@ blist_to_xmlnode(void)
 			"localized-default-group", localized_default);
 	}
 
+	g_snprintf(buf, sizeof(buf), "%u", generation);
+	purple_xmlnode_set_attrib(child, "journal", buf);
+
 	for (gnode = purplebuddylist->root; gnode != NULL; gnode = gnode->next)
 	{
 		if (purple_blist_node_is_transient(gnode))
@@ -401,11 +488,337 @@ blist_to_xmlnode(void)
 	return node;
 }
 
+static gboolean
+blist_journal_enabled(void)
+{
+	return purple_prefs_get_bool("/purple/buddies/journal");
+}
+
+static gchar *
+blist_journal_get_filename(guint generation)
+{
+	gchar *name = g_strdup_printf(BLIST_JOURNAL_FILE ".%u", generation);
+	gchar *filename = g_build_filename(purple_user_dir(), name, NULL);
+
+	g_free(name);
+
+	return filename;
+}
+
+static FILE *
+blist_journal_open(guint generation)
+{
+	gchar *filename = blist_journal_get_filename(generation);
+	FILE *file;
+
+	file = g_fopen(filename, "ab");
+	if (file == NULL) {
+		purple_debug_error("buddylist", "Error opening %s for appending: "
+				"%s\n", filename, g_strerror(errno));
+		g_free(filename);
+		return NULL;
+	}
+
+#ifdef HAVE_FILENO
+#ifndef _WIN32
+	if (fchmod(fileno(file), S_IRUSR | S_IWUSR) == -1) {
+		purple_debug_error("buddylist", "Error setting permissions of "
+				"%s: %s\n", filename, g_strerror(errno));
+	}
+#endif
+#endif
+
+	g_free(filename);
+
+	return file;
+}
+
+static void
+blist_journal_unlink(guint generation)
+{
+	gchar *filename = blist_journal_get_filename(generation);
+
+	if (g_unlink(filename) == -1 && errno != ENOENT) {
+		purple_debug_error("buddylist", "Error removing %s: %s\n",
+				filename, g_strerror(errno));
+	}
+	g_free(filename);
+}
+
+/* Removes the journals that a snapshot based on generation replaces. */
+static void
+blist_journal_unlink_before(guint generation)
+{
+	for (; journal_first_generation < generation; journal_first_generation++)
+		blist_journal_unlink(journal_first_generation);
+}
+
+static void
+blist_journal_clear_dirty(PurpleBlistNode *node)
+{
+	for (; node != NULL; node = node->next) {
+		g_object_set_qdata(G_OBJECT(node), journal_dirty_quark, NULL);
+
+		if (!PURPLE_IS_BUDDY(node) && !PURPLE_IS_CHAT(node))
+			blist_journal_clear_dirty(node->child);
+	}
+}
+
+/* Called once blist.xml holds everything the journals did. */
+static void
+blist_journal_reset(guint generation)
+{
+	blist_journal_unlink_before(generation);
+	journal_generation = generation;
+
+	blist_journal_clear_dirty(purplebuddylist->root);
+
+	journal_size = 0;
+	journal_nodes_dirty = FALSE;
+	journal_compact = FALSE;
+	g_string_truncate(journal_pending, 0);
+	g_hash_table_remove_all(journal_accounts);
+}
+
+static void
+blist_journal_append_record(PurpleXmlNode *record)
+{
+	gsize i = journal_pending->len;
+
+	purple_xmlnode_write_to_string(record, journal_pending);
+	purple_xmlnode_free(record);
+
+	/* Records are separated by newlines, so escape any in the data. */
+	for (; i < journal_pending->len; i++) {
+		if (journal_pending->str[i] == '\n') {
+			g_string_erase(journal_pending, i, 1);
+			g_string_insert(journal_pending, i, "&#10;");
+		} else if (journal_pending->str[i] == '\r') {
+			g_string_erase(journal_pending, i, 1);
+			g_string_insert(journal_pending, i, "&#13;");
+		}
+	}
+
+	g_string_append_c(journal_pending, '\n');
+}
+
+static void
+blist_journal_set_node_attrib(PurpleXmlNode *record, const char *attr,
+		PurpleBlistNode *node)
+{
+	char buf[11];
+
+	g_snprintf(buf, sizeof(buf), "%u",
+			node != NULL ? blist_journal_get_id(node) : 0);
+	purple_xmlnode_set_attrib(record, attr, buf);
+}
+
+static PurpleXmlNode *
+blist_journal_node_to_xmlnode(PurpleBlistNode *node)
+{
+	PurpleXmlNode *record;
+	PurpleBlistNode *prev;
+
+	if (PURPLE_IS_BUDDY(node)) {
+		record = buddy_to_xmlnode(PURPLE_BUDDY(node));
+		blist_journal_set_node_attrib(record, "contact", node->parent);
+	} else if (PURPLE_IS_CHAT(node)) {
+		record = chat_to_xmlnode(PURPLE_CHAT(node));
+		blist_journal_set_node_attrib(record, "group", node->parent);
+	} else if (PURPLE_IS_CONTACT(node)) {
+		gchar *alias;
+
+		record = purple_xmlnode_new("contact");
+		g_object_get(node, "alias", &alias, NULL);
+		if (alias != NULL)
+			purple_xmlnode_set_attrib(record, "alias", alias);
+		g_free(alias);
+
+		g_hash_table_foreach(purple_blist_node_get_settings(node),
+				value_to_xmlnode, record);
+		blist_journal_set_node_attrib(record, "group", node->parent);
+	} else if (PURPLE_IS_GROUP(node)) {
+		record = purple_xmlnode_new("group");
+		if (PURPLE_GROUP(node) != purple_blist_get_default_group()) {
+			purple_xmlnode_set_attrib(record, "name",
+					purple_group_get_name(PURPLE_GROUP(node)));
+		}
+
+		g_hash_table_foreach(purple_blist_node_get_settings(node),
+				value_to_xmlnode, record);
+	} else {
+		return NULL;
+	}
+
+	for (prev = node->prev; prev != NULL; prev = prev->prev) {
+		if (!purple_blist_node_is_transient(prev))
+			break;
+	}
+
+	blist_journal_set_node_attrib(record, "id", node);
+	blist_journal_set_node_attrib(record, "after", prev);
+
+	return record;
+}
+
+/*
+ * Walks the list in document order, so parents and previous siblings are
+ * always journaled before the nodes that refer to them.
+ */
+static void
+blist_journal_add_nodes(PurpleBlistNode *node)
+{
+	for (; node != NULL; node = node->next) {
+		if (purple_blist_node_is_transient(node))
+			continue;
+
+		if (blist_journal_get_id(node) == 0 ||
+				g_object_get_qdata(G_OBJECT(node), journal_dirty_quark)) {
+			PurpleXmlNode *record;
+
+			if (blist_journal_get_id(node) == 0)
+				blist_journal_set_id(node, journal_next_id);
+			g_object_set_qdata(G_OBJECT(node), journal_dirty_quark, NULL);
+
+			record = blist_journal_node_to_xmlnode(node);
+			if (record != NULL)
+				blist_journal_append_record(record);
+		}
+
+		if (!PURPLE_IS_BUDDY(node) && !PURPLE_IS_CHAT(node))
+			blist_journal_add_nodes(node->child);
+	}
+}
+
+static gboolean
+blist_journal_write(void)
+{
+	FILE *file;
+	gsize written;
+
+	if (journal_pending->len == 0)
+		return TRUE;
+
+	file = blist_journal_open(journal_generation);
+	if (file == NULL)
+		return FALSE;
+
+	written = fwrite(journal_pending->str, 1, journal_pending->len, file);
+
+	if (fclose(file) != 0 || written != journal_pending->len) {
+		purple_debug_error("buddylist", "Error writing "
+				BLIST_JOURNAL_FILE ".%u: %s\n", journal_generation,
+				g_strerror(errno));
+		return FALSE;
+	}
+
+	journal_size += written;
+	g_string_truncate(journal_pending, 0);
+
+	return TRUE;
+}
+
+static void
+blist_snapshot_finish(PurpleBlistSnapshot *snapshot)
+{
+	if (snapshot->error != NULL) {
+		/* The journals still have everything, the next save tries again. */
+		purple_debug_error("buddylist", "%s\n", snapshot->error);
+	} else {
+		blist_journal_unlink_before(snapshot->generation);
+		journal_size -= journal_snapshot_size;
+	}
+	journal_snapshot_size = 0;
+
+	purple_xmlnode_free(snapshot->node);
+	g_free(snapshot->filename);
+	g_free(snapshot->error);
+	g_free(snapshot);
+
+	/* Asked for another full save while this one was being written. */
+	if (journal_compact)
+		_purple_blist_schedule_save();
+}
+
+/* Waits for the snapshot that's being written, if there is one. */
+static void
+blist_snapshot_wait(void)
+{
+	PurpleBlistSnapshot *snapshot;
+
+	if (snapshot_thread == NULL)
+		return;
+
+	snapshot = g_thread_join(snapshot_thread);
+	snapshot_thread = NULL;
+
+	blist_snapshot_finish(snapshot);
+}
+
+static gboolean
+blist_snapshot_done_cb(gpointer data)
+{
+	/* blist_snapshot_wait() may have got to it first. */
+	if (snapshot_thread != NULL && GPOINTER_TO_UINT(data) == snapshot_serial)
+		blist_snapshot_wait();
+
+	return FALSE;
+}
+
+/* Runs in the snapshot thread, so it must not call purple_debug. */
+static gpointer
+blist_snapshot_thread_func(gpointer data)
+{
+	PurpleBlistSnapshot *snapshot = data;
+	gchar *xml, *filename_temp;
+	gsize length, written = 0;
+	FILE *file;
+
+	xml = purple_xmlnode_to_formatted_str(snapshot->node, NULL);
+	length = strlen(xml);
+	filename_temp = g_strdup_printf("%s.save", snapshot->filename);
+
+	file = g_fopen(filename_temp, "wb");
+	if (file == NULL) {
+		snapshot->error = g_strdup_printf("Error opening %s for writing: %s",
+				filename_temp, g_strerror(errno));
+	} else {
+		written = fwrite(xml, 1, length, file);
+
+#ifdef HAVE_FILENO
+#ifndef _WIN32
+		fchmod(fileno(file), S_IRUSR | S_IWUSR);
+#endif
+		/* The old journals are removed once this is renamed into place,
+		 * so the data has to be on disk first. */
+		if (written == length &&
+				(fflush(file) != 0 || fsync(fileno(file)) < 0))
+			written = 0;
+#endif
+
+		if (fclose(file) != 0 || written != length) {
+			snapshot->error = g_strdup_printf("Error writing %s: %s",
+					filename_temp, g_strerror(errno));
+		} else if (g_rename(filename_temp, snapshot->filename) == -1) {
+			snapshot->error = g_strdup_printf("Error renaming %s to %s: %s",
+					filename_temp, snapshot->filename, g_strerror(errno));
+		}
+	}
+
+	g_free(filename_temp);
+	g_free(xml);
+
+	g_idle_add(blist_snapshot_done_cb, GUINT_TO_POINTER(snapshot->serial));
+
+	return snapshot;
+}
+
 static void
 purple_blist_sync(void)
 {
 	PurpleXmlNode *node;
 	char *data;
+	guint generation;
 
 	if (!blist_loaded)
 	{
@@ -414,23 +827,105 @@ purple_blist_sync(void)
 		return;
 	}
 
-	node = blist_to_xmlnode();
+	/* An older snapshot must not be renamed over this one. */
+	blist_snapshot_wait();
+
+	generation = journal_generation + 1;
+	node = blist_to_xmlnode(generation);
 	data = purple_xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_file("blist.xml", data, -1);
+	if (purple_util_write_data_to_file("blist.xml", data, -1))
+		blist_journal_reset(generation);
 	g_free(data);
 	purple_xmlnode_free(node);
 }
 
+/*
+ * Appends everything that changed since the last flush to the journal.
+ * Returns FALSE if that failed and everything was rewritten instead.
+ */
+static gboolean
+blist_journal_flush(void)
+{
+	GList *cur;
+
+	if (!blist_loaded)
+		return TRUE;
+
+	if (journal_nodes_dirty) {
+		blist_journal_add_nodes(purplebuddylist->root);
+		journal_nodes_dirty = FALSE;
+	}
+
+	for (cur = purple_accounts_get_all(); cur != NULL; cur = cur->next) {
+		if (g_hash_table_contains(journal_accounts, cur->data))
+			blist_journal_append_record(accountprivacy_to_xmlnode(cur->data));
+	}
+	g_hash_table_remove_all(journal_accounts);
+
+	/* If appending fails, fall back to rewriting everything. */
+	if (!blist_journal_write()) {
+		purple_blist_sync();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Folds the journals into a new blist.xml without blocking the main loop.
+ * Changes made while the snapshot is written go to a new journal, which
+ * the snapshot names as the first one to replay on top of it.
+ */
+static void
+blist_snapshot_start(void)
+{
+	PurpleBlistSnapshot *snapshot;
+	FILE *file;
+
+	if (!blist_journal_flush())
+		return;
+
+	/* Create the next journal up front, so the journals on disk never
+	 * skip a number even if the snapshot can't be written. */
+	file = blist_journal_open(journal_generation + 1);
+	if (file == NULL) {
+		purple_blist_sync();
+		return;
+	}
+	fclose(file);
+
+	journal_generation++;
+	journal_snapshot_size = journal_size;
+	journal_compact = FALSE;
+
+	snapshot = g_new0(PurpleBlistSnapshot, 1);
+	snapshot->node = blist_to_xmlnode(journal_generation);
+	snapshot->filename = g_build_filename(purple_user_dir(), "blist.xml", NULL);
+	snapshot->generation = journal_generation;
+	snapshot->serial = ++snapshot_serial;
+
+	snapshot_thread = g_thread_new("purple-blist-snapshot",
+			blist_snapshot_thread_func, snapshot);
+}
+
 static gboolean
 save_cb(gpointer data)
 {
-	purple_blist_sync();
 	save_timer = 0;
+
+	if (!blist_journal_enabled())
+		purple_blist_sync();
+	else if (snapshot_thread != NULL || (!journal_compact &&
+			journal_size + journal_pending->len < BLIST_JOURNAL_MAX_SIZE))
+		blist_journal_flush();
+	else
+		blist_snapshot_start();
+
 	return FALSE;
 }
 
 static void
-_purple_blist_schedule_save()
+_purple_blist_schedule_save(void)
 {
 	if (save_timer == 0)
 		save_timer = g_timeout_add_seconds(5, save_cb, NULL);
@@ -439,20 +934,58 @@ _purple_blist_schedule_save()
 static void
 purple_blist_save_account(PurpleAccount *account)
 {
-#if 1
-	_purple_blist_schedule_save();
-#else
-	if (account != NULL) {
-		/* Save the buddies and privacy data for this account */
-	} else {
-		/* Save all buddies and privacy data */
+	if (blist_journal_enabled()) {
+		if (journal_loading)
+			return;
+
+		if (account != NULL) {
+			/* Save the privacy data for this account */
+			g_hash_table_add(journal_accounts, account);
+		} else {
+			/* Save all buddies and privacy data */
+			journal_compact = TRUE;
+		}
 	}
-#endif
+
+	_purple_blist_schedule_save();
 }
 
 static void
 purple_blist_save_node(PurpleBlistNode *node)
 {
+	if (blist_journal_enabled()) {
+		if (journal_loading)
+			return;
+
+		g_object_set_qdata(G_OBJECT(node), journal_dirty_quark,
+				GINT_TO_POINTER(TRUE));
+		journal_nodes_dirty = TRUE;
+	}
+
+	_purple_blist_schedule_save();
+}
+
+static void
+purple_blist_remove_node(PurpleBlistNode *node)
+{
+	guint id = blist_journal_get_id(node);
+
+	if (journal_nodes != NULL && id != 0 &&
+			g_hash_table_lookup(journal_nodes, GUINT_TO_POINTER(id)) == node)
+		g_hash_table_remove(journal_nodes, GUINT_TO_POINTER(id));
+
+	if (blist_journal_enabled()) {
+		if (journal_loading)
+			return;
+
+		if (id != 0) {
+			PurpleXmlNode *record = purple_xmlnode_new("remove");
+
+			blist_journal_set_node_attrib(record, "id", node);
+			blist_journal_append_record(record);
+		}
+	}
+
 	_purple_blist_schedule_save();
 }
 
@@ -489,6 +1022,16 @@ parse_setting(PurpleBlistNode *node, PurpleXmlNode *setting)
 	g_free(value);
 }
 
+static void
+blist_journal_load_id(PurpleBlistNode *node, PurpleXmlNode *xml)
+{
+	const char *value = purple_xmlnode_get_attrib(xml, "id");
+	guint id = value != NULL ? strtoul(value, NULL, 10) : 0;
+
+	if (id != 0)
+		blist_journal_set_id(node, id);
+}
+
 static void
 parse_buddy(PurpleGroup *group, PurpleContact *contact, PurpleXmlNode *bnode)
 {
@@ -521,6 +1064,7 @@ parse_buddy(PurpleGroup *group, PurpleContact *contact, PurpleXmlNode *bnode)
 	buddy = purple_buddy_new(account, name, alias);
 	purple_blist_add_buddy(buddy, contact, group,
 			_purple_blist_get_last_child((PurpleBlistNode*)contact));
+	blist_journal_load_id(PURPLE_BLIST_NODE(buddy), bnode);
 
 	for (x = purple_xmlnode_get_child(bnode, "setting"); x; x = purple_xmlnode_get_next_twin(x)) {
 		parse_setting((PurpleBlistNode*)buddy, x);
@@ -539,6 +1083,7 @@ parse_contact(PurpleGroup *group, PurpleXmlNode *cnode)
 
 	purple_blist_add_contact(contact, group,
 			_purple_blist_get_last_child((PurpleBlistNode*)group));
+	blist_journal_load_id(PURPLE_BLIST_NODE(contact), cnode);
 
 	if ((alias = purple_xmlnode_get_attrib(cnode, "alias"))) {
 		purple_contact_set_alias(contact, alias);
@@ -596,6 +1141,7 @@ parse_chat(PurpleGroup *group, PurpleXmlNode *cnode)
 	chat = purple_chat_new(account, alias, components);
 	purple_blist_add_chat(chat, group,
 			_purple_blist_get_last_child((PurpleBlistNode*)group));
+	blist_journal_load_id(PURPLE_BLIST_NODE(chat), cnode);
 
 	for (x = purple_xmlnode_get_child(cnode, "setting"); x; x = purple_xmlnode_get_next_twin(x)) {
 		parse_setting((PurpleBlistNode*)chat, x);
@@ -614,6 +1160,7 @@ parse_group(PurpleXmlNode *groupnode)
 	group = purple_group_new(name);
 	purple_blist_add_group(group,
 			purple_blist_get_last_sibling(purplebuddylist->root));
+	blist_journal_load_id(PURPLE_BLIST_NODE(group), groupnode);
 
 	for (cnode = groupnode->child; cnode; cnode = cnode->next) {
 		if (cnode->type != PURPLE_XMLNODE_TYPE_TAG)
@@ -629,77 +1176,537 @@ parse_group(PurpleXmlNode *groupnode)
 }
 
 static void
-load_blist(void)
+parse_account_privacy(PurpleXmlNode *anode, gboolean replace)
 {
-	PurpleXmlNode *purple, *blist, *privacy;
+	PurpleXmlNode *x;
+	PurpleAccount *account;
+	int imode;
+	const char *acct_name, *proto, *mode;
 
-	blist_loaded = TRUE;
+	acct_name = purple_xmlnode_get_attrib(anode, "name");
+	proto = purple_xmlnode_get_attrib(anode, "proto");
+	mode = purple_xmlnode_get_attrib(anode, "mode");
 
-	purple = purple_util_read_xml_from_file("blist.xml", _("buddy list"));
+	if (!acct_name || !proto || !mode)
+		return;
+
+	account = purple_accounts_find(acct_name, proto);
 
-	if (purple == NULL)
+	if (!account)
 		return;
 
-	blist = purple_xmlnode_get_child(purple, "blist");
-	if (blist) {
-		PurpleXmlNode *groupnode;
+	if (replace) {
+		GSList *cur;
 
-		localized_default_group_name = g_strdup(
-			purple_xmlnode_get_attrib(blist,
-				"localized-default-group"));
+		while ((cur = purple_account_privacy_get_permitted(account))) {
+			char *name = g_strdup(cur->data);
+			gboolean removed = purple_account_privacy_permit_remove(
+					account, name, TRUE);
+			g_free(name);
+			if (!removed)
+				break;
+		}
+		while ((cur = purple_account_privacy_get_denied(account))) {
+			char *name = g_strdup(cur->data);
+			gboolean removed = purple_account_privacy_deny_remove(
+					account, name, TRUE);
+			g_free(name);
+			if (!removed)
+				break;
+		}
+	}
+
+	imode = atoi(mode);
+	purple_account_set_privacy_type(account, (imode != 0 ? imode : PURPLE_ACCOUNT_PRIVACY_ALLOW_ALL));
 
-		for (groupnode = purple_xmlnode_get_child(blist, "group"); groupnode != NULL;
-				groupnode = purple_xmlnode_get_next_twin(groupnode)) {
-			parse_group(groupnode);
+	for (x = anode->child; x; x = x->next) {
+		char *name;
+		if (x->type != PURPLE_XMLNODE_TYPE_TAG)
+			continue;
+
+		if (purple_strequal(x->name, "permit")) {
+			name = purple_xmlnode_get_data(x);
+			purple_account_privacy_permit_add(account, name, TRUE);
+			g_free(name);
+		} else if (purple_strequal(x->name, "block")) {
+			name = purple_xmlnode_get_data(x);
+			purple_account_privacy_deny_add(account, name, TRUE);
+			g_free(name);
 		}
+	}
+}
+
+static PurpleBlistNode *
+blist_journal_lookup(PurpleXmlNode *record, const char *attr)
+{
+	const char *value = purple_xmlnode_get_attrib(record, attr);
+
+	if (value == NULL)
+		return NULL;
+
+	return g_hash_table_lookup(journal_nodes,
+			GUINT_TO_POINTER(strtoul(value, NULL, 10)));
+}
+
+/* Returns whether node has to be (re)inserted to end up after @after. */
+static gboolean
+blist_journal_needs_move(PurpleBlistNode *node, PurpleBlistNode *parent,
+		PurpleBlistNode *after)
+{
+	PurpleBlistNode *prev;
+
+	if (node->parent != parent)
+		return TRUE;
+	if (parent == NULL && node->prev == NULL && purplebuddylist->root != node)
+		return TRUE;
+
+	for (prev = node->prev; prev != NULL; prev = prev->prev) {
+		if (!purple_blist_node_is_transient(prev))
+			break;
+	}
+
+	return prev != after;
+}
+
+static void
+blist_journal_replace_settings(PurpleBlistNode *node, PurpleXmlNode *record)
+{
+	PurpleXmlNode *x;
+
+	g_hash_table_remove_all(purple_blist_node_get_settings(node));
+
+	for (x = purple_xmlnode_get_child(record, "setting"); x; x = purple_xmlnode_get_next_twin(x)) {
+		parse_setting(node, x);
+	}
+}
+
+static void
+blist_journal_apply_group(PurpleXmlNode *record, guint id)
+{
+	const char *name = purple_xmlnode_get_attrib(record, "name");
+	PurpleBlistNode *node = blist_journal_lookup(record, "id");
+	PurpleBlistNode *after = blist_journal_lookup(record, "after");
+	PurpleGroup *group;
+
+	if (after != NULL && (!PURPLE_IS_GROUP(after) || after == node))
+		after = NULL;
+
+	if (node != NULL) {
+		group = PURPLE_GROUP(node);
+		if (name != NULL)
+			purple_group_set_name(group, name);
+		/* Renaming onto an existing group merges the two. */
+		if (g_hash_table_lookup(journal_nodes, GUINT_TO_POINTER(id)) == NULL)
+			group = purple_blist_find_group(name);
 	} else {
-		g_free(localized_default_group_name);
-		localized_default_group_name = NULL;
+		group = purple_group_new(name);
 	}
 
-	privacy = purple_xmlnode_get_child(purple, "privacy");
-	if (privacy) {
-		PurpleXmlNode *anode;
-		for (anode = privacy->child; anode; anode = anode->next) {
-			PurpleXmlNode *x;
-			PurpleAccount *account;
-			int imode;
-			const char *acct_name, *proto, *mode;
+	if (group == NULL)
+		return;
 
-			acct_name = purple_xmlnode_get_attrib(anode, "name");
-			proto = purple_xmlnode_get_attrib(anode, "proto");
-			mode = purple_xmlnode_get_attrib(anode, "mode");
+	node = PURPLE_BLIST_NODE(group);
+	if (blist_journal_needs_move(node, NULL, after))
+		purple_blist_add_group(group, after);
 
-			if (!acct_name || !proto || !mode)
-				continue;
+	blist_journal_replace_settings(node, record);
+	blist_journal_set_id(node, id);
+}
 
-			account = purple_accounts_find(acct_name, proto);
+static void
+blist_journal_apply_contact(PurpleXmlNode *record, guint id)
+{
+	PurpleBlistNode *node = blist_journal_lookup(record, "id");
+	PurpleBlistNode *gnode = blist_journal_lookup(record, "group");
+	PurpleBlistNode *after = blist_journal_lookup(record, "after");
+	PurpleContact *contact;
 
-			if (!account)
-				continue;
+	if (gnode == NULL || !PURPLE_IS_GROUP(gnode) ||
+			(node != NULL && !PURPLE_IS_CONTACT(node)))
+		return;
 
-			imode = atoi(mode);
-			purple_account_set_privacy_type(account, (imode != 0 ? imode : PURPLE_ACCOUNT_PRIVACY_ALLOW_ALL));
+	if (after != NULL && (after->parent != gnode || after == node))
+		after = NULL;
 
-			for (x = anode->child; x; x = x->next) {
-				char *name;
-				if (x->type != PURPLE_XMLNODE_TYPE_TAG)
-					continue;
+	if (node != NULL) {
+		contact = PURPLE_CONTACT(node);
+	} else {
+		contact = purple_contact_new();
+		node = PURPLE_BLIST_NODE(contact);
+	}
 
-				if (purple_strequal(x->name, "permit")) {
-					name = purple_xmlnode_get_data(x);
-					purple_account_privacy_permit_add(account, name, TRUE);
-					g_free(name);
-				} else if (purple_strequal(x->name, "block")) {
-					name = purple_xmlnode_get_data(x);
-					purple_account_privacy_deny_add(account, name, TRUE);
-					g_free(name);
-				}
+	if (blist_journal_needs_move(node, gnode, after))
+		purple_blist_add_contact(contact, PURPLE_GROUP(gnode), after);
+
+	purple_contact_set_alias(contact, purple_xmlnode_get_attrib(record, "alias"));
+	blist_journal_replace_settings(node, record);
+	blist_journal_set_id(node, id);
+}
+
+static void
+blist_journal_apply_buddy(PurpleXmlNode *record, guint id)
+{
+	PurpleBlistNode *node = blist_journal_lookup(record, "id");
+	PurpleBlistNode *cnode = blist_journal_lookup(record, "contact");
+	PurpleBlistNode *after = blist_journal_lookup(record, "after");
+	PurpleAccount *account;
+	PurpleBuddy *buddy;
+	const char *acct_name, *proto;
+	char *name = NULL, *alias = NULL;
+	PurpleXmlNode *x;
+
+	if (cnode == NULL || !PURPLE_IS_CONTACT(cnode) ||
+			(node != NULL && !PURPLE_IS_BUDDY(node)))
+		return;
+
+	if (after != NULL && (after->parent != cnode || after == node))
+		after = NULL;
+
+	acct_name = purple_xmlnode_get_attrib(record, "account");
+	proto = purple_xmlnode_get_attrib(record, "proto");
+
+	if (!acct_name || !proto)
+		return;
+
+	account = purple_accounts_find(acct_name, proto);
+
+	if (!account)
+		return;
+
+	if ((x = purple_xmlnode_get_child(record, "name")))
+		name = purple_xmlnode_get_data(x);
+
+	if (!name)
+		return;
+
+	if ((x = purple_xmlnode_get_child(record, "alias")))
+		alias = purple_xmlnode_get_data(x);
+
+	if (node != NULL) {
+		buddy = PURPLE_BUDDY(node);
+		if (!purple_strequal(purple_buddy_get_name(buddy), name))
+			purple_buddy_set_name(buddy, name);
+		purple_buddy_set_local_alias(buddy, alias);
+	} else {
+		buddy = purple_buddy_new(account, name, alias);
+		node = PURPLE_BLIST_NODE(buddy);
+	}
+
+	if (blist_journal_needs_move(node, cnode, after)) {
+		purple_blist_add_buddy(buddy, PURPLE_CONTACT(cnode),
+				PURPLE_GROUP(cnode->parent), after);
+	}
+
+	blist_journal_replace_settings(node, record);
+	blist_journal_set_id(node, id);
+
+	g_free(name);
+	g_free(alias);
+}
+
+static void
+blist_journal_apply_chat(PurpleXmlNode *record, guint id)
+{
+	PurpleBlistNode *node = blist_journal_lookup(record, "id");
+	PurpleBlistNode *gnode = blist_journal_lookup(record, "group");
+	PurpleBlistNode *after = blist_journal_lookup(record, "after");
+	PurpleAccount *account;
+	PurpleChat *chat;
+	const char *acct_name, *proto;
+	char *alias = NULL;
+	GHashTable *components;
+	PurpleXmlNode *x;
+
+	if (gnode == NULL || !PURPLE_IS_GROUP(gnode) ||
+			(node != NULL && !PURPLE_IS_CHAT(node)))
+		return;
+
+	if (after != NULL && (after->parent != gnode || after == node))
+		after = NULL;
+
+	acct_name = purple_xmlnode_get_attrib(record, "account");
+	proto = purple_xmlnode_get_attrib(record, "proto");
+
+	if (!acct_name || !proto)
+		return;
+
+	account = purple_accounts_find(acct_name, proto);
+
+	if (!account)
+		return;
+
+	if ((x = purple_xmlnode_get_child(record, "alias")))
+		alias = purple_xmlnode_get_data(x);
+
+	if (node != NULL) {
+		chat = PURPLE_CHAT(node);
+		components = purple_chat_get_components(chat);
+		g_hash_table_remove_all(components);
+		purple_chat_set_alias(chat, alias);
+	} else {
+		components = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+		chat = NULL;
+	}
+
+	for (x = purple_xmlnode_get_child(record, "component"); x; x = purple_xmlnode_get_next_twin(x)) {
+		const char *name;
+		char *value;
+
+		name = purple_xmlnode_get_attrib(x, "name");
+		value = purple_xmlnode_get_data(x);
+		g_hash_table_replace(components, g_strdup(name), value);
+	}
+
+	if (chat == NULL) {
+		chat = purple_chat_new(account, alias, components);
+		node = PURPLE_BLIST_NODE(chat);
+	}
+
+	if (blist_journal_needs_move(node, gnode, after))
+		purple_blist_add_chat(chat, PURPLE_GROUP(gnode), after);
+
+	blist_journal_replace_settings(node, record);
+	blist_journal_set_id(node, id);
+
+	g_free(alias);
+}
+
+static void
+blist_journal_apply_remove(PurpleXmlNode *record)
+{
+	PurpleBlistNode *node = blist_journal_lookup(record, "id");
+
+	if (node == NULL)
+		return;
+
+	if (PURPLE_IS_BUDDY(node))
+		purple_blist_remove_buddy(PURPLE_BUDDY(node));
+	else if (PURPLE_IS_CONTACT(node))
+		purple_blist_remove_contact(PURPLE_CONTACT(node));
+	else if (PURPLE_IS_CHAT(node))
+		purple_blist_remove_chat(PURPLE_CHAT(node));
+	else if (PURPLE_IS_GROUP(node))
+		purple_blist_remove_group(PURPLE_GROUP(node));
+}
+
+static void
+blist_journal_apply(PurpleXmlNode *record)
+{
+	const char *value = purple_xmlnode_get_attrib(record, "id");
+	guint id = value ? strtoul(value, NULL, 10) : 0;
+
+	if (purple_strequal(record->name, "account"))
+		parse_account_privacy(record, TRUE);
+	else if (id == 0)
+		return;
+	else if (purple_strequal(record->name, "remove"))
+		blist_journal_apply_remove(record);
+	else if (purple_strequal(record->name, "group"))
+		blist_journal_apply_group(record, id);
+	else if (purple_strequal(record->name, "contact"))
+		blist_journal_apply_contact(record, id);
+	else if (purple_strequal(record->name, "buddy"))
+		blist_journal_apply_buddy(record, id);
+	else if (purple_strequal(record->name, "chat"))
+		blist_journal_apply_chat(record, id);
+}
+
+/* Returns FALSE if there is no journal with that number. */
+static gboolean
+blist_journal_replay(guint generation)
+{
+	gchar *filename, *contents, *line, *end;
+	gsize length;
+	GError *error = NULL;
+
+	filename = blist_journal_get_filename(generation);
+	if (!g_file_get_contents(filename, &contents, &length, &error)) {
+		gboolean exists = !g_error_matches(error, G_FILE_ERROR,
+				G_FILE_ERROR_NOENT);
+
+		if (exists) {
+			purple_debug_error("buddylist", "Error reading %s: %s\n",
+					filename, error->message);
+			journal_compact = TRUE;
+		}
+		g_error_free(error);
+		g_free(filename);
+		return exists;
+	}
+	g_free(filename);
+
+	journal_size += length;
+
+	for (line = contents; line < contents + length; line = end + 1) {
+		PurpleXmlNode *record;
+
+		end = memchr(line, '\n', contents + length - line);
+		if (end == NULL)
+			end = contents + length;
+		if (end == line)
+			continue;
+
+		/* A write that was cut short leaves a truncated last record.
+		 * Anything appended after it would end up on the same line, so
+		 * start over with a new snapshot instead. */
+		record = purple_xmlnode_from_str(line, end - line);
+		if (record == NULL) {
+			purple_debug_warning("buddylist", "Skipping damaged record "
+					"in " BLIST_JOURNAL_FILE ".%u\n", generation);
+			journal_compact = TRUE;
+			continue;
+		}
+
+		blist_journal_apply(record);
+		purple_xmlnode_free(record);
+	}
+
+	g_free(contents);
+
+	return TRUE;
+}
+
+/*
+ * Replays the journals on top of a snapshot based on generation.  That
+ * journal is only created once something is written to it, but the ones
+ * after it always exist.
+ */
+static void
+blist_journal_replay_all(guint generation)
+{
+	PurpleBlistNode *gnode, *cnode, *next;
+	guint stale;
+
+	journal_first_generation = journal_generation = generation;
+
+	/* Left behind if we quit right after the snapshot was written. */
+	for (stale = generation; stale > 0; stale--) {
+		gchar *filename = blist_journal_get_filename(stale - 1);
+		gboolean exists = g_file_test(filename, G_FILE_TEST_EXISTS);
+
+		g_free(filename);
+		if (!exists)
+			break;
+		blist_journal_unlink(stale - 1);
+	}
+
+	for (; ; generation++) {
+		if (blist_journal_replay(generation))
+			journal_generation = generation;
+		else if (generation != journal_first_generation)
+			break;
+	}
+
+	/* Same as parse_contact(), empty contacts cause problems. */
+	for (gnode = purplebuddylist->root; gnode != NULL; gnode = gnode->next) {
+		for (cnode = gnode->child; cnode != NULL; cnode = next) {
+			next = cnode->next;
+			if (PURPLE_IS_CONTACT(cnode) && cnode->child == NULL)
+				purple_blist_remove_contact(PURPLE_CONTACT(cnode));
+		}
+	}
+}
+
+/*
+ * Gives an id to the nodes of a snapshot written before they had one.
+ * Returns TRUE if any node was missing one.
+ */
+static gboolean
+blist_journal_assign_ids(PurpleBlistNode *node)
+{
+	gboolean assigned = FALSE;
+
+	for (; node != NULL; node = node->next) {
+		if (purple_blist_node_is_transient(node))
+			continue;
+
+		if (blist_journal_get_id(node) == 0) {
+			blist_journal_set_id(node, journal_next_id);
+			assigned = TRUE;
+		}
+
+		if (!PURPLE_IS_BUDDY(node) && !PURPLE_IS_CHAT(node) &&
+				blist_journal_assign_ids(node->child))
+			assigned = TRUE;
+	}
+
+	return assigned;
+}
+
+static void
+load_blist(void)
+{
+	PurpleXmlNode *purple, *blist, *privacy;
+	gboolean found;
+	guint generation = 0;
+
+	blist_loaded = TRUE;
+
+	journal_loading = TRUE;
+	journal_next_id = 1;
+	journal_size = 0;
+	journal_compact = FALSE;
+	journal_nodes = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	purple = purple_util_read_xml_from_file("blist.xml", _("buddy list"));
+	found = (purple != NULL);
+
+	if (found) {
+		blist = purple_xmlnode_get_child(purple, "blist");
+		if (blist) {
+			PurpleXmlNode *groupnode;
+			const char *value;
+
+			localized_default_group_name = g_strdup(
+				purple_xmlnode_get_attrib(blist,
+					"localized-default-group"));
+
+			if ((value = purple_xmlnode_get_attrib(blist, "journal")))
+				generation = strtoul(value, NULL, 10);
+
+			for (groupnode = purple_xmlnode_get_child(blist, "group"); groupnode != NULL;
+					groupnode = purple_xmlnode_get_next_twin(groupnode)) {
+				parse_group(groupnode);
+			}
+		} else {
+			g_free(localized_default_group_name);
+			localized_default_group_name = NULL;
+		}
+
+		privacy = purple_xmlnode_get_child(purple, "privacy");
+		if (privacy) {
+			PurpleXmlNode *anode;
+			for (anode = privacy->child; anode; anode = anode->next) {
+				parse_account_privacy(anode, FALSE);
 			}
 		}
+
+		purple_xmlnode_free(purple);
+	}
+
+	blist_journal_replay_all(generation);
+
+	g_hash_table_destroy(journal_nodes);
+	journal_nodes = NULL;
+	journal_loading = FALSE;
+
+	/* Give the nodes of an older blist.xml their ids in a new one, so
+	 * they aren't all journaled as new. */
+	if (blist_journal_assign_ids(purplebuddylist->root) &&
+			blist_journal_enabled()) {
+		journal_compact = TRUE;
+		_purple_blist_schedule_save();
 	}
 
-	purple_xmlnode_free(purple);
+	/* Fold large, damaged or no longer wanted journals into blist.xml. */
+	if (journal_size > 0 && (journal_compact || !blist_journal_enabled() ||
+			journal_size >= BLIST_JOURNAL_MAX_SIZE)) {
+		journal_compact = TRUE;
+		_purple_blist_schedule_save();
+	}
+
+	if (!found && journal_size == 0)
+		return;
 
 	/* This tells the buddy icon code to do its thing. */
 	_purple_buddy_icons_blist_loaded_cb();
@@ -725,6 +1732,11 @@ purple_blist_boot(void)
 					 (GEqualFunc)g_str_equal,
 					 (GDestroyNotify)g_free, NULL);
 
+	journal_id_quark = g_quark_from_static_string("purple-blist-journal-id");
+	journal_dirty_quark = g_quark_from_static_string("purple-blist-journal-dirty");
+	journal_pending = g_string_new(NULL);
+	journal_accounts = g_hash_table_new(g_direct_hash, g_direct_equal);
+
 	for (account = purple_accounts_get_all(); account != NULL; account = account->next)
 	{
 		purple_blist_buddies_cache_add_account(account->data);
@@ -1545,6 +2557,7 @@ PurpleBuddy *purple_blist_find_buddy(PurpleAccount *account, const char *name)
 {
 	PurpleBuddy *buddy;
 	struct _purple_hbuddy hb;
+	char normalized[BUF_LEN];
 	PurpleBlistNode *group;
 
 	g_return_val_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist), NULL);
@@ -1552,7 +2565,8 @@ PurpleBuddy *purple_blist_find_buddy(PurpleAccount *account, const char *name)
 	g_return_val_if_fail((name != NULL) && (*name != '\0'), NULL);
 
 	hb.account = account;
-	hb.name = (gchar *)purple_normalize(account, name);
+	hb.name = (gchar *)purple_normalize_to_buffer(account, name,
+			normalized, sizeof(normalized));
 
 	for (group = purplebuddylist->root; group; group = group->next) {
 		if (!group->child)
@@ -1572,12 +2586,14 @@ PurpleBuddy *purple_blist_find_buddy_in_group(PurpleAccount *account, const char
 		PurpleGroup *group)
 {
 	struct _purple_hbuddy hb;
+	char normalized[BUF_LEN];
 
 	g_return_val_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist), NULL);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 	g_return_val_if_fail((name != NULL) && (*name != '\0'), NULL);
 
-	hb.name = (gchar *)purple_normalize(account, name);
+	hb.name = (gchar *)purple_normalize_to_buffer(account, name,
+			normalized, sizeof(normalized));
 	hb.account = account;
 	hb.group = (PurpleBlistNode*)group;
 
@@ -1604,8 +2620,10 @@ GSList *purple_blist_find_buddies(PurpleAccount *account, const char *name)
 
 	if ((name != NULL) && (*name != '\0')) {
 		struct _purple_hbuddy hb;
+		char normalized[BUF_LEN];
 
-		hb.name = (gchar *)purple_normalize(account, name);
+		hb.name = (gchar *)purple_normalize_to_buffer(account, name,
+				normalized, sizeof(normalized));
 		hb.account = account;
 
 		for (node = purplebuddylist->root; node != NULL; node = node->next) {
@@ -1901,7 +2919,7 @@ purple_blist_set_ui_ops(PurpleBlistUiOps *ops)
 		overrode = TRUE;
 	}
 	if (!ops->remove_node) {
-		ops->remove_node = purple_blist_save_node;
+		ops->remove_node = purple_blist_remove_node;
 		overrode = TRUE;
 	}
 	if (!ops->save_account) {
@@ -1910,7 +2928,7 @@ purple_blist_set_ui_ops(PurpleBlistUiOps *ops)
 	}
 
 	if (overrode && (ops->save_node    != purple_blist_save_node ||
-	                 ops->remove_node  != purple_blist_save_node ||
+	                 ops->remove_node  != purple_blist_remove_node ||
 	                 ops->save_account != purple_blist_save_account)) {
 		purple_debug_warning("buddylist", "Only some of the blist saving UI ops "
 				"were overridden. This probably is not what you want!\n");
@@ -2044,10 +3062,15 @@ purple_blist_uninit(void)
 	if (purplebuddylist == NULL)
 		return;
 
+	blist_snapshot_wait();
+
 	if (save_timer != 0) {
 		g_source_remove(save_timer);
 		save_timer = 0;
-		purple_blist_sync();
+		if (blist_journal_enabled() && !journal_compact)
+			blist_journal_flush();
+		else
+			purple_blist_sync();
 	}
 
 	purple_debug(PURPLE_DEBUG_INFO, "buddylist", "Destroying\n");
@@ -2065,9 +3088,13 @@ purple_blist_uninit(void)
 
 	g_hash_table_destroy(buddies_cache);
 	g_hash_table_destroy(groups_cache);
+	g_hash_table_destroy(journal_accounts);
+	g_string_free(journal_pending, TRUE);
 
 	buddies_cache = NULL;
 	groups_cache = NULL;
+	journal_accounts = NULL;
+	journal_pending = NULL;
 
 	g_object_unref(purplebuddylist);
 	purplebuddylist = NULL;
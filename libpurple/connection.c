@@ -59,6 +59,8 @@ struct _PurpleConnectionPrivate
 	PurpleAccount *account;       /* The account being connected to.   */
 	char *password;               /* The password used.                */
 
+	GHashTable *active_chat_set;  /* The active chats, for lookups       */
+	GHashTable *active_chat_ids;  /* id => chat, for the active chats    */
 	GSList *active_chats;         /* A list of active chats
 	                                  (#PurpleChatConversation structs). */
 
@@ -387,20 +389,91 @@ void
 _purple_connection_add_active_chat(PurpleConnection *gc, PurpleChatConversation *chat)
 {
 	PurpleConnectionPrivate *priv = PURPLE_CONNECTION_GET_PRIVATE(gc);
+	gpointer id;
 
 	g_return_if_fail(priv != NULL);
 
 	priv->active_chats = g_slist_append(priv->active_chats, chat);
+	g_hash_table_add(priv->active_chat_set, chat);
+
+	id = GINT_TO_POINTER(purple_chat_conversation_get_id(chat));
+	if (!g_hash_table_contains(priv->active_chat_ids, id))
+		g_hash_table_insert(priv->active_chat_ids, id, chat);
+}
+
+/* Points an id at the first active chat that has it, if any. */
+static void
+active_chat_ids_refill(PurpleConnectionPrivate *priv, int id)
+{
+	GSList *l;
+
+	g_hash_table_remove(priv->active_chat_ids, GINT_TO_POINTER(id));
+
+	for (l = priv->active_chats; l != NULL; l = l->next) {
+		if (purple_chat_conversation_get_id(l->data) == id) {
+			g_hash_table_insert(priv->active_chat_ids, GINT_TO_POINTER(id),
+					l->data);
+			break;
+		}
+	}
 }
 
 void
 _purple_connection_remove_active_chat(PurpleConnection *gc, PurpleChatConversation *chat)
 {
 	PurpleConnectionPrivate *priv = PURPLE_CONNECTION_GET_PRIVATE(gc);
+	int id;
 
 	g_return_if_fail(priv != NULL);
 
 	priv->active_chats = g_slist_remove(priv->active_chats, chat);
+	if (!g_hash_table_remove(priv->active_chat_set, chat))
+		return;
+
+	id = purple_chat_conversation_get_id(chat);
+	if (g_hash_table_lookup(priv->active_chat_ids, GINT_TO_POINTER(id)) == chat)
+		active_chat_ids_refill(priv, id);
+}
+
+PurpleChatConversation *
+_purple_connection_find_active_chat(const PurpleConnection *gc, int id)
+{
+	PurpleConnectionPrivate *priv = PURPLE_CONNECTION_GET_PRIVATE(gc);
+
+	g_return_val_if_fail(priv != NULL, NULL);
+
+	return g_hash_table_lookup(priv->active_chat_ids, GINT_TO_POINTER(id));
+}
+
+gboolean
+_purple_connection_is_active_chat(const PurpleConnection *gc,
+		PurpleChatConversation *chat)
+{
+	PurpleConnectionPrivate *priv = PURPLE_CONNECTION_GET_PRIVATE(gc);
+
+	g_return_val_if_fail(priv != NULL, FALSE);
+
+	return g_hash_table_contains(priv->active_chat_set, chat);
+}
+
+void
+_purple_connection_update_active_chat_id(PurpleConnection *gc,
+		PurpleChatConversation *chat, int old_id)
+{
+	PurpleConnectionPrivate *priv = PURPLE_CONNECTION_GET_PRIVATE(gc);
+	gpointer id;
+
+	g_return_if_fail(priv != NULL);
+
+	if (!g_hash_table_contains(priv->active_chat_set, chat))
+		return;
+
+	if (g_hash_table_lookup(priv->active_chat_ids, GINT_TO_POINTER(old_id)) == chat)
+		active_chat_ids_refill(priv, old_id);
+
+	id = GINT_TO_POINTER(purple_chat_conversation_get_id(chat));
+	if (!g_hash_table_contains(priv->active_chat_ids, id))
+		g_hash_table_insert(priv->active_chat_ids, id, chat);
 }
 
 gboolean
@@ -783,6 +856,10 @@ static void
 purple_connection_init(GTypeInstance *instance, gpointer klass)
 {
 	PurpleConnection *gc = PURPLE_CONNECTION(instance);
+	PurpleConnectionPrivate *priv = PURPLE_CONNECTION_GET_PRIVATE(gc);
+
+	priv->active_chat_set = g_hash_table_new(g_direct_hash, g_direct_equal);
+	priv->active_chat_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
 
 	purple_connection_set_state(gc, PURPLE_CONNECTION_CONNECTING);
 	connections = g_list_append(connections, gc);
@@ -831,7 +908,7 @@ purple_connection_finalize(GObject *object)
 	{
 		PurpleChatConversation *b = priv->active_chats->data;
 
-		priv->active_chats = g_slist_remove(priv->active_chats, b);
+		_purple_connection_remove_active_chat(gc, b);
 		purple_chat_conversation_leave(b);
 	}
 
@@ -876,6 +953,9 @@ purple_connection_finalize(GObject *object)
 	purple_str_wipe(priv->password);
 	g_free(priv->display_name);
 
+	g_hash_table_destroy(priv->active_chat_set);
+	g_hash_table_destroy(priv->active_chat_ids);
+
 	PURPLE_DBUS_UNREGISTER_POINTER(gc);
 
 	G_OBJECT_CLASS(parent_class)->finalize(object);
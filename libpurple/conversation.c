@@ -56,7 +56,10 @@ struct _PurpleConversationPrivate
 	PurpleConversationUiOps *ui_ops;  /* UI-specific operations.           */
 
 	PurpleConnectionFlags features;   /* The supported features            */
-	GList *message_history; /* Message history, as a GList of PurpleMessages */
+	GQueue message_history; /* Message history, newest PurpleMessage first */
+	gsize history_size;               /* Approximate size of the history  */
+	guint history_evicted;            /* Messages dropped from the history */
+	GList *history_lru_link;          /* Our link in history_lru          */
 
 	PurpleE2eeState *e2ee_state;      /* End-to-end encryption state.      */
 
@@ -81,6 +84,16 @@ enum
 static GObjectClass *parent_class;
 static GParamSpec *properties[PROP_LAST];
 
+/* History limits, 0 if unlimited. */
+static guint history_max_messages = 0;
+static gsize history_max_size = 0;
+static gsize history_budget = 0;
+
+/* Conversations with any history, the most recently written to first. */
+static GQueue history_lru = G_QUEUE_INIT;
+static gsize history_total_size = 0;
+static GQuark history_size_quark = 0;
+
 static void
 common_send(PurpleConversation *conv, const char *message, PurpleMessageFlags msgflags)
 {
@@ -140,6 +153,8 @@ common_send(PurpleConversation *conv, const char *message, PurpleMessageFlags ms
 			purple_signal_emit(purple_conversations_get_handle(),
 				"sent-im-msg", account, msg);
 		}
+
+		g_object_unref(msg);
 	}
 	else if (PURPLE_IS_CHAT_CONVERSATION(conv)) {
 		int id = purple_chat_conversation_get_id(PURPLE_CHAT_CONVERSATION(conv));
@@ -155,6 +170,8 @@ common_send(PurpleConversation *conv, const char *message, PurpleMessageFlags ms
 			purple_signal_emit(purple_conversations_get_handle(),
 				"sent-chat-msg", account, msg, id);
 		}
+
+		g_object_unref(msg);
 	}
 
 	if (err < 0) {
@@ -210,16 +227,147 @@ open_log(PurpleConversation *conv)
 
 /* Functions that deal with PurpleMessage history */
 
+static gsize
+message_history_size(PurpleMessage *msg)
+{
+	const gchar *str;
+	gsize size = sizeof(PurpleMessage) + sizeof(GList) + 64;
+
+	if ((str = purple_message_get_contents(msg)) != NULL)
+		size += strlen(str) + 1;
+	if ((str = purple_message_get_author(msg)) != NULL)
+		size += strlen(str) + 1;
+	if ((str = purple_message_get_recipient(msg)) != NULL)
+		size += strlen(str) + 1;
+
+	return size;
+}
+
+static void
+drop_oldest_message(PurpleConversation *conv)
+{
+	PurpleConversationPrivate *priv = PURPLE_CONVERSATION_GET_PRIVATE(conv);
+	PurpleMessage *msg = g_queue_pop_tail(&priv->message_history);
+	gsize size;
+
+	size = GPOINTER_TO_SIZE(g_object_get_qdata(G_OBJECT(msg),
+			history_size_quark));
+	priv->history_size -= size;
+	history_total_size -= size;
+	priv->history_evicted++;
+
+	if (g_queue_is_empty(&priv->message_history)) {
+		g_queue_delete_link(&history_lru, priv->history_lru_link);
+		priv->history_lru_link = NULL;
+	}
+
+	g_object_unref(msg);
+}
+
+/* Applies the per-conversation limits. */
+static void
+trim_message_history(PurpleConversation *conv)
+{
+	PurpleConversationPrivate *priv = PURPLE_CONVERSATION_GET_PRIVATE(conv);
+
+	while ((history_max_messages > 0 &&
+			priv->message_history.length > history_max_messages) ||
+			(history_max_size > 0 && priv->history_size > history_max_size &&
+			 priv->message_history.length > 1))
+		drop_oldest_message(conv);
+}
+
+/*
+ * Drops the oldest messages of the least recently written to conversations
+ * until the history fits into the global budget.  The newest message of a
+ * conversation is always kept, the UIs look at it.
+ */
+static void
+enforce_history_budget(void)
+{
+	GList *l;
+
+	for (l = history_lru.tail; l != NULL && history_total_size > history_budget;
+			l = l->prev) {
+		PurpleConversationPrivate *priv =
+			PURPLE_CONVERSATION_GET_PRIVATE(l->data);
+
+		while (history_total_size > history_budget &&
+				priv->message_history.length > 1)
+			drop_oldest_message(l->data);
+	}
+}
+
 static void
 add_message_to_history(PurpleConversation *conv, PurpleMessage *msg)
 {
 	PurpleConversationPrivate *priv = PURPLE_CONVERSATION_GET_PRIVATE(conv);
+	gsize size;
 
 	g_return_if_fail(priv != NULL);
 	g_return_if_fail(msg != NULL);
 
-	g_object_ref(msg);
-	priv->message_history = g_list_prepend(priv->message_history, msg);
+	if (G_UNLIKELY(history_size_quark == 0))
+		history_size_quark = g_quark_from_static_string("purple-history-size");
+
+	size = message_history_size(msg);
+	g_object_set_qdata(G_OBJECT(msg), history_size_quark,
+			GSIZE_TO_POINTER(size));
+
+	g_queue_push_head(&priv->message_history, g_object_ref(msg));
+	priv->history_size += size;
+	history_total_size += size;
+
+	if (priv->history_lru_link != NULL)
+		g_queue_unlink(&history_lru, priv->history_lru_link);
+	else
+		priv->history_lru_link = g_list_alloc();
+	priv->history_lru_link->data = conv;
+	g_queue_push_head_link(&history_lru, priv->history_lru_link);
+
+	trim_message_history(conv);
+
+	if (history_budget > 0 && history_total_size > history_budget)
+		enforce_history_budget();
+}
+
+static void
+history_limits_changed_cb(const char *name, PurplePrefType type,
+		gconstpointer val, gpointer data)
+{
+	GList *l;
+
+	history_max_messages = MAX(0, purple_prefs_get_int(
+			"/purple/conversations/history/max_messages"));
+	history_max_size = (gsize)MAX(0, purple_prefs_get_int(
+			"/purple/conversations/history/max_size")) * 1024;
+	history_budget = (gsize)MAX(0, purple_prefs_get_int(
+			"/purple/conversations/history/budget")) * 1024;
+
+	/* Apply the new limits to what we already have. */
+	for (l = history_lru.head; l != NULL; l = l->next)
+		trim_message_history(l->data);
+
+	if (history_budget > 0 && history_total_size > history_budget)
+		enforce_history_budget();
+}
+
+void
+_purple_conversation_history_init(void)
+{
+	void *handle = purple_conversations_get_handle();
+
+	purple_prefs_connect_callback(handle,
+		"/purple/conversations/history/max_messages",
+		history_limits_changed_cb, NULL);
+	purple_prefs_connect_callback(handle,
+		"/purple/conversations/history/max_size",
+		history_limits_changed_cb, NULL);
+	purple_prefs_connect_callback(handle,
+		"/purple/conversations/history/budget",
+		history_limits_changed_cb, NULL);
+
+	history_limits_changed_cb(NULL, PURPLE_PREF_NONE, NULL, NULL);
 }
 
 /**************************************************************************
@@ -554,12 +702,12 @@ _purple_conversation_write_common(PurpleConversation *conv, PurpleMessage *pmsg)
 	if (account != NULL)
 		gc = purple_account_get_connection(account);
 
-	if (PURPLE_IS_CHAT_CONVERSATION(conv) &&
-		(gc != NULL && !g_slist_find(purple_connection_get_active_chats(gc), conv)))
+	if (PURPLE_IS_CHAT_CONVERSATION(conv) && gc != NULL &&
+		!_purple_connection_is_active_chat(gc, PURPLE_CHAT_CONVERSATION(conv)))
 		return;
 
 	if (PURPLE_IS_IM_CONVERSATION(conv) &&
-		!g_list_find(purple_conversations_get_all(), conv))
+		!_purple_conversations_contains(conv))
 		return;
 
 	plugin_return = GPOINTER_TO_INT(purple_signal_emit_return_1(
@@ -661,8 +809,10 @@ purple_conversation_write_message(PurpleConversation *conv, PurpleMessage *msg)
 void purple_conversation_write_system_message(PurpleConversation *conv,
 	const gchar *message, PurpleMessageFlags flags)
 {
-	_purple_conversation_write_common(conv,
-		purple_message_new_system(message, flags));
+	PurpleMessage *msg = purple_message_new_system(message, flags);
+
+	_purple_conversation_write_common(conv, msg);
+	g_object_unref(msg);
 }
 
 void
@@ -781,14 +931,21 @@ purple_conversation_get_extended_menu(PurpleConversation *conv)
 
 void purple_conversation_clear_message_history(PurpleConversation *conv)
 {
-	GList *list;
 	PurpleConversationPrivate *priv = PURPLE_CONVERSATION_GET_PRIVATE(conv);
 
 	g_return_if_fail(priv != NULL);
 
-	list = priv->message_history;
-	g_list_free_full(list, g_object_unref);
-	priv->message_history = NULL;
+	g_list_free_full(priv->message_history.head, g_object_unref);
+	g_queue_init(&priv->message_history);
+
+	history_total_size -= priv->history_size;
+	priv->history_size = 0;
+	priv->history_evicted = 0;
+
+	if (priv->history_lru_link != NULL) {
+		g_queue_delete_link(&history_lru, priv->history_lru_link);
+		priv->history_lru_link = NULL;
+	}
 
 	purple_signal_emit(purple_conversations_get_handle(),
 			"cleared-message-history", conv);
@@ -800,7 +957,33 @@ GList *purple_conversation_get_message_history(PurpleConversation *conv)
 
 	g_return_val_if_fail(priv != NULL, NULL);
 
-	return priv->message_history;
+	return priv->message_history.head;
+}
+
+guint
+purple_conversation_get_evicted_message_count(PurpleConversation *conv)
+{
+	PurpleConversationPrivate *priv = PURPLE_CONVERSATION_GET_PRIVATE(conv);
+
+	g_return_val_if_fail(priv != NULL, 0);
+
+	return priv->history_evicted;
+}
+
+gchar *
+purple_conversation_read_log(PurpleConversation *conv,
+		PurpleLogReadFlags *flags)
+{
+	PurpleConversationPrivate *priv = PURPLE_CONVERSATION_GET_PRIVATE(conv);
+
+	g_return_val_if_fail(priv != NULL, NULL);
+
+	if (priv->logs == NULL)
+		return NULL;
+
+	/* Don't wait for the log writer, the dropped messages are old enough
+	 * to have been written out already. */
+	return purple_log_read(priv->logs->data, flags);
 }
 
 void purple_conversation_set_ui_data(PurpleConversation *conv, gpointer ui_data)
@@ -559,6 +559,13 @@ void purple_conversation_update(PurpleConversation *conv, PurpleConversationUpda
  *
  * Retrieve the message history of a conversation.
  *
+ * The history is bounded by the
+ * <literal>/purple/conversations/history</literal> preferences: the
+ * number of messages and their size per conversation, and a budget for all
+ * conversations together, spent on the most recently active ones.  Older
+ * messages are dropped (see purple_conversation_get_evicted_message_count())
+ * and can be read back from the log with purple_conversation_read_log().
+ *
  * Returns: (element-type PurpleMessage) (transfer none):
  *          A GList of PurpleMessage's. You must not modify the
  *          list or the data within. The list contains the newest message at
@@ -574,6 +581,33 @@ GList *purple_conversation_get_message_history(PurpleConversation *conv);
  */
 void purple_conversation_clear_message_history(PurpleConversation *conv);
 
+/**
+ * purple_conversation_get_evicted_message_count:
+ * @conv:  The conversation
+ *
+ * Returns how many messages were dropped from the message history of a
+ * conversation to keep it within its limits.
+ *
+ * Returns: The number of dropped messages since the history was last
+ *          cleared.
+ */
+guint purple_conversation_get_evicted_message_count(PurpleConversation *conv);
+
+/**
+ * purple_conversation_read_log:
+ * @conv:  The conversation
+ * @flags: (out) (optional): The returned logging flags.
+ *
+ * Reads back the conversation's current log, which includes any messages
+ * that were dropped from the message history.  This doesn't wait for the
+ * log writer, so the most recent messages may not be in it yet.
+ *
+ * Returns: The contents of the log, or %NULL if the conversation isn't
+ *          being logged.  Free it with g_free().
+ */
+gchar *purple_conversation_read_log(PurpleConversation *conv,
+		PurpleLogReadFlags *flags);
+
 /**
  * purple_conversation_set_ui_data:
  * @conv:			The conversation.
@@ -33,6 +33,9 @@ static PurpleConversationUiOps *default_ops = NULL;
  */
 static GHashTable *conversation_cache = NULL;
 
+/* The conversations in the conversations list, for quick membership tests. */
+static GHashTable *conversation_set = NULL;
+
 struct _purple_hconv {
 	gboolean im;
 	char *name;
@@ -68,10 +71,11 @@ purple_conversations_add(PurpleConversation *conv)
 
 	g_return_if_fail(conv != NULL);
 
-	if (g_list_find(conversations, conv) != NULL)
+	if (g_hash_table_contains(conversation_set, conv))
 		return;
 
 	conversations = g_list_prepend(conversations, conv);
+	g_hash_table_add(conversation_set, conv);
 
 	if (PURPLE_IS_IM_CONVERSATION(conv))
 		ims = g_list_prepend(ims, conv);
@@ -97,6 +101,9 @@ purple_conversations_remove(PurpleConversation *conv)
 
 	g_return_if_fail(conv != NULL);
 
+	if (!g_hash_table_remove(conversation_set, conv))
+		return;
+
 	conversations = g_list_remove(conversations, conv);
 
 	if (PURPLE_IS_IM_CONVERSATION(conv))
@@ -142,6 +149,12 @@ _purple_conversations_update_cache(PurpleConversation *conv, const char *name,
 	g_hash_table_insert(conversation_cache, hc, conv);
 }
 
+gboolean
+_purple_conversations_contains(PurpleConversation *conv)
+{
+	return g_hash_table_contains(conversation_set, conv);
+}
+
 GList *
 purple_conversations_get_all(void)
 {
@@ -166,10 +179,12 @@ purple_conversations_find_with_account(const char *name,
 {
 	PurpleConversation *c = NULL;
 	struct _purple_hconv hc;
+	char normalized[BUF_LEN];
 
 	g_return_val_if_fail(name != NULL, NULL);
 
-	hc.name = (gchar *)purple_normalize(account, name);
+	hc.name = (gchar *)purple_normalize_to_buffer(account, name,
+			normalized, sizeof(normalized));
 	hc.account = account;
 
 	hc.im = TRUE;
@@ -188,10 +203,12 @@ purple_conversations_find_im_with_account(const char *name,
 {
 	PurpleIMConversation *im = NULL;
 	struct _purple_hconv hc;
+	char normalized[BUF_LEN];
 
 	g_return_val_if_fail(name != NULL, NULL);
 
-	hc.name = (gchar *)purple_normalize(account, name);
+	hc.name = (gchar *)purple_normalize_to_buffer(account, name,
+			normalized, sizeof(normalized));
 	hc.account = account;
 	hc.im = TRUE;
 
@@ -206,10 +223,12 @@ purple_conversations_find_chat_with_account(const char *name,
 {
 	PurpleChatConversation *c = NULL;
 	struct _purple_hconv hc;
+	char normalized[BUF_LEN];
 
 	g_return_val_if_fail(name != NULL, NULL);
 
-	hc.name = (gchar *)purple_normalize(account, name);
+	hc.name = (gchar *)purple_normalize_to_buffer(account, name,
+			normalized, sizeof(normalized));
 	hc.account = account;
 	hc.im = FALSE;
 
@@ -224,6 +243,11 @@ purple_conversations_find_chat(const PurpleConnection *gc, int id)
 	GList *l;
 	PurpleChatConversation *chat;
 
+	/* Chats that are still joined are indexed by their connection. */
+	if (gc != NULL &&
+			(chat = _purple_connection_find_active_chat(gc, id)) != NULL)
+		return chat;
+
 	for (l = purple_conversations_get_chats(); l != NULL; l = l->next) {
 		chat = (PurpleChatConversation *)l->data;
 
@@ -263,6 +287,7 @@ purple_conversations_init(void)
 	conversation_cache = g_hash_table_new_full((GHashFunc)_purple_conversations_hconv_hash,
 						(GEqualFunc)_purple_conversations_hconv_equal,
 						(GDestroyNotify)_purple_conversations_hconv_free_key, NULL);
+	conversation_set = g_hash_table_new(g_direct_hash, g_direct_equal);
 
 	/**********************************************************************
 	 * Register preferences
@@ -279,6 +304,14 @@ purple_conversations_init(void)
 	purple_prefs_add_none("/purple/conversations/im");
 	purple_prefs_add_bool("/purple/conversations/im/send_typing", TRUE);
 
+	/* Conversations -> History (sizes in KiB, 0 for no limit) */
+	purple_prefs_add_none("/purple/conversations/history");
+	purple_prefs_add_int("/purple/conversations/history/max_messages", 1000);
+	purple_prefs_add_int("/purple/conversations/history/max_size", 1024);
+	purple_prefs_add_int("/purple/conversations/history/budget", 65536);
+
+	_purple_conversation_history_init();
+
 
 	/**********************************************************************
 	 * Register signals
@@ -390,6 +423,12 @@ purple_conversations_init(void)
 						 G_TYPE_NONE, 4, PURPLE_TYPE_CHAT_CONVERSATION,
 						 G_TYPE_STRING, G_TYPE_UINT, G_TYPE_BOOLEAN);
 
+	purple_signal_register(handle, "chat-users-joined",
+						 purple_marshal_VOID__POINTER_POINTER_UINT,
+						 G_TYPE_NONE, 3, PURPLE_TYPE_CHAT_CONVERSATION,
+						 G_TYPE_POINTER, /* pointer to a GList of PurpleChatUser */
+						 G_TYPE_BOOLEAN);
+
 	purple_signal_register(handle, "chat-user-flags",
 						 purple_marshal_VOID__POINTER_UINT_UINT, G_TYPE_NONE, 3,
 						 PURPLE_TYPE_CHAT_USER, G_TYPE_UINT, G_TYPE_UINT);
@@ -464,5 +503,7 @@ purple_conversations_uninit(void)
 		g_object_unref(G_OBJECT(conversations->data));
 
 	g_hash_table_destroy(conversation_cache);
+	g_hash_table_destroy(conversation_set);
+	purple_prefs_disconnect_by_handle(purple_conversations_get_handle());
 	purple_signals_unregister_by_instance(purple_conversations_get_handle());
 }
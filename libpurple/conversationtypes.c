@@ -54,9 +54,17 @@ struct _PurpleChatConversationPrivate
 	int    id;          /* The chat ID.                              */
 	char *nick;         /* Your nick in this chat.                   */
 	gboolean left;      /* We left the chat and kept the window open */
-	GHashTable *users;  /* Hash table of the users in the room.      */
+	GHashTable *users;  /* Hash table of the users in the room, keyed
+	                       by the collation key of their names.      */
+	GHashTable *ignored_set; /* Ignored names by casefolded collation
+	                            key, built on demand from ignored.   */
+	GQueue ui_feed;     /* Users not yet handed to the UI.           */
+	guint ui_feed_timeout; /* Idle source feeding ui_feed to the UI. */
 };
 
+/* How many users the UI is handed per main loop iteration. */
+#define CHAT_USERS_FEED_CHUNK 500
+
 /* Chat Property enums */
 enum {
 	CHAT_PROP_0,
@@ -97,13 +105,15 @@ struct _PurpleChatUserPrivate
 	char *name;                    /* The chat participant's name in the
 	                                  chat.                                 */
 	char *alias;                   /* The chat participant's alias, if known;
-	                                  NULL otherwise.                       */
-	char *alias_key;               /* A string by which this user will be
-	                                  sorted, or @c NULL if the user should be
-	                                  sorted by its @name.
-	                                  (This is currently always NULL.       */
-	gboolean buddy;                /* TRUE if this chat participant is on
+	                                  NULL otherwise.  Shares @name's
+	                                  storage when they're the same, which
+	                                  is the case for most users.           */
+	char *sort_key;                /* Casefolded collation key of the name,
+	                                  or NULL until it is needed.           */
+	guint buddy : 1;               /* TRUE if this chat participant is on
 	                                  the buddy list; FALSE otherwise.      */
+	guint ui_pending : 1;          /* TRUE while the user is waiting in the
+	                                  chat's UI feed.                       */
 	PurpleChatUserFlags flags;     /* A bitwise OR of flags for this
 	                                  participant, such as whether they
 	                                  are a channel operator.               */
@@ -128,6 +138,9 @@ static GParamSpec *cu_properties[CU_PROP_LAST];
 
 static int purple_chat_user_compare(PurpleChatUser *a,
 		PurpleChatUser *b);
+static PurpleChatUser *purple_chat_user_new_internal(
+		PurpleChatConversation *chat, const char *name, const char *alias,
+		PurpleChatUserFlags flags, gboolean buddy);
 
 /**************************************************************************
  * IM Conversation API
@@ -583,23 +596,165 @@ purple_im_conversation_new(PurpleAccount *account, const char *name)
 /**************************************************************************
  * Chat Conversation API
  **************************************************************************/
-static guint
-_purple_conversation_user_hash(gconstpointer data)
+static gchar *
+chat_conversation_ignored_key(const char *name)
+{
+	gchar *folded, *key;
+
+	/* purple_utf8_strcasecmp() never matches invalid UTF-8 either. */
+	if (!g_utf8_validate(name, -1, NULL))
+		return NULL;
+
+	folded = g_utf8_casefold(name, -1);
+	key = g_utf8_collate_key(folded, -1);
+	g_free(folded);
+
+	return key;
+}
+
+static void
+chat_conversation_ignored_set_add(GHashTable *set, const char *name,
+		const char *ign)
+{
+	gchar *key = chat_conversation_ignored_key(name);
+
+	if (key == NULL)
+		return;
+
+	/* The first matching entry of the ignore list wins. */
+	if (g_hash_table_contains(set, key))
+		g_free(key);
+	else
+		g_hash_table_insert(set, key, (gpointer)ign);
+}
+
+/*
+ * Builds a hash of every name the ignore list matches, mapped to what
+ * purple_chat_conversation_get_ignored_user() returns for it.  Returns NULL
+ * if nobody is ignored.
+ */
+static GHashTable *
+chat_conversation_get_ignored_set(PurpleChatConversationPrivate *priv)
+{
+	GList *l;
+
+	if (priv->ignored_set != NULL || priv->ignored == NULL)
+		return priv->ignored_set;
+
+	priv->ignored_set = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, NULL);
+
+	for (l = priv->ignored; l != NULL; l = l->next) {
+		const char *ign = l->data;
+
+		chat_conversation_ignored_set_add(priv->ignored_set, ign, ign);
+
+		if (*ign == '+' || *ign == '%')
+			chat_conversation_ignored_set_add(priv->ignored_set, ign + 1, ign);
+
+		if (*ign == '@') {
+			ign++;
+
+			if (*ign == '+')
+				chat_conversation_ignored_set_add(priv->ignored_set, ign + 1, ign);
+			else
+				chat_conversation_ignored_set_add(priv->ignored_set, ign, ign);
+		}
+	}
+
+	return priv->ignored_set;
+}
+
+static PurpleChatUser *
+chat_conversation_lookup_user(PurpleChatConversationPrivate *priv,
+		const char *name)
 {
-	const gchar *name = data;
-	gchar *collated;
-	guint hash;
+	gchar *key = g_utf8_collate_key(name, -1);
+	PurpleChatUser *cb = g_hash_table_lookup(priv->users, key);
 
-	collated = g_utf8_collate_key(name, -1);
-	hash     = g_str_hash(collated);
-	g_free(collated);
-	return hash;
+	g_free(key);
+	return cb;
+}
+
+static void
+chat_conversation_insert_user(PurpleChatConversationPrivate *priv,
+		PurpleChatUser *cb)
+{
+	g_hash_table_replace(priv->users,
+		g_utf8_collate_key(purple_chat_user_get_name(cb), -1), cb);
+}
+
+static void
+chat_conversation_remove_user(PurpleChatConversationPrivate *priv,
+		const char *name)
+{
+	gchar *key = g_utf8_collate_key(name, -1);
+
+	g_hash_table_remove(priv->users, key);
+	g_free(key);
+}
+
+/* Hands up to max queued users to the UI, sorted. */
+static void
+chat_conversation_feed_users(PurpleChatConversation *chat, guint max)
+{
+	PurpleChatConversationPrivate *priv =
+			PURPLE_CHAT_CONVERSATION_GET_PRIVATE(chat);
+	PurpleConversationUiOps *ops;
+	PurpleChatUser *cb;
+	GList *cbuddies = NULL;
+
+	while (max-- > 0 && (cb = g_queue_pop_head(&priv->ui_feed)) != NULL) {
+		PURPLE_CHAT_USER_GET_PRIVATE(cb)->ui_pending = FALSE;
+		cbuddies = g_list_prepend(cbuddies, cb);
+	}
+
+	if (cbuddies == NULL)
+		return;
+
+	cbuddies = g_list_sort(cbuddies, (GCompareFunc)purple_chat_user_compare);
+
+	ops = purple_conversation_get_ui_ops(PURPLE_CONVERSATION(chat));
+	if (ops != NULL && ops->chat_add_users != NULL)
+		ops->chat_add_users(chat, cbuddies, FALSE);
+
+	g_list_free_full(cbuddies, g_object_unref);
 }
 
 static gboolean
-_purple_conversation_user_equal(gconstpointer a, gconstpointer b)
+chat_conversation_feed_users_cb(gpointer data)
 {
-	return !g_utf8_collate(a, b);
+	PurpleChatConversation *chat = data;
+	PurpleChatConversationPrivate *priv =
+			PURPLE_CHAT_CONVERSATION_GET_PRIVATE(chat);
+
+	chat_conversation_feed_users(chat, CHAT_USERS_FEED_CHUNK);
+
+	if (g_queue_is_empty(&priv->ui_feed)) {
+		priv->ui_feed_timeout = 0;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Hands every queued user to the UI right away.  This has to happen before
+ * the UI is told about anything that changes users it might not have yet.
+ */
+static void
+chat_conversation_flush_users(PurpleChatConversation *chat)
+{
+	PurpleChatConversationPrivate *priv =
+			PURPLE_CHAT_CONVERSATION_GET_PRIVATE(chat);
+
+	if (priv->ui_feed_timeout == 0)
+		return;
+
+	g_source_remove(priv->ui_feed_timeout);
+	priv->ui_feed_timeout = 0;
+
+	chat_conversation_feed_users(chat, G_MAXUINT);
 }
 
 GList *
@@ -668,6 +823,11 @@ purple_chat_conversation_set_ignored(PurpleChatConversation *chat, GList *ignore
 
 	g_return_val_if_fail(priv != NULL, NULL);
 
+	if (priv->ignored_set != NULL) {
+		g_hash_table_destroy(priv->ignored_set);
+		priv->ignored_set = NULL;
+	}
+
 	priv->ignored = ignored;
 	return ignored;
 }
@@ -685,31 +845,25 @@ purple_chat_conversation_get_ignored(const PurpleChatConversation *chat)
 const char *
 purple_chat_conversation_get_ignored_user(const PurpleChatConversation *chat, const char *user)
 {
-	GList *ignored;
+	PurpleChatConversationPrivate *priv;
+	GHashTable *set;
+	const char *ign;
+	gchar *key;
 
 	g_return_val_if_fail(PURPLE_IS_CHAT_CONVERSATION(chat), NULL);
 	g_return_val_if_fail(user != NULL, NULL);
 
-	for (ignored = purple_chat_conversation_get_ignored(chat);
-		 ignored != NULL;
-		 ignored = ignored->next) {
+	priv = PURPLE_CHAT_CONVERSATION_GET_PRIVATE(chat);
+	if ((set = chat_conversation_get_ignored_set(priv)) == NULL)
+		return NULL;
 
-		const char *ign = (const char *)ignored->data;
+	if ((key = chat_conversation_ignored_key(user)) == NULL)
+		return NULL;
 
-		if (!purple_utf8_strcasecmp(user, ign) ||
-			((*ign == '+' || *ign == '%') && !purple_utf8_strcasecmp(user, ign + 1)))
-			return ign;
+	ign = g_hash_table_lookup(set, key);
+	g_free(key);
 
-		if (*ign == '@') {
-			ign++;
-
-			if ((*ign == '+' && !purple_utf8_strcasecmp(user, ign + 1)) ||
-				(*ign != '+' && !purple_utf8_strcasecmp(user, ign)))
-				return ign;
-		}
-	}
-
-	return NULL;
+	return ign;
 }
 
 gboolean
@@ -772,11 +926,18 @@ void
 purple_chat_conversation_set_id(PurpleChatConversation *chat, int id)
 {
 	PurpleChatConversationPrivate *priv = PURPLE_CHAT_CONVERSATION_GET_PRIVATE(chat);
+	PurpleConnection *gc;
+	int old_id;
 
 	g_return_if_fail(priv != NULL);
 
+	old_id = priv->id;
 	priv->id = id;
 
+	gc = purple_conversation_get_connection(PURPLE_CONVERSATION(chat));
+	if (gc != NULL && old_id != id)
+		_purple_connection_update_active_chat_id(gc, chat, old_id);
+
 	g_object_notify_by_pspec(G_OBJECT(chat), chat_properties[CHAT_PROP_ID]);
 }
 
@@ -844,8 +1005,11 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 	PurpleAccount *account;
 	PurpleConnection *gc;
 	PurpleProtocol *protocol;
+	PurpleSignal *joining, *joined;
+	GHashTable *ignored;
 	GList *ul, *fl;
 	GList *cbuddies = NULL;
+	gboolean unique_chatname;
 
 	priv = PURPLE_CHAT_CONVERSATION_GET_PRIVATE(chat);
 
@@ -861,6 +1025,15 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 	protocol = purple_connection_get_protocol(gc);
 	g_return_if_fail(PURPLE_IS_PROTOCOL(protocol));
 
+	/* Everything that doesn't depend on the user is only looked up once,
+	 * which matters when a big room sends its whole roster at once. */
+	unique_chatname = (purple_protocol_get_options(protocol) & OPT_PROTO_UNIQUE_CHATNAME);
+	ignored = chat_conversation_get_ignored_set(priv);
+	joining = purple_signal_lookup(purple_conversations_get_handle(),
+			"chat-user-joining");
+	joined = purple_signal_lookup(purple_conversations_get_handle(),
+			"chat-user-joined");
+
 	ul = users;
 	fl = flags;
 	while ((ul != NULL) && (fl != NULL)) {
@@ -869,8 +1042,9 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 		gboolean quiet;
 		PurpleChatUserFlags flag = GPOINTER_TO_INT(fl->data);
 		const char *extra_msg = (extra_msgs ? extra_msgs->data : NULL);
+		PurpleBuddy *buddy = purple_blist_find_buddy(account, user);
 
-		if(!(purple_protocol_get_options(protocol) & OPT_PROTO_UNIQUE_CHATNAME)) {
+		if (!unique_chatname) {
 			if (purple_strequal(priv->nick, purple_normalize(account, user))) {
 				const char *alias2 = purple_account_get_private_alias(account);
 				if (alias2 != NULL)
@@ -881,22 +1055,20 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 					if (display_name != NULL)
 						alias = display_name;
 				}
-			} else {
-				PurpleBuddy *buddy;
-				if ((buddy = purple_blist_find_buddy(purple_connection_get_account(gc), user)) != NULL)
-					alias = purple_buddy_get_contact_alias(buddy);
+			} else if (buddy != NULL) {
+				alias = purple_buddy_get_contact_alias(buddy);
 			}
 		}
 
-		quiet = GPOINTER_TO_INT(purple_signal_emit_return_1(purple_conversations_get_handle(),
-						 "chat-user-joining", chat, user, flag)) ||
-				purple_chat_conversation_is_ignored_user(chat, user);
+		quiet = GPOINTER_TO_INT(purple_signal_emit_direct_return_1(joining,
+						 chat, user, flag)) ||
+				(ignored != NULL &&
+				 purple_chat_conversation_is_ignored_user(chat, user));
 
-		chatuser = purple_chat_user_new(chat, user, alias, flag);
+		chatuser = purple_chat_user_new_internal(chat, user, alias, flag,
+				buddy != NULL);
 
-		g_hash_table_replace(priv->users,
-			g_strdup(purple_chat_user_get_name(chatuser)),
-			chatuser);
+		chat_conversation_insert_user(priv, chatuser);
 
 		cbuddies = g_list_prepend(cbuddies, chatuser);
 
@@ -919,20 +1091,43 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, G
 			g_free(tmp);
 		}
 
-		purple_signal_emit(purple_conversations_get_handle(),
-						 "chat-user-joined", chat, user, flag, new_arrivals);
+		purple_signal_emit_direct(joined, chat, user, flag, new_arrivals);
 		ul = ul->next;
 		fl = fl->next;
 		if (extra_msgs != NULL)
 			extra_msgs = extra_msgs->next;
 	}
 
-	cbuddies = g_list_sort(cbuddies, (GCompareFunc)purple_chat_user_compare);
+	cbuddies = g_list_reverse(cbuddies);
 
-	if (ops != NULL && ops->chat_add_users != NULL)
+	purple_signal_emit(purple_conversations_get_handle(),
+					 "chat-users-joined", chat, cbuddies, new_arrivals);
+
+	if (ops == NULL || ops->chat_add_users == NULL) {
+		g_list_free(cbuddies);
+		return;
+	}
+
+	if (new_arrivals) {
+		cbuddies = g_list_sort(cbuddies, (GCompareFunc)purple_chat_user_compare);
 		ops->chat_add_users(chat, cbuddies, new_arrivals);
+		g_list_free(cbuddies);
+		return;
+	}
 
+	/* A roster listing can be tens of thousands of users, possibly spread
+	 * over many calls.  Queue them up and let the UI take them in chunks
+	 * from the main loop, so it doesn't freeze while they are inserted. */
+	for (ul = cbuddies; ul != NULL; ul = ul->next) {
+		PURPLE_CHAT_USER_GET_PRIVATE(ul->data)->ui_pending = TRUE;
+		g_queue_push_tail(&priv->ui_feed, g_object_ref(ul->data));
+	}
 	g_list_free(cbuddies);
+
+	if (priv->ui_feed_timeout == 0) {
+		priv->ui_feed_timeout = g_idle_add(chat_conversation_feed_users_cb,
+				chat);
+	}
 }
 
 void
@@ -992,8 +1187,8 @@ purple_chat_conversation_rename_user(PurpleChatConversation *chat, const char *o
 	flags = purple_chat_user_get_flags(purple_chat_conversation_find_user(chat, old_user));
 	cb = purple_chat_user_new(chat, new_user, new_alias, flags);
 
-	g_hash_table_replace(priv->users,
-		g_strdup(purple_chat_user_get_name(cb)), cb);
+	chat_conversation_flush_users(chat);
+	chat_conversation_insert_user(priv, cb);
 
 	if (ops != NULL && ops->chat_rename_user != NULL)
 		ops->chat_rename_user(chat, old_user, new_user, new_alias);
@@ -1001,7 +1196,7 @@ purple_chat_conversation_rename_user(PurpleChatConversation *chat, const char *o
 	cb = purple_chat_conversation_find_user(chat, old_user);
 
 	if (cb)
-		g_hash_table_remove(priv->users, purple_chat_user_get_name(cb));
+		chat_conversation_remove_user(priv, purple_chat_user_get_name(cb));
 
 	if (purple_chat_conversation_is_ignored_user(chat, old_user)) {
 		purple_chat_conversation_unignore(chat, old_user);
@@ -1085,6 +1280,8 @@ purple_chat_conversation_remove_users(PurpleChatConversation *chat, GList *users
 
 	ops  = purple_conversation_get_ui_ops(conv);
 
+	chat_conversation_flush_users(chat);
+
 	for (l = users; l != NULL; l = l->next) {
 		const char *user = (const char *)l->data;
 		quiet = GPOINTER_TO_INT(purple_signal_emit_return_1(purple_conversations_get_handle(),
@@ -1093,10 +1290,8 @@ purple_chat_conversation_remove_users(PurpleChatConversation *chat, GList *users
 
 		cb = purple_chat_conversation_find_user(chat, user);
 
-		if (cb) {
-			g_hash_table_remove(priv->users,
-				purple_chat_user_get_name(cb));
-		}
+		if (cb)
+			chat_conversation_remove_user(priv, purple_chat_user_get_name(cb));
 
 		/* NOTE: Don't remove them from ignored in case they re-enter. */
 
@@ -1143,25 +1338,29 @@ purple_chat_conversation_clear_users(PurpleChatConversation *chat)
 	PurpleConversationUiOps *ops;
 	GHashTableIter it;
 	PurpleChatConversationPrivate *priv = PURPLE_CHAT_CONVERSATION_GET_PRIVATE(chat);
-	gchar *name;
+	PurpleChatUser *cb;
 
 	g_return_if_fail(priv != NULL);
 
 	ops = purple_conversation_get_ui_ops(PURPLE_CONVERSATION(chat));
 
+	chat_conversation_flush_users(chat);
+
 	if (ops != NULL && ops->chat_remove_users != NULL) {
 		GList *names = NULL;
 
 		g_hash_table_iter_init(&it, priv->users);
-		while (g_hash_table_iter_next(&it, (gpointer*)&name, NULL))
-			names = g_list_prepend(names, name);
+		while (g_hash_table_iter_next(&it, NULL, (gpointer*)&cb))
+			names = g_list_prepend(names, (gpointer)purple_chat_user_get_name(cb));
 
 		ops->chat_remove_users(chat, names);
 		g_list_free(names);
 	}
 
 	g_hash_table_iter_init(&it, priv->users);
-	while (g_hash_table_iter_next(&it, (gpointer*)&name, NULL)) {
+	while (g_hash_table_iter_next(&it, NULL, (gpointer*)&cb)) {
+		const char *name = purple_chat_user_get_name(cb);
+
 		purple_signal_emit(purple_conversations_get_handle(),
 						 "chat-user-leaving", chat, name, NULL);
 		purple_signal_emit(purple_conversations_get_handle(),
@@ -1324,7 +1523,7 @@ purple_chat_conversation_find_user(PurpleChatConversation *chat, const char *nam
 	g_return_val_if_fail(priv != NULL, NULL);
 	g_return_val_if_fail(name != NULL, NULL);
 
-	return g_hash_table_lookup(priv->users, name);
+	return chat_conversation_lookup_user(priv, name);
 }
 
 /**************************************************************************
@@ -1395,8 +1594,9 @@ static void purple_chat_conversation_init(GTypeInstance *instance, gpointer klas
 	PURPLE_DBUS_REGISTER_POINTER(PURPLE_CHAT_CONVERSATION(instance),
 			PurpleChatConversation);
 
-	priv->users = g_hash_table_new_full(_purple_conversation_user_hash,
-		_purple_conversation_user_equal, g_free, g_object_unref);
+	priv->users = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		g_object_unref);
+	g_queue_init(&priv->ui_feed);
 }
 
 /* Called when done constructing */
@@ -1429,6 +1629,17 @@ purple_chat_conversation_dispose(GObject *object)
 {
 	PurpleChatConversationPrivate *priv =
 			PURPLE_CHAT_CONVERSATION_GET_PRIVATE(object);
+	PurpleChatUser *cb;
+
+	if (priv->ui_feed_timeout != 0) {
+		g_source_remove(priv->ui_feed_timeout);
+		priv->ui_feed_timeout = 0;
+	}
+
+	while ((cb = g_queue_pop_head(&priv->ui_feed)) != NULL) {
+		PURPLE_CHAT_USER_GET_PRIVATE(cb)->ui_pending = FALSE;
+		g_object_unref(cb);
+	}
 
 	g_hash_table_remove_all(priv->users);
 
@@ -1471,6 +1682,11 @@ purple_chat_conversation_finalize(GObject *object)
 	g_list_free(priv->ignored);
 	priv->ignored = NULL;
 
+	if (priv->ignored_set != NULL) {
+		g_hash_table_destroy(priv->ignored_set);
+		priv->ignored_set = NULL;
+	}
+
 	g_free(priv->who);
 	g_free(priv->topic);
 	g_free(priv->nick);
@@ -1606,12 +1822,32 @@ purple_chat_conversation_new(PurpleAccount *account, const char *name)
 /**************************************************************************
  * Chat Conversation User API
  **************************************************************************/
+/* Equivalent to comparing the sort names with purple_utf8_strcasecmp(), but
+ * only casefolds and collates each user once. */
+static const char *
+purple_chat_user_get_sort_key(PurpleChatUserPrivate *priv)
+{
+	const char *name = priv->name;
+
+	if (priv->sort_key == NULL && name != NULL) {
+		if (g_utf8_validate(name, -1, NULL)) {
+			gchar *folded = g_utf8_casefold(name, -1);
+			priv->sort_key = g_utf8_collate_key(folded, -1);
+			g_free(folded);
+		} else {
+			priv->sort_key = g_strdup(name);
+		}
+	}
+
+	return priv->sort_key;
+}
+
 static int
 purple_chat_user_compare(PurpleChatUser *a, PurpleChatUser *b)
 {
 	PurpleChatUserFlags f1 = 0, f2 = 0;
 	PurpleChatUserPrivate *priva, *privb;
-	char *user1 = NULL, *user2 = NULL;
+	const char *user1 = NULL, *user2 = NULL;
 	gint ret = 0;
 
 	priva = PURPLE_CHAT_USER_GET_PRIVATE(a);
@@ -1619,18 +1855,12 @@ purple_chat_user_compare(PurpleChatUser *a, PurpleChatUser *b)
 
 	if (priva) {
 		f1 = priva->flags;
-		if (priva->alias_key)
-			user1 = priva->alias_key;
-		else if (priva->name)
-			user1 = priva->name;
+		user1 = purple_chat_user_get_sort_key(priva);
 	}
 
 	if (privb) {
 		f2 = privb->flags;
-		if (privb->alias_key)
-			user2 = privb->alias_key;
-		else if (privb->name)
-			user2 = privb->name;
+		user2 = purple_chat_user_get_sort_key(privb);
 	}
 
 	if (user1 == NULL || user2 == NULL) {
@@ -1642,7 +1872,7 @@ purple_chat_user_compare(PurpleChatUser *a, PurpleChatUser *b)
 	} else if (priva->buddy != privb->buddy) {
 		ret = priva->buddy ? -1 : 1;
 	} else {
-		ret = purple_utf8_strcasecmp(user1, user2);
+		ret = strcmp(user1, user2);
 	}
 
 	return ret;
@@ -1691,7 +1921,8 @@ purple_chat_user_set_flags(PurpleChatUser *cb,
 
 	ops = purple_conversation_get_ui_ops(PURPLE_CONVERSATION(priv->chat));
 
-	if (ops != NULL && ops->chat_update_user != NULL)
+	/* A queued user reaches the UI with its current flags anyway. */
+	if (!priv->ui_pending && ops != NULL && ops->chat_update_user != NULL)
 		ops->chat_update_user(cb);
 
 	purple_signal_emit(purple_conversations_get_handle(),
@@ -1765,6 +1996,19 @@ purple_chat_user_is_buddy(const PurpleChatUser *cb)
  * GObject code for chat user
  **************************************************************************/
 
+static void
+purple_chat_user_set_alias_internal(PurpleChatUserPrivate *priv,
+		const char *alias)
+{
+	if (priv->alias != priv->name)
+		g_free(priv->alias);
+
+	if (alias != NULL && purple_strequal(alias, priv->name))
+		priv->alias = priv->name;
+	else
+		priv->alias = g_strdup(alias);
+}
+
 /* Set method for GObject properties */
 static void
 purple_chat_user_set_property(GObject *obj, guint param_id, const GValue *value,
@@ -1778,12 +2022,16 @@ purple_chat_user_set_property(GObject *obj, guint param_id, const GValue *value,
 			priv->chat = g_value_get_object(value);
 			break;
 		case CU_PROP_NAME:
+			if (priv->alias == priv->name)
+				priv->alias = g_strdup(priv->alias);
 			g_free(priv->name);
 			priv->name = g_strdup(g_value_get_string(value));
+			g_free(priv->sort_key);
+			priv->sort_key = NULL;
 			break;
 		case CU_PROP_ALIAS:
-			g_free(priv->alias);
-			priv->alias = g_strdup(g_value_get_string(value));
+			purple_chat_user_set_alias_internal(priv,
+					g_value_get_string(value));
 			break;
 		case CU_PROP_FLAGS:
 			priv->flags = g_value_get_flags(value);
@@ -1836,6 +2084,10 @@ purple_chat_user_constructed(GObject *object)
 
 	cb_parent_class->constructed(object);
 
+	/* purple_chat_user_new_internal() fills these in itself. */
+	if (priv->chat == NULL || priv->name == NULL)
+		return;
+
 	account = purple_conversation_get_account(PURPLE_CONVERSATION(priv->chat));
 
 	if (purple_blist_find_buddy(account, priv->name) != NULL)
@@ -1852,8 +2104,9 @@ purple_chat_user_finalize(GObject *object)
 	purple_signal_emit(purple_conversations_get_handle(),
 			"deleting-chat-user", cb);
 
-	g_free(priv->alias);
-	g_free(priv->alias_key);
+	if (priv->alias != priv->name)
+		g_free(priv->alias);
+	g_free(priv->sort_key);
 	g_free(priv->name);
 
 	PURPLE_DBUS_UNREGISTER_POINTER(cb);
@@ -1943,3 +2196,23 @@ purple_chat_user_new(PurpleChatConversation *chat, const char *name,
 
 	return cb;
 }
+
+/*
+ * Creates a chat user without going through the property machinery, for
+ * callers that add users in bulk and already know whether they're a buddy.
+ */
+static PurpleChatUser *
+purple_chat_user_new_internal(PurpleChatConversation *chat, const char *name,
+		const char *alias, PurpleChatUserFlags flags, gboolean buddy)
+{
+	PurpleChatUser *cb = g_object_new(PURPLE_TYPE_CHAT_USER, NULL);
+	PurpleChatUserPrivate *priv = PURPLE_CHAT_USER_GET_PRIVATE(cb);
+
+	priv->chat  = chat;
+	priv->name  = g_strdup(name);
+	priv->flags = flags;
+	purple_chat_user_set_alias_internal(priv, alias);
+	priv->buddy = buddy;
+
+	return cb;
+}
@@ -555,6 +555,10 @@ void purple_chat_conversation_add_user(PurpleChatConversation *chat, const char
  *
  * The data is copied from @users, @extra_msgs, and @flags, so it is up to
  * the caller to free this list after calling this function.
+ *
+ * When @new_arrivals is %FALSE, as for the roster sent when joining a room,
+ * the users are handed to the UI in chunks from the main loop instead of
+ * all at once.  Protocols should pass as many users per call as they can.
  */
 void purple_chat_conversation_add_users(PurpleChatConversation *chat,
 		GList *users, GList *extra_msgs, GList *flags, gboolean new_arrivals);
@@ -32,7 +32,10 @@
 #define PURPLE_HTTP_URL_CREDENTIALS_CHARS "a-z0-9.,~_/*!&%?=+\\^-"
 #define PURPLE_HTTP_MAX_RECV_BUFFER_LEN 10240
 #define PURPLE_HTTP_MAX_READ_BUFFER_LEN 10240
-#define PURPLE_HTTP_GZ_BUFF_LEN 1024
+#define PURPLE_HTTP_RECV_BUFF_LEN 16384
+#define PURPLE_HTTP_GZ_BUFF_LEN 16384
+/* At most that much is reserved up front for a body of a known length. */
+#define PURPLE_HTTP_MAX_CONTENTS_HINT_LEN (16 * PURPLE_HTTP_MAX_RECV_BUFFER_LEN)
 
 #define PURPLE_HTTP_REQUEST_DEFAULT_MAX_REDIRECTS 20
 #define PURPLE_HTTP_REQUEST_DEFAULT_TIMEOUT 30
@@ -41,6 +44,10 @@
 
 #define PURPLE_HTTP_PROGRESS_WATCHER_DEFAULT_INTERVAL 250000
 
+#define PURPLE_HTTP_KEEPALIVE_DEFAULT_LIMIT_PER_HOST 6
+#define PURPLE_HTTP_KEEPALIVE_DEFAULT_IDLE_TIMEOUT 30
+#define PURPLE_HTTP_KEEPALIVE_MAX_PIPELINE 4
+
 typedef struct _PurpleHttpSocket PurpleHttpSocket;
 
 typedef struct _PurpleHttpHeaders PurpleHttpHeaders;
@@ -60,10 +67,18 @@ struct _PurpleHttpSocket
 	GCancellable *cancellable;
 	guint input_source;
 	guint output_source;
+	guint idle_timeout;
 
 	gboolean is_busy;
 	guint use_count;
 	PurpleHttpKeepaliveHost *host;
+
+	/* PurpleHttpConnections using this socket, in the order their requests
+	 * were written. The head one reads its response, the rest is
+	 * pipelined behind it. */
+	GQueue pipeline;
+	/* Data read past the end of the head's response. */
+	GString *pending;
 };
 
 struct _PurpleHttpRequest
@@ -97,6 +112,8 @@ struct _PurpleHttpConnection
 	gboolean is_reading;
 	gboolean is_keepalive;
 	gboolean is_cancelling;
+	gboolean is_socket_spent;
+	gboolean is_paused;
 
 	PurpleHttpURL *url;
 	PurpleHttpRequest *request;
@@ -177,6 +194,8 @@ struct _PurpleHttpKeepaliveRequest
 	PurpleConnection *gc;
 	PurpleHttpSocketConnectCb cb;
 	gpointer user_data;
+	gboolean can_pipeline;
+	gint64 queued_at;
 
 	PurpleHttpKeepaliveHost *host;
 	PurpleHttpSocket *hs;
@@ -186,6 +205,7 @@ struct _PurpleHttpKeepaliveHost
 {
 	PurpleHttpKeepalivePool *pool;
 
+	PurpleConnection *gc;
 	gchar *host;
 	int port;
 	gboolean is_ssl;
@@ -203,6 +223,10 @@ struct _PurpleHttpKeepalivePool
 	int ref_count;
 
 	guint limit_per_host;
+	guint idle_timeout;
+	gboolean pipelining;
+
+	PurpleHttpKeepaliveStats stats;
 
 	/* key: purple_http_socket_hash, value: PurpleHttpKeepaliveHost */
 	GHashTable *by_hash;
@@ -217,7 +241,6 @@ struct _PurpleHttpConnectionSet
 
 struct _PurpleHttpGzStream
 {
-	gboolean failed;
 	GZlibDecompressor *decompressor;
 	gsize max_output;
 	gsize decompressed;
@@ -242,6 +265,7 @@ static time_t purple_http_rfc1123_to_time(const gchar *str);
 
 static gboolean purple_http_request_is_method(PurpleHttpRequest *request,
 	const gchar *method);
+static gboolean purple_http_request_can_pipeline(PurpleHttpRequest *request);
 
 static PurpleHttpConnection * purple_http_connection_new(
 	PurpleHttpRequest *request, PurpleConnection *gc);
@@ -261,11 +285,14 @@ gchar * purple_http_cookie_jar_dump(PurpleHttpCookieJar *cjar);
 static PurpleHttpKeepaliveRequest *
 purple_http_keepalive_pool_request(PurpleHttpKeepalivePool *pool,
 	PurpleConnection *gc, const gchar *host, int port, gboolean is_ssl,
-	PurpleHttpSocketConnectCb cb, gpointer user_data);
+	gboolean can_pipeline, PurpleHttpSocketConnectCb cb,
+	gpointer user_data);
 static void
 purple_http_keepalive_pool_request_cancel(PurpleHttpKeepaliveRequest *req);
 static void
 purple_http_keepalive_pool_release(PurpleHttpSocket *hs, gboolean invalidate);
+static void
+purple_http_keepalive_host_process_queue(PurpleHttpKeepaliveHost *host);
 
 static void
 purple_http_connection_set_remove(PurpleHttpConnectionSet *set,
@@ -297,6 +324,11 @@ static GHashTable *purple_http_cancelling_gc;
  */
 static GHashTable *purple_http_hc_by_ptr;
 
+/*
+ * The pool used by requests, which weren't given any other.
+ */
+static PurpleHttpKeepalivePool *purple_http_default_pool;
+
 /*** Helper functions *********************************************************/
 
 static time_t purple_http_rfc1123_to_time(const gchar *str)
@@ -374,87 +406,6 @@ purple_http_gz_new(gsize max_output, gboolean is_deflate)
 	return gzs;
 }
 
-static GString *
-purple_http_gz_put(PurpleHttpGzStream *gzs, const gchar *buf, gsize len)
-{
-	const gchar *compressed_buff;
-	gsize compressed_len;
-	GString *ret;
-
-	g_return_val_if_fail(gzs != NULL, NULL);
-	g_return_val_if_fail(buf != NULL, NULL);
-
-	if (gzs->failed)
-		return NULL;
-
-	if (gzs->pending) {
-		g_string_append_len(gzs->pending, buf, len);
-		compressed_buff = gzs->pending->str;
-		compressed_len = gzs->pending->len;
-	} else {
-		compressed_buff = buf;
-		compressed_len = len;
-	}
-
-	ret = g_string_new(NULL);
-	while (compressed_len > 0) {
-		GConverterResult gzres;
-		gchar decompressed_buff[PURPLE_HTTP_GZ_BUFF_LEN];
-		gsize decompressed_len = 0;
-		gsize bytes_read = 0;
-		GError *error = NULL;
-
-		gzres = g_converter_convert(G_CONVERTER(gzs->decompressor),
-			       compressed_buff, compressed_len,
-		       	       decompressed_buff, sizeof(decompressed_buff),
-			       G_CONVERTER_NO_FLAGS,
-			       &bytes_read,
-			       &decompressed_len,
-			       &error);
-
-		compressed_buff += bytes_read;
-		compressed_len -= bytes_read;
-
-		if (gzres == G_CONVERTER_CONVERTED || gzres == G_CONVERTER_FINISHED) {
-			if (decompressed_len == 0)
-				break;
-			if (gzs->decompressed + decompressed_len >=
-				gzs->max_output)
-			{
-				purple_debug_warning("http", "Maximum amount of"
-					" decompressed data is reached\n");
-				decompressed_len = gzs->max_output -
-					gzs->decompressed;
-				gzres = G_CONVERTER_FINISHED;
-			}
-			gzs->decompressed += decompressed_len;
-			g_string_append_len(ret, decompressed_buff,
-				decompressed_len);
-			if (gzres == G_CONVERTER_FINISHED)
-				break;
-		} else {
-			purple_debug_error("http",
-				"Decompression failed (%d): %s\n", gzres,
-				error->message);
-			g_clear_error(&error);
-			gzs->failed = TRUE;
-			return NULL;
-		}
-	}
-
-	if (gzs->pending) {
-		g_string_free(gzs->pending, TRUE);
-		gzs->pending = NULL;
-	}
-
-	if (compressed_len > 0) {
-		gzs->pending = g_string_new_len(compressed_buff,
-			compressed_len);
-	}
-
-	return ret;
-}
-
 static void
 purple_http_gz_free(PurpleHttpGzStream *gzs)
 {
@@ -519,9 +470,13 @@ purple_http_ntlm_gen_type1(const gchar *hostname, const gchar *domain)
 /*** HTTP Sockets *************************************************************/
 
 static gchar *
-purple_http_socket_hash(const gchar *host, int port, gboolean is_ssl)
+purple_http_socket_hash(PurpleConnection *gc, const gchar *host, int port,
+	gboolean is_ssl)
 {
-	return g_strdup_printf("%c:%s:%d", (is_ssl ? 'S' : 'R'), host, port);
+	/* Sockets go through the account's proxy, so they aren't shared
+	 * between connections. */
+	return g_strdup_printf("%c:%p:%s:%d", (is_ssl ? 'S' : 'R'), (void *)gc,
+		host, port);
 }
 
 static void
@@ -612,6 +567,11 @@ purple_http_socket_close_free(PurpleHttpSocket *hs)
 		hs->output_source = 0;
 	}
 
+	if (hs->idle_timeout > 0) {
+		g_source_remove(hs->idle_timeout);
+		hs->idle_timeout = 0;
+	}
+
 	if (hs->cancellable != NULL) {
 		g_cancellable_cancel(hs->cancellable);
 		g_clear_object(&hs->cancellable);
@@ -622,9 +582,52 @@ purple_http_socket_close_free(PurpleHttpSocket *hs)
 		g_clear_object(&hs->conn);
 	}
 
+	g_queue_clear(&hs->pipeline);
+	if (hs->pending != NULL)
+		g_string_free(hs->pending, TRUE);
+
 	g_free(hs);
 }
 
+/* Puts back data, which was read past the end of a response. */
+static void
+purple_http_socket_unread(PurpleHttpSocket *hs, const gchar *buf, gsize len)
+{
+	if (len == 0)
+		return;
+
+	if (hs->pending == NULL)
+		hs->pending = g_string_sized_new(len);
+	g_string_prepend_len(hs->pending, buf, len);
+}
+
+static gboolean
+purple_http_socket_can_pipeline(PurpleHttpSocket *hs)
+{
+	GList *it;
+
+	if (!hs->is_busy || hs->output_source > 0)
+		return FALSE;
+	if (g_queue_is_empty(&hs->pipeline) ||
+		g_queue_get_length(&hs->pipeline) >=
+		PURPLE_HTTP_KEEPALIVE_MAX_PIPELINE)
+	{
+		return FALSE;
+	}
+
+	for (it = hs->pipeline.head; it != NULL; it = g_list_next(it)) {
+		PurpleHttpConnection *hc = it->data;
+
+		if (!hc->is_reading || hc->is_socket_spent ||
+			!purple_http_request_can_pipeline(hc->request))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 /*** Headers collection *******************************************************/
 
 static PurpleHttpHeaders * purple_http_headers_new(void);
@@ -1013,6 +1016,8 @@ static gboolean _purple_http_recv_headers(PurpleHttpConnection *hc,
 				_purple_http_error(hc, _("Error parsing HTTP"));
 				return FALSE;
 			}
+			hc->is_socket_spent = (g_ascii_strncasecmp(hdrline,
+				"HTTP/1.0 ", 9) == 0);
 			if (purple_debug_is_verbose())
 				purple_debug_misc("http",
 					"Got main header with code %d\n",
@@ -1043,30 +1048,10 @@ static gboolean _purple_http_recv_headers(PurpleHttpConnection *hc,
 	return TRUE;
 }
 
-static gboolean _purple_http_recv_body_data(PurpleHttpConnection *hc,
+/* Passes the (decompressed) data to the response writer or the contents. */
+static gboolean _purple_http_recv_body_decoded(PurpleHttpConnection *hc,
 	const gchar *buf, int len)
 {
-	GString *decompressed = NULL;
-
-	if (hc->length_expected >= 0 &&
-		len + hc->length_got > (guint)hc->length_expected)
-	{
-		len = hc->length_expected - hc->length_got;
-	}
-
-	hc->length_got += len;
-
-	if (hc->gz_stream != NULL) {
-		decompressed = purple_http_gz_put(hc->gz_stream, buf, len);
-		if (decompressed == NULL) {
-			_purple_http_error(hc,
-				_("Error while decompressing data"));
-			return FALSE;
-		}
-		buf = decompressed->str;
-		len = decompressed->len;
-	}
-
 	g_assert(hc->request->max_length <=
 		PURPLE_HTTP_REQUEST_HARD_MAX_LENGTH);
 	if (hc->length_got_decompressed + len > hc->request->max_length) {
@@ -1074,14 +1059,13 @@ static gboolean _purple_http_recv_body_data(PurpleHttpConnection *hc,
 			"Maximum length exceeded, truncating\n");
 		len = hc->request->max_length - hc->length_got_decompressed;
 		hc->length_expected = hc->length_got;
+		/* The rest of the body is still on the way. */
+		hc->is_socket_spent = TRUE;
 	}
 	hc->length_got_decompressed += len;
 
-	if (len == 0) {
-		if (decompressed != NULL)
-			g_string_free(decompressed, TRUE);
+	if (len == 0)
 		return TRUE;
-	}
 
 	if (hc->request->response_writer != NULL) {
 		gboolean succ;
@@ -1089,8 +1073,6 @@ static gboolean _purple_http_recv_body_data(PurpleHttpConnection *hc,
 			hc->length_got_decompressed, len,
 			hc->request->response_writer_data);
 		if (!succ) {
-			if (decompressed != NULL)
-				g_string_free(decompressed, TRUE);
 			purple_debug_error("http",
 				"Cannot write using callback\n");
 			_purple_http_error(hc,
@@ -1098,22 +1080,141 @@ static gboolean _purple_http_recv_body_data(PurpleHttpConnection *hc,
 			return FALSE;
 		}
 	} else {
-		if (hc->response->contents == NULL)
-			hc->response->contents = g_string_new("");
+		if (hc->response->contents == NULL) {
+			gsize expected = 0;
+
+			/* Avoid copying bodies around while growing, but
+			 * only reserve so much on the server's word; larger
+			 * ones grow as the data arrives. */
+			if (hc->gz_stream == NULL && hc->length_expected > 0) {
+				expected = MIN((guint)hc->length_expected,
+					hc->request->max_length);
+				expected = MIN(expected,
+					PURPLE_HTTP_MAX_CONTENTS_HINT_LEN);
+			}
+			hc->response->contents = g_string_sized_new(expected);
+		}
 		g_string_append_len(hc->response->contents, buf, len);
 	}
 
-	if (decompressed != NULL)
-		g_string_free(decompressed, TRUE);
-
 	purple_http_conn_notify_progress_watcher(hc);
 	return TRUE;
 }
 
+/* Decompresses the data block by block, straight to the response writer or
+ * the contents. */
+static gboolean _purple_http_recv_body_inflate(PurpleHttpConnection *hc,
+	const gchar *buf, gsize len)
+{
+	PurpleHttpGzStream *gzs = hc->gz_stream;
+	const gchar *compressed_buff = buf;
+	gsize compressed_len = len;
+
+	if (gzs->pending != NULL) {
+		g_string_append_len(gzs->pending, buf, len);
+		if (gzs->pending->len > PURPLE_HTTP_MAX_RECV_BUFFER_LEN) {
+			purple_debug_error("http",
+				"Buffer too big when decompressing data\n");
+			_purple_http_error(hc,
+				_("Error while decompressing data"));
+			return FALSE;
+		}
+		compressed_buff = gzs->pending->str;
+		compressed_len = gzs->pending->len;
+	}
+
+	while (compressed_len > 0) {
+		GConverterResult gzres;
+		gchar decompressed_buff[PURPLE_HTTP_GZ_BUFF_LEN];
+		gsize decompressed_len = 0;
+		gsize bytes_read = 0;
+		GError *error = NULL;
+
+		gzres = g_converter_convert(G_CONVERTER(gzs->decompressor),
+			compressed_buff, compressed_len,
+			decompressed_buff, sizeof(decompressed_buff),
+			G_CONVERTER_NO_FLAGS,
+			&bytes_read,
+			&decompressed_len,
+			&error);
+
+		compressed_buff += bytes_read;
+		compressed_len -= bytes_read;
+
+		if (gzres != G_CONVERTER_CONVERTED &&
+			gzres != G_CONVERTER_FINISHED)
+		{
+			purple_debug_error("http",
+				"Decompression failed (%d): %s\n", gzres,
+				error->message);
+			g_clear_error(&error);
+			_purple_http_error(hc,
+				_("Error while decompressing data"));
+			return FALSE;
+		}
+
+		if (decompressed_len == 0)
+			break;
+		if (gzs->decompressed + decompressed_len >= gzs->max_output) {
+			purple_debug_warning("http", "Maximum amount of "
+				"decompressed data is reached\n");
+			decompressed_len = gzs->max_output - gzs->decompressed;
+			gzres = G_CONVERTER_FINISHED;
+		}
+		gzs->decompressed += decompressed_len;
+
+		if (!_purple_http_recv_body_decoded(hc, decompressed_buff,
+			decompressed_len))
+		{
+			return FALSE;
+		}
+
+		if (gzres == G_CONVERTER_FINISHED)
+			break;
+	}
+
+	if (compressed_len == 0) {
+		if (gzs->pending != NULL) {
+			g_string_free(gzs->pending, TRUE);
+			gzs->pending = NULL;
+		}
+	} else if (gzs->pending == NULL) {
+		gzs->pending = g_string_new_len(compressed_buff,
+			compressed_len);
+	} else {
+		g_string_erase(gzs->pending, 0,
+			compressed_buff - gzs->pending->str);
+	}
+
+	return TRUE;
+}
+
+static gboolean _purple_http_recv_body_data(PurpleHttpConnection *hc,
+	const gchar *buf, int len)
+{
+	if (hc->length_expected >= 0 &&
+		len + hc->length_got > (guint)hc->length_expected)
+	{
+		int body_len = hc->length_expected - hc->length_got;
+
+		/* The rest is the beginning of a pipelined response. */
+		purple_http_socket_unread(hc->socket, buf + body_len,
+			len - body_len);
+		len = body_len;
+	}
+
+	hc->length_got += len;
+
+	if (hc->gz_stream != NULL)
+		return _purple_http_recv_body_inflate(hc, buf, len);
+
+	return _purple_http_recv_body_decoded(hc, buf, len);
+}
+
 static gboolean _purple_http_recv_body_chunked(PurpleHttpConnection *hc,
 	const gchar *buf, int len)
 {
-	gchar *eol, *line;
+	const gchar *eol;
 	int line_len;
 
 	if (hc->chunks_done)
@@ -1121,38 +1222,30 @@ static gboolean _purple_http_recv_body_chunked(PurpleHttpConnection *hc,
 	if (!hc->response_buffer)
 		hc->response_buffer = g_string_new("");
 
-	g_string_append_len(hc->response_buffer, buf, len);
-	if (hc->response_buffer->len > PURPLE_HTTP_MAX_RECV_BUFFER_LEN) {
-		purple_debug_error("http",
-			"Buffer too big when searching for chunk\n");
-		_purple_http_error(hc, _("Error parsing HTTP"));
-		return FALSE;
-	}
-
-	while (hc->response_buffer->len > 0) {
+	while (len > 0) {
 		if (hc->in_chunk) {
-			int got_now = hc->response_buffer->len;
-			if (hc->chunk_got + got_now > hc->chunk_length)
-				got_now = hc->chunk_length - hc->chunk_got;
+			int got_now = MIN(len, hc->chunk_length - hc->chunk_got);
 			hc->chunk_got += got_now;
 
-			if (!_purple_http_recv_body_data(hc,
-				hc->response_buffer->str, got_now))
+			/* Chunk data is passed on without buffering. */
+			if (!_purple_http_recv_body_data(hc, buf, got_now))
 				return FALSE;
 
-			g_string_erase(hc->response_buffer, 0, got_now);
+			buf += got_now;
+			len -= got_now;
 			hc->in_chunk = (hc->chunk_got < hc->chunk_length);
 
 			continue;
 		}
 
-		line = hc->response_buffer->str;
-		eol = strstr(line, "\r\n");
-		if (eol == line) {
-			g_string_erase(hc->response_buffer, 0, 2);
-			line = hc->response_buffer->str;
-			eol = strstr(line, "\r\n");
-		}
+		/* Only the chunk length line is buffered, it may be split
+		 * between reads. */
+		eol = memchr(buf, '\n', len);
+		line_len = (eol != NULL) ? eol - buf + 1 : len;
+		g_string_append_len(hc->response_buffer, buf, line_len);
+		buf += line_len;
+		len -= line_len;
+
 		if (eol == NULL) {
 			/* waiting for more data (unlikely, but possible) */
 			if (hc->response_buffer->len > 20) {
@@ -1163,13 +1256,23 @@ static gboolean _purple_http_recv_body_chunked(PurpleHttpConnection *hc,
 			}
 			return TRUE;
 		}
-		line_len = eol - line;
 
-		if (1 != sscanf(line, "%x", &hc->chunk_length)) {
+		/* The line break after the previous chunk. */
+		if (hc->response_buffer->str[strspn(hc->response_buffer->str,
+			"\r\n")] == '\0')
+		{
+			g_string_truncate(hc->response_buffer, 0);
+			continue;
+		}
+
+		if (1 != sscanf(hc->response_buffer->str, "%x",
+			&hc->chunk_length) || hc->chunk_length < 0)
+		{
+			g_strchomp(hc->response_buffer->str);
 			if (purple_debug_is_unsafe())
 				purple_debug_warning("http",
 					"Chunk length not found in [%s]\n",
-					line);
+					hc->response_buffer->str);
 			else
 				purple_debug_warning("http",
 					"Chunk length not found\n");
@@ -1182,11 +1285,13 @@ static gboolean _purple_http_recv_body_chunked(PurpleHttpConnection *hc,
 		if (purple_debug_is_verbose())
 			purple_debug_misc("http", "Found chunk of length %d\n", hc->chunk_length);
 
-		g_string_erase(hc->response_buffer, 0, line_len + 2);
+		g_string_truncate(hc->response_buffer, 0);
 
 		if (hc->chunk_length == 0) {
 			hc->chunks_done = TRUE;
 			hc->in_chunk = FALSE;
+			/* Keep the rest for the next pipelined response. */
+			g_string_append_len(hc->response_buffer, buf, len);
 			return TRUE;
 		}
 	}
@@ -1206,16 +1311,31 @@ static gboolean _purple_http_recv_body(PurpleHttpConnection *hc,
 static gboolean _purple_http_recv_loopbody(PurpleHttpConnection *hc)
 {
 	int len;
-	gchar buf[4096];
+	gchar buf[PURPLE_HTTP_RECV_BUFF_LEN];
 	gboolean got_anything;
 	GError *error = NULL;
+	GString *pending = hc->socket->pending;
+
+	/* The response writer asked to stop for a while. */
+	if (hc->is_paused)
+		return FALSE;
 
-	len = g_pollable_input_stream_read_nonblocking(
+	if (pending != NULL) {
+		len = MIN(pending->len, sizeof(buf));
+		memcpy(buf, pending->str, len);
+		g_string_erase(pending, 0, len);
+		if (pending->len == 0) {
+			g_string_free(pending, TRUE);
+			hc->socket->pending = NULL;
+		}
+	} else {
+		len = g_pollable_input_stream_read_nonblocking(
 				G_POLLABLE_INPUT_STREAM(
 				g_io_stream_get_input_stream(
 				G_IO_STREAM(hc->socket->conn))),
 				buf, sizeof(buf), hc->socket->cancellable,
 				&error);
+	}
 	got_anything = (len > 0);
 
 	if (len < 0 && (g_error_matches(error,
@@ -1235,6 +1355,7 @@ static gboolean _purple_http_recv_loopbody(PurpleHttpConnection *hc)
 
 	/* EOF */
 	if (len == 0) {
+		hc->is_socket_spent = TRUE;
 		if (hc->request->max_length == 0) {
 			/* It's definitely YHttpServer quirk. */
 			purple_debug_warning("http", "Got EOF, but no data was "
@@ -1283,6 +1404,16 @@ static gboolean _purple_http_recv_loopbody(PurpleHttpConnection *hc)
 		len = 0;
 		if (hc->headers_got) {
 			gboolean is_gzip, is_deflate;
+			if (purple_http_headers_match(hc->response->headers,
+				"Connection", "close"))
+			{
+				hc->is_socket_spent = TRUE;
+			} else if (purple_http_headers_match(
+				hc->response->headers, "Connection",
+				"keep-alive"))
+			{
+				hc->is_socket_spent = FALSE;
+			}
 			if (!purple_http_headers_get_int(hc->response->headers,
 				"Content-Length", &hc->length_expected))
 				hc->length_expected = -1;
@@ -1306,9 +1437,13 @@ static gboolean _purple_http_recv_loopbody(PurpleHttpConnection *hc)
 		{
 			int buffer_len = hc->response_buffer->len;
 			gchar *buffer = g_string_free(hc->response_buffer, FALSE);
+			gboolean succ;
+
 			hc->response_buffer = NULL;
-			_purple_http_recv_body(hc, buffer, buffer_len);
+			succ = _purple_http_recv_body(hc, buffer, buffer_len);
 			g_free(buffer);
+			if (!succ)
+				return FALSE;
 		}
 		if (!hc->headers_got)
 			return got_anything;
@@ -1339,6 +1474,17 @@ static gboolean _purple_http_recv_loopbody(PurpleHttpConnection *hc)
 			return TRUE;
 		}
 
+		/* Whatever follows the last chunk belongs to the next
+		 * pipelined response. */
+		if (hc->response_buffer != NULL &&
+			hc->response_buffer->len > 0)
+		{
+			purple_http_socket_unread(hc->socket,
+				hc->response_buffer->str,
+				hc->response_buffer->len);
+			g_string_truncate(hc->response_buffer, 0);
+		}
+
 		if (!hc->headers_got) {
 			hc->response->code = 0;
 			purple_debug_warning("http", "No headers got\n");
@@ -1417,6 +1563,53 @@ static gboolean _purple_http_recv(GObject *source, gpointer _hc)
 	return G_SOURCE_CONTINUE;
 }
 
+static void _purple_http_watch_input(PurpleHttpConnection *hc)
+{
+	GSource *gsource;
+
+	gsource = g_pollable_input_stream_create_source(
+			G_POLLABLE_INPUT_STREAM(
+			g_io_stream_get_input_stream(
+			G_IO_STREAM(hc->socket->conn))),
+			NULL);
+	g_source_set_callback(gsource,
+		(GSourceFunc)_purple_http_recv, hc, NULL);
+	hc->socket->input_source = g_source_attach(gsource, NULL);
+	g_source_unref(gsource);
+}
+
+static gboolean _purple_http_recv_pending(gpointer _hc)
+{
+	PurpleHttpConnection *hc = _hc;
+
+	hc->socket->input_source = 0;
+	_purple_http_watch_input(hc);
+
+	while (_purple_http_recv_loopbody(hc));
+
+	return G_SOURCE_REMOVE;
+}
+
+static void _purple_http_start_reading(PurpleHttpConnection *hc)
+{
+	GSource *gsource;
+
+	if (hc->is_paused)
+		return;
+
+	if (hc->socket->pending == NULL) {
+		_purple_http_watch_input(hc);
+		return;
+	}
+
+	/* The previous response was followed by (a part of) this one, which
+	 * won't make the socket readable again. */
+	gsource = g_idle_source_new();
+	g_source_set_callback(gsource, _purple_http_recv_pending, hc, NULL);
+	hc->socket->input_source = g_source_attach(gsource, NULL);
+	g_source_unref(gsource);
+}
+
 static void _purple_http_send_got_data(PurpleHttpConnection *hc,
 	gboolean success, gboolean eof, size_t stored)
 {
@@ -1452,7 +1645,7 @@ static gboolean _purple_http_send(GObject *source, gpointer _hc)
 	const gchar *write_from;
 	gboolean writing_headers;
 	GError *error = NULL;
-	GSource *gsource;
+	PurpleHttpSocket *hs;
 
 	/* Waiting for data. This could be written more efficiently, by removing
 	 * (and later, adding) hs->inpa. */
@@ -1550,22 +1743,58 @@ static gboolean _purple_http_send(GObject *source, gpointer _hc)
 		}
 	}
 
-	/* request is completely written, let's read the response */
+	/* request is completely written, let's read the response (unless it's
+	 * pipelined behind another one) */
 	hc->is_reading = TRUE;
-	gsource = g_pollable_input_stream_create_source(
-			G_POLLABLE_INPUT_STREAM(
-			g_io_stream_get_input_stream(
-			G_IO_STREAM(hc->socket->conn))),
-			NULL);
-	g_source_set_callback(gsource,
-		(GSourceFunc)_purple_http_recv, hc, NULL);
-	hc->socket->input_source = g_source_attach(gsource, NULL);
-	g_source_unref(gsource);
+	hs = hc->socket;
+	if (g_queue_peek_head(&hs->pipeline) == hc)
+		_purple_http_start_reading(hc);
+
+	hs->output_source = 0;
+
+	/* Another request may be pipelined now. */
+	if (hs->host != NULL && hs->host->pool->pipelining)
+		purple_http_keepalive_host_process_queue(hs->host);
 
-	hc->socket->output_source = 0;
 	return G_SOURCE_REMOVE;
 }
 
+/* Sends requests, which were pipelined on a broken socket, again. The one
+ * whose response was being read can't be retried, once part of its body
+ * went out to the caller. */
+static void _purple_http_pipeline_abort(PurpleHttpSocket *hs)
+{
+	GList *waiting, *it;
+
+	waiting = hs->pipeline.head;
+	g_queue_init(&hs->pipeline);
+
+	for (it = waiting; it != NULL; it = g_list_next(it)) {
+		PurpleHttpConnection *hc = it->data;
+		hc->socket = NULL;
+	}
+
+	for (it = waiting; it != NULL; it = g_list_next(it)) {
+		PurpleHttpConnection *hc = it->data;
+
+		/* It might be cancelled by a callback of a previous one. */
+		if (!purple_http_conn_is_running(hc))
+			continue;
+
+		if (it == waiting && hc->length_got > 0) {
+			_purple_http_error(hc, _("Error reading from %s: %s"),
+				hc->url->host, _("Connection lost"));
+			continue;
+		}
+
+		purple_debug_info("http", "Pipelined connection lost, "
+			"retrying...\n");
+		purple_http_conn_retry(hc);
+	}
+
+	g_list_free(waiting);
+}
+
 static void _purple_http_disconnect(PurpleHttpConnection *hc,
 	gboolean is_graceful)
 {
@@ -1581,9 +1810,36 @@ static void _purple_http_disconnect(PurpleHttpConnection *hc,
 
 	if (hc->socket_request)
 		purple_http_keepalive_pool_request_cancel(hc->socket_request);
-	else {
-		purple_http_keepalive_pool_release(hc->socket, !is_graceful);
+	else if (hc->socket != NULL) {
+		PurpleHttpSocket *hs = hc->socket;
+
+		/* The socket may be reused only after a complete response (and
+		 * the responses pipelined behind it are still awaited). */
+		if (g_queue_peek_head(&hs->pipeline) != hc ||
+			hc->is_socket_spent)
+		{
+			is_graceful = FALSE;
+		}
+		g_queue_remove(&hs->pipeline, hc);
 		hc->socket = NULL;
+
+		if (!is_graceful)
+			_purple_http_pipeline_abort(hs);
+		else if (!g_queue_is_empty(&hs->pipeline)) {
+			PurpleHttpConnection *next;
+
+			if (hs->input_source > 0) {
+				g_source_remove(hs->input_source);
+				hs->input_source = 0;
+			}
+
+			next = g_queue_peek_head(&hs->pipeline);
+			if (next->is_reading)
+				_purple_http_start_reading(next);
+			return;
+		}
+
+		purple_http_keepalive_pool_release(hs, !is_graceful);
 	}
 }
 
@@ -1602,6 +1858,8 @@ _purple_http_connected(PurpleHttpSocket *hs, const gchar *error, gpointer _hc)
 		return;
 	}
 
+	g_queue_push_tail(&hs->pipeline, hc);
+
 	source = g_pollable_output_stream_create_source(
 			G_POLLABLE_OUTPUT_STREAM(
 			g_io_stream_get_output_stream(G_IO_STREAM(hs->conn))),
@@ -1648,7 +1906,9 @@ static gboolean _purple_http_reconnect(PurpleHttpConnection *hc)
 	if (hc->request->keepalive_pool != NULL) {
 		hc->socket_request = purple_http_keepalive_pool_request(
 			hc->request->keepalive_pool, hc->gc, url->host,
-			url->port, is_ssl, _purple_http_connected, hc);
+			url->port, is_ssl,
+			purple_http_request_can_pipeline(hc->request),
+			_purple_http_connected, hc);
 	} else {
 		hc->socket = purple_http_socket_connect_new(hc->gc, url->host,
 			url->port, is_ssl, _purple_http_connected, hc);
@@ -1667,6 +1927,10 @@ static gboolean _purple_http_reconnect(PurpleHttpConnection *hc)
 	if (hc->response->contents != NULL)
 		g_string_free(hc->response->contents, TRUE);
 	hc->response->contents = NULL;
+	purple_http_gz_free(hc->gz_stream);
+	hc->gz_stream = NULL;
+	hc->is_reading = FALSE;
+	hc->is_socket_spent = FALSE;
 	hc->length_got = 0;
 	hc->length_got_decompressed = 0;
 	hc->length_expected = -1;
@@ -1881,6 +2145,57 @@ void purple_http_conn_cancel(PurpleHttpConnection *http_conn)
 	purple_http_connection_terminate(http_conn);
 }
 
+void purple_http_conn_pause(PurpleHttpConnection *http_conn)
+{
+	PurpleHttpSocket *hs;
+
+	g_return_if_fail(http_conn != NULL);
+
+	if (http_conn->is_paused)
+		return;
+	http_conn->is_paused = TRUE;
+
+	hs = http_conn->socket;
+	if (hs == NULL || !http_conn->is_reading ||
+		g_queue_peek_head(&hs->pipeline) != http_conn)
+	{
+		return;
+	}
+
+	if (hs->input_source > 0) {
+		g_source_remove(hs->input_source);
+		hs->input_source = 0;
+	}
+}
+
+void purple_http_conn_resume(PurpleHttpConnection *http_conn)
+{
+	PurpleHttpSocket *hs;
+
+	g_return_if_fail(http_conn != NULL);
+
+	if (!http_conn->is_paused)
+		return;
+	http_conn->is_paused = FALSE;
+
+	hs = http_conn->socket;
+	if (hs == NULL || !http_conn->is_reading ||
+		g_queue_peek_head(&hs->pipeline) != http_conn)
+	{
+		return;
+	}
+
+	if (hs->input_source == 0)
+		_purple_http_start_reading(http_conn);
+}
+
+gboolean purple_http_conn_is_paused(PurpleHttpConnection *http_conn)
+{
+	g_return_val_if_fail(http_conn != NULL, FALSE);
+
+	return http_conn->is_paused;
+}
+
 static void
 purple_http_conn_retry(PurpleHttpConnection *http_conn)
 {
@@ -1894,6 +2209,15 @@ purple_http_conn_retry(PurpleHttpConnection *http_conn)
 	_purple_http_reconnect(http_conn);
 }
 
+static gboolean
+purple_http_keepalive_host_is_for_gc(gpointer hash, gpointer _host,
+	gpointer gc)
+{
+	PurpleHttpKeepaliveHost *host = _host;
+
+	return (host->gc == gc);
+}
+
 void purple_http_conn_cancel_all(PurpleConnection *gc)
 {
 	GList *gc_list;
@@ -1918,6 +2242,12 @@ void purple_http_conn_cancel_all(PurpleConnection *gc)
 	if (NULL != g_hash_table_lookup(purple_http_hc_by_gc, gc))
 		purple_debug_fatal("http", "Couldn't cancel all connections "
 			"related to gc=%p (it shouldn't happen)\n", gc);
+
+	/* Close the sockets kept open for this connection. */
+	if (gc != NULL && purple_http_default_pool != NULL) {
+		g_hash_table_foreach_remove(purple_http_default_pool->by_hash,
+			purple_http_keepalive_host_is_for_gc, gc);
+	}
 }
 
 gboolean purple_http_conn_is_running(PurpleHttpConnection *http_conn)
@@ -2246,9 +2576,6 @@ gboolean purple_http_cookie_jar_is_empty(PurpleHttpCookieJar *cookie_jar)
 
 /*** HTTP Keep-Alive pool API *************************************************/
 
-static void
-purple_http_keepalive_host_process_queue(PurpleHttpKeepaliveHost *host);
-
 static void
 purple_http_keepalive_host_free(gpointer _host)
 {
@@ -2270,6 +2597,112 @@ purple_http_keepalive_host_free(gpointer _host)
 	g_free(host);
 }
 
+/* Closes an idle socket and forgets the host, if it isn't used anymore. */
+static void
+purple_http_keepalive_host_drop(PurpleHttpKeepaliveHost *host,
+	PurpleHttpSocket *hs)
+{
+	PurpleHttpKeepalivePool *pool = host->pool;
+	gchar *hash;
+
+	host->sockets = g_slist_remove(host->sockets, hs);
+	purple_http_socket_close_free(hs);
+
+	if (host->sockets != NULL || host->queue != NULL || pool->is_destroying)
+		return;
+
+	hash = purple_http_socket_hash(host->gc, host->host, host->port,
+		host->is_ssl);
+	g_hash_table_remove(pool->by_hash, hash);
+	g_free(hash);
+}
+
+static gboolean
+_purple_http_keepalive_socket_idle_read(GObject *source, gpointer _hs)
+{
+	PurpleHttpSocket *hs = _hs;
+	gchar buf[64];
+	gssize len;
+	GError *error = NULL;
+
+	/* Line breaks may trail behind the previous response, anything else
+	 * means the server closed (or broke) the connection. */
+	while ((len = g_pollable_input_stream_read_nonblocking(
+		G_POLLABLE_INPUT_STREAM(source), buf, sizeof(buf),
+		hs->cancellable, &error)) > 0)
+	{
+		gssize i;
+
+		for (i = 0; i < len && (buf[i] == '\r' || buf[i] == '\n'); i++);
+		if (i < len)
+			break;
+	}
+
+	if (len < 0 && g_error_matches(error,
+		G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+	{
+		g_clear_error(&error);
+		return G_SOURCE_CONTINUE;
+	}
+	g_clear_error(&error);
+
+	if (purple_debug_is_verbose())
+		purple_debug_misc("http", "idle socket closed: %p\n", hs);
+
+	hs->input_source = 0;
+	purple_http_keepalive_host_drop(hs->host, hs);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_purple_http_keepalive_socket_idle_timeout(gpointer _hs)
+{
+	PurpleHttpSocket *hs = _hs;
+
+	if (purple_debug_is_verbose())
+		purple_debug_misc("http", "idle socket expired: %p\n", hs);
+
+	hs->idle_timeout = 0;
+	purple_http_keepalive_host_drop(hs->host, hs);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+purple_http_keepalive_socket_set_idle(PurpleHttpSocket *hs, gboolean idle)
+{
+	GSource *source;
+
+	if (hs->idle_timeout > 0) {
+		g_source_remove(hs->idle_timeout);
+		hs->idle_timeout = 0;
+	}
+
+	if (hs->input_source > 0) {
+		g_source_remove(hs->input_source);
+		hs->input_source = 0;
+	}
+
+	if (!idle || hs->conn == NULL)
+		return;
+
+	source = g_pollable_input_stream_create_source(
+			G_POLLABLE_INPUT_STREAM(
+			g_io_stream_get_input_stream(G_IO_STREAM(hs->conn))),
+			NULL);
+	g_source_set_callback(source,
+		(GSourceFunc)_purple_http_keepalive_socket_idle_read, hs, NULL);
+	hs->input_source = g_source_attach(source, NULL);
+	g_source_unref(source);
+
+	if (hs->host->pool->idle_timeout > 0) {
+		hs->idle_timeout = g_timeout_add_seconds(
+			hs->host->pool->idle_timeout,
+			_purple_http_keepalive_socket_idle_timeout, hs);
+	}
+}
+
 PurpleHttpKeepalivePool *
 purple_http_keepalive_pool_new(void)
 {
@@ -2318,10 +2751,17 @@ purple_http_keepalive_pool_unref(PurpleHttpKeepalivePool *pool)
 	return NULL;
 }
 
+PurpleHttpKeepalivePool *
+purple_http_keepalive_pool_get_default(void)
+{
+	return purple_http_default_pool;
+}
+
 static PurpleHttpKeepaliveRequest *
 purple_http_keepalive_pool_request(PurpleHttpKeepalivePool *pool,
 	PurpleConnection *gc, const gchar *host, int port, gboolean is_ssl,
-	PurpleHttpSocketConnectCb cb, gpointer user_data)
+	gboolean can_pipeline, PurpleHttpSocketConnectCb cb,
+	gpointer user_data)
 {
 	PurpleHttpKeepaliveRequest *req;
 	PurpleHttpKeepaliveHost *kahost;
@@ -2335,12 +2775,13 @@ purple_http_keepalive_pool_request(PurpleHttpKeepalivePool *pool,
 		return NULL;
 	}
 
-	hash = purple_http_socket_hash(host, port, is_ssl);
+	hash = purple_http_socket_hash(gc, host, port, is_ssl);
 	kahost = g_hash_table_lookup(pool->by_hash, hash);
 
 	if (kahost == NULL) {
 		kahost = g_new0(PurpleHttpKeepaliveHost, 1);
 		kahost->pool = pool;
+		kahost->gc = gc;
 		kahost->host = g_strdup(host);
 		kahost->port = port;
 		kahost->is_ssl = is_ssl;
@@ -2354,9 +2795,12 @@ purple_http_keepalive_pool_request(PurpleHttpKeepalivePool *pool,
 	req->gc = gc;
 	req->cb = cb;
 	req->user_data = user_data;
+	req->can_pipeline = can_pipeline;
+	req->queued_at = g_get_monotonic_time();
 	req->host = kahost;
 
 	kahost->queue = g_slist_append(kahost->queue, req);
+	pool->stats.requests++;
 
 	purple_http_keepalive_host_process_queue(kahost);
 
@@ -2376,14 +2820,39 @@ _purple_http_keepalive_socket_connected(PurpleHttpSocket *hs,
 	g_free(req);
 }
 
+static PurpleHttpSocket *
+purple_http_keepalive_host_find_pipeline(PurpleHttpKeepaliveHost *host)
+{
+	PurpleHttpSocket *best = NULL;
+	GSList *it;
+
+	for (it = host->sockets; it != NULL; it = g_slist_next(it)) {
+		PurpleHttpSocket *hs = it->data;
+
+		if (!purple_http_socket_can_pipeline(hs))
+			continue;
+
+		if (best == NULL || g_queue_get_length(&hs->pipeline) <
+			g_queue_get_length(&best->pipeline))
+		{
+			best = hs;
+		}
+	}
+
+	return best;
+}
+
 static gboolean
 _purple_http_keepalive_host_process_queue_cb(gpointer _host)
 {
 	PurpleHttpKeepaliveRequest *req;
 	PurpleHttpKeepaliveHost *host = _host;
+	PurpleHttpKeepalivePool *pool;
 	PurpleHttpSocket *hs = NULL;
 	GSList *it;
 	guint sockets_count;
+	gboolean is_pipelined = FALSE;
+	gint64 wait;
 
 	g_return_val_if_fail(host != NULL, FALSE);
 
@@ -2407,25 +2876,45 @@ _purple_http_keepalive_host_process_queue_cb(gpointer _host)
 		it = g_slist_next(it);
 	}
 
-	/* There are no free sockets and we cannot create another one. */
-	if (hs == NULL && sockets_count >= host->pool->limit_per_host &&
-		host->pool->limit_per_host > 0)
+	pool = host->pool;
+	req = host->queue->data;
+
+	/* There are no free sockets and we cannot create another one, but we
+	 * may send the request behind another one. */
+	if (hs == NULL && sockets_count >= pool->limit_per_host &&
+		pool->limit_per_host > 0)
 	{
-		return FALSE;
+		if (pool->pipelining && req->can_pipeline)
+			hs = purple_http_keepalive_host_find_pipeline(host);
+		if (hs == NULL)
+			return FALSE;
+		is_pipelined = TRUE;
 	}
 
-	req = host->queue->data;
 	host->queue = g_slist_remove(host->queue, req);
 
+	wait = g_get_monotonic_time() - req->queued_at;
+	pool->stats.queue_wait += wait;
+	pool->stats.queue_wait_max = MAX(pool->stats.queue_wait_max, wait);
+
 	if (hs != NULL) {
 		if (purple_debug_is_verbose()) {
 			purple_debug_misc("http", "locking a (previously used) "
-				"socket: %p\n", hs);
+				"socket%s: %p\n",
+				is_pipelined ? " for pipelining" : "", hs);
 		}
 
+		if (!is_pipelined)
+			purple_http_keepalive_socket_set_idle(hs, FALSE);
 		hs->is_busy = TRUE;
 		hs->use_count++;
 
+		pool->stats.reused++;
+		if (is_pipelined)
+			pool->stats.pipelined++;
+		if (host->is_ssl)
+			pool->stats.handshakes_saved++;
+
 		purple_http_keepalive_host_process_queue(host);
 
 		req->cb(hs, NULL, req->user_data);
@@ -2445,6 +2934,7 @@ _purple_http_keepalive_host_process_queue_cb(gpointer _host)
 	req->hs = hs;
 	hs->is_busy = TRUE;
 	hs->host = host;
+	pool->stats.connections++;
 
 	if (purple_debug_is_verbose())
 		purple_debug_misc("http", "locking a (new) socket: %p\n", hs);
@@ -2520,6 +3010,13 @@ purple_http_keepalive_pool_release(PurpleHttpSocket *hs, gboolean invalidate)
 	if (invalidate) {
 		host->sockets = g_slist_remove(host->sockets, hs);
 		purple_http_socket_close_free(hs);
+	} else {
+		/* Nothing was pipelined, so it's just garbage. */
+		if (hs->pending != NULL) {
+			g_string_free(hs->pending, TRUE);
+			hs->pending = NULL;
+		}
+		purple_http_keepalive_socket_set_idle(hs, TRUE);
 	}
 
 	purple_http_keepalive_host_process_queue(host);
@@ -2542,6 +3039,50 @@ purple_http_keepalive_pool_get_limit_per_host(PurpleHttpKeepalivePool *pool)
 	return pool->limit_per_host;
 }
 
+void
+purple_http_keepalive_pool_set_idle_timeout(PurpleHttpKeepalivePool *pool,
+	guint timeout)
+{
+	g_return_if_fail(pool != NULL);
+
+	pool->idle_timeout = timeout;
+}
+
+guint
+purple_http_keepalive_pool_get_idle_timeout(PurpleHttpKeepalivePool *pool)
+{
+	g_return_val_if_fail(pool != NULL, 0);
+
+	return pool->idle_timeout;
+}
+
+void
+purple_http_keepalive_pool_set_pipelining(PurpleHttpKeepalivePool *pool,
+	gboolean pipelining)
+{
+	g_return_if_fail(pool != NULL);
+
+	pool->pipelining = pipelining;
+}
+
+gboolean
+purple_http_keepalive_pool_get_pipelining(PurpleHttpKeepalivePool *pool)
+{
+	g_return_val_if_fail(pool != NULL, FALSE);
+
+	return pool->pipelining;
+}
+
+void
+purple_http_keepalive_pool_get_stats(PurpleHttpKeepalivePool *pool,
+	PurpleHttpKeepaliveStats *stats)
+{
+	g_return_if_fail(pool != NULL);
+	g_return_if_fail(stats != NULL);
+
+	*stats = pool->stats;
+}
+
 /*** HTTP connection set API **************************************************/
 
 PurpleHttpConnectionSet *
@@ -2617,7 +3158,9 @@ PurpleHttpRequest * purple_http_request_new(const gchar *url)
 	request->url = g_strdup(url);
 	request->headers = purple_http_headers_new();
 	request->cookie_jar = purple_http_cookie_jar_new();
-	request->keepalive_pool = purple_http_keepalive_pool_new();
+	request->keepalive_pool = purple_http_default_pool;
+	if (request->keepalive_pool != NULL)
+		purple_http_keepalive_pool_ref(request->keepalive_pool);
 
 	request->timeout = PURPLE_HTTP_REQUEST_DEFAULT_TIMEOUT;
 	request->max_redirects = PURPLE_HTTP_REQUEST_DEFAULT_MAX_REDIRECTS;
@@ -2722,6 +3265,17 @@ static gboolean purple_http_request_is_method(PurpleHttpRequest *request,
 	return (g_ascii_strcasecmp(method, rmethod) == 0);
 }
 
+static gboolean purple_http_request_can_pipeline(PurpleHttpRequest *request)
+{
+	g_return_val_if_fail(request != NULL, FALSE);
+
+	/* Pipelined requests have to be safe to send again, if the connection
+	 * breaks before their responses arrive. */
+	return request->http11 && request->contents_length <= 0 &&
+		request->contents_reader == NULL &&
+		purple_http_request_is_method(request, "get");
+}
+
 void
 purple_http_request_set_keepalive_pool(PurpleHttpRequest *request,
 	PurpleHttpKeepalivePool *pool)
@@ -3364,6 +3918,12 @@ void purple_http_init(void)
 	purple_http_hc_by_gc = g_hash_table_new_full(g_direct_hash,
 		g_direct_equal, NULL, (GDestroyNotify)g_list_free);
 	purple_http_cancelling_gc = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	purple_http_default_pool = purple_http_keepalive_pool_new();
+	purple_http_keepalive_pool_set_limit_per_host(purple_http_default_pool,
+		PURPLE_HTTP_KEEPALIVE_DEFAULT_LIMIT_PER_HOST);
+	purple_http_keepalive_pool_set_idle_timeout(purple_http_default_pool,
+		PURPLE_HTTP_KEEPALIVE_DEFAULT_IDLE_TIMEOUT);
 }
 
 static void purple_http_foreach_conn_cancel(gpointer _hc, gpointer user_data)
@@ -3384,6 +3944,12 @@ void purple_http_uninit(void)
 	g_list_foreach(purple_http_hc_list, purple_http_foreach_conn_cancel,
 		NULL);
 
+	/* Requests, which are still around, may keep the pool, but not its
+	 * sockets. */
+	g_hash_table_remove_all(purple_http_default_pool->by_hash);
+	purple_http_keepalive_pool_unref(purple_http_default_pool);
+	purple_http_default_pool = NULL;
+
 	if (purple_http_hc_list != NULL ||
 		0 != g_hash_table_size(purple_http_hc_by_ptr) ||
 		0 != g_hash_table_size(purple_http_hc_by_gc))
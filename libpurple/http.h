@@ -76,6 +76,35 @@ typedef struct _PurpleHttpCookieJar PurpleHttpCookieJar;
  */
 typedef struct _PurpleHttpKeepalivePool PurpleHttpKeepalivePool;
 
+/**
+ * PurpleHttpKeepaliveStats:
+ * @requests:         The number of requests, which asked the pool for a
+ *                    connection.
+ * @connections:      The number of connections opened by the pool.
+ * @reused:           The number of requests sent over an already opened
+ *                    connection.
+ * @pipelined:        The number of reused requests, which were pipelined
+ *                    behind another one.
+ * @handshakes_saved: The number of TLS handshakes avoided by reusing
+ *                    connections.
+ * @queue_wait:       The total time (in microseconds) requests were waiting
+ *                    for a connection.
+ * @queue_wait_max:   The longest time (in microseconds) a request was waiting
+ *                    for a connection.
+ *
+ * Connection reuse counters of a #PurpleHttpKeepalivePool.
+ */
+typedef struct
+{
+	guint64 requests;
+	guint64 connections;
+	guint64 reused;
+	guint64 pipelined;
+	guint64 handshakes_saved;
+	gint64 queue_wait;
+	gint64 queue_wait_max;
+} PurpleHttpKeepaliveStats;
+
 /**
  * PurpleHttpConnectionSet:
  *
@@ -125,7 +154,10 @@ typedef void (*PurpleHttpContentReader)(PurpleHttpConnection *http_conn,
  * @length:    Length of data read.
  * @user_data: The user data passed with callback function.
  *
- * An callback for writting large response contents.
+ * An callback for writting large response contents. The data is passed as
+ * soon as it's read (and decompressed, if needed) in blocks of limited size,
+ * so it's never buffered as a whole. If the data can't be handled right
+ * away, call purple_http_conn_pause() and resume the connection later.
  *
  * Returns:          TRUE, if succeeded, FALSE otherwise.
  */
@@ -214,6 +246,38 @@ PurpleHttpConnection * purple_http_request(PurpleConnection *gc,
  */
 void purple_http_conn_cancel(PurpleHttpConnection *http_conn);
 
+/**
+ * purple_http_conn_pause:
+ * @http_conn: The HTTP connection.
+ *
+ * Stops reading the response, until purple_http_conn_resume() is called. It
+ * lets the response writer keep up with the server: the data isn't buffered
+ * meanwhile, it's the server who waits. The writer may still be called with
+ * the data read before pausing.
+ *
+ * The request timeout (see purple_http_request_set_timeout()) keeps running.
+ */
+void purple_http_conn_pause(PurpleHttpConnection *http_conn);
+
+/**
+ * purple_http_conn_resume:
+ * @http_conn: The HTTP connection.
+ *
+ * Continues reading the response paused with purple_http_conn_pause().
+ */
+void purple_http_conn_resume(PurpleHttpConnection *http_conn);
+
+/**
+ * purple_http_conn_is_paused:
+ * @http_conn: The HTTP connection.
+ *
+ * Checks, if reading the response is paused.
+ *
+ * Returns: TRUE, if purple_http_conn_pause() was called and the connection
+ *          wasn't resumed yet.
+ */
+gboolean purple_http_conn_is_paused(PurpleHttpConnection *http_conn);
+
 /**
  * purple_http_conn_cancel_all:
  * @gc: The handle.
@@ -572,7 +636,9 @@ const gchar * purple_http_request_get_method(PurpleHttpRequest *request);
  * @request: The request.
  * @pool:    The new KeepAlive pool, or NULL to reset.
  *
- * Sets HTTP KeepAlive connections pool for the request.
+ * Sets HTTP KeepAlive connections pool for the request. New requests use the
+ * pool returned by purple_http_keepalive_pool_get_default(); without any pool,
+ * the connection is closed after the request.
  *
  * It increases pool's reference count.
  */
@@ -623,7 +689,9 @@ void purple_http_request_set_contents_reader(PurpleHttpRequest *request,
  * @writer: (scope call): The writer callback, or %NULL to remove existing.
  * @user_data:            The user data to pass to the callback function.
  *
- * Set contents writer for HTTP response.
+ * Set contents writer for HTTP response. The response contents aren't stored
+ * then, so the memory used for the request doesn't depend on the size of the
+ * response. It's still limited by purple_http_request_set_max_len().
  */
 void purple_http_request_set_response_writer(PurpleHttpRequest *request,
 	PurpleHttpContentWriter writer, gpointer user_data);
@@ -777,11 +845,26 @@ void purple_http_request_header_add(PurpleHttpRequest *request,
 /**
  * purple_http_keepalive_pool_new:
  *
- * Creates a new HTTP Keep-Alive pool.
+ * Creates a new HTTP Keep-Alive pool. It has no connection limit, keeps idle
+ * connections until they're closed by the server and doesn't pipeline
+ * requests.
  */
 PurpleHttpKeepalivePool *
 purple_http_keepalive_pool_new(void);
 
+/**
+ * purple_http_keepalive_pool_get_default:
+ *
+ * Gets the pool shared by all requests, which weren't given another one. It
+ * allows 6 connections per host and closes the ones idle for 30 seconds.
+ *
+ * It doesn't affect pool's reference count.
+ *
+ * Returns: (transfer none): The default HTTP Keep-Alive pool.
+ */
+PurpleHttpKeepalivePool *
+purple_http_keepalive_pool_get_default(void);
+
 /**
  * purple_http_keepalive_pool_ref:
  * @pool: The HTTP Keep-Alive pool.
@@ -829,6 +912,66 @@ purple_http_keepalive_pool_set_limit_per_host(PurpleHttpKeepalivePool *pool,
 guint
 purple_http_keepalive_pool_get_limit_per_host(PurpleHttpKeepalivePool *pool);
 
+/**
+ * purple_http_keepalive_pool_set_idle_timeout:
+ * @pool:    The HTTP Keep-Alive pool.
+ * @timeout: The time (in seconds) after which unused connections are closed,
+ *           0 to keep them until the server closes them.
+ *
+ * Sets how long idle connections are kept open.
+ */
+void
+purple_http_keepalive_pool_set_idle_timeout(PurpleHttpKeepalivePool *pool,
+	guint timeout);
+
+/**
+ * purple_http_keepalive_pool_get_idle_timeout:
+ * @pool: The HTTP Keep-Alive pool.
+ *
+ * Gets how long idle connections are kept open.
+ *
+ * Returns:     The timeout in seconds, 0 for none.
+ */
+guint
+purple_http_keepalive_pool_get_idle_timeout(PurpleHttpKeepalivePool *pool);
+
+/**
+ * purple_http_keepalive_pool_set_pipelining:
+ * @pool:       The HTTP Keep-Alive pool.
+ * @pipelining: %TRUE to enable HTTP/1.1 pipelining.
+ *
+ * Enables sending requests over busy connections, when the pool reached its
+ * limit for the host. Only HTTP/1.1 GET requests without contents are
+ * pipelined, and only behind ones of the same kind. The responses come in
+ * order, so it should be enabled only for pools of short requests (no
+ * long-polling).
+ */
+void
+purple_http_keepalive_pool_set_pipelining(PurpleHttpKeepalivePool *pool,
+	gboolean pipelining);
+
+/**
+ * purple_http_keepalive_pool_get_pipelining:
+ * @pool: The HTTP Keep-Alive pool.
+ *
+ * Checks, if HTTP/1.1 pipelining is enabled for the pool.
+ *
+ * Returns:     %TRUE, if requests may be pipelined.
+ */
+gboolean
+purple_http_keepalive_pool_get_pipelining(PurpleHttpKeepalivePool *pool);
+
+/**
+ * purple_http_keepalive_pool_get_stats:
+ * @pool:  The HTTP Keep-Alive pool.
+ * @stats: The location to store the counters.
+ *
+ * Gets connection reuse counters of the pool.
+ */
+void
+purple_http_keepalive_pool_get_stats(PurpleHttpKeepalivePool *pool,
+	PurpleHttpKeepaliveStats *stats);
+
 
 /**************************************************************************/
 /* HTTP connection set API                                                */
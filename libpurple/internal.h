@@ -298,6 +298,43 @@ void _purple_connection_add_active_chat(PurpleConnection *gc,
 void _purple_connection_remove_active_chat(PurpleConnection *gc,
                                            PurpleChatConversation *chat);
 
+/**
+ * _purple_connection_find_active_chat:
+ * @gc:    The connection
+ * @id:    The chat id
+ *
+ * Finds an active chat of a connection by its id, without walking the
+ * active chats list.
+ *
+ * Returns: The chat, or %NULL if no active chat has that id.
+ */
+PurpleChatConversation *_purple_connection_find_active_chat(
+		const PurpleConnection *gc, int id);
+
+/**
+ * _purple_connection_is_active_chat:
+ * @gc:    The connection
+ * @chat:  The chat conversation
+ *
+ * Returns: %TRUE if @chat is in the active chats list of @gc.
+ */
+gboolean _purple_connection_is_active_chat(const PurpleConnection *gc,
+                                           PurpleChatConversation *chat);
+
+/**
+ * _purple_connection_update_active_chat_id:
+ * @gc:     The connection
+ * @chat:   The chat conversation
+ * @old_id: The id @chat had before
+ *
+ * Keeps the id index of the active chats up to date.
+ *
+ * Note: This function should only be called by
+ *       purple_chat_conversation_set_id() in conversationtypes.c.
+ */
+void _purple_connection_update_active_chat_id(PurpleConnection *gc,
+		PurpleChatConversation *chat, int old_id);
+
 /**
  * _purple_conversations_update_cache:
  * @conv:    The conversation.
@@ -314,6 +351,17 @@ void _purple_connection_remove_active_chat(PurpleConnection *gc,
 void _purple_conversations_update_cache(PurpleConversation *conv,
 		const char *name, PurpleAccount *account);
 
+/**
+ * _purple_conversations_contains:
+ * @conv:    The conversation.
+ *
+ * Checks, without walking the list, whether a conversation is in the list
+ * returned by purple_conversations_get_all().
+ *
+ * Returns: %TRUE if @conv is still a known conversation.
+ */
+gboolean _purple_conversations_contains(PurpleConversation *conv);
+
 /**
  * _purple_statuses_get_primitive_scores:
  *
@@ -397,4 +445,15 @@ _purple_assert_connection_is_valid(PurpleConnection *gc,
 void
 _purple_conversation_write_common(PurpleConversation *conv, PurpleMessage *msg);
 
+/**
+ * _purple_conversation_history_init: (skip)
+ *
+ * Reads the message history limits and keeps them up to date.
+ *
+ * Note: This function should only be called by
+ *       purple_conversations_init() in conversations.c.
+ */
+void
+_purple_conversation_history_init(void);
+
 #endif /* _PURPLE_INTERNAL_H_ */
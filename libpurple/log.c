@@ -44,7 +44,80 @@ struct _purple_logsize_user {
 static GHashTable *logsize_users = NULL;
 static GHashTable *logsize_users_decayed = NULL;
 
+/*
+ * The log writer.  Data written with purple_log_common_write() is kept in
+ * a per-file buffer, which is handed to the writer thread once it holds
+ * LOG_WRITER_BUFFER_SIZE bytes, after LOG_WRITER_FLUSH_INTERVAL seconds,
+ * or when the log is closed.  The single writer thread handles the jobs
+ * in order and syncs the files it has written to at most every
+ * LOG_WRITER_SYNC_INTERVAL seconds.
+ */
+#define LOG_WRITER_BUFFER_SIZE     8192
+#define LOG_WRITER_FLUSH_INTERVAL  1
+#define LOG_WRITER_SYNC_INTERVAL   5
+
+typedef struct {
+	FILE *file;
+	gchar *data;
+	gsize len;
+	gboolean close;
+	gboolean sync;
+	gboolean quit;
+} PurpleLogWriteJob;
+
+static GThread *log_writer_thread = NULL;
+static GAsyncQueue *log_writer_queue = NULL;
+static guint log_writer_timer = 0;
+static GMutex log_writer_mutex;
+static GCond log_writer_cond;
+static guint log_writer_syncs_requested = 0;
+static guint log_writer_syncs_done = 0;
+
+/* PurpleLogCommonLoggerData* => GString*, data not handed off yet. */
+static GHashTable *log_writer_buffers = NULL;
+
+/*
+ * The log catalog.  Every account's log directory has a LOG_CATALOG_FILE
+ * listing, for each conversation directory in it, the log files with
+ * their sizes and message counts.  A conversation directory is only
+ * rescanned when its modification time no longer matches the catalog, so
+ * listing and sizing logs needs one stat() instead of one per file.
+ */
+#define LOG_CATALOG_FILE        ".catalog.xml"
+#define LOG_CATALOG_SAVE_DELAY  10
+
+typedef struct {
+	gchar *path;          /* The account's log directory */
+	GHashTable *targets;  /* Directory name => LogCatalogTarget* */
+	gboolean dirty;
+} LogCatalog;
+
+typedef struct {
+	LogCatalog *catalog;
+	gint64 mtime;         /* Of the directory, or -1 to rescan it */
+	GHashTable *files;    /* File name => LogCatalogFile* */
+} LogCatalogTarget;
+
+typedef struct {
+	gint64 size;
+	gint messages;        /* -1 if unknown */
+	gboolean open;        /* Still being written, ahead of the disk */
+} LogCatalogFile;
+
+/* Account log directory => LogCatalog* */
+static GHashTable *log_catalogs = NULL;
+/* Conversation log directory => LogCatalogTarget* */
+static GHashTable *log_catalog_targets = NULL;
+static guint log_catalog_save_timer = 0;
+
 static void log_get_log_sets_common(GHashTable *sets);
+static void log_catalog_add_data(PurpleLogCommonLoggerData *data,
+		gsize size, gint messages);
+static void log_catalog_save_all(void);
+static void log_writer_push(PurpleLogWriteJob *job);
+static void log_writer_flush_all(void);
+static gsize log_writer_printf(PurpleLogCommonLoggerData *data,
+		const char *format, ...) G_GNUC_PRINTF(2, 3);
 
 static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
                                const char *from, GDateTime *time, const char *message);
@@ -676,6 +749,44 @@ purple_log_uninit(void)
 {
 	purple_signals_unregister_by_instance(purple_log_get_handle());
 
+	if (log_writer_timer != 0) {
+		g_source_remove(log_writer_timer);
+		log_writer_timer = 0;
+	}
+
+	if (log_writer_thread != NULL) {
+		PurpleLogWriteJob *job = g_slice_new0(PurpleLogWriteJob);
+
+		log_writer_flush_all();
+
+		job->quit = TRUE;
+		log_writer_push(job);
+		g_thread_join(log_writer_thread);
+		log_writer_thread = NULL;
+
+		g_async_queue_unref(log_writer_queue);
+		log_writer_queue = NULL;
+	}
+
+	if (log_writer_buffers != NULL) {
+		g_hash_table_destroy(log_writer_buffers);
+		log_writer_buffers = NULL;
+	}
+
+	if (log_catalog_save_timer != 0) {
+		g_source_remove(log_catalog_save_timer);
+		log_catalog_save_timer = 0;
+	}
+
+	if (log_catalogs != NULL) {
+		log_catalog_save_all();
+
+		g_hash_table_destroy(log_catalog_targets);
+		log_catalog_targets = NULL;
+		g_hash_table_destroy(log_catalogs);
+		log_catalogs = NULL;
+	}
+
 	purple_log_logger_remove(html_logger);
 	purple_log_logger_free(html_logger);
 	html_logger = NULL;
@@ -855,6 +966,395 @@ convert_image_tags(const PurpleLog *log, const char *msg)
 	return g_string_free(newmsg, FALSE);
 }
 
+static void
+log_catalog_file_free(LogCatalogFile *file)
+{
+	g_slice_free(LogCatalogFile, file);
+}
+
+static void
+log_catalog_target_free(LogCatalogTarget *target)
+{
+	g_hash_table_destroy(target->files);
+	g_slice_free(LogCatalogTarget, target);
+}
+
+static void
+log_catalog_free(LogCatalog *catalog)
+{
+	g_hash_table_destroy(catalog->targets);
+	g_free(catalog->path);
+	g_slice_free(LogCatalog, catalog);
+}
+
+static LogCatalogTarget *
+log_catalog_target_new(LogCatalog *catalog, const char *dir)
+{
+	LogCatalogTarget *target = g_slice_new0(LogCatalogTarget);
+	gchar *name = g_path_get_basename(dir);
+
+	target->catalog = catalog;
+	target->mtime = -1;
+	target->files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)log_catalog_file_free);
+
+	g_hash_table_insert(catalog->targets, name, target);
+	g_hash_table_insert(log_catalog_targets, g_strdup(dir), target);
+
+	return target;
+}
+
+static void
+log_catalog_target_remove(LogCatalogTarget *target, const char *dir)
+{
+	gchar *name = g_path_get_basename(dir);
+
+	g_hash_table_remove(target->catalog->targets, name);
+	g_free(name);
+
+	/* This frees the target. */
+	g_hash_table_remove(log_catalog_targets, dir);
+}
+
+static LogCatalog *
+log_catalog_load(const char *path)
+{
+	LogCatalog *catalog = g_slice_new0(LogCatalog);
+	PurpleXmlNode *root, *tnode, *fnode;
+	gchar *filename, *contents;
+	gsize length;
+
+	catalog->path = g_strdup(path);
+	catalog->targets = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, NULL);
+	g_hash_table_insert(log_catalogs, catalog->path, catalog);
+
+	filename = g_build_filename(path, LOG_CATALOG_FILE, NULL);
+	if (!g_file_get_contents(filename, &contents, &length, NULL)) {
+		g_free(filename);
+		return catalog;
+	}
+	g_free(filename);
+
+	root = purple_xmlnode_from_str(contents, length);
+	g_free(contents);
+	if (root == NULL)
+		return catalog;
+
+	for (tnode = purple_xmlnode_get_child(root, "target"); tnode != NULL;
+			tnode = purple_xmlnode_get_next_twin(tnode)) {
+		const char *name = purple_xmlnode_get_attrib(tnode, "name");
+		const char *mtime = purple_xmlnode_get_attrib(tnode, "mtime");
+		LogCatalogTarget *target;
+		gchar *dir;
+
+		if (name == NULL || mtime == NULL || strchr(name, G_DIR_SEPARATOR))
+			continue;
+
+		dir = g_build_filename(path, name, NULL);
+		target = log_catalog_target_new(catalog, dir);
+		target->mtime = g_ascii_strtoll(mtime, NULL, 10);
+		g_free(dir);
+
+		for (fnode = purple_xmlnode_get_child(tnode, "log"); fnode != NULL;
+				fnode = purple_xmlnode_get_next_twin(fnode)) {
+			const char *file = purple_xmlnode_get_attrib(fnode, "file");
+			const char *size = purple_xmlnode_get_attrib(fnode, "size");
+			const char *messages = purple_xmlnode_get_attrib(fnode, "messages");
+			LogCatalogFile *entry;
+
+			if (file == NULL || size == NULL)
+				continue;
+
+			entry = g_slice_new0(LogCatalogFile);
+			entry->size = g_ascii_strtoll(size, NULL, 10);
+			entry->messages = messages ? atoi(messages) : -1;
+			g_hash_table_replace(target->files, g_strdup(file), entry);
+		}
+	}
+
+	purple_xmlnode_free(root);
+
+	return catalog;
+}
+
+static void
+log_catalog_save(LogCatalog *catalog)
+{
+	PurpleXmlNode *root;
+	GHashTableIter titer;
+	gpointer name, value;
+	gchar *filename, *data;
+
+	root = purple_xmlnode_new("catalog");
+	purple_xmlnode_set_attrib(root, "version", "1.0");
+
+	g_hash_table_iter_init(&titer, catalog->targets);
+	while (g_hash_table_iter_next(&titer, &name, &value)) {
+		LogCatalogTarget *target = value;
+		PurpleXmlNode *tnode;
+		GHashTableIter fiter;
+		gchar buf[32];
+
+		tnode = purple_xmlnode_new_child(root, "target");
+		purple_xmlnode_set_attrib(tnode, "name", name);
+		g_snprintf(buf, sizeof(buf), "%" G_GINT64_FORMAT, target->mtime);
+		purple_xmlnode_set_attrib(tnode, "mtime", buf);
+
+		g_hash_table_iter_init(&fiter, target->files);
+		while (g_hash_table_iter_next(&fiter, &name, &value)) {
+			LogCatalogFile *file = value;
+			PurpleXmlNode *fnode = purple_xmlnode_new_child(tnode, "log");
+
+			purple_xmlnode_set_attrib(fnode, "file", name);
+			g_snprintf(buf, sizeof(buf), "%" G_GINT64_FORMAT, file->size);
+			purple_xmlnode_set_attrib(fnode, "size", buf);
+			g_snprintf(buf, sizeof(buf), "%d", file->messages);
+			purple_xmlnode_set_attrib(fnode, "messages", buf);
+		}
+	}
+
+	filename = g_build_filename(catalog->path, LOG_CATALOG_FILE, NULL);
+	data = purple_xmlnode_to_formatted_str(root, NULL);
+	purple_util_write_data_to_file_absolute(filename, data, -1);
+	g_free(data);
+	g_free(filename);
+	purple_xmlnode_free(root);
+
+	catalog->dirty = FALSE;
+}
+
+static gboolean
+log_catalog_save_cb(gpointer data)
+{
+	log_catalog_save_timer = 0;
+	log_catalog_save_all();
+
+	return FALSE;
+}
+
+static void
+log_catalog_save_all(void)
+{
+	GHashTableIter iter;
+	gpointer catalog;
+
+	if (log_catalogs == NULL)
+		return;
+
+	g_hash_table_iter_init(&iter, log_catalogs);
+	while (g_hash_table_iter_next(&iter, NULL, &catalog)) {
+		if (((LogCatalog *)catalog)->dirty)
+			log_catalog_save(catalog);
+	}
+}
+
+static void
+log_catalog_schedule_save(LogCatalog *catalog)
+{
+	catalog->dirty = TRUE;
+
+	if (log_catalog_save_timer == 0) {
+		log_catalog_save_timer = g_timeout_add_seconds(LOG_CATALOG_SAVE_DELAY,
+				log_catalog_save_cb, NULL);
+	}
+}
+
+static void
+log_catalog_set_mtime(LogCatalogTarget *target, gint64 mtime)
+{
+	/* Changes within the same second don't show up in the mtime. */
+	target->mtime = (mtime >= time(NULL) - 1) ? -1 : mtime;
+}
+
+static void
+log_catalog_rescan(LogCatalogTarget *target, const char *dir, gint64 mtime)
+{
+	GHashTable *files;
+	const gchar *name;
+	GDir *gdir;
+
+	files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)log_catalog_file_free);
+
+	if ((gdir = g_dir_open(dir, 0, NULL)) != NULL) {
+		while ((name = g_dir_read_name(gdir)) != NULL) {
+			gchar *path = g_build_filename(dir, name, NULL);
+			LogCatalogFile *old, *file;
+			GStatBuf st;
+
+			if (g_stat(path, &st) || !S_ISREG(st.st_mode)) {
+				g_free(path);
+				continue;
+			}
+			g_free(path);
+
+			old = g_hash_table_lookup(target->files, name);
+
+			file = g_slice_new(LogCatalogFile);
+			if (old != NULL && old->open) {
+				/* The writer thread may not have caught up yet. */
+				*file = *old;
+			} else {
+				file->size = st.st_size;
+				file->messages = (old && old->size == file->size) ? old->messages : -1;
+				file->open = FALSE;
+			}
+			g_hash_table_insert(files, g_strdup(name), file);
+		}
+		g_dir_close(gdir);
+	}
+
+	g_hash_table_destroy(target->files);
+	target->files = files;
+
+	log_catalog_set_mtime(target, mtime);
+
+	log_catalog_schedule_save(target->catalog);
+}
+
+/*
+ * Returns the up to date catalog entry for a conversation's log directory,
+ * or NULL if it doesn't exist.
+ */
+static LogCatalogTarget *
+log_catalog_get_target(const char *dir)
+{
+	LogCatalogTarget *target;
+	GStatBuf st;
+
+	if (log_catalogs == NULL) {
+		log_catalogs = g_hash_table_new_full(g_str_hash, g_str_equal,
+				NULL, (GDestroyNotify)log_catalog_free);
+		log_catalog_targets = g_hash_table_new_full(g_str_hash,
+				g_str_equal, g_free,
+				(GDestroyNotify)log_catalog_target_free);
+	}
+
+	target = g_hash_table_lookup(log_catalog_targets, dir);
+	if (target == NULL) {
+		gchar *parent = g_path_get_dirname(dir);
+		LogCatalog *catalog = g_hash_table_lookup(log_catalogs, parent);
+
+		if (catalog == NULL) {
+			catalog = log_catalog_load(parent);
+			target = g_hash_table_lookup(log_catalog_targets, dir);
+		}
+		g_free(parent);
+
+		if (target == NULL) {
+			if (g_stat(dir, &st) != 0 || !S_ISDIR(st.st_mode))
+				return NULL;
+
+			target = log_catalog_target_new(catalog, dir);
+			log_catalog_rescan(target, dir, st.st_mtime);
+			return target;
+		}
+	}
+
+	if (g_stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+		log_catalog_schedule_save(target->catalog);
+		log_catalog_target_remove(target, dir);
+		return NULL;
+	}
+
+	if (target->mtime != st.st_mtime)
+		log_catalog_rescan(target, dir, st.st_mtime);
+
+	return target;
+}
+
+/* Looks up a log file without checking whether its directory changed. */
+static LogCatalogFile *
+log_catalog_lookup_file(const char *path, LogCatalogTarget **target_ret)
+{
+	LogCatalogTarget *target = NULL;
+	const char *base = strrchr(path, G_DIR_SEPARATOR);
+	gchar *dir;
+
+	if (base == NULL)
+		return NULL;
+
+	dir = g_strndup(path, base - path);
+	if (log_catalog_targets != NULL)
+		target = g_hash_table_lookup(log_catalog_targets, dir);
+	if (target == NULL)
+		target = log_catalog_get_target(dir);
+	g_free(dir);
+
+	if (target == NULL)
+		return NULL;
+
+	if (target_ret != NULL)
+		*target_ret = target;
+
+	return g_hash_table_lookup(target->files, base + 1);
+}
+
+/* Records a file we just created, without rescanning its directory. */
+static void
+log_catalog_file_created(LogCatalogTarget *target, const char *dir,
+		const char *filename)
+{
+	LogCatalogFile *file;
+	GStatBuf st;
+
+	file = g_hash_table_lookup(target->files, filename);
+	if (file == NULL) {
+		file = g_slice_new(LogCatalogFile);
+		file->size = 0;
+		file->messages = 0;
+		g_hash_table_insert(target->files, g_strdup(filename), file);
+	}
+	file->open = TRUE;
+
+	if (g_stat(dir, &st) == 0)
+		log_catalog_set_mtime(target, st.st_mtime);
+
+	log_catalog_schedule_save(target->catalog);
+}
+
+/* A negative number of messages means it isn't known how many were added. */
+static void
+log_catalog_add_data(PurpleLogCommonLoggerData *data, gsize size,
+		gint messages)
+{
+	LogCatalogTarget *target;
+	LogCatalogFile *file;
+
+	if (data->path == NULL)
+		return;
+
+	file = log_catalog_lookup_file(data->path, &target);
+	if (file == NULL)
+		return;
+
+	file->size += size;
+	if (messages < 0)
+		file->messages = -1;
+	else if (file->messages >= 0)
+		file->messages += messages;
+
+	log_catalog_schedule_save(target->catalog);
+}
+
+int
+purple_log_common_get_message_count(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data;
+	LogCatalogFile *file;
+
+	g_return_val_if_fail(log != NULL, -1);
+
+	data = log->logger_data;
+	if (data == NULL || data->path == NULL)
+		return -1;
+
+	file = log_catalog_lookup_file(data->path, NULL);
+
+	return file ? file->messages : -1;
+}
+
 void purple_log_common_writer(PurpleLog *log, const char *ext)
 {
 	PurpleLogCommonLoggerData *data = log->logger_data;
@@ -862,6 +1362,7 @@ void purple_log_common_writer(PurpleLog *log, const char *ext)
 	if (data == NULL)
 	{
 		/* This log is new */
+		LogCatalogTarget *target;
 		char *dir;
 		GDateTime *dt;
 		const char *tz;
@@ -883,12 +1384,12 @@ void purple_log_common_writer(PurpleLog *log, const char *ext)
 		filename = g_strdup_printf("%s%s%s", date, tz, ext ? ext : "");
 
 		path = g_build_filename(dir, filename, NULL);
-		g_free(dir);
 		g_free(date);
-		g_free(filename);
 
 		log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
 
+		target = log_catalog_get_target(dir);
+
 		data->file = g_fopen(path, "a");
 		if (data->file == NULL)
 		{
@@ -900,18 +1401,323 @@ void purple_log_common_writer(PurpleLog *log, const char *ext)
 					_("Logging of this conversation failed."),
 					PURPLE_MESSAGE_ERROR);
 
+			g_free(dir);
 			g_free(path);
 			return;
 		}
-		g_free(path);
+
+		if (target != NULL)
+			log_catalog_file_created(target, dir, filename);
+
+		g_free(dir);
+		g_free(filename);
+		data->path = path;
+	}
+}
+
+static gboolean
+log_writer_error_cb(gpointer data)
+{
+	purple_debug_error("log", "%s\n", (char *)data);
+	g_free(data);
+
+	return FALSE;
+}
+
+static void
+log_writer_sync_file(FILE *file)
+{
+	if (fflush(file) != 0) {
+		g_idle_add(log_writer_error_cb, g_strdup_printf(
+				"Error flushing log file: %s", g_strerror(errno)));
+	}
+#ifdef HAVE_FILENO
+	if (fsync(fileno(file)) < 0) {
+		g_idle_add(log_writer_error_cb, g_strdup_printf(
+				"Error syncing log file: %s", g_strerror(errno)));
+	}
+#endif
+}
+
+static void
+log_writer_sync_files(GHashTable *files)
+{
+	GHashTableIter iter;
+	gpointer file;
+
+	g_hash_table_iter_init(&iter, files);
+	while (g_hash_table_iter_next(&iter, &file, NULL))
+		log_writer_sync_file(file);
+	g_hash_table_remove_all(files);
+}
+
+static gpointer
+log_writer_thread_func(gpointer user_data)
+{
+	/* FILE* => FILE*, written to since they were last synced. */
+	GHashTable *unsynced = g_hash_table_new(g_direct_hash, g_direct_equal);
+	gint64 last_sync = g_get_monotonic_time();
+	gboolean quit = FALSE;
+
+	while (!quit) {
+		PurpleLogWriteJob *job;
+		gint64 timeout;
+
+		timeout = last_sync + LOG_WRITER_SYNC_INTERVAL * G_TIME_SPAN_SECOND -
+			g_get_monotonic_time();
+		if (g_hash_table_size(unsynced) == 0)
+			job = g_async_queue_pop(log_writer_queue);
+		else if (timeout > 0)
+			job = g_async_queue_timeout_pop(log_writer_queue, timeout);
+		else
+			job = NULL;
+
+		if (job == NULL) {
+			log_writer_sync_files(unsynced);
+			last_sync = g_get_monotonic_time();
+			continue;
+		}
+
+		if (job->len > 0 &&
+				fwrite(job->data, 1, job->len, job->file) != job->len) {
+			g_idle_add(log_writer_error_cb, g_strdup_printf(
+					"Error writing log file: %s", g_strerror(errno)));
+		}
+
+		if (job->close) {
+			g_hash_table_remove(unsynced, job->file);
+			log_writer_sync_file(job->file);
+			fclose(job->file);
+		} else if (job->file != NULL) {
+			g_hash_table_add(unsynced, job->file);
+		}
+
+		if (job->sync || job->quit) {
+			log_writer_sync_files(unsynced);
+			last_sync = g_get_monotonic_time();
+		}
+
+		if (job->sync) {
+			g_mutex_lock(&log_writer_mutex);
+			log_writer_syncs_done++;
+			g_cond_broadcast(&log_writer_cond);
+			g_mutex_unlock(&log_writer_mutex);
+		} else if (!job->quit &&
+				g_async_queue_length(log_writer_queue) <= 0) {
+			/* Make the data visible to readers without syncing. */
+			GHashTableIter iter;
+			gpointer file;
+
+			g_hash_table_iter_init(&iter, unsynced);
+			while (g_hash_table_iter_next(&iter, &file, NULL))
+				fflush(file);
+		}
+
+		quit = job->quit;
+		g_free(job->data);
+		g_slice_free(PurpleLogWriteJob, job);
+	}
+
+	g_hash_table_destroy(unsynced);
+
+	return NULL;
+}
+
+static void
+log_writer_push(PurpleLogWriteJob *job)
+{
+	if (log_writer_thread == NULL) {
+		log_writer_queue = g_async_queue_new();
+		log_writer_thread = g_thread_new("purple-log-writer",
+				log_writer_thread_func, NULL);
+	}
+
+	g_async_queue_push(log_writer_queue, job);
+}
+
+static void
+log_writer_flush(PurpleLogCommonLoggerData *data, GString *buffer,
+		gboolean close)
+{
+	PurpleLogWriteJob *job = g_slice_new0(PurpleLogWriteJob);
+
+	job->file = data->file;
+	job->close = close;
+	if (buffer != NULL) {
+		job->len = buffer->len;
+		job->data = g_string_free(buffer, FALSE);
+	}
+
+	log_writer_push(job);
+}
+
+static void
+log_writer_flush_all(void)
+{
+	GHashTableIter iter;
+	gpointer data, buffer;
+
+	if (log_writer_buffers == NULL)
+		return;
+
+	g_hash_table_iter_init(&iter, log_writer_buffers);
+	while (g_hash_table_iter_next(&iter, &data, &buffer)) {
+		log_writer_flush(data, buffer, FALSE);
+		g_hash_table_iter_remove(&iter);
+	}
+}
+
+static gboolean
+log_writer_timeout_cb(gpointer user_data)
+{
+	log_writer_timer = 0;
+	log_writer_flush_all();
+
+	return FALSE;
+}
+
+static GString *
+log_writer_get_buffer(PurpleLogCommonLoggerData *data)
+{
+	GString *buffer;
+
+	if (log_writer_buffers == NULL) {
+		log_writer_buffers = g_hash_table_new(g_direct_hash,
+				g_direct_equal);
 	}
+
+	buffer = g_hash_table_lookup(log_writer_buffers, data);
+	if (buffer == NULL) {
+		buffer = g_string_sized_new(LOG_WRITER_BUFFER_SIZE);
+		g_hash_table_insert(log_writer_buffers, data, buffer);
+	}
+
+	return buffer;
+}
+
+static void
+log_writer_check_buffer(PurpleLogCommonLoggerData *data, GString *buffer)
+{
+	if (buffer->len >= LOG_WRITER_BUFFER_SIZE) {
+		g_hash_table_remove(log_writer_buffers, data);
+		log_writer_flush(data, buffer, FALSE);
+	} else if (log_writer_timer == 0) {
+		log_writer_timer = g_timeout_add_seconds(LOG_WRITER_FLUSH_INTERVAL,
+				log_writer_timeout_cb, NULL);
+	}
+}
+
+static gsize
+log_writer_printf(PurpleLogCommonLoggerData *data, const char *format, ...)
+{
+	GString *buffer = log_writer_get_buffer(data);
+	gsize len = buffer->len;
+	va_list args;
+
+	va_start(args, format);
+	g_string_append_vprintf(buffer, format, args);
+	va_end(args);
+
+	len = buffer->len - len;
+	log_writer_check_buffer(data, buffer);
+
+	return len;
+}
+
+gsize
+purple_log_common_write(PurpleLog *log, const char *data, gssize len)
+{
+	PurpleLogCommonLoggerData *common;
+	GString *buffer;
+
+	g_return_val_if_fail(log != NULL, 0);
+	g_return_val_if_fail(data != NULL, 0);
+
+	common = log->logger_data;
+	g_return_val_if_fail(common != NULL, 0);
+
+	if (common->file == NULL)
+		return 0;
+
+	if (len < 0)
+		len = strlen(data);
+
+	buffer = log_writer_get_buffer(common);
+	g_string_append_len(buffer, data, len);
+	log_writer_check_buffer(common, buffer);
+
+	/* Only the built-in loggers know where their messages start. */
+	log_catalog_add_data(common, len, -1);
+
+	return len;
+}
+
+void
+purple_log_common_close(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data;
+	GString *buffer = NULL;
+
+	g_return_if_fail(log != NULL);
+
+	data = log->logger_data;
+	if (data == NULL || data->file == NULL)
+		return;
+
+	if (data->path != NULL) {
+		LogCatalogFile *file = log_catalog_lookup_file(data->path, NULL);
+
+		if (file != NULL)
+			file->open = FALSE;
+	}
+
+	if (log_writer_buffers != NULL) {
+		buffer = g_hash_table_lookup(log_writer_buffers, data);
+		g_hash_table_remove(log_writer_buffers, data);
+	}
+
+	/* The writer thread may still be using this file, and whatever is
+	 * still buffered has to be written before it's closed. */
+	if (log_writer_thread != NULL || buffer != NULL)
+		log_writer_flush(data, buffer, TRUE);
+	else
+		fclose(data->file);
+
+	data->file = NULL;
+}
+
+void
+purple_log_common_sync(void)
+{
+	PurpleLogWriteJob *job;
+	guint target;
+
+	log_writer_flush_all();
+
+	if (log_writer_thread == NULL)
+		return;
+
+	job = g_slice_new0(PurpleLogWriteJob);
+	job->sync = TRUE;
+
+	g_mutex_lock(&log_writer_mutex);
+	target = ++log_writer_syncs_requested;
+	g_mutex_unlock(&log_writer_mutex);
+
+	log_writer_push(job);
+
+	g_mutex_lock(&log_writer_mutex);
+	while (log_writer_syncs_done < target)
+		g_cond_wait(&log_writer_cond, &log_writer_mutex);
+	g_mutex_unlock(&log_writer_mutex);
 }
 
 GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext, PurpleLogLogger *logger)
 {
-	GDir *dir;
+	LogCatalogTarget *target;
+	GHashTableIter iter;
 	GList *list = NULL;
-	const char *filename;
+	gpointer key;
 	char *path;
 
 	if(!account)
@@ -921,14 +1727,18 @@ GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAcco
 	if (path == NULL)
 		return NULL;
 
-	if (!(dir = g_dir_open(path, 0, NULL)))
+	if (!(target = log_catalog_get_target(path)))
 	{
 		g_free(path);
 		return NULL;
 	}
 
-	while ((filename = g_dir_read_name(dir)))
+	g_hash_table_iter_init(&iter, target->files);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
 	{
+		const char *filename = key;
+
+
 		if (purple_str_has_suffix(filename, ext) &&
 		    strlen(filename) >= (17 + strlen(ext)))
 		{
@@ -946,16 +1756,16 @@ GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAcco
 			g_date_time_unref(stamp);
 		}
 	}
-	g_dir_close(dir);
 	g_free(path);
 	return list;
 }
 
 int purple_log_common_total_sizer(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext)
 {
-	GDir *dir;
+	LogCatalogTarget *target;
+	GHashTableIter iter;
+	gpointer key, value;
 	int size = 0;
-	const char *filename;
 	char *path;
 
 	if(!account)
@@ -965,31 +1775,22 @@ int purple_log_common_total_sizer(PurpleLogType type, const char *name, PurpleAc
 	if (path == NULL)
 		return 0;
 
-	if (!(dir = g_dir_open(path, 0, NULL)))
-	{
-		g_free(path);
+	target = log_catalog_get_target(path);
+	g_free(path);
+	if (target == NULL)
 		return 0;
-	}
 
-	while ((filename = g_dir_read_name(dir)))
+	g_hash_table_iter_init(&iter, target->files);
+	while (g_hash_table_iter_next(&iter, &key, &value))
 	{
+		const char *filename = key;
+
 		if (purple_str_has_suffix(filename, ext) &&
 		    strlen(filename) >= (17 + strlen(ext)))
 		{
-			char *tmp = g_build_filename(path, filename, NULL);
-			GStatBuf st;
-			if (g_stat(tmp, &st))
-			{
-				purple_debug_error("log", "Error stating log file: %s\n", tmp);
-				g_free(tmp);
-				continue;
-			}
-			g_free(tmp);
-			size += st.st_size;
+			size += ((LogCatalogFile *)value)->size;
 		}
 	}
-	g_dir_close(dir);
-	g_free(path);
 	return size;
 }
 
@@ -997,10 +1798,17 @@ int purple_log_common_sizer(PurpleLog *log)
 {
 	GStatBuf st;
 	PurpleLogCommonLoggerData *data = log->logger_data;
+	LogCatalogFile *file;
 
 	g_return_val_if_fail(data != NULL, 0);
 
-	if (!data->path || g_stat(data->path, &st))
+	if (!data->path)
+		return 0;
+
+	if ((file = log_catalog_lookup_file(data->path, NULL)) != NULL)
+		return file->size;
+
+	if (g_stat(data->path, &st))
 		st.st_size = 0;
 
 	return st.st_size;
@@ -1075,6 +1883,9 @@ static void log_get_log_sets_common(GHashTable *sets)
 				size_t len;
 				PurpleLogSet *set;
 
+				if (purple_strequal(name, LOG_CATALOG_FILE))
+					continue;
+
 				/* IMPORTANT: Always initialize all members of PurpleLogSet */
 				set = g_slice_new(PurpleLogSet);
 
@@ -1141,7 +1952,25 @@ gboolean purple_log_common_deleter(PurpleLog *log)
 
 	ret = g_unlink(data->path);
 	if (ret == 0)
+	{
+		LogCatalogTarget *target;
+
+		if (log_catalog_lookup_file(data->path, &target) != NULL)
+		{
+			gchar *filename = g_path_get_basename(data->path);
+			gchar *dirname = g_path_get_dirname(data->path);
+			GStatBuf st;
+
+			g_hash_table_remove(target->files, filename);
+			if (g_stat(dirname, &st) == 0)
+				log_catalog_set_mtime(target, st.st_mtime);
+			log_catalog_schedule_save(target->catalog);
+
+			g_free(filename);
+			g_free(dirname);
+		}
 		return TRUE;
+	}
 	else if (ret == -1)
 	{
 		purple_debug_error("log", "Failed to delete: %s - %s\n", data->path, g_strerror(errno));
@@ -1249,9 +2078,9 @@ static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
 		date = g_date_time_format(dt, "%c");
 		g_date_time_unref(dt);
 
-		written += fprintf(data->file, "<html><head>");
-		written += fprintf(data->file, "<meta http-equiv=\"content-type\" content=\"text/html; charset=UTF-8\">");
-		written += fprintf(data->file, "<title>");
+		written += log_writer_printf(data, "<html><head>");
+		written += log_writer_printf(data, "<meta http-equiv=\"content-type\" content=\"text/html; charset=UTF-8\">");
+		written += log_writer_printf(data, "<title>");
 		if (log->type == PURPLE_LOG_SYSTEM)
 			header = g_strdup_printf("System log for account %s (%s) connected at %s",
 					purple_account_get_username(log->account), proto, date);
@@ -1259,9 +2088,9 @@ static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
 			header = g_strdup_printf("Conversation with %s at %s on %s (%s)",
 					log->name, date, purple_account_get_username(log->account), proto);
 
-		written += fprintf(data->file, "%s", header);
-		written += fprintf(data->file, "</title></head><body>");
-		written += fprintf(data->file, "<h3>%s</h3>\n", header);
+		written += log_writer_printf(data, "%s", header);
+		written += log_writer_printf(data, "</title></head><body>");
+		written += log_writer_printf(data, "<h3>%s</h3>\n", header);
 		g_free(date);
 		g_free(header);
 	}
@@ -1284,43 +2113,44 @@ static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
 	date = log_get_timestamp(log, time);
 
 	if(log->type == PURPLE_LOG_SYSTEM){
-		written += fprintf(data->file, "---- %s @ %s ----<br/>\n", msg_fixed, date);
+		written += log_writer_printf(data, "---- %s @ %s ----<br/>\n", msg_fixed, date);
 	} else {
 		if (type & PURPLE_MESSAGE_SYSTEM)
-			written += fprintf(data->file, "<font size=\"2\">(%s)</font><b> %s</b><br/>\n", date, msg_fixed);
+			written += log_writer_printf(data, "<font size=\"2\">(%s)</font><b> %s</b><br/>\n", date, msg_fixed);
 		else if (type & PURPLE_MESSAGE_RAW)
-			written += fprintf(data->file, "<font size=\"2\">(%s)</font> %s<br/>\n", date, msg_fixed);
+			written += log_writer_printf(data, "<font size=\"2\">(%s)</font> %s<br/>\n", date, msg_fixed);
 		else if (type & PURPLE_MESSAGE_ERROR)
-			written += fprintf(data->file, "<font color=\"#FF0000\"><font size=\"2\">(%s)</font><b> %s</b></font><br/>\n", date, msg_fixed);
+			written += log_writer_printf(data, "<font color=\"#FF0000\"><font size=\"2\">(%s)</font><b> %s</b></font><br/>\n", date, msg_fixed);
 		else if (type & PURPLE_MESSAGE_AUTO_RESP) {
 			if (type & PURPLE_MESSAGE_SEND)
-				written += fprintf(data->file, _("<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
+				written += log_writer_printf(data, _("<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
 			else if (type & PURPLE_MESSAGE_RECV)
-				written += fprintf(data->file, _("<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
+				written += log_writer_printf(data, _("<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
 		} else if (type & PURPLE_MESSAGE_RECV) {
 			if(purple_message_meify(msg_fixed, -1))
-				written += fprintf(data->file, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
+				written += log_writer_printf(data, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
 						date, escaped_from, msg_fixed);
 			else
-				written += fprintf(data->file, "<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
+				written += log_writer_printf(data, "<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
 						date, escaped_from, msg_fixed);
 		} else if (type & PURPLE_MESSAGE_SEND) {
 			if(purple_message_meify(msg_fixed, -1))
-				written += fprintf(data->file, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
+				written += log_writer_printf(data, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
 						date, escaped_from, msg_fixed);
 			else
-				written += fprintf(data->file, "<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
+				written += log_writer_printf(data, "<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
 						date, escaped_from, msg_fixed);
 		} else {
 			purple_debug_error("log", "Unhandled message type.\n");
-			written += fprintf(data->file, "<font size=\"2\">(%s)</font><b> %s:</b></font> %s<br/>\n",
+			written += log_writer_printf(data, "<font size=\"2\">(%s)</font><b> %s:</b></font> %s<br/>\n",
 						date, escaped_from, msg_fixed);
 		}
 	}
 	g_free(date);
 	g_free(msg_fixed);
 	g_free(escaped_from);
-	fflush(data->file);
+
+	log_catalog_add_data(data, written, 1);
 
 	return written;
 }
@@ -1330,8 +2160,9 @@ static void html_logger_finalize(PurpleLog *log)
 	PurpleLogCommonLoggerData *data = log->logger_data;
 	if (data) {
 		if(data->file) {
-			fprintf(data->file, "</body></html>\n");
-			fclose(data->file);
+			log_catalog_add_data(data,
+					log_writer_printf(data, "</body></html>\n"), 0);
+			purple_log_common_close(log);
 		}
 		g_free(data->path);
 
@@ -1410,11 +2241,11 @@ static gsize txt_logger_write(PurpleLog *log, PurpleMessageFlags type,
 		dt = g_date_time_to_local(log->time);
 		date = g_date_time_format(dt, "%c");
 		if (log->type == PURPLE_LOG_SYSTEM)
-			written += fprintf(data->file, "System log for account %s (%s) connected at %s\n",
+			written += log_writer_printf(data, "System log for account %s (%s) connected at %s\n",
 				purple_account_get_username(log->account), proto,
 				date);
 		else
-			written += fprintf(data->file, "Conversation with %s at %s on %s (%s)\n",
+			written += log_writer_printf(data, "Conversation with %s at %s on %s (%s)\n",
 				log->name, date,
 				purple_account_get_username(log->account), proto);
 		g_free(date);
@@ -1429,36 +2260,38 @@ static gsize txt_logger_write(PurpleLog *log, PurpleMessageFlags type,
 	date = log_get_timestamp(log, time);
 
 	if(log->type == PURPLE_LOG_SYSTEM){
-		written += fprintf(data->file, "---- %s @ %s ----\n", stripped, date);
+		written += log_writer_printf(data, "---- %s @ %s ----\n", stripped, date);
 	} else {
 		if (type & PURPLE_MESSAGE_SEND ||
 			type & PURPLE_MESSAGE_RECV) {
 			if (type & PURPLE_MESSAGE_AUTO_RESP) {
-				written += fprintf(data->file, _("(%s) %s <AUTO-REPLY>: %s\n"), date,
+				written += log_writer_printf(data, _("(%s) %s <AUTO-REPLY>: %s\n"), date,
 						from, stripped);
 			} else {
 				if(purple_message_meify(stripped, -1))
-					written += fprintf(data->file, "(%s) ***%s %s\n", date, from,
+					written += log_writer_printf(data, "(%s) ***%s %s\n", date, from,
 							stripped);
 				else
-					written += fprintf(data->file, "(%s) %s: %s\n", date, from,
+					written += log_writer_printf(data, "(%s) %s: %s\n", date, from,
 							stripped);
 			}
 		} else if (type & PURPLE_MESSAGE_SYSTEM ||
 			type & PURPLE_MESSAGE_ERROR ||
 			type & PURPLE_MESSAGE_RAW)
-			written += fprintf(data->file, "(%s) %s\n", date, stripped);
+			written += log_writer_printf(data, "(%s) %s\n", date, stripped);
 		else if (type & PURPLE_MESSAGE_NO_LOG) {
 			/* This shouldn't happen */
 			g_free(stripped);
+			log_catalog_add_data(data, written, 0);
 			return written;
 		} else
-			written += fprintf(data->file, "(%s) %s%s %s\n", date, from ? from : "",
+			written += log_writer_printf(data, "(%s) %s%s %s\n", date, from ? from : "",
 					from ? ":" : "", stripped);
 	}
 	g_free(date);
 	g_free(stripped);
-	fflush(data->file);
+
+	log_catalog_add_data(data, written, 1);
 
 	return written;
 }
@@ -1467,8 +2300,7 @@ static void txt_logger_finalize(PurpleLog *log)
 {
 	PurpleLogCommonLoggerData *data = log->logger_data;
 	if (data) {
-		if(data->file)
-			fclose(data->file);
+		purple_log_common_close(log);
 		g_free(data->path);
 
 		g_slice_free(PurpleLogCommonLoggerData, data);
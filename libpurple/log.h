@@ -433,6 +433,43 @@ void purple_log_set_free(PurpleLogSet *set);
  */
 void purple_log_common_writer(PurpleLog *log, const char *ext);
 
+/**
+ * purple_log_common_write:
+ * @log:   The log to write to.
+ * @data:  The data to append to the log file.
+ * @len:   The length of @data, or -1 if it is NUL-terminated.
+ *
+ * Appends data to a log file opened by purple_log_common_writer().
+ *
+ * The data is buffered and written out by a background thread, in the
+ * order it was queued.  Once this has been called for a log, its file
+ * handle belongs to that thread and must only be closed with
+ * purple_log_common_close().
+ *
+ * The log catalog can't tell how many messages @data holds, so
+ * purple_log_common_get_message_count() returns -1 for the log afterwards.
+ *
+ * Returns: The number of bytes queued.
+ */
+gsize purple_log_common_write(PurpleLog *log, const char *data, gssize len);
+
+/**
+ * purple_log_common_close:
+ * @log:   The log to close.
+ *
+ * Queues anything still buffered for a log file opened by
+ * purple_log_common_writer(), then closes and syncs the file.
+ */
+void purple_log_common_close(PurpleLog *log);
+
+/**
+ * purple_log_common_sync:
+ *
+ * Waits until all data queued with purple_log_common_write() has been
+ * written and synced to disk.
+ */
+void purple_log_common_sync(void);
+
 /**
  * purple_log_common_lister:
  * @type:     The type of the logs being listed.
@@ -494,6 +531,19 @@ int purple_log_common_total_sizer(PurpleLogType type, const char *name,
  */
 int purple_log_common_sizer(PurpleLog *log);
 
+/**
+ * purple_log_common_get_message_count:
+ * @log:      The PurpleLog.
+ *
+ * Returns the number of messages in a log written with
+ * purple_log_common_writer(), as recorded in the log catalog.
+ *
+ * Returns: The number of messages, or -1 if it isn't known (for example
+ *          because the log was written by something else, or with
+ *          purple_log_common_write()).
+ */
+int purple_log_common_get_message_count(PurpleLog *log);
+
 /**
  * purple_log_common_deleter:
  * @log:      The PurpleLog to delete.
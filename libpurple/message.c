@@ -56,6 +56,7 @@ enum
 static GObjectClass *parent_class;
 static GParamSpec *properties[PROP_LAST];
 
+/* id => PurpleMessage*, without holding a reference. */
 static GHashTable *messages = NULL;
 
 /******************************************************************************
@@ -132,6 +133,9 @@ purple_message_find_by_id(guint id)
 {
 	g_return_val_if_fail(id > 0, NULL);
 
+	if (messages == NULL)
+		return NULL;
+
 	return g_hash_table_lookup(messages, GINT_TO_POINTER(id));
 }
 
@@ -244,7 +248,8 @@ purple_message_init(GTypeInstance *instance, gpointer klass)
 	PURPLE_DBUS_REGISTER_POINTER(msg, PurpleMessage);
 
 	priv->id = ++max_id;
-	g_hash_table_insert(messages, GINT_TO_POINTER(max_id), msg);
+	if (messages != NULL)
+		g_hash_table_insert(messages, GINT_TO_POINTER(max_id), msg);
 }
 
 static void
@@ -253,6 +258,9 @@ purple_message_finalize(GObject *obj)
 	PurpleMessage *message = PURPLE_MESSAGE(obj);
 	PurpleMessagePrivate *priv = PURPLE_MESSAGE_GET_PRIVATE(message);
 
+	if (messages != NULL)
+		g_hash_table_remove(messages, GINT_TO_POINTER(priv->id));
+
 	g_free(priv->author);
 	g_free(priv->author_alias);
 	g_free(priv->recipient);
@@ -395,8 +403,7 @@ purple_message_get_type(void)
 void
 _purple_message_init(void)
 {
-	messages = g_hash_table_new_full(g_direct_hash, g_direct_equal,
-		NULL, g_object_unref);
+	messages = g_hash_table_new(g_direct_hash, g_direct_equal);
 }
 
 void
@@ -145,9 +145,11 @@ purple_message_get_id(const PurpleMessage *msg);
  * purple_message_find_by_id:
  * @id: The message identifier.
  *
- * Finds the message with a given @id.
+ * Finds the message with a given @id.  Messages are only kept around
+ * for as long as someone (such as a conversation's history) holds a
+ * reference to them.
  *
- * Returns: the #PurpleMessage, or %NULL if not found.
+ * Returns: (transfer none): the #PurpleMessage, or %NULL if not found.
  */
 PurpleMessage *
 purple_message_find_by_id(guint id);
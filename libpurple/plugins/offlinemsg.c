@@ -81,6 +81,7 @@ record_pounce(OfflineMsg *offline)
 	PurplePounceEvent event;
 	PurplePounceOption option;
 	PurpleConversation *conv;
+	PurpleMessage *msg;
 	char *temp;
 
 	event = PURPLE_POUNCE_SIGNON;
@@ -108,8 +109,9 @@ record_pounce(OfflineMsg *offline)
 				GINT_TO_POINTER(OFFLINE_MSG_YES));
 
 	/* TODO: use a reference to a PurpleMessage */
-	purple_conversation_write_message(conv,
-		purple_message_new_outgoing(offline->who, offline->message, 0));
+	msg = purple_message_new_outgoing(offline->who, offline->message, 0);
+	purple_conversation_write_message(conv, msg);
+	g_object_unref(msg);
 
 	discard_data(offline);
 }
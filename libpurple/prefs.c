@@ -93,6 +93,13 @@ static guint       save_timer = 0;
 static gboolean    prefs_loaded = FALSE;
 static GSList     *ui_callbacks = NULL;
 
+/* Prefs changed inside a transaction, in the order they first changed. The
+ * names in the queue are shared with the hash table, which is only used to
+ * skip duplicates. */
+static guint       transaction_depth = 0;
+static GQueue     *transaction_queue = NULL;
+static GHashTable *transaction_names = NULL;
+
 #define PURPLE_PREFS_UI_OP_CALL(member, ...) \
 	{ \
 		PurplePrefsUiOps *uiop = purple_prefs_get_ui_ops(); \
@@ -826,17 +833,93 @@ purple_prefs_destroy()
 	purple_prefs_remove("/");
 }
 
-static void
+static guint
 do_callbacks(const char* name, struct purple_pref *pref)
 {
 	GSList *cbs;
 	struct purple_pref *cb_pref;
+	guint fired = 0;
+
 	for(cb_pref = pref; cb_pref; cb_pref = cb_pref->parent) {
 		for(cbs = cb_pref->callbacks; cbs; cbs = cbs->next) {
 			PurplePrefCallbackData *cb = cbs->data;
+
+			/* A committed transaction schedules a single save itself */
+			if (transaction_queue != NULL && cb->func == prefs_save_cb)
+				continue;
+
 			cb->func(name, pref->type, pref->value.generic, cb->data);
+			fired++;
 		}
 	}
+
+	return fired;
+}
+
+static void
+pref_changed(const char *name, struct purple_pref *pref)
+{
+	char *key;
+
+	if (transaction_depth == 0) {
+		do_callbacks(name, pref);
+		return;
+	}
+
+	if (g_hash_table_contains(transaction_names, name))
+		return;
+
+	key = g_strdup(name);
+	g_hash_table_add(transaction_names, key);
+	g_queue_push_tail(transaction_queue, key);
+}
+
+void
+purple_prefs_begin_transaction(void)
+{
+	if (transaction_depth++ > 0)
+		return;
+
+	transaction_queue = g_queue_new();
+	transaction_names = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+guint
+purple_prefs_commit_transaction(void)
+{
+	gboolean changed;
+	guint fired = 0;
+	char *name;
+
+	g_return_val_if_fail(transaction_depth > 0, 0);
+
+	if (--transaction_depth > 0)
+		return 0;
+
+	/* Callbacks may set more prefs; those aren't part of the transaction
+	 * anymore and fire right away. */
+	g_hash_table_destroy(transaction_names);
+	transaction_names = NULL;
+
+	changed = !g_queue_is_empty(transaction_queue);
+
+	while ((name = g_queue_pop_head(transaction_queue)) != NULL) {
+		struct purple_pref *pref = find_pref(name);
+
+		/* It may have been removed since it changed */
+		if (pref != NULL)
+			fired += do_callbacks(name, pref);
+
+		g_free(name);
+	}
+
+	g_queue_free(transaction_queue);
+	transaction_queue = NULL;
+
+	if (changed && prefs_loaded)
+		schedule_prefs_save();
+
+	return fired;
 }
 
 static void
@@ -885,7 +968,7 @@ purple_prefs_trigger_callback(const char *name)
 		return;
 	}
 
-	do_callbacks(name, pref);
+	pref_changed(name, pref);
 }
 
 /* this function is deprecated, so it doesn't get the new UI ops */
@@ -907,7 +990,7 @@ purple_prefs_set_bool(const char *name, gboolean value)
 
 		if(pref->value.boolean != value) {
 			pref->value.boolean = value;
-			do_callbacks(name, pref);
+			pref_changed(name, pref);
 		}
 	} else {
 		purple_prefs_add_bool(name, value);
@@ -932,7 +1015,7 @@ purple_prefs_set_int(const char *name, int value)
 
 		if(pref->value.integer != value) {
 			pref->value.integer = value;
-			do_callbacks(name, pref);
+			pref_changed(name, pref);
 		}
 	} else {
 		purple_prefs_add_int(name, value);
@@ -963,7 +1046,7 @@ purple_prefs_set_string(const char *name, const char *value)
 		if (!purple_strequal(pref->value.string, value)) {
 			g_free(pref->value.string);
 			pref->value.string = g_strdup(value);
-			do_callbacks(name, pref);
+			pref_changed(name, pref);
 		}
 	} else {
 		purple_prefs_add_string(name, value);
@@ -1003,7 +1086,7 @@ purple_prefs_set_string_list(const char *name, GList *value)
 		}
 		pref->value.stringlist = g_list_reverse(pref->value.stringlist);
 
-		do_callbacks(name, pref);
+		pref_changed(name, pref);
 
 	} else {
 		purple_prefs_add_string_list(name, value);
@@ -1029,7 +1112,7 @@ purple_prefs_set_path(const char *name, const char *value)
 		if (!purple_strequal(pref->value.string, value)) {
 			g_free(pref->value.string);
 			pref->value.string = g_strdup(value);
-			do_callbacks(name, pref);
+			pref_changed(name, pref);
 		}
 	} else {
 		purple_prefs_add_path(name, value);
@@ -1064,7 +1147,7 @@ purple_prefs_set_path_list(const char *name, GList *value)
 					g_strdup(tmp->data));
 		pref->value.stringlist = g_list_reverse(pref->value.stringlist);
 
-		do_callbacks(name, pref);
+		pref_changed(name, pref);
 
 	} else {
 		purple_prefs_add_path_list(name, value);
@@ -1726,6 +1809,7 @@ purple_prefs_init(void)
 
 	/* Buddies */
 	purple_prefs_add_none("/purple/buddies");
+	purple_prefs_add_bool("/purple/buddies/journal", FALSE);
 
 	/* Contact Priority Settings */
 	purple_prefs_add_none("/purple/contact");
@@ -1741,6 +1825,12 @@ purple_prefs_init(void)
 void
 purple_prefs_uninit()
 {
+	if (transaction_depth > 0) {
+		purple_debug_warning("prefs", "Uncommitted transaction at exit\n");
+		transaction_depth = 1;
+		purple_prefs_commit_transaction();
+	}
+
 	if (save_timer != 0)
 	{
 		g_source_remove(save_timer);
@@ -495,6 +495,31 @@ void purple_prefs_disconnect_callback(guint callback_id);
  */
 void purple_prefs_disconnect_by_handle(void *handle);
 
+/**
+ * purple_prefs_begin_transaction:
+ *
+ * Starts a batch of pref changes.  Until the matching
+ * purple_prefs_commit_transaction(), changing a pref doesn't call its
+ * callbacks; each changed pref is remembered once instead, no matter how
+ * often it changes.  Transactions may be nested, in which case only the
+ * outermost commit has any effect.
+ *
+ * This has no effect on prefs handled by the UI's #PurplePrefsUiOps.
+ */
+void purple_prefs_begin_transaction(void);
+
+/**
+ * purple_prefs_commit_transaction:
+ *
+ * Ends a batch of pref changes started by purple_prefs_begin_transaction().
+ * The callbacks of every pref changed in the batch are called once, with its
+ * current value, in the order the prefs first changed, and prefs.xml is
+ * saved once.
+ *
+ * Returns: The number of callbacks that were called.
+ */
+guint purple_prefs_commit_transaction(void);
+
 /**
  * purple_prefs_trigger_callback:
  *
@@ -220,6 +220,18 @@ PurpleBuddyPresence *purple_buddy_presence_new(PurpleBuddy *buddy);
  */
 PurpleBuddy *purple_buddy_presence_get_buddy(const PurpleBuddyPresence *presence);
 
+/**
+ * purple_buddy_presence_compute_score:
+ * @buddy_presence: The presence.
+ *
+ * Computes the availability score purple_buddy_presence_compare() ranks
+ * presences by, from the active statuses, the idle state and the account's
+ * "score" setting.  The idle time bonus is not included.
+ *
+ * Returns: The score, higher meaning more available.
+ */
+int purple_buddy_presence_compute_score(const PurpleBuddyPresence *buddy_presence);
+
 /**
  * purple_buddy_presence_compare:
  * @buddy_presence1: The first presence.
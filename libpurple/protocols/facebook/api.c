@@ -31,6 +31,10 @@
 #include "thrift.h"
 #include "util.h"
 
+/* The inflated payloads are kept in one buffer per connection, which is only
+ * shrunk back after one bigger than this. */
+#define FB_API_INFLATE_KEEP_SIZE  (256 * 1024)
+
 typedef struct _FbApiData FbApiData;
 
 enum
@@ -68,6 +72,10 @@ struct _FbApiPrivate
 	guint unread;
 	FbId lastmid;
 	gchar *contacts_delta;
+
+	GHashTable *parsers;
+	GZlibDecompressor *inflater;
+	GByteArray *inflated;
 };
 
 struct _FbApiData
@@ -189,6 +197,18 @@ fb_api_dispose(GObject *obj)
 	g_free(priv->stoken);
 	g_free(priv->token);
 	g_free(priv->contacts_delta);
+
+	if (priv->parsers != NULL) {
+		g_hash_table_destroy(priv->parsers);
+		priv->parsers = NULL;
+	}
+
+	if (priv->inflater != NULL) {
+		g_object_unref(priv->inflater);
+		g_byte_array_free(priv->inflated, TRUE);
+		priv->inflater = NULL;
+		priv->inflated = NULL;
+	}
 }
 
 static void
@@ -1132,13 +1152,15 @@ fb_api_cb_mqtt_connect(FbMqtt *mqtt, gpointer data)
 }
 
 static void
-fb_api_cb_publish_mark(FbApi *api, GByteArray *pload)
+fb_api_cb_publish_mark(FbApi *api, GByteArray *pload, guint offset)
 {
 	FbJsonValues *values;
 	GError *err = NULL;
 	JsonNode *root;
 
-	if (!fb_api_json_chk(api, pload->data, pload->len, &root)) {
+	if (!fb_api_json_chk(api, pload->data + offset, pload->len - offset,
+	                     &root))
+	{
 		return;
 	}
 
@@ -1244,7 +1266,7 @@ fb_api_event_parse(FbApi *api, FbApiEvent *event, GSList *events,
 }
 
 static void
-fb_api_cb_publish_mercury(FbApi *api, GByteArray *pload)
+fb_api_cb_publish_mercury(FbApi *api, GByteArray *pload, guint offset)
 {
 	const gchar *str;
 	FbApiEvent event;
@@ -1254,7 +1276,9 @@ fb_api_cb_publish_mercury(FbApi *api, GByteArray *pload)
 	JsonNode *root;
 	JsonNode *node;
 
-	if (!fb_api_json_chk(api, pload->data, pload->len, &root)) {
+	if (!fb_api_json_chk(api, pload->data + offset, pload->len - offset,
+	                     &root))
+	{
 		return;
 	}
 
@@ -1285,7 +1309,7 @@ fb_api_cb_publish_mercury(FbApi *api, GByteArray *pload)
 }
 
 static void
-fb_api_cb_publish_typing(FbApi *api, GByteArray *pload)
+fb_api_cb_publish_typing(FbApi *api, GByteArray *pload, guint offset)
 {
 	const gchar *str;
 	FbApiPrivate *priv = api->priv;
@@ -1294,7 +1318,9 @@ fb_api_cb_publish_typing(FbApi *api, GByteArray *pload)
 	GError *err = NULL;
 	JsonNode *root;
 
-	if (!fb_api_json_chk(api, pload->data, pload->len, &root)) {
+	if (!fb_api_json_chk(api, pload->data + offset, pload->len - offset,
+	                     &root))
+	{
 		return;
 	}
 
@@ -1326,7 +1352,7 @@ fb_api_cb_publish_typing(FbApi *api, GByteArray *pload)
 }
 
 static void
-fb_api_cb_publish_ms_r(FbApi *api, GByteArray *pload)
+fb_api_cb_publish_ms_r(FbApi *api, GByteArray *pload, guint offset)
 {
 	FbApiMessage *msg;
 	FbApiPrivate *priv = api->priv;
@@ -1334,7 +1360,9 @@ fb_api_cb_publish_ms_r(FbApi *api, GByteArray *pload)
 	GError *err = NULL;
 	JsonNode *root;
 
-	if (!fb_api_json_chk(api, pload->data, pload->len, &root)) {
+	if (!fb_api_json_chk(api, pload->data + offset, pload->len - offset,
+	                     &root))
+	{
 		return;
 	}
 
@@ -1487,7 +1515,7 @@ static GSList *
 fb_api_cb_publish_ms_event(FbApi *api, JsonNode *root, GSList *events, FbApiEventType type, GError **error);
 
 static void
-fb_api_cb_publish_ms(FbApi *api, GByteArray *pload)
+fb_api_cb_publish_ms(FbApi *api, GByteArray *pload, guint offset)
 {
 	const gchar *data;
 	FbApiPrivate *priv = api->priv;
@@ -1515,7 +1543,7 @@ fb_api_cb_publish_ms(FbApi *api, GByteArray *pload)
 	};
 
 	/* Read identifier string (for Facebook employees) */
-	thft = fb_thrift_new(pload, 0);
+	thft = fb_thrift_new(pload, offset);
 	fb_thrift_read_str(thft, NULL);
 	size = fb_thrift_get_pos(thft);
 	g_object_unref(thft);
@@ -1883,13 +1911,13 @@ fb_api_cb_publish_pt(FbThrift *thft, GSList **press, GError **error)
 }
 
 static void
-fb_api_cb_publish_p(FbApi *api, GByteArray *pload)
+fb_api_cb_publish_p(FbApi *api, GByteArray *pload, guint offset)
 {
 	FbThrift *thft;
 	GError *err = NULL;
 	GSList *press = NULL;
 
-	thft = fb_thrift_new(pload, 0);
+	thft = fb_thrift_new(pload, offset);
 	fb_api_cb_publish_pt(thft, &press, &err);
 	g_object_unref(thft);
 
@@ -1902,20 +1930,39 @@ fb_api_cb_publish_p(FbApi *api, GByteArray *pload)
 	g_slist_free_full(press, (GDestroyNotify) fb_api_presence_free);
 }
 
-static void
-fb_api_cb_mqtt_publish(FbMqtt *mqtt, const gchar *topic, GByteArray *pload,
-                       gpointer data)
+typedef void (*FbApiPublishFunc) (FbApi *api, GByteArray *pload,
+                                  guint offset);
+
+static guint
+fb_api_topic_hash(gconstpointer key)
 {
-	FbApi *api = data;
-	gboolean comp;
-	GByteArray *bytes;
-	GError *err = NULL;
+	const gchar *str;
+	guint hash = 5381;
+
+	/* g_str_hash(), but the topics are compared without case */
+	for (str = key; *str != '\0'; str++) {
+		hash = (hash << 5) + hash + g_ascii_tolower(*str);
+	}
+
+	return hash;
+}
+
+static gboolean
+fb_api_topic_equal(gconstpointer a, gconstpointer b)
+{
+	return g_ascii_strcasecmp(a, b) == 0;
+}
+
+static GHashTable *
+fb_api_parsers_new(void)
+{
+	GHashTable *parsers;
 	guint i;
 
 	static const struct {
 		const gchar *topic;
-		void (*func) (FbApi *api, GByteArray *pload);
-	} parsers[] = {
+		FbApiPublishFunc func;
+	} topics[] = {
 		{"/mark_thread_response", fb_api_cb_publish_mark},
 		{"/mercury", fb_api_cb_publish_mercury},
 		{"/orca_typing_notifications", fb_api_cb_publish_typing},
@@ -1924,28 +1971,78 @@ fb_api_cb_mqtt_publish(FbMqtt *mqtt, const gchar *topic, GByteArray *pload,
 		{"/t_p", fb_api_cb_publish_p}
 	};
 
-	comp = fb_util_zlib_test(pload);
+	parsers = g_hash_table_new(fb_api_topic_hash, fb_api_topic_equal);
 
-	if (G_LIKELY(comp)) {
-		bytes = fb_util_zlib_inflate(pload, &err);
-		FB_API_ERROR_EMIT(api, err, return);
-	} else {
-		bytes = (GByteArray *) pload;
+	for (i = 0; i < G_N_ELEMENTS(topics); i++) {
+		g_hash_table_insert(parsers, (gpointer) topics[i].topic,
+		                    topics[i].func);
 	}
 
-	fb_util_debug_hexdump(FB_UTIL_DEBUG_INFO, bytes,
-	                      "Reading message (topic: %s)",
-			      topic);
+	return parsers;
+}
 
-	for (i = 0; i < G_N_ELEMENTS(parsers); i++) {
-		if (g_ascii_strcasecmp(topic, parsers[i].topic) == 0) {
-			parsers[i].func(api, bytes);
-			break;
+static void
+fb_api_cb_mqtt_publish(FbMqtt *mqtt, const gchar *topic, GByteArray *pload,
+                       guint offset, gpointer data)
+{
+	FbApi *api = data;
+	FbApiPrivate *priv = api->priv;
+	FbApiPublishFunc func;
+	GByteArray *bytes;
+	GError *err = NULL;
+
+	if (G_UNLIKELY(priv->parsers == NULL)) {
+		priv->parsers = fb_api_parsers_new();
+	}
+
+	func = g_hash_table_lookup(priv->parsers, topic);
+
+	/* The payload stays in the MQTT receive buffer, unless it has to be
+	 * inflated, which reuses the same buffer every time. */
+	if (G_LIKELY(fb_util_zlib_test(pload->data + offset,
+	                               pload->len - offset)))
+	{
+		if (G_UNLIKELY(priv->inflater == NULL)) {
+			priv->inflater = g_zlib_decompressor_new(
+				G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+			priv->inflated = g_byte_array_new();
 		}
+
+		if (!fb_util_zlib_inflate_into(priv->inflater,
+		                               pload->data + offset,
+		                               pload->len - offset,
+		                               priv->inflated, &err))
+		{
+			FB_API_ERROR_EMIT(api, err, return);
+		}
+
+		bytes = priv->inflated;
+		offset = 0;
+	} else {
+		bytes = pload;
 	}
 
-	if (G_LIKELY(comp)) {
-		g_byte_array_free(bytes, TRUE);
+	if (fb_util_debug_is_enabled(FB_UTIL_DEBUG_INFO)) {
+		GByteArray *dump = g_byte_array_sized_new(bytes->len - offset);
+
+		g_byte_array_append(dump, bytes->data + offset,
+		                    bytes->len - offset);
+		fb_util_debug_hexdump(FB_UTIL_DEBUG_INFO, dump,
+		                      "Reading message (topic: %s)",
+		                      topic);
+		g_byte_array_free(dump, TRUE);
+	}
+
+	if (func != NULL) {
+		func(api, bytes, offset);
+	}
+
+	/* Don't hold on to what an unusually large payload needed. */
+	if ((bytes == priv->inflated) &&
+	    (priv->inflated->len > FB_API_INFLATE_KEEP_SIZE))
+	{
+		g_byte_array_free(priv->inflated, TRUE);
+		priv->inflated = g_byte_array_new();
 	}
 }
 
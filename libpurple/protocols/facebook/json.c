@@ -27,8 +27,17 @@
 #include "json.h"
 #include "util.h"
 
+typedef struct _FbJsonPlan FbJsonPlan;
 typedef struct _FbJsonValue FbJsonValue;
 
+struct _FbJsonPlan
+{
+	gchar *name;
+	GSList *values;
+	GSList *children;
+	GSList *fallback;
+};
+
 struct _FbJsonValue
 {
 	const gchar *expr;
@@ -42,6 +51,7 @@ struct _FbJsonValuesPrivate
 	JsonNode *root;
 	GQueue *queue;
 	GList *next;
+	FbJsonPlan *plan;
 
 	gboolean isarray;
 	JsonArray *array;
@@ -52,12 +62,20 @@ struct _FbJsonValuesPrivate
 
 G_DEFINE_TYPE(FbJsonValues, fb_json_values, G_TYPE_OBJECT);
 
+static void
+fb_json_plan_free(FbJsonPlan *plan);
+
 static void
 fb_json_values_dispose(GObject *obj)
 {
 	FbJsonValue *value;
 	FbJsonValuesPrivate *priv = FB_JSON_VALUES(obj)->priv;
 
+	if (priv->plan != NULL) {
+		fb_json_plan_free(priv->plan);
+		priv->plan = NULL;
+	}
+
 	while (!g_queue_is_empty(priv->queue)) {
 		value = g_queue_pop_head(priv->queue);
 
@@ -286,18 +304,88 @@ fb_json_node_new(const gchar *data, gssize size, GError **error)
 	return root;
 }
 
+/* Splits a "$.member.member" expression into the member names, or returns
+ * NULL if it needs a real #JsonPath. */
+static gchar **
+fb_json_path_compile(const gchar *expr)
+{
+	gchar **path;
+	guint i;
+
+	if (expr[0] != '$') {
+		return NULL;
+	}
+
+	if (expr[1] == '\0') {
+		return g_new0(gchar *, 1);
+	}
+
+	if ((expr[1] != '.') || (strpbrk(expr + 2, "$@*?()[]'\" ") != NULL)) {
+		return NULL;
+	}
+
+	path = g_strsplit(expr + 2, ".", -1);
+
+	/* Also rules out the recursive descent ("..") */
+	for (i = 0; path[i] != NULL; i++) {
+		if (path[i][0] == '\0') {
+			g_strfreev(path);
+			return NULL;
+		}
+	}
+
+	return path;
+}
+
+static JsonNode *
+fb_json_path_lookup(JsonNode *root, gchar **path)
+{
+	for (; *path != NULL; path++) {
+		if (!JSON_NODE_HOLDS_OBJECT(root)) {
+			return NULL;
+		}
+
+		root = json_object_get_member(json_node_get_object(root), *path);
+
+		if (root == NULL) {
+			return NULL;
+		}
+	}
+
+	return root;
+}
+
 JsonNode *
 fb_json_node_get(JsonNode *root, const gchar *expr, GError **error)
 {
 	GError *err = NULL;
+	gchar **path;
 	guint size;
 	JsonArray *rslt;
 	JsonNode *node;
 	JsonNode *ret;
 
-	/* Special case for json-glib < 0.99.2 */
-	if (purple_strequal(expr, "$")) {
-		return json_node_copy(root);
+	/* Plain member lookups don't need the JSONPath machinery, which
+	 * parses the expression and copies the matches every time. */
+	path = fb_json_path_compile(expr);
+
+	if (path != NULL) {
+		node = fb_json_path_lookup(root, path);
+		g_strfreev(path);
+
+		if (node == NULL) {
+			g_set_error(error, FB_JSON_ERROR, FB_JSON_ERROR_NOMATCH,
+			            _("No matches for %s"), expr);
+			return NULL;
+		}
+
+		if (JSON_NODE_HOLDS_NULL(node)) {
+			g_set_error(error, FB_JSON_ERROR, FB_JSON_ERROR_NULL,
+			            _("Null value for %s"), expr);
+			return NULL;
+		}
+
+		return json_node_copy(node);
 	}
 
 	node = json_path_query(expr, root, &err);
@@ -437,6 +525,137 @@ fb_json_node_get_str(JsonNode *root, const gchar *expr, GError **error)
 	return ret;
 }
 
+static void
+fb_json_plan_free(FbJsonPlan *plan)
+{
+	g_slist_free_full(plan->children, (GDestroyNotify) fb_json_plan_free);
+	g_slist_free(plan->values);
+	g_slist_free(plan->fallback);
+	g_free(plan->name);
+	g_free(plan);
+}
+
+/* Merges the expressions into a tree of member names, so the members
+ * shared by several of them are only looked up once. */
+static FbJsonPlan *
+fb_json_plan_new(GQueue *queue)
+{
+	FbJsonPlan *child;
+	FbJsonPlan *plan;
+	FbJsonPlan *root;
+	FbJsonValue *value;
+	gchar **path;
+	GList *l;
+	GSList *m;
+	guint i;
+
+	root = g_new0(FbJsonPlan, 1);
+
+	for (l = queue->head; l != NULL; l = l->next) {
+		value = l->data;
+		path = fb_json_path_compile(value->expr);
+
+		if (path == NULL) {
+			root->fallback = g_slist_append(root->fallback, value);
+			continue;
+		}
+
+		for (plan = root, i = 0; path[i] != NULL; plan = child, i++) {
+			for (m = plan->children; m != NULL; m = m->next) {
+				child = m->data;
+
+				if (purple_strequal(child->name, path[i])) {
+					break;
+				}
+			}
+
+			if (m == NULL) {
+				child = g_new0(FbJsonPlan, 1);
+				child->name = g_strdup(path[i]);
+				plan->children = g_slist_append(plan->children,
+				                                child);
+			}
+		}
+
+		plan->values = g_slist_append(plan->values, value);
+		g_strfreev(path);
+	}
+
+	return root;
+}
+
+static gboolean
+fb_json_value_bind(FbJsonValue *value, JsonNode *node, GError **error)
+{
+	GType type;
+
+	if (G_IS_VALUE(&value->value)) {
+		g_value_unset(&value->value);
+	}
+
+	if ((node == NULL) || JSON_NODE_HOLDS_NULL(node)) {
+		if (!value->required) {
+			return TRUE;
+		}
+
+		if (node == NULL) {
+			g_set_error(error, FB_JSON_ERROR, FB_JSON_ERROR_NOMATCH,
+			            _("No matches for %s"), value->expr);
+		} else {
+			g_set_error(error, FB_JSON_ERROR, FB_JSON_ERROR_NULL,
+			            _("Null value for %s"), value->expr);
+		}
+
+		return FALSE;
+	}
+
+	type = json_node_get_value_type(node);
+
+	if (G_UNLIKELY(type != value->type)) {
+		g_set_error(error, FB_JSON_ERROR, FB_JSON_ERROR_TYPE,
+		            _("Expected a %s but got a %s for %s"),
+		            g_type_name(value->type),
+		            g_type_name(type),
+		            value->expr);
+		return FALSE;
+	}
+
+	json_node_get_value(node, &value->value);
+	return TRUE;
+}
+
+/* Walks the tree along the plan, binding the values on the way. */
+static gboolean
+fb_json_plan_bind(FbJsonPlan *plan, JsonNode *node, GError **error)
+{
+	FbJsonPlan *child;
+	GSList *l;
+	JsonObject *obj = NULL;
+
+	for (l = plan->values; l != NULL; l = l->next) {
+		if (!fb_json_value_bind(l->data, node, error)) {
+			return FALSE;
+		}
+	}
+
+	if ((node != NULL) && JSON_NODE_HOLDS_OBJECT(node)) {
+		obj = json_node_get_object(node);
+	}
+
+	for (l = plan->children; l != NULL; l = l->next) {
+		child = l->data;
+
+		if (!fb_json_plan_bind(child, (obj != NULL) ?
+		                       json_object_get_member(obj, child->name) :
+		                       NULL, error))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
 FbJsonValues *
 fb_json_values_new(JsonNode *root)
 {
@@ -469,6 +688,11 @@ fb_json_values_add(FbJsonValues *values, FbJsonType type, gboolean required,
 	value->required = required;
 
 	g_queue_push_tail(priv->queue, value);
+
+	if (priv->plan != NULL) {
+		fb_json_plan_free(priv->plan);
+		priv->plan = NULL;
+	}
 }
 
 JsonNode *
@@ -516,9 +740,9 @@ fb_json_values_update(FbJsonValues *values, GError **error)
 {
 	FbJsonValue *value;
 	FbJsonValuesPrivate *priv;
+	gboolean succ;
 	GError *err = NULL;
-	GList *l;
-	GType type;
+	GSList *l;
 	JsonNode *root;
 	JsonNode *node;
 
@@ -545,16 +769,22 @@ fb_json_values_update(FbJsonValues *values, GError **error)
 
 	g_return_val_if_fail(root != NULL, FALSE);
 
-	for (l = priv->queue->head; l != NULL; l = l->next) {
+	if (priv->plan == NULL) {
+		priv->plan = fb_json_plan_new(priv->queue);
+	}
+
+	if (!fb_json_plan_bind(priv->plan, root, error)) {
+		return FALSE;
+	}
+
+	for (l = priv->plan->fallback; l != NULL; l = l->next) {
 		value = l->data;
 		node = fb_json_node_get(root, value->expr, &err);
 
-		if (G_IS_VALUE(&value->value)) {
-			g_value_unset(&value->value);
-		}
-
 		if (err != NULL) {
-			json_node_free(node);
+			if (G_IS_VALUE(&value->value)) {
+				g_value_unset(&value->value);
+			}
 
 			if (value->required) {
 				g_propagate_error(error, err);
@@ -565,20 +795,12 @@ fb_json_values_update(FbJsonValues *values, GError **error)
 			continue;
 		}
 
-		type = json_node_get_value_type(node);
+		succ = fb_json_value_bind(value, node, error);
+		json_node_free(node);
 
-		if (G_UNLIKELY(type != value->type)) {
-			g_set_error(error, FB_JSON_ERROR, FB_JSON_ERROR_TYPE,
-			            _("Expected a %s but got a %s for %s"),
-			            g_type_name(value->type),
-			            g_type_name(type),
-				    value->expr);
-			json_node_free(node);
+		if (!succ) {
 			return FALSE;
 		}
-
-		json_node_get_value(node, &value->value);
-		json_node_free(node);
 	}
 
 	priv->next = priv->queue->head;
@@ -136,9 +136,12 @@ fb_mqtt_class_init(FbMqttClass *klass)
 	 * FbMqtt::publish:
 	 * @mqtt: The #FbMqtt.
 	 * @topic: The topic.
-	 * @pload: The payload.
+	 * @bytes: The #GByteArray holding the payload.
+	 * @offset: The offset of the payload in @bytes.
 	 *
-	 * Emitted upon an incoming message from the steam.
+	 * Emitted upon an incoming message from the steam. The payload is
+	 * not copied out of the receive buffer, so @bytes is only valid
+	 * during the emission.
 	 */
 	g_signal_new("publish",
 	             G_TYPE_FROM_CLASS(klass),
@@ -146,7 +149,9 @@ fb_mqtt_class_init(FbMqttClass *klass)
 	             0,
 	             NULL, NULL, NULL,
 	             G_TYPE_NONE,
-	             2, G_TYPE_STRING, G_TYPE_BYTE_ARRAY);
+	             3, G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE,
+	             G_TYPE_BYTE_ARRAY | G_SIGNAL_TYPE_STATIC_SCOPE,
+	             G_TYPE_UINT);
 }
 
 static void
@@ -471,7 +476,6 @@ fb_mqtt_read(FbMqtt *mqtt, FbMqttMessage *msg)
 	FbMqttMessage *nsg;
 	FbMqttPrivate *priv;
 	FbMqttMessagePrivate *mriv;
-	GByteArray *wytes;
 	gchar *str;
 	guint8 chr;
 	guint16 mid;
@@ -529,10 +533,8 @@ fb_mqtt_read(FbMqtt *mqtt, FbMqttMessage *msg)
 			g_object_unref(nsg);
 		}
 
-		wytes = g_byte_array_new();
-		fb_mqtt_message_read_r(msg, wytes);
-		g_signal_emit_by_name(mqtt, "publish", str, wytes);
-		g_byte_array_free(wytes, TRUE);
+		g_signal_emit_by_name(mqtt, "publish", str, mriv->bytes,
+		                      mriv->pos);
 		g_free(str);
 		return;
 
@@ -0,0 +1,310 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include "protocols/facebook/json.h"
+
+/* The fields fb_api_cb_publish_ms_new_message() reads from every delta. */
+static const struct {
+	FbJsonType type;
+	const gchar *expr;
+} test_fb_json_delta_fields[] = {
+	{ FB_JSON_TYPE_INT, "$.messageMetadata.offlineThreadingId" },
+	{ FB_JSON_TYPE_INT, "$.messageMetadata.actorFbId" },
+	{ FB_JSON_TYPE_INT, "$.messageMetadata.threadKey.otherUserFbId" },
+	{ FB_JSON_TYPE_INT, "$.messageMetadata.threadKey.threadFbId" },
+	{ FB_JSON_TYPE_INT, "$.messageMetadata.timestamp" },
+	{ FB_JSON_TYPE_STR, "$.body" },
+	{ FB_JSON_TYPE_INT, "$.stickerId" },
+	{ FB_JSON_TYPE_STR, "$.messageMetadata.messageId" }
+};
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+/* A "deltas" sync payload, shaped like the ones the MQTT topics deliver. */
+static JsonNode *
+test_fb_json_deltas_new(guint count)
+{
+	GString *data = g_string_new("{\"deltas\": [");
+	JsonNode *root;
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		g_string_append_printf(data,
+			"%s{\"class\": \"NewMessage\", "
+			"\"attachments\": [], "
+			"\"body\": \"message %u\", "
+			"%s"
+			"\"irisSeqId\": \"%u\", "
+			"\"messageMetadata\": {"
+				"\"actorFbId\": %u, "
+				"\"folderId\": {\"systemFolderId\": \"INBOX\"}, "
+				"\"messageId\": \"mid.$%08x\", "
+				"\"offlineThreadingId\": %u, "
+				"\"skipBumpThread\": false, "
+				"\"tags\": [\"source:messenger:web\"], "
+				"\"threadKey\": {%s: %u}, "
+				"\"timestamp\": %" G_GINT64_FORMAT "}}",
+			(i > 0) ? ", " : "", i,
+			(i % 5 == 0) ? "\"stickerId\": 369239263222822, " : "",
+			i, 100000 + i % 50, i, 6000000 + i,
+			(i % 3 == 0) ? "\"threadFbId\"" : "\"otherUserFbId\"",
+			200000 + i % 20, G_GINT64_CONSTANT(1500000000000) + i);
+	}
+
+	g_string_append(data, "]}");
+	root = fb_json_node_new(data->str, data->len, NULL);
+	g_assert_nonnull(root);
+	g_string_free(data, TRUE);
+
+	return root;
+}
+
+/* What every field of every element used to go through. */
+static gboolean
+test_fb_json_path_value(JsonNode *root, const gchar *expr, GValue *value)
+{
+	JsonArray *rslt;
+	JsonNode *node;
+	JsonNode *match;
+
+	node = json_path_query(expr, root, NULL);
+	rslt = json_node_get_array(node);
+
+	if ((json_array_get_length(rslt) != 1) ||
+	    json_array_get_null_element(rslt, 0))
+	{
+		json_node_free(node);
+		return FALSE;
+	}
+
+	match = json_array_dup_element(rslt, 0);
+	json_node_get_value(match, value);
+	json_node_free(match);
+	json_node_free(node);
+	return TRUE;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_fb_json_values(void)
+{
+	const gchar *data =
+		"{\"id\": 42, \"name\": \"Somebody\", \"nothing\": null, "
+		"\"flag\": true, \"ratio\": 0.5, "
+		"\"meta\": {\"id\": 7, \"key\": {\"fbid\": 9, \"name\": \"deep\"}}, "
+		"\"list\": [{\"id\": 1}, {\"id\": 2}]}";
+	FbJsonValues *values;
+	GError *err = NULL;
+	JsonNode *root;
+
+	root = fb_json_node_new(data, -1, NULL);
+	g_assert_nonnull(root);
+
+	/* Members that share a prefix, missing and null ones, and one that
+	 * needs a real JSONPath, all in one plan. */
+	values = fb_json_values_new(root);
+	fb_json_values_add(values, FB_JSON_TYPE_INT, TRUE, "$.meta.key.fbid");
+	fb_json_values_add(values, FB_JSON_TYPE_STR, TRUE, "$.name");
+	fb_json_values_add(values, FB_JSON_TYPE_INT, TRUE, "$.meta.id");
+	fb_json_values_add(values, FB_JSON_TYPE_STR, FALSE, "$.meta.key.none");
+	fb_json_values_add(values, FB_JSON_TYPE_STR, FALSE, "$.nothing");
+	fb_json_values_add(values, FB_JSON_TYPE_INT, TRUE, "$.list[1].id");
+	fb_json_values_add(values, FB_JSON_TYPE_BOOL, TRUE, "$.flag");
+	fb_json_values_add(values, FB_JSON_TYPE_DBL, TRUE, "$.ratio");
+	fb_json_values_add(values, FB_JSON_TYPE_STR, TRUE, "$.meta.key.name");
+	fb_json_values_add(values, FB_JSON_TYPE_INT, FALSE, "$.name.id");
+
+	g_assert_true(fb_json_values_update(values, &err));
+	g_assert_no_error(err);
+
+	g_assert_cmpint(9, ==, fb_json_values_next_int(values, 0));
+	g_assert_cmpstr("Somebody", ==, fb_json_values_next_str(values, NULL));
+	g_assert_cmpint(7, ==, fb_json_values_next_int(values, 0));
+	g_assert_cmpstr("default", ==,
+	                fb_json_values_next_str(values, "default"));
+	g_assert_null(fb_json_values_next_str(values, NULL));
+	g_assert_cmpint(2, ==, fb_json_values_next_int(values, 0));
+	g_assert_true(fb_json_values_next_bool(values, FALSE));
+	g_assert_cmpfloat(0.5, ==, fb_json_values_next_dbl(values, 0.0));
+	g_assert_cmpstr("deep", ==, fb_json_values_next_str(values, NULL));
+	g_assert_cmpint(-1, ==, fb_json_values_next_int(values, -1));
+	g_object_unref(values);
+
+	/* The same errors as before. */
+	values = fb_json_values_new(root);
+	fb_json_values_add(values, FB_JSON_TYPE_INT, TRUE, "$.meta.none");
+	g_assert_false(fb_json_values_update(values, &err));
+	g_assert_error(err, FB_JSON_ERROR, FB_JSON_ERROR_NOMATCH);
+	g_clear_error(&err);
+	g_object_unref(values);
+
+	values = fb_json_values_new(root);
+	fb_json_values_add(values, FB_JSON_TYPE_STR, TRUE, "$.nothing");
+	g_assert_false(fb_json_values_update(values, &err));
+	g_assert_error(err, FB_JSON_ERROR, FB_JSON_ERROR_NULL);
+	g_clear_error(&err);
+	g_object_unref(values);
+
+	values = fb_json_values_new(root);
+	fb_json_values_add(values, FB_JSON_TYPE_STR, FALSE, "$.meta.id");
+	g_assert_false(fb_json_values_update(values, &err));
+	g_assert_error(err, FB_JSON_ERROR, FB_JSON_ERROR_TYPE);
+	g_clear_error(&err);
+	g_object_unref(values);
+
+	json_node_free(root);
+}
+
+static void
+test_fb_json_values_array(void)
+{
+	FbJsonValues *values;
+	GError *err = NULL;
+	JsonNode *root;
+	guint count = 0;
+	guint i;
+
+	root = test_fb_json_deltas_new(100);
+
+	values = fb_json_values_new(root);
+	for (i = 0; i < G_N_ELEMENTS(test_fb_json_delta_fields); i++) {
+		fb_json_values_add(values, test_fb_json_delta_fields[i].type, FALSE,
+		                   test_fb_json_delta_fields[i].expr);
+	}
+	fb_json_values_set_array(values, FALSE, "$.deltas");
+
+	while (fb_json_values_update(values, &err)) {
+		JsonNode *node = fb_json_values_get_root(values);
+
+		/* Each value matches what JSONPath finds for it. */
+		for (i = 0; i < G_N_ELEMENTS(test_fb_json_delta_fields); i++) {
+			const GValue *value = fb_json_values_next(values);
+			GValue expected = G_VALUE_INIT;
+
+			if (!test_fb_json_path_value(node,
+				test_fb_json_delta_fields[i].expr, &expected))
+			{
+				g_assert_null(value);
+				continue;
+			}
+
+			g_assert_nonnull(value);
+			g_assert_true(G_VALUE_TYPE(value) == G_VALUE_TYPE(&expected));
+
+			if (G_VALUE_HOLDS_STRING(value)) {
+				g_assert_cmpstr(g_value_get_string(&expected), ==,
+				                g_value_get_string(value));
+			} else {
+				g_assert_cmpint(g_value_get_int64(&expected), ==,
+				                g_value_get_int64(value));
+			}
+
+			g_value_unset(&expected);
+		}
+
+		count++;
+	}
+
+	g_assert_no_error(err);
+	g_assert_cmpint(100, ==, count);
+
+	g_object_unref(values);
+	json_node_free(root);
+}
+
+static void
+test_fb_json_values_performance(void)
+{
+	const guint count = 2000;
+	FbJsonValues *values;
+	GValue value = G_VALUE_INIT;
+	JsonArray *deltas;
+	JsonNode *root;
+	gdouble compiled, path;
+	guint i, j;
+
+	root = test_fb_json_deltas_new(count);
+
+	g_test_timer_start();
+	values = fb_json_values_new(root);
+	for (i = 0; i < G_N_ELEMENTS(test_fb_json_delta_fields); i++) {
+		fb_json_values_add(values, test_fb_json_delta_fields[i].type, FALSE,
+		                   test_fb_json_delta_fields[i].expr);
+	}
+	fb_json_values_set_array(values, FALSE, "$.deltas");
+
+	for (i = 0; fb_json_values_update(values, NULL); i++);
+	compiled = g_test_timer_elapsed();
+
+	g_assert_cmpint(count, ==, i);
+	g_object_unref(values);
+
+	/* The same work, one JSONPath query per field. */
+	g_test_timer_start();
+	deltas = json_node_get_array(json_object_get_member(
+		json_node_get_object(root), "deltas"));
+
+	for (i = 0; i < count; i++) {
+		JsonNode *node = json_array_get_element(deltas, i);
+
+		for (j = 0; j < G_N_ELEMENTS(test_fb_json_delta_fields); j++) {
+			if (test_fb_json_path_value(node,
+				test_fb_json_delta_fields[j].expr, &value))
+			{
+				g_value_unset(&value);
+			}
+		}
+	}
+	path = g_test_timer_elapsed();
+
+	g_test_minimized_result(compiled / count,
+		"%u deltas: %.2f us per delta compiled, %.2f us with JSONPath "
+		"(%.1fx)", count, compiled * 1e6 / count, path * 1e6 / count,
+		path / compiled);
+
+	json_node_free(root);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/facebook/json/values",
+	                test_fb_json_values);
+	g_test_add_func("/facebook/json/values/array",
+	                test_fb_json_values_array);
+	if (g_test_perf()) {
+		g_test_add_func("/facebook/json/values/performance",
+		                test_fb_json_values_performance);
+	}
+
+	return g_test_run();
+}
@@ -0,0 +1,133 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "protocols/facebook/util.h"
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static GByteArray *
+test_fb_util_pattern(guint size)
+{
+	GByteArray *bytes = g_byte_array_sized_new(size);
+	guint i;
+
+	for (i = 0; i < size; i++) {
+		guint8 byte = "presence"[i % 8] + (i / 4096);
+
+		g_byte_array_append(bytes, &byte, 1);
+	}
+
+	return bytes;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_fb_util_zlib_inflate_into(void)
+{
+	const guint sizes[] = { 300 * 1024, 17, 1, 5000 };
+	GZlibDecompressor *conv;
+	GByteArray *inflated;
+	guint i;
+
+	conv = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+	inflated = g_byte_array_new();
+
+	/* The same decompressor and array, for payloads of any size. */
+	for (i = 0; i < G_N_ELEMENTS(sizes); i++) {
+		GByteArray *plain = test_fb_util_pattern(sizes[i]);
+		GByteArray *deflated = fb_util_zlib_deflate(plain, NULL);
+		GError *err = NULL;
+
+		g_assert_nonnull(deflated);
+		g_assert_true(fb_util_zlib_test(deflated->data, deflated->len));
+		g_assert_true(fb_util_zlib_inflate_into(conv, deflated->data,
+		                                        deflated->len, inflated,
+		                                        &err));
+		g_assert_no_error(err);
+
+		g_assert_cmpint(plain->len, ==, inflated->len);
+		g_assert_true(memcmp(plain->data, inflated->data,
+		                     plain->len) == 0);
+
+		g_byte_array_free(deflated, TRUE);
+		g_byte_array_free(plain, TRUE);
+	}
+
+	g_byte_array_free(inflated, TRUE);
+	g_object_unref(conv);
+}
+
+static void
+test_fb_util_zlib_inflate_into_error(void)
+{
+	GByteArray *plain = test_fb_util_pattern(10000);
+	GByteArray *deflated = fb_util_zlib_deflate(plain, NULL);
+	GByteArray *inflated = g_byte_array_new();
+	GZlibDecompressor *conv;
+	GError *err = NULL;
+
+	conv = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+
+	/* A truncated payload fails, and doesn't break the next one. */
+	g_assert_false(fb_util_zlib_inflate_into(conv, deflated->data,
+	                                         deflated->len / 2, inflated,
+	                                         &err));
+	g_assert_nonnull(err);
+	g_clear_error(&err);
+
+	g_assert_true(fb_util_zlib_inflate_into(conv, deflated->data,
+	                                        deflated->len, inflated,
+	                                        &err));
+	g_assert_no_error(err);
+	g_assert_cmpint(plain->len, ==, inflated->len);
+
+	/* Uncompressed payloads are told apart by the header. */
+	g_assert_false(fb_util_zlib_test(plain->data, plain->len));
+	g_assert_false(fb_util_zlib_test(deflated->data, 1));
+
+	g_object_unref(conv);
+	g_byte_array_free(inflated, TRUE);
+	g_byte_array_free(deflated, TRUE);
+	g_byte_array_free(plain, TRUE);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/facebook/util/zlib/inflate-into",
+	                test_fb_util_zlib_inflate_into);
+	g_test_add_func("/facebook/util/zlib/inflate-into/error",
+	                test_fb_util_zlib_inflate_into_error);
+
+	return g_test_run();
+}
@@ -106,21 +106,27 @@ fb_util_debug(PurpleDebugLevel level, const gchar *format, ...)
 	va_end(ap);
 }
 
-void
-fb_util_vdebug(PurpleDebugLevel level, const gchar *format, va_list ap)
+gboolean
+fb_util_debug_is_enabled(PurpleDebugLevel level)
 {
 	gboolean unsafe;
 	gboolean verbose;
-	gchar *str;
-
-	g_return_if_fail(format != NULL);
 
 	unsafe = (level & FB_UTIL_DEBUG_FLAG_UNSAFE) != 0;
 	verbose = (level & FB_UTIL_DEBUG_FLAG_VERBOSE) != 0;
 
-	if ((unsafe && !purple_debug_is_unsafe()) ||
-	    (verbose && !purple_debug_is_verbose()))
-	{
+	return (!unsafe || purple_debug_is_unsafe()) &&
+	       (!verbose || purple_debug_is_verbose());
+}
+
+void
+fb_util_vdebug(PurpleDebugLevel level, const gchar *format, va_list ap)
+{
+	gchar *str;
+
+	g_return_if_fail(format != NULL);
+
+	if (!fb_util_debug_is_enabled(level)) {
 		return;
 	}
 
@@ -196,6 +202,11 @@ fb_util_debug_hexdump(PurpleDebugLevel level, const GByteArray *bytes,
 
 	g_return_if_fail(bytes != NULL);
 
+	/* Don't format what won't be logged (every packet, otherwise) */
+	if (!fb_util_debug_is_enabled(level)) {
+		return;
+	}
+
 	if (format != NULL) {
 		va_start(ap, format);
 		fb_util_vdebug(level, format, ap);
@@ -432,6 +443,7 @@ fb_util_serv_got_im(PurpleConnection *gc, const gchar *who, const gchar *text,
 	msg = purple_message_new_outgoing(name, text, flags);
 	purple_message_set_time(msg, timestamp);
 	purple_conversation_write_message(PURPLE_CONVERSATION(conv), msg);
+	g_object_unref(msg);
 }
 
 void
@@ -456,6 +468,7 @@ fb_util_serv_got_chat_in(PurpleConnection *gc, gint id, const gchar *who,
 	msg = purple_message_new_outgoing(name, text, flags);
 	purple_message_set_time(msg, timestamp);
 	purple_conversation_write_message(PURPLE_CONVERSATION(conv), msg);
+	g_object_unref(msg);
 }
 
 gboolean
@@ -480,19 +493,19 @@ fb_util_strtest(const gchar *str, GAsciiType type)
 }
 
 gboolean
-fb_util_zlib_test(const GByteArray *bytes)
+fb_util_zlib_test(const guint8 *data, gsize size)
 {
 	guint8 b0;
 	guint8 b1;
 
-	g_return_val_if_fail(bytes != NULL, FALSE);
+	g_return_val_if_fail(data != NULL || size == 0, FALSE);
 
-	if (bytes->len < 2) {
+	if (size < 2) {
 		return FALSE;
 	}
 
-	b0 = *(bytes->data + 0);
-	b1 = *(bytes->data + 1);
+	b0 = *(data + 0);
+	b1 = *(data + 1);
 
 	return ((((b0 << 8) | b1) % 31) == 0) &&    /* Check the header */
 	       ((b0 & 0x0F) == 8 /* Z_DEFLATED */); /* Check the method */
@@ -560,7 +573,72 @@ fb_util_zlib_inflate(const GByteArray *bytes, GError **error)
 	GZlibDecompressor *conv;
 
 	conv = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
-	ret = fb_util_zlib_conv(G_CONVERTER(conv), bytes, error);
+	ret = g_byte_array_new();
+
+	if (!fb_util_zlib_inflate_into(conv, bytes->data, bytes->len, ret,
+	                               error))
+	{
+		g_byte_array_free(ret, TRUE);
+		ret = NULL;
+	}
+
 	g_object_unref(conv);
 	return ret;
 }
+
+gboolean
+fb_util_zlib_inflate_into(GZlibDecompressor *conv, const guint8 *data,
+                          gsize size, GByteArray *bytes, GError **error)
+{
+	GConverterResult res;
+	GError *err = NULL;
+	gsize cize = 0;
+	gsize rize;
+	gsize wize;
+	gsize wpos = 0;
+
+	g_return_val_if_fail(G_IS_ZLIB_DECOMPRESSOR(conv), FALSE);
+	g_return_val_if_fail(bytes != NULL, FALSE);
+
+	g_converter_reset(G_CONVERTER(conv));
+
+	/* Inflate straight into the array, which only ever grows (and so
+	 * is only reallocated when a bigger payload comes by). */
+	g_byte_array_set_size(bytes, MAX(size * 4, 1024));
+
+	while (TRUE) {
+		rize = 0;
+		wize = 0;
+
+		res = g_converter_convert(G_CONVERTER(conv),
+		                          data + cize, size - cize,
+		                          bytes->data + wpos,
+		                          bytes->len - wpos,
+		                          G_CONVERTER_INPUT_AT_END,
+		                          &rize, &wize, &err);
+
+		cize += rize;
+		wpos += wize;
+
+		if (res == G_CONVERTER_FINISHED) {
+			g_byte_array_set_size(bytes, wpos);
+			return TRUE;
+		}
+
+		if (res == G_CONVERTER_ERROR) {
+			if (!g_error_matches(err, G_IO_ERROR,
+			                     G_IO_ERROR_NO_SPACE))
+			{
+				g_propagate_error(error, err);
+				g_byte_array_set_size(bytes, 0);
+				return FALSE;
+			}
+
+			g_clear_error(&err);
+		} else if (wpos < bytes->len) {
+			continue;
+		}
+
+		g_byte_array_set_size(bytes, bytes->len * 2);
+	}
+}
@@ -32,6 +32,7 @@
  */
 
 #include <glib.h>
+#include <gio/gio.h>
 
 #include <libpurple/util.h>
 
@@ -200,6 +201,18 @@ void
 fb_util_debug_fatal(const gchar *format, ...)
                     G_GNUC_PRINTF(1, 2);
 
+/**
+ * fb_util_debug_is_enabled:
+ * @level: The #PurpleDebugLevel.
+ *
+ * Checks if messages with the #PurpleDebugLevel, including its
+ * #FbUtilDebugFlags, are logged at all.
+ *
+ * Returns: #TRUE if the messages are logged, otherwise #FALSE.
+ */
+gboolean
+fb_util_debug_is_enabled(PurpleDebugLevel level);
+
 /**
  * fb_util_debug_hexdump:
  * @level: The #PurpleDebugLevel.
@@ -312,14 +325,15 @@ fb_util_strtest(const gchar *str, GAsciiType type);
 
 /**
  * fb_util_zlib_test:
- * @bytes: The #GByteArray.
+ * @data: The data.
+ * @size: The size of @data.
  *
- * Tests if the #GByteArray is zlib compressed.
+ * Tests if the data is zlib compressed.
  *
- * Returns: #TRUE if the #GByteArray is compressed, otherwise #FALSE.
+ * Returns: #TRUE if the data is compressed, otherwise #FALSE.
  */
 gboolean
-fb_util_zlib_test(const GByteArray *bytes);
+fb_util_zlib_test(const guint8 *data, gsize size);
 
 /**
  * fb_util_zlib_deflate:
@@ -347,4 +361,22 @@ fb_util_zlib_deflate(const GByteArray *bytes, GError **error);
 GByteArray *
 fb_util_zlib_inflate(const GByteArray *bytes, GError **error);
 
+/**
+ * fb_util_zlib_inflate_into:
+ * @conv: The #GZlibDecompressor.
+ * @data: The data.
+ * @size: The size of @data.
+ * @bytes: The #GByteArray to inflate into.
+ * @error: The return location for the #GError or #NULL.
+ *
+ * Inflates data with zlib into an existing #GByteArray, replacing its
+ * contents. The decompressor is reset first, so that it (and @bytes)
+ * can be reused for every payload on a connection.
+ *
+ * Returns: #TRUE if the data was inflated, otherwise #FALSE.
+ */
+gboolean
+fb_util_zlib_inflate_into(GZlibDecompressor *conv, const guint8 *data,
+                          gsize size, GByteArray *bytes, GError **error);
+
 #endif /* _FACEBOOK_UTIL_H_ */
@@ -241,6 +241,7 @@ static void ggp_message_got_display(PurpleConnection *gc,
 		purple_message_set_time(pmsg, msg->time);
 
 		purple_conversation_write_message(PURPLE_CONVERSATION(im), pmsg);
+		g_object_unref(pmsg);
 	} else
 		purple_debug_error("gg", "ggp_message_got_display: "
 			"unexpected message type: %d\n", msg->type);
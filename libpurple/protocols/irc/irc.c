@@ -315,6 +315,8 @@ static void irc_login(PurpleAccount *account)
 	irc_cmd_table_build(irc);
 	irc->msgs = g_hash_table_new(g_str_hash, g_str_equal);
 	irc_msg_table_build(irc);
+	irc->receiving_text = purple_signal_lookup(_irc_protocol,
+			"irc-receiving-text");
 
 	purple_connection_update_progress(gc, _("Connecting"), 1, 2);
 
@@ -430,9 +432,8 @@ irc_login_cb(GObject *source, GAsyncResult *res, gpointer user_data)
 			g_io_stream_get_output_stream(G_IO_STREAM(irc->conn)));
 
 	if (do_login(gc)) {
-		irc->input = g_data_input_stream_new(
-				g_io_stream_get_input_stream(
-						G_IO_STREAM(irc->conn)));
+		irc->input = g_object_ref(g_io_stream_get_input_stream(
+				G_IO_STREAM(irc->conn)));
 		irc_read_input(irc);
 	}
 }
@@ -454,8 +455,7 @@ static void irc_close(PurpleConnection *gc)
 
 	if (irc->conn != NULL) {
 		purple_gio_graceful_close(G_IO_STREAM(irc->conn),
-				G_INPUT_STREAM(irc->input),
-				G_OUTPUT_STREAM(irc->output));
+				irc->input, G_OUTPUT_STREAM(irc->output));
 	}
 
 	g_clear_object(&irc->input);
@@ -470,6 +470,7 @@ static void irc_close(PurpleConnection *gc)
 	if (irc->motd)
 		g_string_free(irc->motd, TRUE);
 	g_free(irc->server);
+	g_free(irc->inbuf);
 
 	g_free(irc->mode_chars);
 	g_free(irc->reqnick);
@@ -575,24 +576,71 @@ static void irc_remove_buddy(PurpleConnection *gc, PurpleBuddy *buddy, PurpleGro
 	}
 }
 
+char *
+irc_input_reserve(struct irc_conn *irc, gsize *size)
+{
+	/* Always leave room for the terminating NUL irc_input_parse() adds. */
+	if (irc->inbuflen < irc->inbufused + IRC_INITIAL_BUFSIZE) {
+		irc->inbuflen += IRC_INITIAL_BUFSIZE;
+		irc->inbuf = g_realloc(irc->inbuf, irc->inbuflen);
+	}
+
+	*size = irc->inbuflen - irc->inbufused - 1;
+	return irc->inbuf + irc->inbufused;
+}
+
+void
+irc_input_parse(struct irc_conn *irc, gsize len)
+{
+	char *cur, *end, *last;
+
+	irc->inbufused += len;
+	irc->inbuf[irc->inbufused] = '\0';
+
+	cur = irc->inbuf;
+	last = irc->inbuf + irc->inbufused;
+
+	/* Parse every complete line right where it is in the buffer. */
+	while (cur < last && (end = memchr(cur, '\n', last - cur)) != NULL) {
+		char *line = cur;
+
+		cur = end + 1;
+
+		if (end > line && end[-1] == '\r')
+			end--;
+		*end = '\0';
+
+		/* This is a hack to work around the fact that marv gets messages
+		 * with null bytes in them while using some weird irc server at work
+		 */
+		while (line < end && *line == '\0')
+			++line;
+
+		if (line < end)
+			irc_parse_msg(irc, line);
+	}
+
+	/* Keep the partial line for the next read. */
+	irc->inbufused = last - cur;
+	if (irc->inbufused > 0 && cur != irc->inbuf)
+		memmove(irc->inbuf, cur, irc->inbufused);
+}
+
 static void
 irc_read_input_cb(GObject *source, GAsyncResult *res, gpointer data)
 {
 	PurpleConnection *gc = data;
 	struct irc_conn *irc;
-	gchar *line;
-	gsize len;
-	gsize start = 0;
+	gssize len;
 	GError *error = NULL;
 
-	line = g_data_input_stream_read_line_finish(
-			G_DATA_INPUT_STREAM(source), res, &len, &error);
+	len = g_input_stream_read_finish(G_INPUT_STREAM(source), res, &error);
 
-	if (line == NULL && error != NULL) {
+	if (len < 0) {
 		g_prefix_error(&error, _("Lost connection with server: "));
 		purple_connection_take_error(gc, error);
 		return;
-	} else if (line == NULL) {
+	} else if (len == 0) {
 		purple_connection_take_error(gc, g_error_new_literal(
 			PURPLE_CONNECTION_ERROR,
 			PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
@@ -604,19 +652,7 @@ irc_read_input_cb(GObject *source, GAsyncResult *res, gpointer data)
 
 	purple_connection_update_last_received(gc);
 
-	if (len > 0 && line[len - 1] == '\r')
-		line[len - 1] = '\0';
-
-	/* This is a hack to work around the fact that marv gets messages
-	 * with null bytes in them while using some weird irc server at work
- 	 */
-	while (start < len && line[start] == '\0')
-		++start;
-
-	if (len - start > 0)
-		irc_parse_msg(irc, line + start);
-
-	g_free(line);
+	irc_input_parse(irc, len);
 
 	irc_read_input(irc);
 }
@@ -625,8 +661,14 @@ static void
 irc_read_input(struct irc_conn *irc)
 {
 	PurpleConnection *gc = purple_account_get_connection(irc->account);
+	char *buf;
+	gsize size;
+
+	/* Read whatever the socket has; one read usually brings in many lines,
+	 * which irc_input_parse() then handles in one go. */
+	buf = irc_input_reserve(irc, &size);
 
-	g_data_input_stream_read_line_async(irc->input,
+	g_input_stream_read_async(irc->input, buf, size,
 			G_PRIORITY_DEFAULT, irc->cancellable,
 			irc_read_input_cb, gc);
 }
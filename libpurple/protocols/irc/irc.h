@@ -57,6 +57,10 @@
 
 #define IRC_MAX_MSG_SIZE 512
 
+/* Upper bounds for the message table in parse.c. */
+#define IRC_MAX_MSG_NAME 32
+#define IRC_MAX_MSG_ARGS 16
+
 #define IRC_NAMES_FLAG "irc-namelist"
 
 enum { IRC_USEROPT_SERVER, IRC_USEROPT_PORT, IRC_USEROPT_CHARSET };
@@ -85,9 +89,15 @@ struct irc_conn {
 	gboolean ison_outstanding;
 	GList *buddies_outstanding;
 
-	GDataInputStream *input;
+	GInputStream *input;
 	PurpleQueuedOutputStream *output;
 
+	char *inbuf;
+	gsize inbuflen;
+	gsize inbufused;
+
+	PurpleSignal *receiving_text;
+
 	GString *motd;
 	GString *names;
 	struct _whois {
@@ -137,6 +147,8 @@ G_MODULE_EXPORT GType irc_protocol_get_type(void);
 
 int irc_send(struct irc_conn *irc, const char *buf);
 int irc_send_len(struct irc_conn *irc, const char *buf, int len);
+char *irc_input_reserve(struct irc_conn *irc, gsize *size);
+void irc_input_parse(struct irc_conn *irc, gsize len);
 gboolean irc_blist_timeout(struct irc_conn *irc);
 gboolean irc_who_channel_timeout(struct irc_conn *irc);
 void irc_buddy_query(struct irc_conn *irc);
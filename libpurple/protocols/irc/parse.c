@@ -677,13 +677,70 @@ char *irc_format(struct irc_conn *irc, const char *format, ...)
 	return (g_string_free(string, FALSE));
 }
 
+/*
+ * Whether irc_recv_convert() would hand back valid UTF-8 unchanged, so
+ * arguments that already are valid UTF-8 can be used in place.
+ */
+static gboolean irc_recv_is_passthrough(struct irc_conn *irc)
+{
+	const gchar *enclist;
+
+	if (purple_account_get_bool(irc->account, "autodetect_utf8", IRC_DEFAULT_AUTODETECT))
+		return TRUE;
+
+	enclist = purple_account_get_string(irc->account, "encoding", IRC_DEFAULT_CHARSET);
+	while (*enclist == ' ')
+		enclist++;
+
+	return (!g_ascii_strncasecmp(enclist, "UTF-8", 5) &&
+		(enclist[5] == '\0' || enclist[5] == ','));
+}
+
+/*
+ * Returns string converted for a 't', 'n', 'c' or ':' argument.  If that
+ * needed a copy, it is added to owned so the caller can free it.
+ */
+static char *irc_recv_convert_arg(struct irc_conn *irc, char *string,
+		gboolean passthrough, GSList **owned)
+{
+	char *utf8;
+
+	if (passthrough && g_utf8_validate(string, -1, NULL))
+		return string;
+
+	utf8 = irc_recv_convert(irc, string);
+	*owned = g_slist_prepend(*owned, utf8);
+	return utf8;
+}
+
+/* Ditto for 'v' and '*' arguments, which are only salvaged. */
+static char *irc_recv_salvage_arg(char *string, GSList **owned)
+{
+	char *utf8;
+
+	if (g_utf8_validate(string, -1, NULL))
+		return string;
+
+	utf8 = purple_utf8_salvage(string);
+	*owned = g_slist_prepend(*owned, utf8);
+	return utf8;
+}
+
+/*
+ * Parses one line from the server.  The line is tokenized in place, so
+ * arguments that need no conversion are handed to the message callbacks
+ * without being copied.
+ */
 void irc_parse_msg(struct irc_conn *irc, char *input)
 {
 	struct _irc_msg *msgent;
-	char *cur, *end, *tmp, *from, *msgname, *fmt, **args, *msg;
-	guint i;
+	char *cur, *end, *from, *fmt, *args[IRC_MAX_MSG_ARGS], *msg, *line;
+	char msgname[IRC_MAX_MSG_NAME];
+	char sep;
+	guint i, len;
 	PurpleConnection *gc = purple_account_get_connection(irc->account);
-	gboolean fmt_valid;
+	GSList *owned = NULL;
+	gboolean fmt_valid, passthrough;
 	int args_cnt;
 
 	irc->recv_time = time(NULL);
@@ -693,7 +750,9 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 	 * TODO: It should be passed as an array of bytes and a length
 	 * instead of a null terminated string.
 	 */
-	purple_signal_emit(_irc_protocol, "irc-receiving-text", gc, &input);
+	line = input;
+	if (irc->receiving_text != NULL)
+		purple_signal_emit_direct(irc->receiving_text, gc, &input);
 
 	if (!strncmp(input, "PING ", 5)) {
 		msg = irc_format(irc, "vv", "PONG", input + 5);
@@ -724,64 +783,93 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 		return;
 	}
 
-	from = g_strndup(&input[1], cur - &input[1]);
-	cur++;
-	end = strchr(cur, ' ');
-	if (!end)
-		end = cur + strlen(cur);
-
-	tmp = g_strndup(cur, end - cur);
-	msgname = g_ascii_strdown(tmp, -1);
-	g_free(tmp);
+	from = &input[1];
+	end = cur + 1;
+	while (*end != ' ' && *end != '\0')
+		end++;
+
+	/* Look the command up without copying it; nothing we know about is
+	 * anywhere near as long as the buffer. */
+	len = end - (cur + 1);
+	if (len < sizeof(msgname)) {
+		for (i = 0; i < len; i++)
+			msgname[i] = g_ascii_tolower(cur[1 + i]);
+		msgname[len] = '\0';
+		msgent = g_hash_table_lookup(irc->msgs, msgname);
+	} else {
+		msgent = NULL;
+	}
 
-	if ((msgent = g_hash_table_lookup(irc->msgs, msgname)) == NULL) {
+	if (msgent == NULL) {
+		from = g_strndup(&input[1], cur - &input[1]);
 		irc_msg_default(irc, "", from, &input);
-		g_free(msgname);
 		g_free(from);
 		return;
 	}
-	g_free(msgname);
 
+	if (strlen(msgent->format) > G_N_ELEMENTS(args)) {
+		purple_debug_error("irc", "too many arguments in the format for '%s'",
+			msgent->name);
+		return;
+	}
+
+	/* From here on the line is cut up, so make sure it is ours to cut if
+	 * a signal handler replaced it. */
+	if (input != line) {
+		gsize cur_offset = cur - input, end_offset = end - input;
+
+		input = g_strdup(input);
+		owned = g_slist_prepend(owned, input);
+		from = &input[1];
+		cur = input + cur_offset;
+		end = input + end_offset;
+	}
+
+	*cur = '\0';
+	passthrough = irc_recv_is_passthrough(irc);
+
+	memset(args, 0, sizeof(args));
 	fmt_valid = TRUE;
-	args = g_new0(char *, strlen(msgent->format));
 	args_cnt = 0;
-	for (cur = end, fmt = msgent->format, i = 0; fmt[i] && *cur++; i++) {
+	sep = *end;
+	cur = end;
+	for (fmt = msgent->format, i = 0; fmt[i] && sep != '\0'; i++) {
+		cur++;
+
 		switch (fmt[i]) {
 		case 'v':
+		case 't':
+		case 'n':
+		case 'c':
 			if (!(end = strchr(cur, ' '))) end = cur + strlen(cur);
-			/* This is a string of unknown encoding which we do not
+			sep = *end;
+			*end = '\0';
+			/* A 'v' is a string of unknown encoding which we do not
 			 * want to transcode, but it may or may not be valid
 			 * UTF-8, so we'll salvage it.  If a nick/channel/target
 			 * field has inadvertently been marked verbatim, this
 			 * could cause weirdness. */
-			tmp = g_strndup(cur, end - cur);
-			args[i] = purple_utf8_salvage(tmp);
-			g_free(tmp);
-			cur += end - cur;
-			break;
-		case 't':
-		case 'n':
-		case 'c':
-			if (!(end = strchr(cur, ' '))) end = cur + strlen(cur);
-			tmp = g_strndup(cur, end - cur);
-			args[i] = irc_recv_convert(irc, tmp);
-			g_free(tmp);
-			cur += end - cur;
+			if (fmt[i] == 'v')
+				args[i] = irc_recv_salvage_arg(cur, &owned);
+			else
+				args[i] = irc_recv_convert_arg(irc, cur, passthrough, &owned);
+			cur = end;
 			break;
 		case ':':
 			if (*cur == ':') cur++;
-			args[i] = irc_recv_convert(irc, cur);
-			cur = cur + strlen(cur);
+			args[i] = irc_recv_convert_arg(irc, cur, passthrough, &owned);
+			sep = '\0';
 			break;
 		case '*':
 			/* Ditto 'v' above; we're going to salvage this in case
 			 * it leaks past the IRC protocol */
-			args[i] = purple_utf8_salvage(cur);
-			cur = cur + strlen(cur);
+			args[i] = irc_recv_salvage_arg(cur, &owned);
+			sep = '\0';
 			break;
 		default:
 			purple_debug(PURPLE_DEBUG_ERROR, "irc", "invalid message format character '%c'\n", fmt[i]);
 			fmt_valid = FALSE;
+			sep = '\0';
 			break;
 		}
 		if (fmt_valid)
@@ -790,19 +878,15 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 	if (G_UNLIKELY(!fmt_valid)) {
 		purple_debug_error("irc", "message format was invalid");
 	} else if (G_LIKELY(args_cnt >= msgent->req_cnt)) {
-		tmp = irc_recv_convert(irc, from);
-		(msgent->cb)(irc, msgent->name, tmp, args);
-		g_free(tmp);
+		from = irc_recv_convert_arg(irc, from, passthrough, &owned);
+		(msgent->cb)(irc, msgent->name, from, args);
 	} else {
 		purple_debug_error("irc", "args count (%d) doesn't reach "
 			"expected value of %d for the '%s' command",
 			args_cnt, msgent->req_cnt, msgent->name);
 	}
-	for (i = 0; i < strlen(msgent->format); i++) {
-		g_free(args[i]);
-	}
-	g_free(args);
-	g_free(from);
+
+	g_slist_free_full(owned, g_free);
 }
 
 static void irc_parse_error_cb(struct irc_conn *irc, char *input)
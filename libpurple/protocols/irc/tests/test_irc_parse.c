@@ -0,0 +1,262 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include <purple.h>
+
+#include "tests/test_ui.h"
+#include "protocols/irc/irc.h"
+
+extern PurpleProtocol *_irc_protocol;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_irc_parse_receiving_text_cb(PurpleConnection *gc, char **input,
+                                 GPtrArray *lines)
+{
+	g_ptr_array_add(lines, g_strdup(*input));
+}
+
+/* Sets up just enough of an IRC connection for the message handlers. */
+static struct irc_conn *
+test_irc_parse_connect(const gchar *username) {
+	PurpleAccount *account;
+	PurpleConnection *gc;
+	struct irc_conn *irc;
+
+	gc = test_ui_connect(username);
+	account = purple_connection_get_account(gc);
+	purple_connection_set_display_name(gc, "tester");
+
+	irc = g_new0(struct irc_conn, 1);
+	irc->account = account;
+	irc->msgs = g_hash_table_new(g_str_hash, g_str_equal);
+	irc_msg_table_build(irc);
+	irc->buddies = g_hash_table_new(g_str_hash, g_str_equal);
+	irc->output = purple_queued_output_stream_new(
+		g_memory_output_stream_new_resizable());
+	irc->receiving_text = purple_signal_lookup(_irc_protocol,
+	                                           "irc-receiving-text");
+	purple_connection_set_protocol_data(gc, irc);
+
+	return irc;
+}
+
+static void
+test_irc_parse_disconnect(struct irc_conn *irc) {
+	PurpleConnection *gc = purple_account_get_connection(irc->account);
+
+	/* Let the PONGs and WHOs drain into the memory stream. */
+	while (g_main_context_iteration(NULL, FALSE));
+
+	purple_connection_set_protocol_data(gc, NULL);
+	test_ui_disconnect(gc);
+
+	g_object_unref(irc->output);
+	g_hash_table_destroy(irc->buddies);
+	g_hash_table_destroy(irc->msgs);
+	if (irc->names)
+		g_string_free(irc->names, TRUE);
+	g_free(irc->inbuf);
+	g_free(irc);
+}
+
+/* Feeds data like socket reads of at most chunk bytes would. */
+static void
+test_irc_parse_feed(struct irc_conn *irc, const gchar *data, gsize len,
+                    gsize chunk)
+{
+	while (len > 0) {
+		gsize size, n;
+		char *buf = irc_input_reserve(irc, &size);
+
+		n = MIN(MIN(size, chunk), len);
+		memcpy(buf, data, n);
+		irc_input_parse(irc, n);
+
+		data += n;
+		len -= n;
+	}
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_irc_parse_lines(void) {
+	const gchar data[] =
+		":irc.example.net NOTICE tester :first\r\n"
+		":irc.example.net NOTICE tester :second\n"
+		"\r\n"
+		"\0\0:irc.example.net NOTICE tester :third\r\n"
+		":irc.example.net NOTICE tester :partial";
+	const gchar *expected[] = {
+		":irc.example.net NOTICE tester :first",
+		":irc.example.net NOTICE tester :second",
+		":irc.example.net NOTICE tester :third",
+	};
+	const gsize chunks[] = { 1, 7, sizeof(data) };
+	struct irc_conn *irc = test_irc_parse_connect("lines@irc.example.net");
+	GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+	guint i, j;
+
+	purple_signal_connect(_irc_protocol, "irc-receiving-text", lines,
+	                      PURPLE_CALLBACK(test_irc_parse_receiving_text_cb),
+	                      lines);
+
+	for (i = 0; i < G_N_ELEMENTS(chunks); i++) {
+		g_ptr_array_set_size(lines, 0);
+		test_irc_parse_feed(irc, data, sizeof(data) - 1, chunks[i]);
+
+		g_assert_cmpint(G_N_ELEMENTS(expected), ==, lines->len);
+		for (j = 0; j < lines->len; j++)
+			g_assert_cmpstr(expected[j], ==, g_ptr_array_index(lines, j));
+
+		/* The unterminated line waits for the rest of it. */
+		g_assert_cmpint(strlen(":irc.example.net NOTICE tester :partial"),
+		                ==, irc->inbufused);
+		test_irc_parse_feed(irc, "\r\n", 2, chunks[i]);
+		g_assert_cmpint(G_N_ELEMENTS(expected) + 1, ==, lines->len);
+		g_assert_cmpint(0, ==, irc->inbufused);
+	}
+
+	purple_signals_disconnect_by_handle(lines);
+	g_ptr_array_free(lines, TRUE);
+	test_irc_parse_disconnect(irc);
+}
+
+static void
+test_irc_parse_args(void) {
+	const gchar data[] =
+		":alice!~alice@alice.example.org PRIVMSG tester :caf\xe9 au lait\r\n"
+		":bob!~bob@bob.example.org PRIVMSG tester :d\xc3\xa9j\xc3\xa0 vu\r\n";
+	struct irc_conn *irc = test_irc_parse_connect("args@irc.example.net");
+	PurpleIMConversation *im;
+	GList *history;
+
+	purple_account_set_string(irc->account, "encoding", "UTF-8,ISO-8859-1");
+
+	test_irc_parse_feed(irc, data, sizeof(data) - 1, sizeof(data));
+
+	/* Latin-1 is converted, valid UTF-8 is passed through. */
+	im = purple_conversations_find_im_with_account("alice", irc->account);
+	g_assert_nonnull(im);
+	history = purple_conversation_get_message_history(PURPLE_CONVERSATION(im));
+	g_assert_nonnull(history);
+	g_assert_cmpstr("caf\xc3\xa9 au lait", ==,
+	                purple_message_get_contents(history->data));
+	g_assert_cmpstr("alice", ==, purple_message_get_author(history->data));
+
+	im = purple_conversations_find_im_with_account("bob", irc->account);
+	g_assert_nonnull(im);
+	history = purple_conversation_get_message_history(PURPLE_CONVERSATION(im));
+	g_assert_nonnull(history);
+	g_assert_cmpstr("d\xc3\xa9j\xc3\xa0 vu", ==,
+	                purple_message_get_contents(history->data));
+
+	test_irc_parse_disconnect(irc);
+}
+
+static void
+test_irc_parse_replay_performance(void) {
+	const gint target = 50000;
+	struct irc_conn *irc = test_irc_parse_connect("replay@irc.example.net");
+	gchar *path, *contents, *body;
+	gsize len, preamble, body_len;
+	gint body_lines, lines = 0;
+	gdouble elapsed = 0;
+	guint i;
+
+	path = g_build_filename(TEST_DATA_DIR, "replay.txt", NULL);
+	g_assert_true(g_file_get_contents(path, &contents, &len, NULL));
+	g_free(path);
+
+	/* The first six lines join the channel; the rest is replayed. */
+	for (i = 0, preamble = 0; i < 6; i++)
+		preamble = (gchar *)memchr(contents + preamble, '\n',
+		                           len - preamble) - contents + 1;
+	body = contents + preamble;
+	body_len = len - preamble;
+	for (i = 0, body_lines = 0; i < body_len; i++)
+		body_lines += (body[i] == '\n');
+
+	test_irc_parse_feed(irc, contents, preamble, 4096);
+	g_assert_nonnull(purple_conversations_find_chat_with_account("#pidgin",
+		irc->account));
+
+	while (lines < target) {
+		g_test_timer_start();
+		test_irc_parse_feed(irc, body, body_len, 4096);
+		elapsed += g_test_timer_elapsed();
+
+		lines += body_lines;
+
+		/* Keep the queued output from piling up. */
+		while (g_main_context_iteration(NULL, FALSE));
+	}
+
+	g_test_minimized_result(elapsed / lines,
+		"%d lines: %.2f us per line, %.0f lines/s", lines,
+		elapsed * 1e6 / lines, lines / elapsed);
+
+	g_free(contents);
+	test_irc_parse_disconnect(irc);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	_irc_protocol = test_ui_protocol_add();
+
+	purple_signal_register(_irc_protocol, "irc-sending-text",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE,
+	                       2, PURPLE_TYPE_CONNECTION, G_TYPE_POINTER);
+	purple_signal_register(_irc_protocol, "irc-receiving-text",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE,
+	                       2, PURPLE_TYPE_CONNECTION, G_TYPE_POINTER);
+
+	/* Keep the messages out of the logs and off the terminal. */
+	purple_prefs_set_bool("/purple/logging/log_ims", FALSE);
+	purple_prefs_set_bool("/purple/logging/log_chats", FALSE);
+	purple_conversations_set_ui_ops(NULL);
+
+	g_test_add_func("/irc/parse/lines",
+	                test_irc_parse_lines);
+	g_test_add_func("/irc/parse/args",
+	                test_irc_parse_args);
+	if (g_test_perf()) {
+		g_test_add_func("/irc/parse/replay/performance",
+		                test_irc_parse_replay_performance);
+	}
+
+	return g_test_run();
+}
@@ -95,6 +95,11 @@ gtalk_protocol_init(PurpleProtocol *protocol)
 	protocol->account_options = g_list_append(protocol->account_options,
 						  option);
 
+	option = purple_account_option_int_new(_("Write delay (ms)"),
+						"write_delay", 0);
+	protocol->account_options = g_list_append(protocol->account_options,
+						option);
+
 	/* this should probably be part of global smiley theme settings later on,
 	  shared with MSN */
 	option = purple_account_option_bool_new(_("Show Custom Smileys"),
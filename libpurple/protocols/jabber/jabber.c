@@ -83,6 +83,18 @@
  */
 #define DEFAULT_INACTIVITY_TIME 120
 
+/* Outgoing stanzas are serialized into a reused buffer; anything that grew
+ * it past the maximum (a big roster push or file chunk) gets it freed. */
+#define JABBER_SEND_STR_SIZE 1024
+#define JABBER_SEND_STR_MAX_SIZE (64 * 1024)
+
+/* Stanzas sent within one main loop iteration (or within the account's
+ * "write_delay" milliseconds) are written out together, unless that much of
+ * them piles up first. */
+#define JABBER_WRITE_BUFFER_SIZE 4096
+#define JABBER_WRITE_FLUSH_SIZE (64 * 1024)
+#define JABBER_WRITE_DELAY_MAX 1000
+
 GList *jabber_features = NULL;
 GList *jabber_identities = NULL;
 
@@ -294,7 +306,7 @@ void jabber_process_packet(JabberStream *js, PurpleXmlNode **packet)
 	const char *name;
 	const char *xmlns;
 
-	purple_signal_emit(purple_connection_get_protocol(js->gc), "jabber-receiving-xmlnode", js->gc, packet);
+	purple_signal_emit_direct(js->receiving_xmlnode_signal, js->gc, packet);
 
 	/* if the signal leaves us with a null packet, we're done */
 	if(NULL == *packet)
@@ -350,82 +362,122 @@ static int jabber_do_send(JabberStream *js, const char *data, int len)
 	return ret;
 }
 
-static void jabber_send_cb(gpointer data, gint source, PurpleInputCondition cond)
+static void jabber_write_error(JabberStream *js)
 {
-	JabberStream *js = data;
-	const gchar *output = NULL;
-	int ret, writelen;
+	PurpleAccount *account = purple_connection_get_account(js->gc);
+	gchar *tmp;
 
-	writelen = purple_circular_buffer_get_max_read(js->write_buffer);
-	output = purple_circular_buffer_get_output(js->write_buffer);
+	/* Nothing will ever get out of here. */
+	g_string_truncate(js->write_buffer, 0);
 
-	if (writelen == 0) {
-		purple_input_remove(js->writeh);
-		js->writeh = 0;
+	/*
+	 * The server may have closed the socket (on a stream error), so if
+	 * we're disconnecting, don't generate (possibly another) error that
+	 * (for some UIs) would mask the first.
+	 */
+	if (purple_account_is_disconnecting(account))
 		return;
+
+	tmp = g_strdup_printf(_("Lost connection with server: %s"),
+			g_strerror(errno));
+	purple_connection_error(js->gc,
+		PURPLE_CONNECTION_ERROR_NETWORK_ERROR, tmp);
+	g_free(tmp);
+}
+
+static void jabber_send_cb(gpointer data, gint source, PurpleInputCondition cond);
+
+/* Writes as much of the queued data as the socket takes, in one go. */
+static gboolean jabber_write_flush(JabberStream *js)
+{
+	int ret;
+
+	if (js->write_flush != 0) {
+		g_source_remove(js->write_flush);
+		js->write_flush = 0;
 	}
 
-	ret = jabber_do_send(js, output, writelen);
+	if (js->write_buffer->len == 0)
+		return TRUE;
+
+	ret = jabber_do_send(js, js->write_buffer->str, js->write_buffer->len);
 
 	if (ret < 0 && errno == EAGAIN)
-		return;
+		ret = 0;
 	else if (ret <= 0) {
-		gchar *tmp = g_strdup_printf(_("Lost connection with server: %s"),
-				g_strerror(errno));
-		purple_connection_error(js->gc,
-			PURPLE_CONNECTION_ERROR_NETWORK_ERROR, tmp);
-		g_free(tmp);
-		return;
+		if (js->writeh != 0) {
+			purple_input_remove(js->writeh);
+			js->writeh = 0;
+		}
+		jabber_write_error(js);
+		return FALSE;
 	}
 
-	purple_circular_buffer_mark_read(js->write_buffer, ret);
+	g_string_erase(js->write_buffer, 0, ret);
+
+	if (js->write_buffer->len == 0) {
+		if (js->writeh != 0) {
+			purple_input_remove(js->writeh);
+			js->writeh = 0;
+		}
+
+		/* Don't keep what a big burst grew it to. */
+		if (js->write_buffer->allocated_len > JABBER_WRITE_FLUSH_SIZE) {
+			g_string_free(js->write_buffer, TRUE);
+			js->write_buffer =
+				g_string_sized_new(JABBER_WRITE_BUFFER_SIZE);
+		}
+	} else if (js->writeh == 0) {
+		js->writeh = purple_input_add(
+			js->gsc ? js->gsc->fd : js->fd,
+			PURPLE_INPUT_WRITE, jabber_send_cb, js);
+	}
+
+	return TRUE;
 }
 
-static gboolean do_jabber_send_raw(JabberStream *js, const char *data, int len)
+static void jabber_send_cb(gpointer data, gint source, PurpleInputCondition cond)
 {
-	int ret;
-	gboolean success = TRUE;
+	jabber_write_flush(data);
+}
+
+static gboolean jabber_write_flush_cb(gpointer data)
+{
+	JabberStream *js = data;
 
+	js->write_flush = 0;
+	jabber_write_flush(js);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean do_jabber_send_raw(JabberStream *js, const char *data, int len)
+{
 	g_return_val_if_fail(len > 0, FALSE);
 
 	if (js->state == JABBER_STREAM_CONNECTED)
 		jabber_stream_restart_inactivity_timer(js);
 
-	if (js->writeh == 0)
-		ret = jabber_do_send(js, data, len);
-	else {
-		ret = -1;
-		errno = EAGAIN;
-	}
+	g_string_append_len(js->write_buffer, data, len);
 
-	if (ret < 0 && errno != EAGAIN) {
-		PurpleAccount *account = purple_connection_get_account(js->gc);
-		/*
-		 * The server may have closed the socket (on a stream error), so if
-		 * we're disconnecting, don't generate (possibly another) error that
-		 * (for some UIs) would mask the first.
-		 */
-		if (!purple_account_is_disconnecting(account)) {
-			gchar *tmp = g_strdup_printf(_("Lost connection with server: %s"),
-					g_strerror(errno));
-			purple_connection_error(js->gc,
-				PURPLE_CONNECTION_ERROR_NETWORK_ERROR, tmp);
-			g_free(tmp);
-		}
+	/* Waiting for the socket to take the rest already. */
+	if (js->writeh != 0)
+		return TRUE;
 
-		success = FALSE;
-	} else if (ret < len) {
-		if (ret < 0)
-			ret = 0;
-		if (js->writeh == 0)
-			js->writeh = purple_input_add(
-				js->gsc ? js->gsc->fd : js->fd,
-				PURPLE_INPUT_WRITE, jabber_send_cb, js);
-		purple_circular_buffer_append(js->write_buffer,
-			data + ret, len - ret);
+	if (js->write_buffer->len >= JABBER_WRITE_FLUSH_SIZE)
+		return jabber_write_flush(js);
+
+	if (js->write_flush == 0) {
+		if (js->write_delay > 0) {
+			js->write_flush = g_timeout_add(js->write_delay,
+				jabber_write_flush_cb, js);
+		} else {
+			js->write_flush = g_idle_add_full(G_PRIORITY_DEFAULT,
+				jabber_write_flush_cb, js, NULL);
+		}
 	}
 
-	return success;
+	return TRUE;
 }
 
 void jabber_send_raw(JabberStream *js, const char *data, int len)
@@ -478,7 +530,7 @@ void jabber_send_raw(JabberStream *js, const char *data, int len)
 		g_free(text);
 	}
 
-	purple_signal_emit(purple_connection_get_protocol(gc), "jabber-sending-text", gc, &data);
+	purple_signal_emit_direct(js->sending_text_signal, gc, &data);
 	if (data == NULL)
 		return;
 
@@ -553,8 +605,7 @@ void jabber_send_signal_cb(PurpleConnection *pc, PurpleXmlNode **packet,
                            gpointer unused)
 {
 	JabberStream *js;
-	char *txt;
-	int len;
+	GString *str;
 
 	if (NULL == packet)
 		return;
@@ -571,14 +622,30 @@ void jabber_send_signal_cb(PurpleConnection *pc, PurpleXmlNode **packet,
 				purple_strequal((*packet)->name, "iq") ||
 				purple_strequal((*packet)->name, "presence"))
 			purple_xmlnode_set_namespace(*packet, NS_XMPP_CLIENT);
-	txt = purple_xmlnode_to_str(*packet, &len);
-	jabber_send_raw(js, txt, len);
-	g_free(txt);
+
+	/* Serialize into a buffer that's kept around between stanzas.  It's
+	 * taken off the stream while in use, because a "jabber-sending-text"
+	 * handler is free to send another stanza. */
+	str = js->send_str;
+	js->send_str = NULL;
+	if (str == NULL)
+		str = g_string_sized_new(JABBER_SEND_STR_SIZE);
+
+	purple_xmlnode_write_to_string(*packet, str);
+	jabber_send_raw(js, str->str, str->len);
+
+	/* Don't hold on to the memory used by a one-off huge stanza */
+	if (js->send_str == NULL && str->allocated_len <= JABBER_SEND_STR_MAX_SIZE) {
+		g_string_truncate(str, 0);
+		js->send_str = str;
+	} else {
+		g_string_free(str, TRUE);
+	}
 }
 
 void jabber_send(JabberStream *js, PurpleXmlNode *packet)
 {
-	purple_signal_emit(purple_connection_get_protocol(js->gc), "jabber-sending-xmlnode", js->gc, &packet);
+	purple_signal_emit_direct(js->sending_xmlnode_signal, js->gc, &packet);
 }
 
 static gboolean jabber_keepalive_timeout(PurpleConnection *gc)
@@ -830,6 +897,9 @@ jabber_ssl_connect_failure(PurpleSslConnection *gsc, PurpleSslErrorType error,
 
 static void tls_init(JabberStream *js)
 {
+	/* Anything still queued was meant to go out unencrypted. */
+	jabber_write_flush(js);
+
 	purple_input_remove(js->inpa);
 	js->inpa = 0;
 	js->gsc = purple_ssl_connect_with_host_fd(purple_connection_get_account(js->gc), js->fd,
@@ -910,6 +980,7 @@ static JabberStream *
 jabber_stream_new(PurpleAccount *account)
 {
 	PurpleConnection *gc = purple_account_get_connection(account);
+	PurpleProtocol *protocol;
 	JabberStream *js;
 	PurplePresence *presence;
 	gchar *user;
@@ -919,6 +990,14 @@ jabber_stream_new(PurpleAccount *account)
 	purple_connection_set_protocol_data(gc, js);
 	js->gc = gc;
 	js->fd = -1;
+
+	protocol = purple_connection_get_protocol(gc);
+	js->receiving_xmlnode_signal =
+		purple_signal_lookup(protocol, "jabber-receiving-xmlnode");
+	js->sending_xmlnode_signal =
+		purple_signal_lookup(protocol, "jabber-sending-xmlnode");
+	js->sending_text_signal =
+		purple_signal_lookup(protocol, "jabber-sending-text");
 	js->http_conns = purple_http_connection_set_new();
 
 	/* we might want to expose this at some point */
@@ -984,7 +1063,9 @@ jabber_stream_new(PurpleAccount *account)
 	js->chats = g_hash_table_new_full(g_str_hash, g_str_equal,
 			g_free, (GDestroyNotify)jabber_chat_free);
 	js->next_id = g_random_int();
-	js->write_buffer = purple_circular_buffer_new(512);
+	js->write_buffer = g_string_sized_new(JABBER_WRITE_BUFFER_SIZE);
+	js->write_delay = CLAMP(purple_account_get_int(account, "write_delay", 0),
+		0, JABBER_WRITE_DELAY_MAX);
 	js->old_length = 0;
 	js->keepalive_timeout = 0;
 	js->max_inactivity = DEFAULT_INACTIVITY_TIME;
@@ -1594,8 +1675,10 @@ void jabber_close(PurpleConnection *gc)
 	if (js->bosh) {
 		jabber_bosh_connection_destroy(js->bosh);
 		js->bosh = NULL;
-	} else if ((js->gsc && js->gsc->fd > 0) || js->fd > 0)
+	} else if ((js->gsc && js->gsc->fd > 0) || js->fd > 0) {
 		jabber_send_raw(js, "</stream:stream>", -1);
+		jabber_write_flush(js);
+	}
 
 	if(js->gsc) {
 		purple_ssl_close(js->gsc);
@@ -1647,7 +1730,11 @@ void jabber_close(PurpleConnection *gc)
 	g_free(js->caps_hash);
 
 	if (js->write_buffer)
-		g_object_unref(G_OBJECT(js->write_buffer));
+		g_string_free(js->write_buffer, TRUE);
+	if (js->write_flush)
+		g_source_remove(js->write_flush);
+	if (js->send_str)
+		g_string_free(js->send_str, TRUE);
 	if(js->writeh)
 		purple_input_remove(js->writeh);
 	if (js->auth_mech && js->auth_mech->dispose)
@@ -3045,6 +3132,7 @@ static PurpleCmdRet jabber_cmd_chat_msg(PurpleConversation *conv,
 		const char *cmd, char **args, char **error, void *data)
 {
 	JabberChat *chat = jabber_chat_find_by_conv(PURPLE_CHAT_CONVERSATION(conv));
+	PurpleMessage *msg;
 	char *who;
 
 	if (!chat)
@@ -3052,8 +3140,9 @@ static PurpleCmdRet jabber_cmd_chat_msg(PurpleConversation *conv,
 
 	who = g_strdup_printf("%s@%s/%s", chat->room, chat->server, args[0]);
 
-	jabber_message_send_im(purple_conversation_get_connection(conv),
-		purple_message_new_outgoing(who, args[1], 0));
+	msg = purple_message_new_outgoing(who, args[1], 0);
+	jabber_message_send_im(purple_conversation_get_connection(conv), msg);
+	g_object_unref(msg);
 
 	g_free(who);
 	return PURPLE_CMD_RET_OK;
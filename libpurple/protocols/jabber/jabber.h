@@ -67,6 +67,7 @@ typedef struct _JabberStream JabberStream;
 #include "mediamanager.h"
 #include "protocol.h"
 #include "roomlist.h"
+#include "signals.h"
 #include "sslconn.h"
 
 #include "namespaces.h"
@@ -210,8 +211,18 @@ struct _JabberStream
 
 	GSList *pending_buddy_info_requests;
 
-	PurpleCircularBuffer *write_buffer;
+	/* Outgoing data, written out once per main loop iteration (see
+	 * write_delay) or when the socket takes it. */
+	GString *write_buffer;
 	guint writeh;
+	guint write_flush;
+	guint write_delay;
+	GString *send_str;
+
+	/* Emitted for every stanza, so they're only looked up once */
+	PurpleSignal *receiving_xmlnode_signal;
+	PurpleSignal *sending_xmlnode_signal;
+	PurpleSignal *sending_text_signal;
 
 	gboolean reinit;
 
@@ -31,6 +31,9 @@
 #include "util.h"
 #include "xmlnode.h"
 
+/* Big enough for a typical presence stanza */
+#define JABBER_STANZA_POOL_BLOCK_SIZE 4096
+
 static void
 jabber_parser_element_start_libxml(void *user_data,
 				   const xmlChar *element_name, const xmlChar *prefix, const xmlChar *namespace,
@@ -107,8 +110,15 @@ jabber_parser_element_start_libxml(void *user_data,
 
 		if(js->current)
 			node = purple_xmlnode_new_child(js->current, (const char*) element_name);
-		else
-			node = purple_xmlnode_new((const char*) element_name);
+		else {
+			/* Every stanza is allocated from its own pool, which is
+			 * released at once when the stanza is freed. */
+			PurpleMemoryPool *pool = purple_memory_pool_new();
+			purple_memory_pool_set_block_size(pool,
+				JABBER_STANZA_POOL_BLOCK_SIZE);
+			node = purple_xmlnode_new_pooled((const char*) element_name, pool);
+			g_object_unref(pool);
+		}
 		purple_xmlnode_set_namespace(node, (const char*) namespace);
 		purple_xmlnode_set_prefix(node, (const char *)prefix);
 
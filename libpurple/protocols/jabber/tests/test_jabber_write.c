@@ -0,0 +1,200 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <purple.h>
+
+#include "tests/test_ui.h"
+#include "../jabber.h"
+
+static PurpleProtocol *test_jabber_write_protocol = NULL;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+/* Sets up just enough of a stream to send over the client end of a socket
+ * pair. */
+static JabberStream *
+test_jabber_write_connect(const gchar *username, gint *server) {
+	JabberStream *js = g_new0(JabberStream, 1);
+	gint fds[2];
+
+	g_assert_cmpint(0, ==, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	g_assert_true(g_unix_set_fd_nonblocking(fds[0], TRUE, NULL));
+	g_assert_true(g_unix_set_fd_nonblocking(fds[1], TRUE, NULL));
+
+	js->gc = test_ui_connect(username);
+	js->fd = fds[0];
+	js->state = JABBER_STREAM_CONNECTING;
+	js->write_buffer = g_string_new(NULL);
+	js->sending_text_signal = purple_signal_lookup(test_jabber_write_protocol,
+	                                               "jabber-sending-text");
+	*server = fds[1];
+
+	return js;
+}
+
+static void
+test_jabber_write_disconnect(JabberStream *js, gint server) {
+	while (g_main_context_iteration(NULL, FALSE));
+
+	g_assert_cmpint(0, ==, js->write_flush);
+	g_assert_cmpint(0, ==, js->writeh);
+
+	close(js->fd);
+	close(server);
+	test_ui_disconnect(js->gc);
+	g_string_free(js->write_buffer, TRUE);
+	g_free(js);
+}
+
+/* Returns what has arrived so far, without waiting for more. */
+static GString *
+test_jabber_write_received(gint server) {
+	GString *received = g_string_new(NULL);
+	gchar buf[4096];
+	gssize n;
+
+	while ((n = read(server, buf, sizeof(buf))) > 0)
+		g_string_append_len(received, buf, n);
+	g_assert_true(n == 0 || errno == EAGAIN || errno == EWOULDBLOCK);
+
+	return received;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_write_coalesce(void) {
+	const gchar *stanzas[] = {
+		"<presence/>",
+		"<iq type='get' id='1'/>",
+		"<message to='a@b'><body>hi</body></message>"
+	};
+	JabberStream *js;
+	GString *expected, *received;
+	gint server;
+	guint i;
+
+	js = test_jabber_write_connect("coalesce", &server);
+
+	expected = g_string_new(NULL);
+	for (i = 0; i < G_N_ELEMENTS(stanzas); i++) {
+		jabber_send_raw(js, stanzas[i], -1);
+		g_string_append(expected, stanzas[i]);
+	}
+
+	/* Nothing goes out until the main loop gets to it... */
+	received = test_jabber_write_received(server);
+	g_assert_cmpint(0, ==, received->len);
+	g_assert_cmpint(expected->len, ==, js->write_buffer->len);
+	g_assert_cmpint(0, !=, js->write_flush);
+	g_string_free(received, TRUE);
+
+	/* ...and then all of it does, in order. */
+	g_main_context_iteration(NULL, FALSE);
+	received = test_jabber_write_received(server);
+	g_assert_cmpstr(expected->str, ==, received->str);
+	g_assert_cmpint(0, ==, js->write_buffer->len);
+	g_assert_cmpint(0, ==, js->write_flush);
+	g_string_free(received, TRUE);
+
+	g_string_free(expected, TRUE);
+	test_jabber_write_disconnect(js, server);
+}
+
+static void
+test_jabber_write_flush_size(void) {
+	JabberStream *js;
+	GString *expected, *received;
+	gchar *stanza;
+	gint server;
+
+	js = test_jabber_write_connect("flush", &server);
+
+	jabber_send_raw(js, "<presence/>", -1);
+	g_assert_cmpint(0, !=, js->write_flush);
+
+	/* A burst that piles up 64 KiB is written right away, without waiting
+	 * for the main loop. */
+	stanza = g_strnfill(64 * 1024, 'x');
+	jabber_send_raw(js, stanza, -1);
+	g_assert_cmpint(0, ==, js->write_flush);
+
+	expected = g_string_new("<presence/>");
+	g_string_append(expected, stanza);
+
+	received = test_jabber_write_received(server);
+	g_assert_cmpint(received->len, >, 0);
+	g_assert_true(memcmp(expected->str, received->str, received->len) == 0);
+
+	/* Whatever the socket didn't take waits for it to be writable. */
+	if (received->len < expected->len) {
+		g_assert_cmpint(0, !=, js->writeh);
+		g_assert_cmpint(expected->len - received->len, ==,
+		                js->write_buffer->len);
+	}
+
+	while (received->len < expected->len) {
+		GString *more;
+
+		g_main_context_iteration(NULL, TRUE);
+		more = test_jabber_write_received(server);
+		g_string_append_len(received, more->str, more->len);
+		g_string_free(more, TRUE);
+	}
+	g_assert_cmpstr(expected->str, ==, received->str);
+	g_assert_cmpint(0, ==, js->write_buffer->len);
+
+	g_string_free(received, TRUE);
+	g_string_free(expected, TRUE);
+	g_free(stanza);
+	test_jabber_write_disconnect(js, server);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	test_jabber_write_protocol = test_ui_protocol_add();
+	purple_signal_register(test_jabber_write_protocol, "jabber-sending-text",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE,
+	                       2, PURPLE_TYPE_CONNECTION, G_TYPE_POINTER);
+
+	g_test_add_func("/jabber/write/coalesce", test_jabber_write_coalesce);
+	g_test_add_func("/jabber/write/flush-size",
+	                test_jabber_write_flush_size);
+
+	return g_test_run();
+}
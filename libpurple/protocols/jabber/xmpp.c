@@ -86,6 +86,11 @@ xmpp_protocol_init(PurpleProtocol *protocol)
 	protocol->account_options = g_list_append(protocol->account_options,
 						  option);
 
+	option = purple_account_option_int_new(_("Write delay (ms)"),
+						"write_delay", 0);
+	protocol->account_options = g_list_append(protocol->account_options,
+						option);
+
 	/* this should probably be part of global smiley theme settings
 	 * later on
 	 */
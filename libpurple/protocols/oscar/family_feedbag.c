@@ -48,6 +48,16 @@
 
 static int aim_ssi_addmoddel(OscarData *od);
 
+/*
+ * How much of the difference between the two lists goes into one add/mod/del
+ * SNAC.  Other clients send a couple of hundred items at a time, and keeping
+ * the SNAC below 8 KB keeps it well within what the servers accept.
+ */
+#define AIM_SSI_BATCH_ITEMS 200
+#define AIM_SSI_BATCH_SIZE 0x1e00
+
+#define AIM_SSI_ID_KEY(gid, bid) GUINT_TO_POINTER(((guint32)(gid) << 16) + (bid))
+
 static void aim_ssi_item_free(struct aim_ssi_item *item)
 {
 	g_free(item->name);
@@ -55,24 +65,91 @@ static void aim_ssi_item_free(struct aim_ssi_item *item)
 	g_free(item);
 }
 
-static void aim_ssi_item_set_name(struct aim_ssi_itemlist *list, struct aim_ssi_item *item, const char *name)
+/**
+ * Add an item to, or remove it from, one of the name indexes.  Each key
+ * maps to a queue of items, because the same name can show up more than
+ * once (the same buddy in two groups, or duplicates that cleanlist has not
+ * gotten to yet).  The head of the queue is the item that was added first.
+ */
+static void
+aim_ssi_index_update(GHashTable *idx, const gchar *key, struct aim_ssi_item *item, gboolean add)
+{
+	GQueue *items = g_hash_table_lookup(idx, key);
+
+	if (add) {
+		if (!items) {
+			items = g_queue_new();
+			g_hash_table_insert(idx, g_strdup(key), items);
+		}
+		g_queue_push_tail(items, item);
+	} else if (items) {
+		g_queue_remove(items, item);
+		if (g_queue_is_empty(items))
+			g_hash_table_remove(idx, key);
+	}
+}
+
+static struct aim_ssi_item *
+aim_ssi_index_lookup(GHashTable *idx, const gchar *key)
+{
+	GQueue *items = g_hash_table_lookup(idx, key);
+
+	return items ? g_queue_peek_head(items) : NULL;
+}
+
+/**
+ * Add or remove the name index entries of an item.  Every named item is
+ * indexed by type and name, and buddies are also indexed by group ID# and
+ * name, so a buddy can be found in a given group without walking the list.
+ */
+static void aim_ssi_itemlist_index_name(struct aim_ssi_itemlist *list, struct aim_ssi_item *item, gboolean add)
 {
 	gchar key[3000];
 
-	if (item->name) {
-		/* Remove old name from hash table */
-		snprintf(key, sizeof(key), "%hx%s", item->type, oscar_normalize(NULL, item->name));
-		g_hash_table_remove(list->idx_all_named_items, key);
+	if (!item->name)
+		return;
+
+	snprintf(key, sizeof(key), "%hx%s", item->type, oscar_normalize(NULL, item->name));
+	aim_ssi_index_update(list->idx_all_named_items, key, item, add);
+
+	if (item->type == AIM_SSI_TYPE_BUDDY) {
+		snprintf(key, sizeof(key), "%04hx%s", item->gid, oscar_normalize(NULL, item->name));
+		aim_ssi_index_update(list->idx_group_buddies, key, item, add);
 	}
+}
+
+/**
+ * Remember that the item with this ID has changed, so the next sync
+ * compares it with the server's copy.  Only the local list tracks this.
+ */
+static void aim_ssi_itemlist_touch(struct aim_ssi_itemlist *list, struct aim_ssi_item *item)
+{
+	if (list->dirty)
+		g_hash_table_add(list->dirty, AIM_SSI_ID_KEY(item->gid, item->bid));
+}
+
+static void aim_ssi_item_set_name(struct aim_ssi_itemlist *list, struct aim_ssi_item *item, const char *name)
+{
+	/* Remove old name from hash table */
+	aim_ssi_itemlist_index_name(list, item, FALSE);
 
 	g_free(item->name);
 	item->name = g_strdup(name);
 
-	if (name) {
-		/* Add new name to hash table */
-		snprintf(key, sizeof(key), "%hx%s", item->type, oscar_normalize(NULL, item->name));
-		g_hash_table_insert(list->idx_all_named_items, g_strdup(key), item);
-	}
+	/* Add new name to hash table */
+	aim_ssi_itemlist_index_name(list, item, TRUE);
+
+	aim_ssi_itemlist_touch(list, item);
+}
+
+/**
+ * Check if the first item comes before the second one.  Lists are kept in
+ * ascending order of group ID# and then buddy ID#, so every group item is
+ * directly followed by the items in that group.
+ */
+static gboolean aim_ssi_item_before(struct aim_ssi_item *cur1, struct aim_ssi_item *cur2)
+{
+	return (cur1->gid < cur2->gid) || ((cur1->gid == cur2->gid) && (cur1->bid < cur2->bid));
 }
 
 /**
@@ -123,7 +200,7 @@ aim_ssi_type_to_string(guint16 type)
  * @param item List item from which information is extracted.
  */
 static void
-aim_ssi_item_debug_append(GString *str, char *prefix, struct aim_ssi_item *item)
+aim_ssi_item_debug_append(GString *str, const char *prefix, struct aim_ssi_item *item)
 {
 	g_string_append_printf(str, 
 		"%s gid=0x%04hx, bid=0x%04hx, list_type=0x%04hx [%s], name=%s.\n",
@@ -156,8 +233,8 @@ aim_ssi_itemlist_rebuildgroup(struct aim_ssi_itemlist *list, const char *name)
 			if ((cur->type == AIM_SSI_TYPE_GROUP) && (cur->gid != 0x0000))
 				newlen += 2;
 	} else {
-		for (cur=list->data; cur; cur=cur->next)
-			if ((cur->gid == group->gid) && (cur->type == AIM_SSI_TYPE_BUDDY))
+		for (cur=group->next; cur && (cur->gid == group->gid); cur=cur->next)
+			if (cur->type == AIM_SSI_TYPE_BUDDY)
 				newlen += 2;
 	}
 
@@ -172,11 +249,12 @@ aim_ssi_itemlist_rebuildgroup(struct aim_ssi_itemlist *list, const char *name)
 				if ((cur->type == AIM_SSI_TYPE_GROUP) && (cur->gid != 0x0000))
 						newlen += aimutil_put16(newdata+newlen, cur->gid);
 		} else {
-			for (cur=list->data; cur; cur=cur->next)
-				if ((cur->gid == group->gid) && (cur->type == AIM_SSI_TYPE_BUDDY))
+			for (cur=group->next; cur && (cur->gid == group->gid); cur=cur->next)
+				if (cur->type == AIM_SSI_TYPE_BUDDY)
 						newlen += aimutil_put16(newdata+newlen, cur->bid);
 		}
 		aim_tlvlist_replace_raw(&group->data, 0x00c8, newlen, newdata);
+		aim_ssi_itemlist_touch(list, group);
 
 		g_free(newdata);
 	}
@@ -197,7 +275,7 @@ aim_ssi_itemlist_rebuildgroup(struct aim_ssi_itemlist *list, const char *name)
 static struct aim_ssi_item *aim_ssi_itemlist_add(struct aim_ssi_itemlist *list, const char *name, guint16 gid, guint16 bid, guint16 type, GSList *data)
 {
 	gboolean exists;
-	struct aim_ssi_item *cur, *new;
+	struct aim_ssi_item *cur, *prev, *new;
 
 	new = g_new0(struct aim_ssi_item, 1);
 
@@ -208,13 +286,7 @@ static struct aim_ssi_item *aim_ssi_itemlist_add(struct aim_ssi_itemlist *list,
 		if ((new->gid == 0xFFFF) && name) {
 			do {
 				new->gid += 0x0001;
-				exists = FALSE;
-				for (cur = list->data; cur != NULL; cur = cur->next)
-					if ((cur->type == AIM_SSI_TYPE_GROUP) && (cur->gid == new->gid)) {
-						exists = TRUE;
-						break;
-					}
-			} while (exists);
+			} while (aim_ssi_itemlist_find(list, new->gid, 0x0000));
 		}
 	} else if (new->gid == 0x0000) {
 		/*
@@ -237,13 +309,7 @@ static struct aim_ssi_item *aim_ssi_itemlist_add(struct aim_ssi_itemlist *list,
 		if (new->bid == 0xFFFF) {
 			do {
 				new->bid += 0x0001;
-				exists = FALSE;
-				for (cur = list->data; cur != NULL; cur = cur->next)
-					if (cur->bid == new->bid && cur->gid == new->gid) {
-						exists = TRUE;
-						break;
-					}
-			} while (exists);
+			} while (aim_ssi_itemlist_find(list, new->gid, new->bid));
 		}
 	}
 
@@ -251,7 +317,7 @@ static struct aim_ssi_item *aim_ssi_itemlist_add(struct aim_ssi_itemlist *list,
 	new->type = type;
 
 	/* Add it to the gid+bid hashtable */
-	g_hash_table_insert(list->idx_gid_bid, GINT_TO_POINTER((new->gid << 16) + new->bid), new);
+	g_hash_table_insert(list->idx_gid_bid, AIM_SSI_ID_KEY(new->gid, new->bid), new);
 
 	/* Set the name - do this *AFTER* setting the type because type is used for the key */
 	aim_ssi_item_set_name(list, new, name);
@@ -259,22 +325,27 @@ static struct aim_ssi_item *aim_ssi_itemlist_add(struct aim_ssi_itemlist *list,
 	/* Set the TLV list */
 	new->data = aim_tlvlist_copy(data);
 
-	/* Add the item to the list in the correct numerical position.  Fancy, eh? */
-	if (list->data) {
-		if ((new->gid < list->data->gid) || ((new->gid == list->data->gid) && (new->bid < list->data->bid))) {
-			new->next = list->data;
-			list->data = new;
-		} else {
-			struct aim_ssi_item *prev;
-			for ((prev=list->data, cur=list->data->next); (cur && ((new->gid > cur->gid) || ((new->gid == cur->gid) && (new->bid > cur->bid)))); prev=cur, cur=cur->next);
-			new->next = prev->next;
-			prev->next = new;
-		}
+	/*
+	 * Add the item to the list in the correct numerical position.  Fancy, eh?
+	 * Items in a group go somewhere after the group, so start looking there.
+	 */
+	prev = NULL;
+	if (new->bid != 0x0000)
+		prev = aim_ssi_itemlist_find(list, new->gid, 0x0000);
+	if (!prev && list->data && !aim_ssi_item_before(new, list->data))
+		prev = list->data;
+
+	if (prev) {
+		for (cur=prev->next; cur && aim_ssi_item_before(cur, new); prev=cur, cur=cur->next);
+		new->next = prev->next;
+		prev->next = new;
 	} else {
 		new->next = list->data;
 		list->data = new;
 	}
 
+	aim_ssi_itemlist_touch(list, new);
+
 	return new;
 }
 
@@ -287,26 +358,29 @@ static struct aim_ssi_item *aim_ssi_itemlist_add(struct aim_ssi_itemlist *list,
  */
 static int aim_ssi_itemlist_del(struct aim_ssi_itemlist *list, struct aim_ssi_item *del)
 {
-	gchar key[3000];
-
 	if (!(list->data) || !del)
 		return -EINVAL;
 
-	/* Remove the item from the list */
+	/* Remove the item from the list, starting from its group if it's in one */
 	if (list->data == del) {
 		list->data = list->data->next;
 	} else {
-		struct aim_ssi_item *cur;
-		for (cur=list->data; (cur->next && (cur->next!=del)); cur=cur->next);
+		struct aim_ssi_item *cur = NULL;
+		if (del->bid != 0x0000)
+			cur = aim_ssi_itemlist_find(list, del->gid, 0x0000);
+		if (!cur || cur == del)
+			cur = list->data;
+		for (; (cur->next && (cur->next!=del)); cur=cur->next);
 		if (cur->next)
 			cur->next = del->next;
 	}
 
 	/* Remove from the hashtables */
-	g_hash_table_remove(list->idx_gid_bid, GINT_TO_POINTER((del->gid << 16) + del->bid));
+	if (aim_ssi_itemlist_find(list, del->gid, del->bid) == del)
+		g_hash_table_remove(list->idx_gid_bid, AIM_SSI_ID_KEY(del->gid, del->bid));
 
-	snprintf(key, sizeof(key), "%hx%s", del->type, oscar_normalize(NULL, del->name));
-	g_hash_table_remove(list->idx_all_named_items, key);
+	aim_ssi_itemlist_index_name(list, del, FALSE);
+	aim_ssi_itemlist_touch(list, del);
 
 	/* Free the removed item */
 	aim_ssi_item_free(del);
@@ -356,13 +430,17 @@ static int aim_ssi_itemlist_cmp(struct aim_ssi_item *cur1, struct aim_ssi_item *
 	return 0;
 }
 
-static gboolean aim_ssi_itemlist_valid(struct aim_ssi_itemlist *list, struct aim_ssi_item *item)
+/**
+ * Check if the item of a pending change is still in the given list.  This
+ * only compares pointers, since the item may have been freed since.
+ *
+ * @param list A pointer to the current list of items.
+ * @param tmp The pending change.
+ * @return Return TRUE if the item is still in the list.
+ */
+static gboolean aim_ssi_itemlist_valid(struct aim_ssi_itemlist *list, struct aim_ssi_tmp *tmp)
 {
-	struct aim_ssi_item *cur;
-	for (cur=list->data; cur; cur=cur->next)
-		if (cur == item)
-			return TRUE;
-	return FALSE;
+	return tmp->item && (aim_ssi_itemlist_find(list, tmp->gid, tmp->bid) == tmp->item);
 }
 
 /**
@@ -375,8 +453,23 @@ static gboolean aim_ssi_itemlist_valid(struct aim_ssi_itemlist *list, struct aim
  */
 struct aim_ssi_item *aim_ssi_itemlist_find(struct aim_ssi_itemlist *list, guint16 gid, guint16 bid)
 {
-	guint32 id_key = (gid << 16) + bid;
-	return g_hash_table_lookup(list->idx_gid_bid, GINT_TO_POINTER(id_key));
+	return g_hash_table_lookup(list->idx_gid_bid, AIM_SSI_ID_KEY(gid, bid));
+}
+
+/**
+ * Locally find a buddy given its group ID# and name.
+ *
+ * @param list A pointer to the current list of items.
+ * @param gid The group ID# of the desired buddy.
+ * @param bn The buddy name of the desired buddy.
+ * @return Return a pointer to the item if found, else return NULL.
+ */
+static struct aim_ssi_item *aim_ssi_itemlist_findbuddy(struct aim_ssi_itemlist *list, guint16 gid, const char *bn)
+{
+	gchar key[3000];
+
+	snprintf(key, sizeof(key), "%04hx%s", gid, oscar_normalize(NULL, bn));
+	return aim_ssi_index_lookup(list->idx_group_buddies, key);
 }
 
 /**
@@ -399,17 +492,13 @@ struct aim_ssi_item *aim_ssi_itemlist_finditem(struct aim_ssi_itemlist *list, co
 
 	if (gn && bn) { /* For finding buddies in groups */
 		g_return_val_if_fail(type == AIM_SSI_TYPE_BUDDY, NULL);
-		for (cur=list->data; cur; cur=cur->next)
-			if ((cur->type == type) && (cur->name) && !(oscar_util_name_compare(cur->name, bn))) {
-				struct aim_ssi_item *curg;
-				for (curg=list->data; curg; curg=curg->next)
-					if ((curg->type == AIM_SSI_TYPE_GROUP) && (curg->gid == cur->gid) && (curg->name) && !(oscar_util_name_compare(curg->name, gn)))
-						return cur;
-			}
+		if (!(cur = aim_ssi_itemlist_finditem(list, gn, NULL, AIM_SSI_TYPE_GROUP)))
+			return NULL;
+		return aim_ssi_itemlist_findbuddy(list, cur->gid, bn);
 
 	} else if (gn || bn) { /* For finding groups, permits, denies and ignores */
 		snprintf(key, sizeof(key), "%hx%s", type, oscar_normalize(NULL, gn ? gn : bn));
-		return g_hash_table_lookup(list->idx_all_named_items, key);
+		return aim_ssi_index_lookup(list->idx_all_named_items, key);
 
 	/* For stuff without names--permit deny setting, visibility mask, etc. */
 	} else for (cur=list->data; cur; cur=cur->next) {
@@ -555,6 +644,66 @@ gboolean aim_ssi_waitingforauth(struct aim_ssi_itemlist *list, const char *gn, c
 	return FALSE;
 }
 
+/**
+ * Find out what has to be sent to the server for the item with the given
+ * IDs, if anything.
+ *
+ * @param od The oscar session.
+ * @param key The group ID# and buddy ID# of the item.
+ * @param item Set to the item that should be sent.
+ * @return Return the add/mod/del subtype to send, or 0 if both lists agree.
+ */
+static guint16 aim_ssi_itemlist_diff(OscarData *od, guint32 key, struct aim_ssi_item **item)
+{
+	struct aim_ssi_item *cur1, *cur2;
+
+	cur1 = aim_ssi_itemlist_find(&od->ssi.local, key >> 16, key & 0xffff);
+	cur2 = aim_ssi_itemlist_find(&od->ssi.official, key >> 16, key & 0xffff);
+
+	if (!cur1 && cur2) {
+		*item = cur2;
+		return SNAC_SUBTYPE_FEEDBAG_DEL;
+	} else if (cur1 && !cur2) {
+		*item = cur1;
+		return SNAC_SUBTYPE_FEEDBAG_ADD;
+	} else if (cur1 && cur2 && aim_ssi_itemlist_cmp(cur1, cur2)) {
+		*item = cur1;
+		return SNAC_SUBTYPE_FEEDBAG_MOD;
+	}
+
+	return 0;
+}
+
+static gint aim_ssi_key_cmp(gconstpointer a, gconstpointer b)
+{
+	guint32 key1 = *(const guint32 *)a, key2 = *(const guint32 *)b;
+
+	return (key1 > key2) - (key1 < key2);
+}
+
+/**
+ * Queue a change to be sent with the next add/mod/del SNAC.
+ */
+static void aim_ssi_pending_append(OscarData *od, guint16 action, struct aim_ssi_item *item)
+{
+	struct aim_ssi_tmp *new;
+
+	new = g_new(struct aim_ssi_tmp, 1);
+	new->action = action;
+	new->ack = 0xffff;
+	new->name = NULL;
+	new->gid = item->gid;
+	new->bid = item->bid;
+	new->item = item;
+	new->next = NULL;
+
+	if (od->ssi.pending_tail)
+		od->ssi.pending_tail->next = new;
+	else
+		od->ssi.pending = new;
+	od->ssi.pending_tail = new;
+}
+
 /**
  * If there are changes, then create temporary items and
  * call addmoddel.
@@ -564,15 +713,28 @@ gboolean aim_ssi_waitingforauth(struct aim_ssi_itemlist *list, const char *gn, c
  */
 static int aim_ssi_sync(OscarData *od)
 {
-	struct aim_ssi_item *cur1, *cur2;
-	struct aim_ssi_tmp *cur, *new;
-	int n = 0;
-	GString *debugstr = g_string_new("");
+	static const guint16 actions[] = {
+		SNAC_SUBTYPE_FEEDBAG_DEL,
+		SNAC_SUBTYPE_FEEDBAG_ADD,
+		SNAC_SUBTYPE_FEEDBAG_MOD
+	};
+	static const char *prefixes[] = {
+		"Deleting item ",
+		"Adding item ",
+		"Modifying item "
+	};
+	struct aim_ssi_item *cur1;
+	GHashTableIter iter;
+	gpointer key;
+	GArray *keys;
+	gsize size = 0;
+	guint i, j, n = 0;
+	GString *debugstr;
 
 	/*
-	 * The variable "n" is used to limit the number of addmoddel's that
-	 * are performed in a single SNAC.  It will hopefully keep the size
-	 * of the SNAC below the maximum SNAC size.
+	 * The variables "n" and "size" are used to limit the number of
+	 * addmoddel's that are performed in a single SNAC.  They will
+	 * hopefully keep the size of the SNAC below the maximum SNAC size.
 	 */
 
 	if (!od)
@@ -583,80 +745,50 @@ static int aim_ssi_sync(OscarData *od)
 		return 0;
 
 	/*
-	 * Compare the 2 lists and create an aim_ssi_tmp for each difference.
-	 * We should only send either additions, modifications, or deletions
-	 * before waiting for an acknowledgement.  So first do deletions, then
-	 * additions, then modifications.  Also, both the official and the local
-	 * list should be in ascending numerical order for the group ID#s and the
-	 * buddy ID#s, which makes things more efficient.  I think.
+	 * Only the items that were touched since the last sync can differ
+	 * between the 2 lists, so create an aim_ssi_tmp for each of those that
+	 * does.  We should only send either additions, modifications, or
+	 * deletions before waiting for an acknowledgement.  So first do
+	 * deletions, then additions, then modifications.  Send them in
+	 * ascending numerical order for the group ID#s and the buddy ID#s, so
+	 * that a group is added before the buddies in it.
 	 */
-
-	/* Deletions */
-	if (!od->ssi.pending) {
-		for (cur1=od->ssi.official.data; cur1 && (n < 15); cur1=cur1->next) {
-			if (!aim_ssi_itemlist_find(&od->ssi.local, cur1->gid, cur1->bid)) {
-				n++;
-				new = g_new(struct aim_ssi_tmp, 1);
-				new->action = SNAC_SUBTYPE_FEEDBAG_DEL;
-				new->ack = 0xffff;
-				new->name = NULL;
-				new->item = cur1;
-				new->next = NULL;
-				if (od->ssi.pending) {
-					for (cur=od->ssi.pending; cur->next; cur=cur->next);
-					cur->next = new;
-				} else {
-					od->ssi.pending = new;
-				}
-				aim_ssi_item_debug_append(debugstr, "Deleting item ", cur1);
-			}
-		}
+	keys = g_array_sized_new(FALSE, FALSE, sizeof(guint32), g_hash_table_size(od->ssi.local.dirty));
+	g_hash_table_iter_init(&iter, od->ssi.local.dirty);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		guint32 id_key = GPOINTER_TO_UINT(key);
+		g_array_append_val(keys, id_key);
 	}
-
-	/* Additions */
-	if (!od->ssi.pending) {
-		for (cur1=od->ssi.local.data; cur1 && (n < 15); cur1=cur1->next) {
-			if (!aim_ssi_itemlist_find(&od->ssi.official, cur1->gid, cur1->bid)) {
-				n++;
-				new = g_new(struct aim_ssi_tmp, 1);
-				new->action = SNAC_SUBTYPE_FEEDBAG_ADD;
-				new->ack = 0xffff;
-				new->name = NULL;
-				new->item = cur1;
-				new->next = NULL;
-				if (od->ssi.pending) {
-					for (cur=od->ssi.pending; cur->next; cur=cur->next);
-					cur->next = new;
-				} else {
-					od->ssi.pending = new;
-				}
-				aim_ssi_item_debug_append(debugstr, "Adding item ", cur1);
+	g_array_sort(keys, aim_ssi_key_cmp);
+
+	debugstr = g_string_new("");
+	for (i = 0; (i < G_N_ELEMENTS(actions)) && !od->ssi.pending; i++) {
+		for (j = 0; j < keys->len; j++) {
+			guint32 id_key = g_array_index(keys, guint32, j);
+			guint16 action = aim_ssi_itemlist_diff(od, id_key, &cur1);
+			gsize itemsize;
+
+			if (!action) {
+				/* Nothing to send, both lists agree */
+				g_hash_table_remove(od->ssi.local.dirty, GUINT_TO_POINTER(id_key));
+				continue;
 			}
+			if (action != actions[i])
+				continue;
+
+			itemsize = 10 + (cur1->name ? strlen(cur1->name) : 0) + aim_tlvlist_size(cur1->data);
+			if ((n > 0) && ((n >= AIM_SSI_BATCH_ITEMS) || (size + itemsize > AIM_SSI_BATCH_SIZE)))
+				break;
+			n++;
+			size += itemsize;
+
+			aim_ssi_pending_append(od, action, cur1);
+			g_hash_table_remove(od->ssi.local.dirty, GUINT_TO_POINTER(id_key));
+			aim_ssi_item_debug_append(debugstr, prefixes[i], cur1);
 		}
 	}
+	g_array_free(keys, TRUE);
 
-	/* Modifications */
-	if (!od->ssi.pending) {
-		for (cur1=od->ssi.local.data; cur1 && (n < 15); cur1=cur1->next) {
-			cur2 = aim_ssi_itemlist_find(&od->ssi.official, cur1->gid, cur1->bid);
-			if (cur2 && (aim_ssi_itemlist_cmp(cur1, cur2))) {
-				n++;
-				new = g_new(struct aim_ssi_tmp, 1);
-				new->action = SNAC_SUBTYPE_FEEDBAG_MOD;
-				new->ack = 0xffff;
-				new->name = NULL;
-				new->item = cur1;
-				new->next = NULL;
-				if (od->ssi.pending) {
-					for (cur=od->ssi.pending; cur->next; cur=cur->next);
-					cur->next = new;
-				} else {
-					od->ssi.pending = new;
-				}
-				aim_ssi_item_debug_append(debugstr, "Modifying item ", cur1);
-			}
-		}
-	}
 	if (debugstr->len > 0) {
 		purple_debug_info("oscar", "%s", debugstr->str);
 		if (purple_debug_is_verbose()) {
@@ -731,10 +863,19 @@ aim_ssi_freelist(OscarData *od)
 		g_free(deltmp);
 	}
 
+	g_hash_table_remove_all(od->ssi.official.idx_gid_bid);
+	g_hash_table_remove_all(od->ssi.official.idx_all_named_items);
+	g_hash_table_remove_all(od->ssi.official.idx_group_buddies);
+	g_hash_table_remove_all(od->ssi.local.idx_gid_bid);
+	g_hash_table_remove_all(od->ssi.local.idx_all_named_items);
+	g_hash_table_remove_all(od->ssi.local.idx_group_buddies);
+	g_hash_table_remove_all(od->ssi.local.dirty);
+
 	od->ssi.numitems = 0;
 	od->ssi.official.data = NULL;
 	od->ssi.local.data = NULL;
 	od->ssi.pending = NULL;
+	od->ssi.pending_tail = NULL;
 	od->ssi.timestamp = (time_t)0;
 }
 
@@ -743,7 +884,7 @@ aim_ssi_freelist(OscarData *od)
  * the TLV is not a valid UTF-8 string then use purple_utf8_salvage()
  * to replace invalid bytes with question marks.
  */
-static void cleanlist_ensure_utf8_data(struct aim_ssi_item *item, guint16 tlvtype)
+static void cleanlist_ensure_utf8_data(struct aim_ssi_itemlist *list, struct aim_ssi_item *item, guint16 tlvtype)
 {
 	aim_tlv_t *tlv;
 	gchar *value, *salvaged;
@@ -761,6 +902,7 @@ static void cleanlist_ensure_utf8_data(struct aim_ssi_item *item, guint16 tlvtyp
 			aim_tlvlist_replace_str(&item->data, tlvtype, salvaged);
 		else
 			aim_tlvlist_remove(&item->data, tlvtype);
+		aim_ssi_itemlist_touch(list, item);
 		g_free(salvaged);
 	}
 }
@@ -806,33 +948,31 @@ static int aim_ssi_cleanlist(OscarData *od)
 
 	cur = od->ssi.local.data;
 	while (cur) {
+		next = cur->next;
 		if ((cur->type == AIM_SSI_TYPE_BUDDY) || (cur->type == AIM_SSI_TYPE_PERMIT) || (cur->type == AIM_SSI_TYPE_DENY))
 		{
-			struct aim_ssi_item *cur2, *next2;
+			struct aim_ssi_item *first = NULL;
 
 			/* Make sure there aren't any duplicate permits or denies, or
-			   duplicate buddies within a group */
-			cur2 = cur->next;
-			while (cur2) {
-				next2 = cur2->next;
-				if (cur->type == cur2->type
-						&& cur->gid == cur2->gid
-						&& cur->name
-						&& cur2->name
-						&& !oscar_util_name_compare(cur->name, cur2->name))
-				{
-					aim_ssi_itemlist_del(&od->ssi.local, cur2);
-				}
-				cur2 = next2;
+			   duplicate buddies within a group.  The name indexes know
+			   which one of them came first. */
+			if (cur->name && (cur->type == AIM_SSI_TYPE_BUDDY))
+				first = aim_ssi_itemlist_findbuddy(&od->ssi.local, cur->gid, cur->name);
+			else if (cur->name)
+				first = aim_ssi_itemlist_finditem(&od->ssi.local, NULL, cur->name, cur->type);
+			if (first && (first != cur) && (first->gid == cur->gid)) {
+				aim_ssi_itemlist_del(&od->ssi.local, cur);
+				cur = next;
+				continue;
 			}
 
 			/* Make sure alias is valid UTF-8 */
-			cleanlist_ensure_utf8_data(cur, 0x0131);
+			cleanlist_ensure_utf8_data(&od->ssi.local, cur, 0x0131);
 
 			/* Make sure comment is valid UTF-8 */
-			cleanlist_ensure_utf8_data(cur, 0x013c);
+			cleanlist_ensure_utf8_data(&od->ssi.local, cur, 0x013c);
 		}
-		cur = cur->next;
+		cur = next;
 	}
 
 	/* If we've made any changes then sync our list with the server's */
@@ -1040,6 +1180,7 @@ int aim_ssi_aliasbuddy(OscarData *od, const char *gn, const char *bn, const char
 		aim_tlvlist_replace_str(&tmp->data, 0x0131, alias);
 	else
 		aim_tlvlist_remove(&tmp->data, 0x0131);
+	aim_ssi_itemlist_touch(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	return aim_ssi_sync(od);
@@ -1070,6 +1211,7 @@ int aim_ssi_editcomment(OscarData *od, const char *gn, const char *bn, const cha
 		aim_tlvlist_replace_str(&tmp->data, 0x013c, comment);
 	else
 		aim_tlvlist_remove(&tmp->data, 0x013c);
+	aim_ssi_itemlist_touch(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	return aim_ssi_sync(od);
@@ -1130,6 +1272,7 @@ int aim_ssi_setpermdeny(OscarData *od, guint8 permdeny)
 
 	/* Need to add the 0x00ca TLV to the TLV chain */
 	aim_tlvlist_replace_8(&tmp->data, 0x00ca, permdeny);
+	aim_ssi_itemlist_touch(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	return aim_ssi_sync(od);
@@ -1170,6 +1313,7 @@ int aim_ssi_seticon(OscarData *od, const guint8 *iconsum, guint8 iconsumlen)
 
 	/* Need to add the 0x0131 TLV to the TLV chain, used to cache the icon */
 	aim_tlvlist_replace_noval(&tmp->data, 0x0131);
+	aim_ssi_itemlist_touch(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	aim_ssi_sync(od);
@@ -1222,6 +1366,7 @@ int aim_ssi_setpresence(OscarData *od, guint32 presence) {
 
 	/* Need to add the x00c9 TLV to the TLV chain */
 	aim_tlvlist_replace_32(&tmp->data, 0x00c9, presence);
+	aim_ssi_itemlist_touch(&od->ssi.local, tmp);
 
 	/* Sync our local list with the server list */
 	return aim_ssi_sync(od);
@@ -1342,6 +1487,9 @@ static int parsedata(OscarData *od, FlapConnection *conn, aim_module_t *mod, Fla
 		for (cur=od->ssi.official.data; cur; cur=cur->next)
 			aim_ssi_itemlist_add(&od->ssi.local, cur->name, cur->gid, cur->bid, cur->type, cur->data);
 
+		/* Both lists are the same, so there is nothing to sync yet */
+		g_hash_table_remove_all(od->ssi.local.dirty);
+
 		/* Clean the buddy list */
 		aim_ssi_cleanlist(od);
 
@@ -1493,6 +1641,7 @@ static int parsemod(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 
 		/* Replace the 2 local items with the given one */
 		if ((item = aim_ssi_itemlist_find(&od->ssi.local, gid, bid))) {
+			aim_ssi_item_set_name(&od->ssi.local, item, NULL);
 			item->type = type;
 			aim_ssi_item_set_name(&od->ssi.local, item, name);
 			aim_tlvlist_free(item->data);
@@ -1500,6 +1649,7 @@ static int parsemod(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 		}
 
 		if ((item = aim_ssi_itemlist_find(&od->ssi.official, gid, bid))) {
+			aim_ssi_item_set_name(&od->ssi.official, item, NULL);
 			item->type = type;
 			aim_ssi_item_set_name(&od->ssi.official, item, name);
 			aim_tlvlist_free(item->data);
@@ -1579,7 +1729,7 @@ static int parseack(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 				/* Remove the item from the local list */
 				/* Make sure cur->item is still valid memory */
 				/* TODO: "Still valid memory"?  That's bad form. */
-				if (aim_ssi_itemlist_valid(&od->ssi.local, cur->item)) {
+				if (aim_ssi_itemlist_valid(&od->ssi.local, cur)) {
 					cur->name = g_strdup(cur->item->name);
 					aim_ssi_itemlist_del(&od->ssi.local, cur->item);
 				}
@@ -1587,10 +1737,10 @@ static int parseack(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 
 			} else if (cur->action == SNAC_SUBTYPE_FEEDBAG_MOD) {
 				/* Replace the local item with the item from the official list */
-				if (aim_ssi_itemlist_valid(&od->ssi.local, cur->item)) {
+				if (aim_ssi_itemlist_valid(&od->ssi.local, cur)) {
 					struct aim_ssi_item *cur1;
 					if ((cur1 = aim_ssi_itemlist_find(&od->ssi.official, cur->item->gid, cur->item->bid))) {
-						aim_ssi_item_set_name(&od->ssi.official, cur->item, cur1->name);
+						aim_ssi_item_set_name(&od->ssi.local, cur->item, cur1->name);
 						aim_tlvlist_free(cur->item->data);
 						cur->item->data = aim_tlvlist_copy(cur1->data);
 					}
@@ -1599,7 +1749,7 @@ static int parseack(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 
 			} else if (cur->action == SNAC_SUBTYPE_FEEDBAG_DEL) {
 				/* Add the item back into the local list */
-				if (aim_ssi_itemlist_valid(&od->ssi.official, cur->item)) {
+				if (aim_ssi_itemlist_valid(&od->ssi.official, cur)) {
 					aim_ssi_itemlist_add(&od->ssi.local, cur->item->name, cur->item->gid, cur->item->bid, cur->item->type, cur->item->data);
 				} else
 					cur->item = NULL;
@@ -1609,14 +1759,14 @@ static int parseack(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 			/* Do the exact opposite */
 			if (cur->action == SNAC_SUBTYPE_FEEDBAG_ADD) {
 			/* Add the local item to the official list */
-				if (aim_ssi_itemlist_valid(&od->ssi.local, cur->item)) {
+				if (aim_ssi_itemlist_valid(&od->ssi.local, cur)) {
 					aim_ssi_itemlist_add(&od->ssi.official, cur->item->name, cur->item->gid, cur->item->bid, cur->item->type, cur->item->data);
 				} else
 					cur->item = NULL;
 
 			} else if (cur->action == SNAC_SUBTYPE_FEEDBAG_MOD) {
 				/* Replace the official item with the item from the local list */
-				if (aim_ssi_itemlist_valid(&od->ssi.local, cur->item)) {
+				if (aim_ssi_itemlist_valid(&od->ssi.local, cur)) {
 					struct aim_ssi_item *cur1;
 					if ((cur1 = aim_ssi_itemlist_find(&od->ssi.official, cur->item->gid, cur->item->bid))) {
 						aim_ssi_item_set_name(&od->ssi.official, cur1, cur->item->name);
@@ -1628,7 +1778,7 @@ static int parseack(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 
 			} else if (cur->action == SNAC_SUBTYPE_FEEDBAG_DEL) {
 				/* Remove the item from the official list */
-				if (aim_ssi_itemlist_valid(&od->ssi.official, cur->item))
+				if (aim_ssi_itemlist_valid(&od->ssi.official, cur))
 					aim_ssi_itemlist_del(&od->ssi.official, cur->item);
 				cur->item = NULL;
 			}
@@ -1649,6 +1799,8 @@ static int parseack(OscarData *od, FlapConnection *conn, aim_module_t *mod, Flap
 		g_free(del);
 	}
 	od->ssi.pending = cur;
+	if (!od->ssi.pending)
+		od->ssi.pending_tail = NULL;
 
 	/* If we're not waiting for any more acks, then send more SNACs */
 	if (!od->ssi.pending) {
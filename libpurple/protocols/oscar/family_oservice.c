@@ -336,10 +336,8 @@ rateresp(OscarData *od, FlapConnection *conn, aim_module_t *mod, FlapFrame *fram
 	{
 		struct rateclass *rateclass;
 		guint32 delta;
-		struct timeval now;
 
-		gettimeofday(&now, NULL);
-		rateclass = g_new(struct rateclass, 1);
+		rateclass = g_new0(struct rateclass, 1);
 
 		rateclass->classid = byte_stream_get16(bs);
 		rateclass->windowsize = byte_stream_get32(bs);
@@ -357,8 +355,7 @@ rateresp(OscarData *od, FlapConnection *conn, aim_module_t *mod, FlapFrame *fram
 			rateclass->dropping_snacs = 0;
 		}
 
-		rateclass->last.tv_sec = now.tv_sec - delta / 1000;
-		rateclass->last.tv_usec = now.tv_usec - (delta % 1000) * 1000;
+		rateclass->last = g_get_monotonic_time() / 1000 - delta;
 
 		conn->rateclasses = g_slist_prepend(conn->rateclasses, rateclass);
 
@@ -454,7 +451,6 @@ ratechange(OscarData *od, FlapConnection *conn, aim_module_t *mod, FlapFrame *fr
 	guint16 code, classid;
 	struct rateclass *rateclass;
 	guint32 delta;
-	struct timeval now;
 	static const char *codes[5] = {
 		"invalid",
 		"change",
@@ -463,7 +459,6 @@ ratechange(OscarData *od, FlapConnection *conn, aim_module_t *mod, FlapFrame *fr
 		"limit cleared",
 	};
 
-	gettimeofday(&now, NULL);
 	code = byte_stream_get16(bs);
 	classid = byte_stream_get16(bs);
 
@@ -487,8 +482,7 @@ ratechange(OscarData *od, FlapConnection *conn, aim_module_t *mod, FlapFrame *fr
 		rateclass->dropping_snacs = 0;
 	}
 
-	rateclass->last.tv_sec = now.tv_sec - delta / 1000;
-	rateclass->last.tv_usec = now.tv_usec - (delta % 1000) * 1000;
+	rateclass->last = g_get_monotonic_time() / 1000 - delta;
 
 	purple_debug_misc("oscar", "rate %s (param ID 0x%04hx): curavg = %u, "
 			"maxavg = %u, alert at %u, clear warning at %u, limit at %u, "
@@ -504,6 +498,9 @@ ratechange(OscarData *od, FlapConnection *conn, aim_module_t *mod, FlapFrame *fr
 				"limit. Please wait 10 seconds and try again.\n");
 	}
 
+	/* The limits changed, so anything we're holding may be sent sooner */
+	flap_connection_send_queued_snacs(conn);
+
 	return 1;
 }
 
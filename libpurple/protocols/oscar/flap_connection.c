@@ -118,80 +118,211 @@ flap_connection_get_rateclass(FlapConnection *conn, guint16 family, guint16 subt
  * were to send a SNAC in this rateclass at the given time.
  */
 static guint32
-rateclass_get_new_current(FlapConnection *conn, struct rateclass *rateclass, struct timeval *now)
+rateclass_get_new_current(struct rateclass *rateclass, gint64 now)
 {
-	unsigned long timediff; /* In milliseconds */
+	gint64 timediff; /* In milliseconds */
 	guint32 current;
 
 	/* This formula is documented at http://dev.aol.com/aim/oscar/#RATELIMIT */
-	timediff = (now->tv_sec - rateclass->last.tv_sec) * 1000 + (now->tv_usec - rateclass->last.tv_usec) / 1000;
+	timediff = now - rateclass->last;
 	current = ((rateclass->current * (rateclass->windowsize - 1)) + timediff) / rateclass->windowsize;
 
 	return MIN(current, rateclass->max);
 }
 
 /*
- * Attempt to send the contents of a given queue
+ * The average we must stay above when sending a SNAC.  High priority
+ * SNACs may use everything down to the alert level, but low priority
+ * ones stop at the clear level so there's always room for the others.
+ */
+static guint32
+rateclass_get_level(struct rateclass *rateclass, gboolean high_priority)
+{
+	guint32 level;
+
+	level = rateclass->alert;
+	if (!high_priority)
+		level = MAX(level, rateclass->clear);
+
+	/* The average can't go past max, so don't wait for it to */
+	if (rateclass->max > 0 && level >= rateclass->max)
+		level = rateclass->max - 1;
+
+	return level;
+}
+
+/*
+ * Work out how many milliseconds we have to wait before a SNAC can
+ * be sent in this rateclass without its average dropping to level.
  *
- * @return TRUE if the queue was completely emptied or was initially
- *         empty; FALSE if rate limiting prevented it from being
- *         emptied.
+ * @return 0 if it can be sent now, or G_MAXUINT32 if the server is
+ *         dropping SNACs in this class and we have to wait for it
+ *         to tell us otherwise.
  */
-static gboolean flap_connection_send_snac_queue(FlapConnection *conn, struct timeval now, GQueue *queue)
+static guint32
+rateclass_get_wait(struct rateclass *rateclass, gint64 now, gboolean high_priority)
 {
-	while (!g_queue_is_empty(queue))
+	gint64 needed;
+
+	if (rateclass->dropping_snacs)
+		return G_MAXUINT32;
+
+	/*
+	 * The new average is above level once
+	 * current * (windowsize - 1) + timediff >= (level + 1) * windowsize
+	 */
+	needed = (gint64)(rateclass_get_level(rateclass, high_priority) + 1) * rateclass->windowsize
+			- (gint64)rateclass->current * (rateclass->windowsize - 1);
+	needed -= now - rateclass->last;
+
+	return CLAMP(needed, 0, G_MAXUINT32 - 1);
+}
+
+static void
+rateclass_sent(struct rateclass *rateclass, gint64 now)
+{
+	rateclass->current = rateclass_get_new_current(rateclass, now);
+	rateclass->last = now;
+}
+
+static void
+rateclass_enqueue(FlapConnection *conn, struct rateclass *rateclass, QueuedSnac *queued_snac, gboolean high_priority, gint64 now)
+{
+	guint queued;
+
+	if (rateclass->throttled_since == 0)
 	{
-		QueuedSnac *queued_snac;
-		struct rateclass *rateclass;
+		purple_debug_info("oscar", "Rate class 0x%04hx for conn %p "
+				"is at %u and we alert at %u; enqueueing\n",
+				rateclass->classid, conn,
+				rateclass_get_new_current(rateclass, now),
+				rateclass->alert);
+		rateclass->throttled_since = now;
+	}
 
-		queued_snac = g_queue_peek_head(queue);
+	g_queue_push_tail(&rateclass->queued[high_priority ? RATECLASS_QUEUE_HIGH : RATECLASS_QUEUE_LOW], queued_snac);
 
-		rateclass = flap_connection_get_rateclass(conn, queued_snac->family, queued_snac->subtype);
-		if (rateclass != NULL)
-		{
-			guint32 new_current;
+	queued = rateclass->queued[RATECLASS_QUEUE_HIGH].length + rateclass->queued[RATECLASS_QUEUE_LOW].length;
+	rateclass->throttled++;
+	rateclass->max_queued = MAX(rateclass->max_queued, queued);
+}
 
-			new_current = rateclass_get_new_current(conn, rateclass, &now);
+/*
+ * Send as many of the SNACs queued for a rateclass as the rate
+ * limit allows, high priority ones first.
+ *
+ * @return How many milliseconds until the next one can be sent,
+ *         or G_MAXUINT32 if the queues were emptied or we have to
+ *         wait for the server.
+ */
+static guint32
+rateclass_send_queued(FlapConnection *conn, struct rateclass *rateclass, gint64 now)
+{
+	int i;
+
+	for (i = RATECLASS_QUEUE_HIGH; i <= RATECLASS_QUEUE_LOW; i++)
+	{
+		GQueue *queue = &rateclass->queued[i];
 
-			if (rateclass->dropping_snacs || new_current <= rateclass->alert)
+		while (!g_queue_is_empty(queue))
+		{
+			QueuedSnac *queued_snac;
+			guint32 wait;
+
+			wait = rateclass_get_wait(rateclass, now, i == RATECLASS_QUEUE_HIGH);
+			if (wait > 0)
 				/* Not ready to send this SNAC yet--keep waiting. */
-				return FALSE;
+				return wait;
 
-			rateclass->current = new_current;
-			rateclass->last.tv_sec = now.tv_sec;
-			rateclass->last.tv_usec = now.tv_usec;
+			queued_snac = g_queue_pop_head(queue);
+			rateclass_sent(rateclass, now);
+			flap_connection_send(conn, queued_snac->frame);
+			g_free(queued_snac);
 		}
+	}
 
-		flap_connection_send(conn, queued_snac->frame);
-		g_free(queued_snac);
-		g_queue_pop_head(queue);
+	/* We emptied the queues */
+	if (rateclass->throttled_since != 0)
+	{
+		rateclass->throttled_time += now - rateclass->throttled_since;
+		rateclass->throttled_since = 0;
+
+		purple_debug_info("oscar", "Rate class 0x%04hx for conn %p "
+				"caught up; %u SNACs have waited for it, at most %u "
+				"at once, for %" G_GINT64_FORMAT " ms in all\n",
+				rateclass->classid, conn, rateclass->throttled,
+				rateclass->max_queued, rateclass->throttled_time);
 	}
 
-	/* We emptied the queue */
-	return TRUE;
+	return G_MAXUINT32;
 }
 
-static gboolean flap_connection_send_queued(gpointer data)
+static gboolean
+flap_connection_send_queued(gpointer data)
 {
-	FlapConnection *conn;
-	struct timeval now;
+	FlapConnection *conn = data;
 
-	conn = data;
-	gettimeofday(&now, NULL);
-
-	purple_debug_info("oscar", "Attempting to send %u queued SNACs and %u queued low-priority SNACs for %p\n",
-					  (conn->queued_snacs ? conn->queued_snacs->length : 0),
-					  (conn->queued_lowpriority_snacs ? conn->queued_lowpriority_snacs->length : 0),
-					  conn);
-	if (!conn->queued_snacs || flap_connection_send_snac_queue(conn, now, conn->queued_snacs)) {
-		if (!conn->queued_lowpriority_snacs || flap_connection_send_snac_queue(conn, now, conn->queued_lowpriority_snacs)) {
-			/* Both queues emptied. */
-			conn->queued_timeout = 0;
-			return FALSE;
-		}
+	conn->queued_timeout = 0;
+	flap_connection_send_queued_snacs(conn);
+
+	return FALSE;
+}
+
+/**
+ * Send whatever queued SNACs the rate limits allow, and set a timer
+ * for when the rateclass that will be ready first can send again.
+ * This should be called whenever the rate limits change.
+ */
+void
+flap_connection_send_queued_snacs(FlapConnection *conn)
+{
+	GSList *cur;
+	gint64 now;
+	guint32 wakeup = G_MAXUINT32;
+
+	now = g_get_monotonic_time() / 1000;
+
+	for (cur = conn->rateclasses; cur != NULL; cur = cur->next)
+		wakeup = MIN(wakeup, rateclass_send_queued(conn, cur->data, now));
+
+	if (conn->queued_timeout != 0)
+	{
+		g_source_remove(conn->queued_timeout);
+		conn->queued_timeout = 0;
 	}
 
-	/* We couldn't send all our SNACs. Keep trying */
+	if (wakeup != G_MAXUINT32)
+		conn->queued_timeout = g_timeout_add(wakeup, flap_connection_send_queued, conn);
+}
+
+/**
+ * Fill in how backed up the rate class that a SNAC family and subtype
+ * belong to is.
+ *
+ * @return FALSE if there's no rate class for that SNAC on this
+ *         connection, in which case stats is left alone.
+ */
+gboolean
+flap_connection_get_rate_stats(FlapConnection *conn, guint16 family, guint16 subtype, FlapRateStats *stats)
+{
+	struct rateclass *rateclass;
+
+	g_return_val_if_fail(stats != NULL, FALSE);
+
+	rateclass = flap_connection_get_rateclass(conn, family, subtype);
+	if (rateclass == NULL)
+		return FALSE;
+
+	stats->classid = rateclass->classid;
+	stats->queued_high = rateclass->queued[RATECLASS_QUEUE_HIGH].length;
+	stats->queued_low = rateclass->queued[RATECLASS_QUEUE_LOW].length;
+	stats->throttled = rateclass->throttled;
+	stats->max_queued = rateclass->max_queued;
+	stats->throttled_time = rateclass->throttled_time;
+
+	if (rateclass->throttled_since != 0)
+		stats->throttled_time += g_get_monotonic_time() / 1000 - rateclass->throttled_since;
+
 	return TRUE;
 }
 
@@ -199,20 +330,22 @@ static gboolean flap_connection_send_queued(gpointer data)
  * This sends a channel 2 FLAP containing a SNAC.  The SNAC family and
  * subtype are looked up in the rate info for this connection, and if
  * sending this SNAC will induce rate limiting then we delay sending
- * of the SNAC by putting it into an outgoing holding queue.
+ * of the SNAC by putting it into its rate class's holding queue.
+ * SNACs in other rate classes aren't held up by it.
  *
  * @param data The optional bytestream that makes up the data portion
  *        of this SNAC.  For empty SNACs this should be NULL.
  * @param high_priority If TRUE, the SNAC will be queued normally if
  *        needed. If FALSE, it will be queued separately, to be sent
- *        only if all high priority SNACs have been sent.
+ *        only if all high priority SNACs in its rate class have been
+ *        sent, and only while the rate class is well clear of its
+ *        limit.
  */
 void
 flap_connection_send_snac_with_priority(OscarData *od, FlapConnection *conn, guint16 family, const guint16 subtype, aim_snacid_t snacid, ByteStream *data, gboolean high_priority)
 {
 	FlapFrame *frame;
 	guint32 length;
-	gboolean enqueue = FALSE;
 	struct rateclass *rateclass;
 
 	length = data != NULL ? data->offset : 0;
@@ -226,54 +359,38 @@ flap_connection_send_snac_with_priority(OscarData *od, FlapConnection *conn, gui
 		byte_stream_putbs(&frame->data, data, length);
 	}
 
-	if (conn->queued_timeout != 0)
-		enqueue = TRUE;
-	else if ((rateclass = flap_connection_get_rateclass(conn, family, subtype)) != NULL)
+	rateclass = flap_connection_get_rateclass(conn, family, subtype);
+	if (rateclass != NULL)
 	{
-		struct timeval now;
-		guint32 new_current;
+		gboolean waiting;
+		gint64 now;
 
-		gettimeofday(&now, NULL);
-		new_current = rateclass_get_new_current(conn, rateclass, &now);
+		now = g_get_monotonic_time() / 1000;
 
-		if (rateclass->dropping_snacs || new_current <= rateclass->alert)
-		{
-			purple_debug_info("oscar", "Current rate for conn %p would be %u, but we alert at %u; enqueueing\n", conn, new_current, rateclass->alert);
+		/* Don't jump ahead of SNACs that are already waiting */
+		waiting = !g_queue_is_empty(&rateclass->queued[RATECLASS_QUEUE_HIGH]) ||
+				(!high_priority && !g_queue_is_empty(&rateclass->queued[RATECLASS_QUEUE_LOW]));
 
-			enqueue = TRUE;
-		}
-		else
+		if (waiting || rateclass_get_wait(rateclass, now, high_priority) > 0)
 		{
-			rateclass->current = new_current;
-			rateclass->last.tv_sec = now.tv_sec;
-			rateclass->last.tv_usec = now.tv_usec;
-		}
-	}
+			/* We've been sending too fast, so delay this message */
+			QueuedSnac *queued_snac;
 
-	if (enqueue)
-	{
-		/* We've been sending too fast, so delay this message */
-		QueuedSnac *queued_snac;
-
-		queued_snac = g_new(QueuedSnac, 1);
-		queued_snac->family = family;
-		queued_snac->subtype = subtype;
-		queued_snac->frame = frame;
-
-		if (high_priority) {
-			if (!conn->queued_snacs)
-				conn->queued_snacs = g_queue_new();
-			g_queue_push_tail(conn->queued_snacs, queued_snac);
-		} else {
-			if (!conn->queued_lowpriority_snacs)
-				conn->queued_lowpriority_snacs = g_queue_new();
-			g_queue_push_tail(conn->queued_lowpriority_snacs, queued_snac);
-		}
+			queued_snac = g_new(QueuedSnac, 1);
+			queued_snac->family = family;
+			queued_snac->subtype = subtype;
+			queued_snac->frame = frame;
 
-		if (conn->queued_timeout == 0)
-			conn->queued_timeout = g_timeout_add(500, flap_connection_send_queued, conn);
+			rateclass_enqueue(conn, rateclass, queued_snac, high_priority, now);
 
-		return;
+			/* This class might be ready before the timer we have now */
+			if (!waiting)
+				flap_connection_send_queued_snacs(conn);
+
+			return;
+		}
+
+		rateclass_sent(rateclass, now);
 	}
 
 	flap_connection_send(conn, frame);
@@ -403,21 +520,29 @@ flap_connection_close(OscarData *od, FlapConnection *conn)
 		conn->gsc = NULL;
 	}
 
-	g_free(conn->buffer_incoming.data.data);
-	conn->buffer_incoming.data.data = NULL;
+	g_free(conn->buffer_read);
+	conn->buffer_read = NULL;
+	conn->buffer_read_size = conn->buffer_read_len = 0;
 
 	g_object_unref(G_OBJECT(conn->buffer_outgoing));
 	conn->buffer_outgoing = NULL;
 }
 
 /**
- * Free a FlapFrame
+ * Free a FlapFrame, or keep it for flap_frame_new() to reuse.
  *
  * @param frame The frame to free.
  */
 static void
-flap_frame_destroy(FlapFrame *frame)
+flap_frame_destroy(OscarData *od, FlapFrame *frame)
 {
+	if (od->frame_pool_len < OSCAR_FRAME_POOL_SIZE &&
+			frame->size <= OSCAR_FRAME_POOL_MAX_DATA)
+	{
+		od->frame_pool[od->frame_pool_len++] = frame;
+		return;
+	}
+
 	g_free(frame->data.data);
 	g_free(frame);
 }
@@ -502,34 +627,26 @@ flap_connection_destroy_cb(gpointer data)
 	g_slist_free(conn->groups);
 	while (conn->rateclasses != NULL)
 	{
-		g_free(conn->rateclasses->data);
-		conn->rateclasses = g_slist_delete_link(conn->rateclasses, conn->rateclasses);
-	}
-
-	g_hash_table_destroy(conn->rateclass_members);
+		struct rateclass *rateclass = conn->rateclasses->data;
+		int i;
 
-	if (conn->queued_snacs) {
-		while (!g_queue_is_empty(conn->queued_snacs))
+		for (i = RATECLASS_QUEUE_HIGH; i <= RATECLASS_QUEUE_LOW; i++)
 		{
-			QueuedSnac *queued_snac;
-			queued_snac = g_queue_pop_head(conn->queued_snacs);
-			flap_frame_destroy(queued_snac->frame);
-			g_free(queued_snac);
+			while (!g_queue_is_empty(&rateclass->queued[i]))
+			{
+				QueuedSnac *queued_snac;
+				queued_snac = g_queue_pop_head(&rateclass->queued[i]);
+				flap_frame_destroy(od, queued_snac->frame);
+				g_free(queued_snac);
+			}
 		}
-		g_queue_free(conn->queued_snacs);
-	}
 
-	if (conn->queued_lowpriority_snacs) {
-		while (!g_queue_is_empty(conn->queued_lowpriority_snacs))
-		{
-			QueuedSnac *queued_snac;
-			queued_snac = g_queue_pop_head(conn->queued_lowpriority_snacs);
-			flap_frame_destroy(queued_snac->frame);
-			g_free(queued_snac);
-		}
-		g_queue_free(conn->queued_lowpriority_snacs);
+		g_free(rateclass);
+		conn->rateclasses = g_slist_delete_link(conn->rateclasses, conn->rateclasses);
 	}
 
+	g_hash_table_destroy(conn->rateclass_members);
+
 	if (conn->queued_timeout > 0)
 		g_source_remove(conn->queued_timeout);
 
@@ -719,19 +836,70 @@ flap_frame_new(OscarData *od, guint16 channel, int datalen)
 {
 	FlapFrame *frame;
 
-	frame = g_new0(FlapFrame, 1);
+	if (od->frame_pool_len > 0)
+	{
+		frame = od->frame_pool[--od->frame_pool_len];
+		frame->seqnum = 0;
+	}
+	else
+		frame = g_new0(FlapFrame, 1);
 	frame->channel = channel;
 
-	if (datalen > 0)
-		byte_stream_new(&frame->data, datalen);
+	if (datalen < 0)
+		datalen = 0;
+
+	/* Reuse the buffer if it is big enough */
+	if ((size_t)datalen > frame->size)
+	{
+		g_free(frame->data.data);
+		frame->data.data = g_malloc(datalen);
+		frame->size = datalen;
+	}
+	byte_stream_init(&frame->data, frame->data.data, datalen);
 
 	return frame;
 }
 
+/**
+ * Free the frames kept around by flap_frame_destroy().
+ */
+void
+flap_frame_pool_free(OscarData *od)
+{
+	while (od->frame_pool_len > 0)
+	{
+		FlapFrame *frame = od->frame_pool[--od->frame_pool_len];
+
+		g_free(frame->data.data);
+		g_free(frame);
+	}
+}
+
+/**
+ * Hand a SNAC to the module for its family, and then to the
+ * modules that take any family if that one didn't handle it.
+ */
+static void
+dispatch_snac(OscarData *od, FlapConnection *conn, FlapFrame *frame, aim_modsnac_t *snac)
+{
+	aim_module_t *mod;
+	GSList *cur;
+
+	mod = aim__findmodulebygroup(od, snac->family);
+	if (mod != NULL && mod->snachandler(od, conn, mod, frame, snac, &frame->data))
+		return;
+
+	for (cur = od->modmulti; cur; cur = cur->next) {
+		mod = cur->data;
+
+		if (mod->snachandler(od, conn, mod, frame, snac, &frame->data))
+			return;
+	}
+}
+
 static void
 parse_snac(OscarData *od, FlapConnection *conn, FlapFrame *frame)
 {
-	aim_module_t *cur;
 	aim_modsnac_t snac;
 
 	if (byte_stream_bytes_left(&frame->data) < 10)
@@ -763,36 +931,19 @@ parse_snac(OscarData *od, FlapConnection *conn, FlapFrame *frame)
 		byte_stream_advance(&frame->data, byte_stream_get16(&frame->data));
 	}
 
-	for (cur = (aim_module_t *)od->modlistv; cur; cur = cur->next) {
-
-		if (!(cur->flags & AIM_MODFLAG_MULTIFAMILY) &&
-				(cur->family != snac.family))
-			continue;
-
-		if (cur->snachandler(od, conn, cur, frame, &snac, &frame->data))
-			return;
-	}
+	dispatch_snac(od, conn, frame, &snac);
 }
 
 static void
 parse_fakesnac(OscarData *od, FlapConnection *conn, FlapFrame *frame, guint16 family, guint16 subtype)
 {
-	aim_module_t *cur;
 	aim_modsnac_t snac;
 
 	snac.family = family;
 	snac.subtype = subtype;
 	snac.flags = snac.id = 0;
 
-	for (cur = (aim_module_t *)od->modlistv; cur; cur = cur->next) {
-
-		if (!(cur->flags & AIM_MODFLAG_MULTIFAMILY) &&
-				(cur->family != snac.family))
-			continue;
-
-		if (cur->snachandler(od, conn, cur, frame, &snac, &frame->data))
-			return;
-	}
+	dispatch_snac(od, conn, frame, &snac);
 }
 
 static void
@@ -866,125 +1017,121 @@ parse_flap(OscarData *od, FlapConnection *conn, FlapFrame *frame)
 	}
 }
 
+/**
+ * Handle every complete FLAP in the read buffer, and move whatever
+ * is left of an incomplete one to the start of it.
+ *
+ * @return FALSE if the data wasn't FLAP data and the connection is
+ *         being closed.
+ */
+static gboolean
+flap_connection_parse_read(FlapConnection *conn)
+{
+	guint8 *buf = conn->buffer_read;
+	gsize len = conn->buffer_read_len;
+	gsize framelen;
+
+	while (len >= 6)
+	{
+		/* All FLAP frames must start with the byte 0x2a */
+		if (aimutil_get8(&buf[0]) != 0x2a)
+		{
+			conn->buffer_read_len = 0;
+			flap_connection_schedule_destroy(conn,
+					OSCAR_DISCONNECT_INVALID_DATA, NULL);
+			return FALSE;
+		}
+
+		framelen = aimutil_get16(&buf[4]);
+		if (len < 6 + framelen)
+			/* Waiting for more data to arrive */
+			break;
+
+		/*
+		 * We have a complete FLAP!  Parse it where it is, rather
+		 * than copying it out of the read buffer.
+		 */
+		conn->buffer_incoming.channel = aimutil_get8(&buf[1]);
+		conn->buffer_incoming.seqnum = aimutil_get16(&buf[2]);
+		byte_stream_init(&conn->buffer_incoming.data, buf + 6, framelen);
+		parse_flap(conn->od, conn, &conn->buffer_incoming);
+		conn->lastactivity = time(NULL);
+
+		buf += 6 + framelen;
+		len -= 6 + framelen;
+	}
+
+	if (len > 0 && buf != conn->buffer_read)
+		memmove(conn->buffer_read, buf, len);
+	conn->buffer_read_len = len;
+
+	return TRUE;
+}
+
 /**
  * Read in all available data on the socket for a given connection.
  * All complete FLAPs handled immedate after they're received.
  * Incomplete FLAP data is stored locally and appended to the next
  * time this callback is triggered.
  *
+ * Several FLAPs are read at once when they're available, and the
+ * buffer they're read into is kept for the life of the connection.
+ *
  * This is called by flap_connection_recv_cb and
  * flap_connection_recv_cb_ssl for unencrypted/encrypted connections.
  */
 static void
 flap_connection_recv(FlapConnection *conn)
 {
-	gpointer buf;
 	gsize buflen;
 	gssize read;
 
 	/* Read data until we run out of data and break out of the loop */
 	while (TRUE)
 	{
-		/* Start reading a new FLAP */
-		if (conn->buffer_incoming.data.data == NULL)
+		/* Make sure the FLAP we're in the middle of will fit */
+		buflen = FLAP_CONNECTION_READ_SIZE;
+		if (conn->buffer_read_len >= 6)
+			buflen = MAX(buflen, 6 + aimutil_get16(&conn->buffer_read[4]));
+		if (buflen > conn->buffer_read_size)
 		{
-			buf = conn->header + conn->header_received;
-			buflen = 6 - conn->header_received;
-
-			/* Read the first 6 bytes (the FLAP header) */
-			if (conn->gsc)
-				read = purple_ssl_read(conn->gsc, buf, buflen);
-			else
-				read = recv(conn->fd, buf, buflen, 0);
-
-			/* Check if the FLAP server closed the connection */
-			if (read == 0)
-			{
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_REMOTE_CLOSED, NULL);
-				break;
-			}
-
-			/* If there was an error then close the connection */
-			if (read < 0)
-			{
-				if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
-					/* No worries */
-					break;
-
-				/* Error! */
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_LOST_CONNECTION, g_strerror(errno));
-				break;
-			}
-			purple_connection_update_last_received(conn->od->gc);
-
-			/* If we don't even have a complete FLAP header then do nothing */
-			conn->header_received += read;
-			if (conn->header_received < 6)
-				break;
+			conn->buffer_read = g_realloc(conn->buffer_read, buflen);
+			conn->buffer_read_size = buflen;
+		}
 
-			/* All FLAP frames must start with the byte 0x2a */
-			if (aimutil_get8(&conn->header[0]) != 0x2a)
-			{
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_INVALID_DATA, NULL);
-				break;
-			}
+		buflen = conn->buffer_read_size - conn->buffer_read_len;
+		if (conn->gsc)
+			read = purple_ssl_read(conn->gsc,
+					conn->buffer_read + conn->buffer_read_len, buflen);
+		else
+			read = recv(conn->fd,
+					conn->buffer_read + conn->buffer_read_len, buflen, 0);
 
-			/* Initialize a new temporary FlapFrame for incoming data */
-			conn->buffer_incoming.channel = aimutil_get8(&conn->header[1]);
-			conn->buffer_incoming.seqnum = aimutil_get16(&conn->header[2]);
-			conn->buffer_incoming.data.len = aimutil_get16(&conn->header[4]);
-			conn->buffer_incoming.data.data = g_new(guint8, conn->buffer_incoming.data.len);
-			conn->buffer_incoming.data.offset = 0;
+		/* Check if the FLAP server closed the connection */
+		if (read == 0)
+		{
+			flap_connection_schedule_destroy(conn,
+					OSCAR_DISCONNECT_REMOTE_CLOSED, NULL);
+			break;
 		}
 
-		buflen = conn->buffer_incoming.data.len - conn->buffer_incoming.data.offset;
-		if (buflen)
+		/* If there was an error then close the connection */
+		if (read < 0)
 		{
-			buf = &conn->buffer_incoming.data.data[conn->buffer_incoming.data.offset];
-			/* Read data into the temporary FlapFrame until it is complete */
-			if (conn->gsc)
-				read = purple_ssl_read(conn->gsc, buf, buflen);
-			else
-				read = recv(conn->fd, buf, buflen, 0);
-
-			/* Check if the FLAP server closed the connection */
-			if (read == 0)
-			{
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_REMOTE_CLOSED, NULL);
-				break;
-			}
-
-			if (read < 0)
-			{
-				if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
-					/* No worries */
-					break;
-
-				/* Error! */
-				flap_connection_schedule_destroy(conn,
-						OSCAR_DISCONNECT_LOST_CONNECTION, g_strerror(errno));
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				/* No worries */
 				break;
-			}
 
-			conn->buffer_incoming.data.offset += read;
-			if (conn->buffer_incoming.data.offset < conn->buffer_incoming.data.len)
-				/* Waiting for more data to arrive */
-				break;
+			/* Error! */
+			flap_connection_schedule_destroy(conn,
+					OSCAR_DISCONNECT_LOST_CONNECTION, g_strerror(errno));
+			break;
 		}
+		purple_connection_update_last_received(conn->od->gc);
 
-		/* We have a complete FLAP!  Handle it and continue reading */
-		byte_stream_rewind(&conn->buffer_incoming.data);
-		parse_flap(conn->od, conn, &conn->buffer_incoming);
-		conn->lastactivity = time(NULL);
-
-		g_free(conn->buffer_incoming.data.data);
-		conn->buffer_incoming.data.data = NULL;
-
-		conn->header_received = 0;
+		conn->buffer_read_len += read;
+		if (!flap_connection_parse_read(conn))
+			break;
 	}
 }
 
@@ -1067,11 +1214,9 @@ flap_connection_send_byte_stream(ByteStream *bs, FlapConnection *conn, size_t co
 	if (count > byte_stream_bytes_left(bs))
 		count = byte_stream_bytes_left(bs); /* truncate to remaining space */
 
-	if (count == 0)
-		return;
-
 	/* Add everything to our outgoing buffer */
-	purple_circular_buffer_append(conn->buffer_outgoing, bs->data, count);
+	if (count > 0)
+		purple_circular_buffer_append(conn->buffer_outgoing, bs->data, count);
 
 	/* If we haven't already started writing stuff, then start the cycle */
 	if (conn->watcher_outgoing == 0)
@@ -1091,28 +1236,23 @@ flap_connection_send_byte_stream(ByteStream *bs, FlapConnection *conn, size_t co
 static void
 sendframe_flap(FlapConnection *conn, FlapFrame *frame)
 {
+	guint8 header[6];
 	ByteStream bs;
-	int payloadlen, bslen;
+	int payloadlen;
 
 	payloadlen = byte_stream_curpos(&frame->data);
 
-	byte_stream_new(&bs, 6 + payloadlen);
-
 	/* FLAP header */
+	byte_stream_init(&bs, header, sizeof(header));
 	byte_stream_put8(&bs, 0x2a);
 	byte_stream_put8(&bs, frame->channel);
 	byte_stream_put16(&bs, frame->seqnum);
 	byte_stream_put16(&bs, payloadlen);
+	purple_circular_buffer_append(conn->buffer_outgoing, header, sizeof(header));
 
-	/* Payload */
+	/* Payload, straight from the frame */
 	byte_stream_rewind(&frame->data);
-	byte_stream_putbs(&bs, &frame->data, payloadlen);
-
-	bslen = byte_stream_curpos(&bs);
-	byte_stream_rewind(&bs);
-	flap_connection_send_byte_stream(&bs, conn, bslen);
-
-	byte_stream_destroy(&bs);
+	flap_connection_send_byte_stream(&frame->data, conn, payloadlen);
 }
 
 void
@@ -1120,5 +1260,5 @@ flap_connection_send(FlapConnection *conn, FlapFrame *frame)
 {
 	frame->seqnum = ++(conn->seqnum_out);
 	sendframe_flap(conn, frame);
-	flap_frame_destroy(frame);
+	flap_frame_destroy(conn->od, frame);
 }
@@ -66,6 +66,7 @@ typedef struct _ByteStream         ByteStream;
 typedef struct _ClientInfo         ClientInfo;
 typedef struct _FlapConnection     FlapConnection;
 typedef struct _FlapFrame          FlapFrame;
+typedef struct _FlapRateStats      FlapRateStats;
 typedef struct _IcbmArgsCh2        IcbmArgsCh2;
 typedef struct _IcbmCookie         IcbmCookie;
 typedef struct _OscarData          OscarData;
@@ -81,6 +82,25 @@ extern "C" {
 
 #define FAIM_SNAC_HASH_SIZE 16
 
+/*
+ * SNAC families below this are dispatched through OscarData.modtable.
+ * All the families we have modules for are well under it.
+ */
+#define AIM_MODULE_FAMILIES 0x0040
+
+/*
+ * How many sent FlapFrames each session keeps around for reuse, and
+ * the largest payload buffer it will hold on to.
+ */
+#define OSCAR_FRAME_POOL_SIZE 16
+#define OSCAR_FRAME_POOL_MAX_DATA 8192
+
+/*
+ * How much we try to read from a FLAP connection at once.  Reading
+ * more than one FLAP at a time saves a couple of reads per FLAP.
+ */
+#define FLAP_CONNECTION_READ_SIZE 4096
+
 /*
  * Current Maximum Length for usernames (not including NULL)
  *
@@ -278,6 +298,7 @@ struct _FlapFrame
 	guint8 channel;
 	guint16 seqnum;
 	ByteStream data;        /* payload stream */
+	size_t size;            /* bytes allocated for data.data */
 };
 
 struct _FlapConnection
@@ -298,9 +319,10 @@ struct _FlapConnection
 
 	int fd;
 	PurpleSslConnection *gsc;
-	guint8 header[6];
-	gssize header_received;
-	FlapFrame buffer_incoming;
+	guint8 *buffer_read;        /**< Data read from the server that hasn't been parsed yet. */
+	gsize buffer_read_size;     /**< Bytes allocated for buffer_read. */
+	gsize buffer_read_len;      /**< Bytes of buffer_read in use. */
+	FlapFrame buffer_incoming;  /**< The FLAP being parsed, pointing into buffer_read. */
 	PurpleCircularBuffer *buffer_outgoing;
 	guint watcher_incoming;
 	guint watcher_outgoing;
@@ -314,9 +336,7 @@ struct _FlapConnection
 	struct rateclass *default_rateclass;
 	GHashTable *rateclass_members; /* Key is family and subtype, value is pointer to the rateclass struct to use. */
 
-	GQueue *queued_snacs; /**< Contains QueuedSnacs. */
-	GQueue *queued_lowpriority_snacs; /**< Contains QueuedSnacs to send only once queued_snacs is empty */
-	guint queued_timeout;
+	guint queued_timeout; /**< When the next queued SNAC can be sent. */
 
 	void *internal; /* internal conn-specific libfaim data */
 };
@@ -336,6 +356,8 @@ struct aim_ssi_itemlist {
 	struct aim_ssi_item *data;
 	GHashTable *idx_gid_bid;
 	GHashTable *idx_all_named_items;
+	GHashTable *idx_group_buddies;
+	GHashTable *dirty;
 };
 
 /**
@@ -382,6 +404,12 @@ struct _OscarData
 	PurpleConnection *gc;
 
 	void *modlistv;
+	struct aim_module_s *modtable[AIM_MODULE_FAMILIES]; /**< The module for each family, from modlistv. */
+	GSList *modmulti; /**< The AIM_MODFLAG_MULTIFAMILY modules, in modlistv order. */
+
+	/* Sent FlapFrames for flap_frame_new() to hand out again */
+	FlapFrame *frame_pool[OSCAR_FRAME_POOL_SIZE];
+	guint frame_pool_len;
 
 	/*
 	 * Outstanding snac handling
@@ -419,6 +447,7 @@ struct _OscarData
 		struct aim_ssi_itemlist official;
 		struct aim_ssi_itemlist local;
 		struct aim_ssi_tmp *pending;
+		struct aim_ssi_tmp *pending_tail;
 		time_t timestamp;
 		gboolean waiting_for_ack;
 		gboolean in_transaction;
@@ -548,7 +577,10 @@ void flap_connection_send_version_with_cookie_and_clientinfo(OscarData *od, Flap
 void flap_connection_send_snac(OscarData *od, FlapConnection *conn, guint16 family, const guint16 subtype, aim_snacid_t snacid, ByteStream *data);
 void flap_connection_send_snac_with_priority(OscarData *od, FlapConnection *conn, guint16 family, const guint16 subtype, aim_snacid_t snacid, ByteStream *data, gboolean high_priority);
 void flap_connection_send_keepalive(OscarData *od, FlapConnection *conn);
+void flap_connection_send_queued_snacs(FlapConnection *conn);
+gboolean flap_connection_get_rate_stats(FlapConnection *conn, guint16 family, guint16 subtype, FlapRateStats *stats);
 FlapFrame *flap_frame_new(OscarData *od, guint16 channel, int datalen);
+void flap_frame_pool_free(OscarData *od);
 
 /* oscar_data.c */
 typedef int (*aim_rxcallback_t)(OscarData *od, FlapConnection *conn, FlapFrame *frame, ...);
@@ -932,6 +964,8 @@ struct aim_ssi_tmp
 	guint16 action;
 	guint16 ack;
 	char *name;
+	guint16 gid;
+	guint16 bid;
 	struct aim_ssi_item *item;
 	struct aim_ssi_tmp *next;
 };
@@ -1307,6 +1341,9 @@ struct chatsnacinfo {
 	guint16 instance;
 };
 
+#define RATECLASS_QUEUE_HIGH 0
+#define RATECLASS_QUEUE_LOW  1
+
 struct rateclass {
 	guint16 classid;
 	guint32 windowsize;
@@ -1318,7 +1355,30 @@ struct rateclass {
 	guint32 max;
 	guint8 dropping_snacs;
 
-	struct timeval last; /**< The time when we last sent a SNAC of this rate class. */
+	gint64 last; /**< The monotonic time in milliseconds when we last sent a SNAC of this rate class. */
+
+	/**
+	 * QueuedSnacs waiting for this rate class.  Low priority SNACs
+	 * are only sent once there are no high priority ones.
+	 */
+	GQueue queued[2];
+
+	guint throttled; /**< How many SNACs have had to wait for this rate class. */
+	guint max_queued; /**< The most SNACs that have waited at once. */
+	gint64 throttled_since; /**< When the current backlog started, or 0 if there isn't one. */
+	gint64 throttled_time; /**< How many milliseconds this rate class has had a backlog. */
+};
+
+/**
+ * A snapshot of a rate class, see flap_connection_get_rate_stats().
+ */
+struct _FlapRateStats {
+	guint16 classid;
+	guint queued_high; /**< High priority SNACs waiting right now. */
+	guint queued_low; /**< Low priority SNACs waiting right now. */
+	guint throttled; /**< How many SNACs have had to wait. */
+	guint max_queued; /**< The most SNACs that have waited at once. */
+	gint64 throttled_time; /**< Milliseconds spent with a backlog, including the current one. */
 };
 
 int aim_cachecookie(OscarData *od, IcbmCookie *cookie);
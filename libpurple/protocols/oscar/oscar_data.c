@@ -48,10 +48,14 @@ oscar_data_new(void)
 	od->handlerlist = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
 
 	od->ssi.local.idx_gid_bid = g_hash_table_new(g_direct_hash, g_direct_equal);
-	od->ssi.local.idx_all_named_items = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	od->ssi.local.idx_all_named_items = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_queue_free);
+	od->ssi.local.idx_group_buddies = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_queue_free);
+	/* Only changes to the local list need to be sent to the server */
+	od->ssi.local.dirty = g_hash_table_new(g_direct_hash, g_direct_equal);
 
 	od->ssi.official.idx_gid_bid = g_hash_table_new(g_direct_hash, g_direct_equal);
-	od->ssi.official.idx_all_named_items = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	od->ssi.official.idx_all_named_items = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_queue_free);
+	od->ssi.official.idx_group_buddies = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_queue_free);
 
 	/*
 	 * Register all the modules for this session...
@@ -126,6 +130,8 @@ oscar_data_destroy(OscarData *od)
 		peer_connection_destroy(od->peer_connections->data,
 				OSCAR_DISCONNECT_LOCAL_CLOSED, NULL);
 
+	flap_frame_pool_free(od);
+
 	aim__shutdownmodules(od);
 
 	g_hash_table_destroy(od->buddyinfo);
@@ -133,9 +139,12 @@ oscar_data_destroy(OscarData *od)
 
 	g_hash_table_destroy(od->ssi.local.idx_gid_bid);
 	g_hash_table_destroy(od->ssi.local.idx_all_named_items);
+	g_hash_table_destroy(od->ssi.local.idx_group_buddies);
+	g_hash_table_destroy(od->ssi.local.dirty);
 
 	g_hash_table_destroy(od->ssi.official.idx_gid_bid);
 	g_hash_table_destroy(od->ssi.official.idx_all_named_items);
+	g_hash_table_destroy(od->ssi.official.idx_group_buddies);
 
 	g_free(od);
 }
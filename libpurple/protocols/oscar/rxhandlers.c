@@ -25,6 +25,9 @@ aim_module_t *aim__findmodulebygroup(OscarData *od, guint16 group)
 {
 	aim_module_t *cur;
 
+	if (group < AIM_MODULE_FAMILIES)
+		return od->modtable[group];
+
 	for (cur = (aim_module_t *)od->modlistv; cur; cur = cur->next) {
 		if (cur->family == group)
 			return cur;
@@ -69,6 +72,15 @@ int aim__registermodule(OscarData *od, int (*modfirst)(OscarData *, aim_module_t
 	mod->next = (aim_module_t *)od->modlistv;
 	od->modlistv = mod;
 
+	/*
+	 * Like the list, the most recently registered module wins if two
+	 * of them claim the same family.
+	 */
+	if (mod->flags & AIM_MODFLAG_MULTIFAMILY)
+		od->modmulti = g_slist_prepend(od->modmulti, mod);
+	else if (mod->family < AIM_MODULE_FAMILIES)
+		od->modtable[mod->family] = mod;
+
 	return 0;
 }
 
@@ -90,6 +102,9 @@ void aim__shutdownmodules(OscarData *od)
 	}
 
 	od->modlistv = NULL;
+	memset(od->modtable, 0, sizeof(od->modtable));
+	g_slist_free(od->modmulti);
+	od->modmulti = NULL;
 
 	return;
 }
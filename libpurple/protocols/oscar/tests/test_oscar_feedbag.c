@@ -0,0 +1,291 @@
+#include <glib.h>
+
+#include "../oscar.h"
+
+#define TEST_OSCAR_FEEDBAG_GROUPS 50
+#define TEST_OSCAR_FEEDBAG_BUDDIES 5000
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static OscarData *
+test_oscar_feedbag_new(void) {
+	OscarData *od = oscar_data_new();
+
+	od->ssi.received_data = TRUE;
+
+	return od;
+}
+
+static gchar *
+test_oscar_feedbag_group(guint i) {
+	return g_strdup_printf("Group %u", i % TEST_OSCAR_FEEDBAG_GROUPS);
+}
+
+static gchar *
+test_oscar_feedbag_buddy(guint i) {
+	return g_strdup_printf("%u", 100000000 + i);
+}
+
+/* Acks everything in the SNAC we're waiting on, like the server would. */
+static guint
+test_oscar_feedbag_ack(OscarData *od, guint16 *action) {
+	aim_module_t *mod = aim__findmodule(od, "feedbag");
+	aim_modsnac_t snac = {
+		SNAC_FAMILY_FEEDBAG, SNAC_SUBTYPE_FEEDBAG_SRVACK, 0, 0
+	};
+	struct aim_ssi_tmp *cur;
+	ByteStream bs;
+	guint i, count = 0;
+
+	g_assert_nonnull(mod);
+	g_assert_true(od->ssi.waiting_for_ack);
+	g_assert_nonnull(od->ssi.pending);
+
+	/* One kind of change per SNAC. */
+	*action = od->ssi.pending->action;
+	for (cur = od->ssi.pending; cur->next; cur = cur->next) {
+		g_assert_cmpint(*action, ==, cur->action);
+		count++;
+	}
+	g_assert_true(cur == od->ssi.pending_tail);
+	count++;
+
+	byte_stream_new(&bs, count * 2);
+	for (i = 0; i < count; i++)
+		byte_stream_put16(&bs, 0x0000);
+	byte_stream_rewind(&bs);
+
+	mod->snachandler(od, NULL, mod, NULL, &snac, &bs);
+
+	byte_stream_destroy(&bs);
+
+	return count;
+}
+
+/* Acks SNACs until both lists agree, and returns how many it took. */
+static guint
+test_oscar_feedbag_settle(OscarData *od, guint *changes, guint *dels,
+                          guint *adds, guint *mods)
+{
+	guint16 action, last = SNAC_SUBTYPE_FEEDBAG_DEL;
+	guint count, snacs = 0;
+
+	*changes = *dels = *adds = *mods = 0;
+
+	while (od->ssi.pending) {
+		count = test_oscar_feedbag_ack(od, &action);
+
+		/* Deletions, then additions, then modifications. */
+		if (action == SNAC_SUBTYPE_FEEDBAG_DEL) {
+			g_assert_cmpint(last, ==, SNAC_SUBTYPE_FEEDBAG_DEL);
+			*dels += count;
+		} else if (action == SNAC_SUBTYPE_FEEDBAG_ADD) {
+			g_assert_cmpint(last, !=, SNAC_SUBTYPE_FEEDBAG_MOD);
+			*adds += count;
+		} else {
+			g_assert_cmpint(action, ==, SNAC_SUBTYPE_FEEDBAG_MOD);
+			*mods += count;
+		}
+		last = action;
+
+		*changes += count;
+		snacs++;
+	}
+
+	g_assert_false(od->ssi.waiting_for_ack);
+	g_assert_null(od->ssi.pending_tail);
+	g_assert_cmpint(0, ==, g_hash_table_size(od->ssi.local.dirty));
+
+	return snacs;
+}
+
+static void
+test_oscar_feedbag_assert_group(struct aim_ssi_itemlist *list,
+                                const gchar *gn, guint count)
+{
+	struct aim_ssi_item *group;
+	aim_tlv_t *tlv;
+
+	group = aim_ssi_itemlist_finditem(list, gn, NULL, AIM_SSI_TYPE_GROUP);
+	g_assert_nonnull(group);
+
+	tlv = aim_tlv_gettlv(group->data, 0x00c8, 1);
+	g_assert_nonnull(tlv);
+	g_assert_cmpint(count * 2, ==, tlv->length);
+}
+
+static void
+test_oscar_feedbag_add_all(OscarData *od) {
+	guint i;
+
+	for (i = 0; i < TEST_OSCAR_FEEDBAG_BUDDIES; i++) {
+		gchar *gn = test_oscar_feedbag_group(i);
+		gchar *bn = test_oscar_feedbag_buddy(i);
+
+		aim_ssi_addbuddy(od, bn, gn, NULL, NULL, NULL, NULL, FALSE);
+
+		g_free(bn);
+		g_free(gn);
+	}
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_oscar_feedbag_finditem(void) {
+	OscarData *od = test_oscar_feedbag_new();
+	struct aim_ssi_item *item1, *item2;
+
+	aim_ssi_addbuddy(od, "Some Buddy", "Friends", NULL, NULL, NULL, NULL,
+	                 FALSE);
+	aim_ssi_addbuddy(od, "somebuddy", "Work", NULL, NULL, NULL, NULL, FALSE);
+
+	/* Names are compared like oscar_util_name_compare() does. */
+	item1 = aim_ssi_itemlist_finditem(&od->ssi.local, "friends", "SOMEBUDDY",
+	                                  AIM_SSI_TYPE_BUDDY);
+	item2 = aim_ssi_itemlist_finditem(&od->ssi.local, "Work", "Some Buddy",
+	                                  AIM_SSI_TYPE_BUDDY);
+	g_assert_nonnull(item1);
+	g_assert_nonnull(item2);
+	g_assert_true(item1 != item2);
+	g_assert_cmpint(item1->gid, !=, item2->gid);
+	g_assert_null(aim_ssi_itemlist_finditem(&od->ssi.local, "Nobody",
+	                                        "Some Buddy", AIM_SSI_TYPE_BUDDY));
+
+	/* The buddy is still on the list after leaving one of the groups. */
+	g_assert_true(aim_ssi_itemlist_exists(&od->ssi.local, "somebuddy") == item1);
+	aim_ssi_delbuddy(od, "somebuddy", "Friends");
+	g_assert_null(aim_ssi_itemlist_finditem(&od->ssi.local, "Friends",
+	                                        "somebuddy", AIM_SSI_TYPE_BUDDY));
+	g_assert_true(aim_ssi_itemlist_exists(&od->ssi.local, "somebuddy") == item2);
+	g_assert_cmpstr("Work", ==,
+	                aim_ssi_itemlist_findparentname(&od->ssi.local, "somebuddy"));
+
+	oscar_data_destroy(od);
+}
+
+static void
+test_oscar_feedbag_sync(void) {
+	OscarData *od = test_oscar_feedbag_new();
+	guint changes, dels, adds, mods, snacs;
+	gchar *gn, *bn;
+	guint i;
+
+	test_oscar_feedbag_add_all(od);
+
+	/* The first SNAC went out with the first buddy. */
+	g_assert_true(od->ssi.waiting_for_ack);
+	snacs = test_oscar_feedbag_settle(od, &changes, &dels, &adds, &mods);
+
+	/* The buddies, their groups and the master group, many to a SNAC. */
+	g_assert_cmpint(0, ==, dels);
+	g_assert_cmpint(TEST_OSCAR_FEEDBAG_BUDDIES + TEST_OSCAR_FEEDBAG_GROUPS + 1,
+	                ==, adds);
+	g_assert_cmpint(changes / 15, >, snacs);
+
+	for (i = 0; i < TEST_OSCAR_FEEDBAG_BUDDIES; i++) {
+		gn = test_oscar_feedbag_group(i);
+		bn = test_oscar_feedbag_buddy(i);
+		g_assert_nonnull(aim_ssi_itemlist_finditem(&od->ssi.official, gn, bn,
+			AIM_SSI_TYPE_BUDDY));
+		g_free(bn);
+		g_free(gn);
+	}
+	for (i = 0; i < TEST_OSCAR_FEEDBAG_GROUPS; i++) {
+		gn = test_oscar_feedbag_group(i);
+		test_oscar_feedbag_assert_group(&od->ssi.official, gn,
+			TEST_OSCAR_FEEDBAG_BUDDIES / TEST_OSCAR_FEEDBAG_GROUPS);
+		g_free(gn);
+	}
+
+	/* Nothing changed, so there is nothing to send. */
+	aim_ssi_aliasbuddy(od, "Group 0", "100000000", NULL);
+	g_assert_null(od->ssi.pending);
+
+	/* Only what changed gets sent. */
+	aim_ssi_aliasbuddy(od, "Group 7", "100000007", "Seven");
+	snacs = test_oscar_feedbag_settle(od, &changes, &dels, &adds, &mods);
+	g_assert_cmpint(1, ==, snacs);
+	g_assert_cmpint(1, ==, mods);
+
+	/* Move every buddy in one group to the next one. */
+	for (i = 1; i < TEST_OSCAR_FEEDBAG_BUDDIES; i += TEST_OSCAR_FEEDBAG_GROUPS) {
+		bn = test_oscar_feedbag_buddy(i);
+		aim_ssi_movebuddy(od, "Group 1", "Group 2", bn);
+		g_free(bn);
+	}
+	snacs = test_oscar_feedbag_settle(od, &changes, &dels, &adds, &mods);
+	g_assert_cmpint(TEST_OSCAR_FEEDBAG_BUDDIES / TEST_OSCAR_FEEDBAG_GROUPS, ==,
+	                dels);
+	g_assert_cmpint(TEST_OSCAR_FEEDBAG_BUDDIES / TEST_OSCAR_FEEDBAG_GROUPS, ==,
+	                adds);
+	g_assert_cmpint(2, ==, mods);
+
+	for (i = 1; i < TEST_OSCAR_FEEDBAG_BUDDIES; i += TEST_OSCAR_FEEDBAG_GROUPS) {
+		bn = test_oscar_feedbag_buddy(i);
+		g_assert_null(aim_ssi_itemlist_finditem(&od->ssi.official, "Group 1",
+			bn, AIM_SSI_TYPE_BUDDY));
+		g_assert_nonnull(aim_ssi_itemlist_finditem(&od->ssi.official,
+			"Group 2", bn, AIM_SSI_TYPE_BUDDY));
+		g_free(bn);
+	}
+	test_oscar_feedbag_assert_group(&od->ssi.official, "Group 2",
+		2 * TEST_OSCAR_FEEDBAG_BUDDIES / TEST_OSCAR_FEEDBAG_GROUPS);
+
+	oscar_data_destroy(od);
+}
+
+static void
+test_oscar_feedbag_performance(void) {
+	OscarData *od = test_oscar_feedbag_new();
+	guint changes, dels, adds, mods, snacs;
+	gdouble elapsed;
+	guint i;
+
+	g_test_timer_start();
+
+	test_oscar_feedbag_add_all(od);
+	snacs = test_oscar_feedbag_settle(od, &changes, &dels, &adds, &mods);
+
+	for (i = 0; i < TEST_OSCAR_FEEDBAG_BUDDIES; i += 2) {
+		gchar *gn = test_oscar_feedbag_group(i);
+		gchar *newgn = test_oscar_feedbag_group(i + 1);
+		gchar *bn = test_oscar_feedbag_buddy(i);
+
+		aim_ssi_movebuddy(od, gn, newgn, bn);
+
+		g_free(bn);
+		g_free(newgn);
+		g_free(gn);
+	}
+	snacs += test_oscar_feedbag_settle(od, &changes, &dels, &adds, &mods);
+
+	elapsed = g_test_timer_elapsed();
+
+	g_test_minimized_result(elapsed,
+		"%u buddies added and half of them moved: %.3f s, %u SNACs",
+		TEST_OSCAR_FEEDBAG_BUDDIES, elapsed, snacs);
+
+	oscar_data_destroy(od);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/oscar/feedbag/finditem",
+	                test_oscar_feedbag_finditem);
+	g_test_add_func("/oscar/feedbag/sync",
+	                test_oscar_feedbag_sync);
+	if (g_test_perf()) {
+		g_test_add_func("/oscar/feedbag/performance",
+		                test_oscar_feedbag_performance);
+	}
+
+	return g_test_run();
+}
@@ -0,0 +1,686 @@
+#include <glib.h>
+#include <glib-unix.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <purple.h>
+
+#include "tests/test_ui.h"
+#include "../oscar.h"
+
+/* The SNACs each handler was called for, by family and subtype. */
+static GHashTable *test_oscar_flap_handled = NULL;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static int
+test_oscar_flap_handled_cb(OscarData *od, FlapConnection *conn,
+                           FlapFrame *frame, ...)
+{
+	gpointer key;
+
+	/* The SNAC header is still at the start of the frame. */
+	key = GUINT_TO_POINTER((aimutil_get16(frame->data.data) << 16) +
+	                       aimutil_get16(frame->data.data + 2));
+	g_hash_table_insert(test_oscar_flap_handled, key, GUINT_TO_POINTER(
+		GPOINTER_TO_UINT(g_hash_table_lookup(test_oscar_flap_handled,
+		                                     key)) + 1));
+
+	return 1;
+}
+
+/* Sets up a FLAP connection with the server end of a socket pair. */
+static FlapConnection *
+test_oscar_flap_connect(const gchar *username, gint *server) {
+	FlapConnection *conn;
+	OscarData *od;
+	gint fds[2];
+
+	od = oscar_data_new();
+	od->gc = test_ui_connect(username);
+
+	oscar_data_addhandler(od, SNAC_FAMILY_BUDDY, SNAC_SUBTYPE_BUDDY_ONCOMING,
+	                      test_oscar_flap_handled_cb, 0);
+	oscar_data_addhandler(od, SNAC_FAMILY_BUDDY, SNAC_SUBTYPE_BUDDY_OFFGOING,
+	                      test_oscar_flap_handled_cb, 0);
+	oscar_data_addhandler(od, SNAC_FAMILY_ICBM, 0x0007,
+	                      test_oscar_flap_handled_cb, 0);
+	oscar_data_addhandler(od, SNAC_FAMILY_ICBM, 0x0014,
+	                      test_oscar_flap_handled_cb, 0);
+	/* Nothing handles this family, so misc's error handler gets it. */
+	oscar_data_addhandler(od, 0x0022, 0x0001,
+	                      test_oscar_flap_handled_cb, 0);
+
+	g_assert_cmpint(0, ==, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	g_assert_true(g_unix_set_fd_nonblocking(fds[0], TRUE, NULL));
+	g_assert_true(g_unix_set_fd_nonblocking(fds[1], TRUE, NULL));
+
+	conn = flap_connection_new(od, SNAC_FAMILY_LOCATE);
+	conn->fd = fds[0];
+	*server = fds[1];
+
+	return conn;
+}
+
+static void
+test_oscar_flap_disconnect(FlapConnection *conn, gint server) {
+	OscarData *od = conn->od;
+	PurpleConnection *gc = od->gc;
+
+	oscar_data_destroy(od);
+	close(server);
+
+	while (g_main_context_iteration(NULL, FALSE));
+
+	test_ui_disconnect(gc);
+}
+
+/* Feeds data like the server would, in writes of at most chunk bytes. */
+static void
+test_oscar_flap_feed(FlapConnection *conn, gint server, const guint8 *data,
+                     gsize len, gsize chunk)
+{
+	while (len > 0) {
+		gssize n = write(server, data, MIN(chunk, len));
+
+		g_assert_cmpint(n, >, 0);
+		flap_connection_recv_cb(conn, conn->fd, PURPLE_INPUT_READ);
+
+		data += n;
+		len -= n;
+	}
+}
+
+/* Counts the frames in a capture, and the SNACs by family and subtype.
+ * largest is set to the length of the longest frame, header included. */
+static guint
+test_oscar_flap_tally(const guint8 *data, gsize len, GHashTable *snacs,
+                      gsize *largest)
+{
+	guint frames = 0;
+
+	if (largest != NULL)
+		*largest = 0;
+
+	while (len >= 6) {
+		gsize framelen = aimutil_get16(data + 4);
+
+		g_assert_cmpint(0x2a, ==, data[0]);
+		g_assert_cmpint(len, >=, 6 + framelen);
+		if (largest != NULL)
+			*largest = MAX(*largest, 6 + framelen);
+
+		if (snacs != NULL && data[1] == 0x02) {
+			gpointer key = GUINT_TO_POINTER(
+				(aimutil_get16(data + 6) << 16) + aimutil_get16(data + 8));
+
+			g_hash_table_insert(snacs, key, GUINT_TO_POINTER(
+				GPOINTER_TO_UINT(g_hash_table_lookup(snacs, key)) + 1));
+		}
+
+		data += 6 + framelen;
+		len -= 6 + framelen;
+		frames++;
+	}
+
+	g_assert_cmpint(0, ==, len);
+
+	return frames;
+}
+
+static void
+test_oscar_flap_put_frame(GByteArray *capture, guint8 channel,
+                          const guint8 *data, gsize len)
+{
+	static guint16 seqnum = 0;
+	guint8 header[6] = {
+		0x2a, channel, seqnum >> 8, seqnum & 0xff, len >> 8, len & 0xff
+	};
+
+	seqnum++;
+	g_byte_array_append(capture, header, sizeof(header));
+	g_byte_array_append(capture, data, len);
+}
+
+/* Appends a SNAC with the data in bs, and frees bs. */
+static void
+test_oscar_flap_put_snac(GByteArray *capture, guint16 family, guint16 subtype,
+                         aim_snacid_t snacid, ByteStream *bs)
+{
+	ByteStream snac;
+
+	byte_stream_new(&snac, 10 + byte_stream_curpos(bs));
+	byte_stream_put16(&snac, family);
+	byte_stream_put16(&snac, subtype);
+	byte_stream_put16(&snac, 0x0000);
+	byte_stream_put32(&snac, snacid);
+	byte_stream_putraw(&snac, bs->data, byte_stream_curpos(bs));
+
+	test_oscar_flap_put_frame(capture, 0x02, snac.data,
+	                          byte_stream_curpos(&snac));
+
+	byte_stream_destroy(&snac);
+	byte_stream_destroy(bs);
+}
+
+/* The user info block that starts buddy and ICBM SNACs. */
+static void
+test_oscar_flap_put_userinfo(ByteStream *bs, const gchar *bn) {
+	byte_stream_put8(bs, strlen(bn));
+	byte_stream_putstr(bs, bn);
+	byte_stream_put16(bs, 0x0000); /* Warning level */
+	byte_stream_put16(bs, 2);
+	byte_stream_put16(bs, 0x0001); /* User class */
+	byte_stream_put16(bs, 2);
+	byte_stream_put16(bs, 0x0050);
+	byte_stream_put16(bs, 0x0003); /* Online since */
+	byte_stream_put16(bs, 4);
+	byte_stream_put32(bs, 1500000000);
+}
+
+/* An IM on channel 1, with a text of len bytes. */
+static void
+test_oscar_flap_put_im(GByteArray *capture, aim_snacid_t snacid,
+                       const gchar *bn, gsize len)
+{
+	ByteStream bs;
+	gsize i;
+
+	byte_stream_new(&bs, 64 + strlen(bn) + len);
+	byte_stream_put32(&bs, snacid); /* Cookie */
+	byte_stream_put32(&bs, 0);
+	byte_stream_put16(&bs, 0x0001);
+	test_oscar_flap_put_userinfo(&bs, bn);
+
+	byte_stream_put16(&bs, 0x0002); /* Message block */
+	byte_stream_put16(&bs, 5 + 8 + len);
+	byte_stream_put16(&bs, 0x0501); /* Features */
+	byte_stream_put16(&bs, 1);
+	byte_stream_put8(&bs, 0x01);
+	byte_stream_put16(&bs, 0x0101); /* Text, ASCII */
+	byte_stream_put16(&bs, 4 + len);
+	byte_stream_put16(&bs, 0x0000);
+	byte_stream_put16(&bs, 0x0000);
+	for (i = 0; i < len; i++)
+		byte_stream_put8(&bs, 'a' + i % 26);
+
+	test_oscar_flap_put_snac(capture, SNAC_FAMILY_ICBM, 0x0007, snacid, &bs);
+}
+
+/* Builds the FLAPs a busy buddy list gets: mostly buddies coming and going,
+ * typing notifications and IMs, with the odd keepalive and error.  One IM is
+ * longer than a read, so it has to be put together from several. */
+static guint8 *
+test_oscar_flap_capture(gsize *len) {
+	const guint8 hello[] = { 0x00, 0x00, 0x00, 0x01 };
+	GByteArray *capture = g_byte_array_new();
+	guint i;
+
+	test_oscar_flap_put_frame(capture, 0x01, hello, sizeof(hello));
+
+	for (i = 0; i < 1450; i++) {
+		gchar *bn = g_strdup_printf("%u", 100000000 + i % 97);
+		ByteStream bs;
+
+		switch (i % 12) {
+			case 0:
+			case 1:
+			case 2:
+			case 3:
+				byte_stream_new(&bs, 64 + strlen(bn));
+				test_oscar_flap_put_userinfo(&bs, bn);
+				test_oscar_flap_put_snac(capture, SNAC_FAMILY_BUDDY,
+					(i % 12 == 3) ? SNAC_SUBTYPE_BUDDY_OFFGOING :
+					SNAC_SUBTYPE_BUDDY_ONCOMING, i, &bs);
+				break;
+			case 4:
+			case 5:
+			case 6:
+			case 7:
+				byte_stream_new(&bs, 16 + strlen(bn));
+				byte_stream_put32(&bs, i); /* Cookie */
+				byte_stream_put32(&bs, 0);
+				byte_stream_put16(&bs, 0x0001);
+				byte_stream_put8(&bs, strlen(bn));
+				byte_stream_putstr(&bs, bn);
+				byte_stream_put16(&bs, i % 3); /* Typing event */
+				test_oscar_flap_put_snac(capture, SNAC_FAMILY_ICBM, 0x0014,
+				                         i, &bs);
+				break;
+			case 8:
+			case 9:
+			case 10:
+				test_oscar_flap_put_im(capture, i, bn,
+				                       (i == 704) ? 10000 : 1 + i * 37 % 300);
+				break;
+			default:
+				if (i % 120 == 11) {
+					byte_stream_new(&bs, 2);
+					byte_stream_put16(&bs, 0x0004);
+					test_oscar_flap_put_snac(capture, 0x0022, 0x0001, i, &bs);
+				} else {
+					test_oscar_flap_put_frame(capture, 0x05, NULL, 0);
+				}
+				break;
+		}
+
+		g_free(bn);
+	}
+
+	*len = capture->len;
+
+	return g_byte_array_free(capture, FALSE);
+}
+
+/* A rate class that starts out full, like the server sends them.  The
+ * levels are far enough apart that which SNACs have to wait doesn't
+ * depend on how long the test takes between sends. */
+static struct rateclass *
+test_oscar_flap_rateclass(FlapConnection *conn, guint16 classid) {
+	struct rateclass *rateclass = g_new0(struct rateclass, 1);
+
+	rateclass->classid = classid;
+	rateclass->windowsize = 2;
+	rateclass->alert = 2000;
+	rateclass->clear = 8000;
+	rateclass->limit = 1000;
+	rateclass->disconnect = 500;
+	rateclass->max = 40000;
+	rateclass->current = rateclass->max;
+	rateclass->last = g_get_monotonic_time() / 1000;
+
+	conn->rateclasses = g_slist_append(conn->rateclasses, rateclass);
+
+	return rateclass;
+}
+
+static void
+test_oscar_flap_send_empty(FlapConnection *conn, guint16 family,
+                           aim_snacid_t snacid, gboolean high_priority)
+{
+	flap_connection_send_snac_with_priority(conn->od, conn, family, 0x0006,
+	                                        snacid, NULL, high_priority);
+}
+
+static gboolean
+test_oscar_flap_expired(gpointer data) {
+	gboolean *expired = data;
+
+	*expired = TRUE;
+
+	return FALSE;
+}
+
+/* Runs the main loop until every queued SNAC has been sent. */
+static void
+test_oscar_flap_drain(FlapConnection *conn) {
+	gboolean expired = FALSE;
+	guint guard;
+
+	guard = g_timeout_add_seconds(10, test_oscar_flap_expired, &expired);
+	while (conn->queued_timeout != 0 && !expired)
+		g_main_context_iteration(NULL, TRUE);
+	g_assert_false(expired);
+	g_source_remove(guard);
+
+	while (g_main_context_iteration(NULL, FALSE));
+}
+
+/* Reads what was sent, and returns the SNAC IDs in the order they went. */
+static GArray *
+test_oscar_flap_sent(gint server) {
+	GArray *ids = g_array_new(FALSE, FALSE, sizeof(guint32));
+	guint8 buf[1024];
+	gsize len = 0, i = 0;
+	gssize n;
+
+	while ((n = read(server, buf + len, sizeof(buf) - len)) > 0)
+		len += n;
+
+	while (i + 16 <= len) {
+		guint32 snacid = aimutil_get32(buf + i + 12);
+
+		g_array_append_val(ids, snacid);
+		i += 6 + aimutil_get16(buf + i + 4);
+	}
+	g_assert_cmpint(i, ==, len);
+
+	return ids;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_oscar_flap_modules(void) {
+	OscarData *od = oscar_data_new();
+	aim_module_t *cur;
+
+	/* Each family's module is in the table, and misc takes the rest. */
+	for (cur = od->modlistv; cur; cur = cur->next) {
+		if (cur->flags & AIM_MODFLAG_MULTIFAMILY) {
+			g_assert_nonnull(g_slist_find(od->modmulti, cur));
+			continue;
+		}
+
+		g_assert_cmpint(cur->family, <, AIM_MODULE_FAMILIES);
+		g_assert_true(aim__findmodulebygroup(od, cur->family) == cur);
+	}
+
+	g_assert_true(aim__findmodulebygroup(od, SNAC_FAMILY_FEEDBAG) ==
+	              aim__findmodule(od, "feedbag"));
+	g_assert_null(aim__findmodulebygroup(od, 0x0022));
+	g_assert_null(od->modmulti->next);
+	g_assert_cmpstr("misc", ==, ((aim_module_t *)od->modmulti->data)->name);
+
+	oscar_data_destroy(od);
+}
+
+static void
+test_oscar_flap_recv(void) {
+	const gsize chunks[] = { 1, 7, 4096, G_MAXSIZE };
+	GHashTable *snacs = g_hash_table_new(g_direct_hash, g_direct_equal);
+	guint8 *data;
+	gsize len, largest;
+	guint i;
+
+	data = test_oscar_flap_capture(&len);
+	test_oscar_flap_tally(data, len, snacs, &largest);
+	g_assert_cmpint(largest, >, FLAP_CONNECTION_READ_SIZE);
+
+	/* However the reads split the frames up, every SNAC gets handled. */
+	for (i = 0; i < G_N_ELEMENTS(chunks); i++) {
+		GHashTableIter iter;
+		gpointer key, value;
+		FlapConnection *conn;
+		gint server;
+
+		conn = test_oscar_flap_connect("recv", &server);
+		test_oscar_flap_handled = g_hash_table_new(g_direct_hash,
+		                                           g_direct_equal);
+
+		test_oscar_flap_feed(conn, server, data, len, chunks[i]);
+
+		g_assert_true(conn->connected);
+		g_assert_cmpint(0, ==, conn->buffer_read_len);
+		/* The buffer only grew as far as the longest frame needed. */
+		g_assert_cmpint(largest, ==, conn->buffer_read_size);
+		g_assert_cmpint(g_hash_table_size(snacs), ==,
+		                g_hash_table_size(test_oscar_flap_handled));
+
+		g_hash_table_iter_init(&iter, snacs);
+		while (g_hash_table_iter_next(&iter, &key, &value)) {
+			g_assert_cmpint(GPOINTER_TO_UINT(value), ==, GPOINTER_TO_UINT(
+				g_hash_table_lookup(test_oscar_flap_handled, key)));
+		}
+
+		g_hash_table_destroy(test_oscar_flap_handled);
+		test_oscar_flap_disconnect(conn, server);
+	}
+
+	g_hash_table_destroy(snacs);
+	g_free(data);
+}
+
+static void
+test_oscar_flap_recv_invalid(void) {
+	const guint8 data[] = {
+		0x2a, 0x05, 0x00, 0x01, 0x00, 0x00,
+		0x2b, 0x05, 0x00, 0x02, 0x00, 0x00
+	};
+	FlapConnection *conn;
+	gint server;
+
+	conn = test_oscar_flap_connect("invalid", &server);
+
+	/* A FLAP that doesn't start with 0x2a closes the connection. */
+	test_oscar_flap_feed(conn, server, data, 6, sizeof(data));
+	g_assert_cmpint(0, ==, conn->destroy_timeout);
+	test_oscar_flap_feed(conn, server, data + 6, 6, sizeof(data));
+	g_assert_cmpint(0, !=, conn->destroy_timeout);
+	g_assert_cmpint(0, ==, conn->buffer_read_len);
+
+	test_oscar_flap_disconnect(conn, server);
+}
+
+static void
+test_oscar_flap_send(void) {
+	FlapConnection *conn;
+	FlapFrame *frame;
+	guint8 buf[256], payload[100];
+	ByteStream bs;
+	gint server;
+	guint i;
+
+	conn = test_oscar_flap_connect("send", &server);
+
+	for (i = 0; i < sizeof(payload); i++)
+		payload[i] = i;
+
+	/* Frames of different sizes, one after another. */
+	for (i = 0; i < 3; i++) {
+		gsize len = 10 + i * 45;
+
+		byte_stream_new(&bs, i * 45);
+		byte_stream_putraw(&bs, payload, i * 45);
+		flap_connection_send_snac(conn->od, conn, SNAC_FAMILY_ICBM, 0x0006,
+		                          i, &bs);
+		byte_stream_destroy(&bs);
+
+		/* Let the write watcher flush what the first send didn't. */
+		while (g_main_context_iteration(NULL, FALSE));
+
+		g_assert_cmpint(6 + len, ==, read(server, buf, sizeof(buf)));
+		g_assert_cmpint(0x2a, ==, buf[0]);
+		g_assert_cmpint(0x02, ==, buf[1]);
+		g_assert_cmpint(i + 1, ==, aimutil_get16(buf + 2));
+		g_assert_cmpint(len, ==, aimutil_get16(buf + 4));
+		g_assert_cmpint(SNAC_FAMILY_ICBM, ==, aimutil_get16(buf + 6));
+		g_assert_cmpint(0x0006, ==, aimutil_get16(buf + 8));
+		g_assert_cmpint(i, ==, aimutil_get32(buf + 12));
+		g_assert_true(memcmp(payload, buf + 16, len - 10) == 0);
+	}
+
+	/* Sent frames are handed out again. */
+	g_assert_cmpint(1, ==, conn->od->frame_pool_len);
+	frame = conn->od->frame_pool[0];
+	g_assert_true(flap_frame_new(conn->od, 0x05, 0) == frame);
+	g_assert_cmpint(0, ==, conn->od->frame_pool_len);
+	flap_connection_send(conn, frame);
+	while (g_main_context_iteration(NULL, FALSE));
+	g_assert_cmpint(6, ==, read(server, buf, sizeof(buf)));
+	g_assert_cmpint(0x05, ==, buf[1]);
+	g_assert_cmpint(0, ==, aimutil_get16(buf + 4));
+	g_assert_true(conn->od->frame_pool[0] == frame);
+
+	test_oscar_flap_disconnect(conn, server);
+}
+
+static void
+test_oscar_flap_rate(void) {
+	const guint32 order[] = { 1, 2, 5, 6, 8, 7, 3, 4 };
+	struct rateclass *general, *icbm;
+	FlapConnection *conn;
+	FlapRateStats stats;
+	GArray *ids;
+	gint server;
+	guint i;
+
+	conn = test_oscar_flap_connect("rate", &server);
+
+	general = test_oscar_flap_rateclass(conn, 0x0001);
+	conn->default_rateclass = general;
+	icbm = test_oscar_flap_rateclass(conn, 0x0002);
+	g_hash_table_insert(conn->rateclass_members,
+	                    GUINT_TO_POINTER((SNAC_FAMILY_ICBM << 16) + 0x0006),
+	                    icbm);
+
+	/* Low priority SNACs wait once the average nears the clear level... */
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_LOCATE, 1, FALSE);
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_LOCATE, 2, FALSE);
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_LOCATE, 3, FALSE);
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_LOCATE, 4, FALSE);
+	g_assert_true(flap_connection_get_rate_stats(conn, SNAC_FAMILY_LOCATE,
+	                                             0x0006, &stats));
+	g_assert_cmpint(0x0001, ==, stats.classid);
+	g_assert_cmpint(0, ==, stats.queued_high);
+	g_assert_cmpint(2, ==, stats.queued_low);
+	g_assert_cmpint(0, !=, conn->queued_timeout);
+
+	/* ...but high priority ones go ahead of them until the alert level. */
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_LOCATE, 5, TRUE);
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_LOCATE, 6, TRUE);
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_LOCATE, 7, TRUE);
+	g_assert_true(flap_connection_get_rate_stats(conn, SNAC_FAMILY_LOCATE,
+	                                             0x0006, &stats));
+	g_assert_cmpint(1, ==, stats.queued_high);
+	g_assert_cmpint(2, ==, stats.queued_low);
+	g_assert_cmpint(3, ==, stats.throttled);
+	g_assert_cmpint(3, ==, stats.max_queued);
+
+	/* Another rate class isn't held up by this one. */
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_ICBM, 8, FALSE);
+	g_assert_true(flap_connection_get_rate_stats(conn, SNAC_FAMILY_ICBM,
+	                                             0x0006, &stats));
+	g_assert_cmpint(0x0002, ==, stats.classid);
+	g_assert_cmpint(0, ==, stats.queued_low);
+	g_assert_cmpint(0, ==, stats.throttled);
+
+	/* Rather than wait for the average to recover, pretend the last SNAC
+	 * went out ten minutes ago.  Everything fits again, high priority first. */
+	general->last -= 10 * 60 * 1000;
+	flap_connection_send_queued_snacs(conn);
+	while (g_main_context_iteration(NULL, FALSE));
+
+	ids = test_oscar_flap_sent(server);
+	g_assert_cmpint(G_N_ELEMENTS(order), ==, ids->len);
+	for (i = 0; i < G_N_ELEMENTS(order); i++)
+		g_assert_cmpint(order[i], ==, g_array_index(ids, guint32, i));
+	g_array_free(ids, TRUE);
+
+	/* The average never went below where each lane stops. */
+	g_assert_cmpint(general->current, >, general->clear);
+	g_assert_true(flap_connection_get_rate_stats(conn, SNAC_FAMILY_LOCATE,
+	                                             0x0006, &stats));
+	g_assert_cmpint(0, ==, stats.queued_high);
+	g_assert_cmpint(0, ==, stats.queued_low);
+	g_assert_cmpint(3, ==, stats.throttled);
+	g_assert_cmpint(0, ==, general->throttled_since);
+	g_assert_cmpint(0, ==, conn->queued_timeout);
+
+	/* Nothing is sent while the server says it's dropping SNACs, and
+	 * there's nothing to poll for until it says otherwise. */
+	icbm->dropping_snacs = 1;
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_ICBM, 9, TRUE);
+	g_assert_cmpint(1, ==, icbm->queued[RATECLASS_QUEUE_HIGH].length);
+	g_assert_cmpint(0, ==, conn->queued_timeout);
+
+	icbm->dropping_snacs = 0;
+	flap_connection_send_queued_snacs(conn);
+	while (g_main_context_iteration(NULL, FALSE));
+	ids = test_oscar_flap_sent(server);
+	g_assert_cmpint(1, ==, ids->len);
+	g_assert_cmpint(9, ==, g_array_index(ids, guint32, 0));
+	g_array_free(ids, TRUE);
+
+	/* Sitting right at the alert level, a high priority SNAC has to wait
+	 * about alert + 2 milliseconds, and the timer sends it after that. */
+	icbm->alert = 500;
+	icbm->current = icbm->alert;
+	icbm->last = g_get_monotonic_time() / 1000;
+	test_oscar_flap_send_empty(conn, SNAC_FAMILY_ICBM, 10, TRUE);
+	g_assert_cmpint(1, ==, icbm->queued[RATECLASS_QUEUE_HIGH].length);
+
+	test_oscar_flap_drain(conn);
+	ids = test_oscar_flap_sent(server);
+	g_assert_cmpint(1, ==, ids->len);
+	g_assert_cmpint(10, ==, g_array_index(ids, guint32, 0));
+	g_array_free(ids, TRUE);
+
+	g_assert_true(flap_connection_get_rate_stats(conn, SNAC_FAMILY_ICBM,
+	                                             0x0006, &stats));
+	g_assert_cmpint(2, ==, stats.throttled);
+	g_assert_cmpint(0, <, stats.throttled_time);
+
+	/* Whatever is still waiting is freed with the connection. */
+	general->current = general->alert;
+	for (i = 11; i < 21; i++)
+		test_oscar_flap_send_empty(conn, SNAC_FAMILY_LOCATE, i, i % 2);
+	g_assert_cmpint(0, !=, conn->queued_timeout);
+
+	test_oscar_flap_disconnect(conn, server);
+}
+
+static void
+test_oscar_flap_recv_performance(void) {
+	const guint target = 500000;
+	FlapConnection *conn;
+	gdouble elapsed = 0;
+	guint8 *data;
+	guint frames = 0, capture_frames;
+	gsize len;
+	gint server;
+
+	data = test_oscar_flap_capture(&len);
+	capture_frames = test_oscar_flap_tally(data, len, NULL, NULL);
+
+	conn = test_oscar_flap_connect("replay", &server);
+	test_oscar_flap_handled = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	while (frames < target) {
+		gsize offset = 0;
+
+		/* Time just the reading and parsing, not the writing. */
+		while (offset < len) {
+			gssize n = write(server, data + offset, MIN(4096, len - offset));
+
+			g_assert_cmpint(n, >, 0);
+			offset += n;
+
+			g_test_timer_start();
+			flap_connection_recv_cb(conn, conn->fd, PURPLE_INPUT_READ);
+			elapsed += g_test_timer_elapsed();
+		}
+
+		frames += capture_frames;
+	}
+
+	g_test_minimized_result(elapsed / frames,
+		"%u frames: %.2f us per frame, %.0f frames/s", frames,
+		elapsed * 1e6 / frames, frames / elapsed);
+
+	g_hash_table_destroy(test_oscar_flap_handled);
+	test_oscar_flap_disconnect(conn, server);
+	g_free(data);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	test_ui_protocol_add();
+
+	g_test_add_func("/oscar/flap/modules",
+	                test_oscar_flap_modules);
+	g_test_add_func("/oscar/flap/recv",
+	                test_oscar_flap_recv);
+	g_test_add_func("/oscar/flap/recv/invalid",
+	                test_oscar_flap_recv_invalid);
+	g_test_add_func("/oscar/flap/send",
+	                test_oscar_flap_send);
+	g_test_add_func("/oscar/flap/rate",
+	                test_oscar_flap_rate);
+	if (g_test_perf()) {
+		g_test_add_func("/oscar/flap/recv/performance",
+		                test_oscar_flap_recv_performance);
+	}
+
+	return g_test_run();
+}
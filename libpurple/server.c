@@ -542,6 +542,7 @@ void purple_serv_got_im(PurpleConnection *gc, const char *who, const char *msg,
 
 	pmsg = purple_message_new_incoming(name, message, flags, mtime);
 	purple_conversation_write_message(PURPLE_CONVERSATION(im), pmsg);
+	g_object_unref(pmsg);
 	g_free(message);
 
 	/*
@@ -615,6 +616,7 @@ void purple_serv_got_im(PurpleConnection *gc, const char *who, const char *msg,
 
 					purple_serv_send_im(gc, msg);
 					purple_conversation_write_message(PURPLE_CONVERSATION(im), msg);
+					g_object_unref(msg);
 				}
 			}
 		}
@@ -768,7 +770,7 @@ PurpleChatConversation *purple_serv_got_joined_chat(PurpleConnection *gc,
 	chat = purple_chat_conversation_new(account, name);
 	g_return_val_if_fail(chat != NULL, NULL);
 
-	if (!g_slist_find(purple_connection_get_active_chats(gc), chat))
+	if (!_purple_connection_is_active_chat(gc, chat))
 		_purple_connection_add_active_chat(gc, chat);
 
 	purple_chat_conversation_set_id(chat, id);
@@ -780,16 +782,9 @@ PurpleChatConversation *purple_serv_got_joined_chat(PurpleConnection *gc,
 
 void purple_serv_got_chat_left(PurpleConnection *g, int id)
 {
-	GSList *bcs;
-	PurpleChatConversation *chat = NULL;
-
-	for (bcs = purple_connection_get_active_chats(g); bcs != NULL; bcs = bcs->next) {
-		if (purple_chat_conversation_get_id(
-				PURPLE_CHAT_CONVERSATION(bcs->data)) == id) {
-			chat = (PurpleChatConversation *)bcs->data;
-			break;
-		}
-	}
+	PurpleChatConversation *chat;
+
+	chat = _purple_connection_find_active_chat(g, id);
 
 	if (!chat)
 		return;
@@ -813,8 +808,7 @@ void purple_serv_got_join_chat_failed(PurpleConnection *gc, GHashTable *data)
 void purple_serv_got_chat_in(PurpleConnection *g, int id, const char *who,
 					  PurpleMessageFlags flags, const char *message, time_t mtime)
 {
-	GSList *bcs;
-	PurpleChatConversation *chat = NULL;
+	PurpleChatConversation *chat;
 	char *buffy, *angel;
 	int plugin_return;
 	PurpleMessage *pmsg;
@@ -830,13 +824,7 @@ void purple_serv_got_chat_in(PurpleConnection *g, int id, const char *who,
 		mtime = time(NULL);
 	}
 
-	for (bcs = purple_connection_get_active_chats(g); bcs != NULL; bcs = bcs->next) {
-		if (purple_chat_conversation_get_id(
-				PURPLE_CHAT_CONVERSATION(bcs->data)) == id) {
-			chat = (PurpleChatConversation *)bcs->data;
-			break;
-		}
-	}
+	chat = _purple_connection_find_active_chat(g, id);
 
 	if (!chat)
 		return;
@@ -882,6 +870,7 @@ void purple_serv_got_chat_in(PurpleConnection *g, int id, const char *who,
 		purple_message_set_time(pmsg, mtime);
 	}
 	purple_conversation_write_message(PURPLE_CONVERSATION(chat), pmsg);
+	g_object_unref(pmsg);
 
 	g_free(angel);
 	g_free(buffy);
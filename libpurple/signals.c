@@ -38,8 +38,9 @@ typedef struct
 
 } PurpleInstanceData;
 
-typedef struct
+struct _PurpleSignal
 {
+	char *name;
 	gulong id;
 
 	PurpleSignalMarshalFunc marshal;
@@ -52,7 +53,9 @@ typedef struct
 	size_t handler_count;
 
 	gulong next_handler_id;
-} PurpleSignalData;
+};
+
+typedef PurpleSignal PurpleSignalData;
 
 typedef struct
 {
@@ -82,6 +85,7 @@ destroy_signal_data(PurpleSignalData *signal_data)
 	g_list_free(signal_data->handlers);
 
 	g_free(signal_data->value_types);
+	g_free(signal_data->name);
 	g_free(signal_data);
 }
 
@@ -109,13 +113,14 @@ purple_signal_register(void *instance, const char *signal,
 		instance_data->next_signal_id = 1;
 
 		instance_data->signals =
-			g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
 								  (GDestroyNotify)destroy_signal_data);
 
 		g_hash_table_insert(instance_table, instance, instance_data);
 	}
 
 	signal_data = g_new0(PurpleSignalData, 1);
+	signal_data->name            = g_strdup(signal);
 	signal_data->id              = instance_data->next_signal_id;
 	signal_data->marshal         = marshal;
 	signal_data->next_handler_id = 1;
@@ -136,8 +141,10 @@ purple_signal_register(void *instance, const char *signal,
 		va_end(args);
 	}
 
-	g_hash_table_insert(instance_data->signals,
-						g_strdup(signal), signal_data);
+	/* The key is owned by the signal data, so it has to be replaced along
+	 * with it if the signal is registered again. */
+	g_hash_table_replace(instance_data->signals,
+						signal_data->name, signal_data);
 
 	instance_data->next_signal_id++;
 	instance_data->signal_count++;
@@ -403,35 +410,28 @@ purple_signals_disconnect_by_handle(void *handle)
 						 (GHFunc)disconnect_handle_from_instance, handle);
 }
 
-void
-purple_signal_emit(void *instance, const char *signal, ...)
+/* Emissions are forwarded to D-Bus, when it's up, even if no handlers are
+ * connected. */
+static gboolean
+signal_is_forwarded(void)
 {
-	va_list args;
-
-	g_return_if_fail(instance != NULL);
-	g_return_if_fail(signal   != NULL);
-
-	va_start(args, signal);
-	purple_signal_emit_vargs(instance, signal, args);
-	va_end(args);
+#ifdef HAVE_DBUS
+	return purple_dbus_get_connection() != NULL;
+#else
+	return FALSE;
+#endif
 }
 
-void
-purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
+static PurpleSignalData *
+signal_lookup_common(void *instance, const char *signal)
 {
 	PurpleInstanceData *instance_data;
 	PurpleSignalData *signal_data;
-	PurpleSignalHandlerData *handler_data;
-	GList *l, *l_next;
-	va_list tmp;
-
-	g_return_if_fail(instance != NULL);
-	g_return_if_fail(signal   != NULL);
 
 	instance_data =
 		(PurpleInstanceData *)g_hash_table_lookup(instance_table, instance);
 
-	g_return_if_fail(instance_data != NULL);
+	g_return_val_if_fail(instance_data != NULL, NULL);
 
 	signal_data =
 		(PurpleSignalData *)g_hash_table_lookup(instance_data->signals, signal);
@@ -440,9 +440,19 @@ purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
 	{
 		purple_debug(PURPLE_DEBUG_ERROR, "signals",
 				   "Signal data for %s not found!\n", signal);
-		return;
+		return NULL;
 	}
 
+	return signal_data;
+}
+
+static void
+signal_emit_common(PurpleSignalData *signal_data, va_list args)
+{
+	PurpleSignalHandlerData *handler_data;
+	GList *l, *l_next;
+	va_list tmp;
+
 	for (l = signal_data->handlers; l != NULL; l = l_next)
 	{
 		l_next = l->next;
@@ -468,59 +478,22 @@ purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
 	}
 
 #ifdef HAVE_DBUS
-	purple_dbus_signal_emit_purple(signal, signal_data->num_values,
+	purple_dbus_signal_emit_purple(signal_data->name, signal_data->num_values,
 				   signal_data->value_types, args);
 #endif	/* HAVE_DBUS */
 
 }
 
-void *
-purple_signal_emit_return_1(void *instance, const char *signal, ...)
+static void *
+signal_emit_return_1_common(PurpleSignalData *signal_data, va_list args)
 {
-	void *ret_val;
-	va_list args;
-
-	g_return_val_if_fail(instance != NULL, NULL);
-	g_return_val_if_fail(signal   != NULL, NULL);
-
-	va_start(args, signal);
-	ret_val = purple_signal_emit_vargs_return_1(instance, signal, args);
-	va_end(args);
-
-	return ret_val;
-}
-
-void *
-purple_signal_emit_vargs_return_1(void *instance, const char *signal,
-								va_list args)
-{
-	PurpleInstanceData *instance_data;
-	PurpleSignalData *signal_data;
 	PurpleSignalHandlerData *handler_data;
 	GList *l, *l_next;
 	va_list tmp;
 
-	g_return_val_if_fail(instance != NULL, NULL);
-	g_return_val_if_fail(signal   != NULL, NULL);
-
-	instance_data =
-		(PurpleInstanceData *)g_hash_table_lookup(instance_table, instance);
-
-	g_return_val_if_fail(instance_data != NULL, NULL);
-
-	signal_data =
-		(PurpleSignalData *)g_hash_table_lookup(instance_data->signals, signal);
-
-	if (signal_data == NULL)
-	{
-		purple_debug(PURPLE_DEBUG_ERROR, "signals",
-				   "Signal data for %s not found!\n", signal);
-		return 0;
-	}
-
 #ifdef HAVE_DBUS
 	G_VA_COPY(tmp, args);
-	purple_dbus_signal_emit_purple(signal, signal_data->num_values,
+	purple_dbus_signal_emit_purple(signal_data->name, signal_data->num_values,
 				   signal_data->value_types, tmp);
 	va_end(tmp);
 #endif	/* HAVE_DBUS */
@@ -553,6 +526,139 @@ purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 	return NULL;
 }
 
+void
+purple_signal_emit(void *instance, const char *signal, ...)
+{
+	va_list args;
+
+	g_return_if_fail(instance != NULL);
+	g_return_if_fail(signal   != NULL);
+
+	va_start(args, signal);
+	purple_signal_emit_vargs(instance, signal, args);
+	va_end(args);
+}
+
+void
+purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
+{
+	PurpleSignalData *signal_data;
+
+	g_return_if_fail(instance != NULL);
+	g_return_if_fail(signal   != NULL);
+
+	signal_data = signal_lookup_common(instance, signal);
+	if (signal_data == NULL)
+		return;
+
+	signal_emit_common(signal_data, args);
+}
+
+void *
+purple_signal_emit_return_1(void *instance, const char *signal, ...)
+{
+	void *ret_val;
+	va_list args;
+
+	g_return_val_if_fail(instance != NULL, NULL);
+	g_return_val_if_fail(signal   != NULL, NULL);
+
+	va_start(args, signal);
+	ret_val = purple_signal_emit_vargs_return_1(instance, signal, args);
+	va_end(args);
+
+	return ret_val;
+}
+
+void *
+purple_signal_emit_vargs_return_1(void *instance, const char *signal,
+								va_list args)
+{
+	PurpleSignalData *signal_data;
+
+	g_return_val_if_fail(instance != NULL, NULL);
+	g_return_val_if_fail(signal   != NULL, NULL);
+
+	signal_data = signal_lookup_common(instance, signal);
+	if (signal_data == NULL)
+		return NULL;
+
+	return signal_emit_return_1_common(signal_data, args);
+}
+
+PurpleSignal *
+purple_signal_lookup(void *instance, const char *signal)
+{
+	g_return_val_if_fail(instance != NULL, NULL);
+	g_return_val_if_fail(signal   != NULL, NULL);
+
+	return signal_lookup_common(instance, signal);
+}
+
+gboolean
+purple_signal_has_handlers(const PurpleSignal *signal)
+{
+	g_return_val_if_fail(signal != NULL, FALSE);
+
+	return (signal->handlers != NULL || signal_is_forwarded());
+}
+
+void
+purple_signal_emit_direct(PurpleSignal *signal, ...)
+{
+	va_list args;
+
+	g_return_if_fail(signal != NULL);
+
+	/* Nothing to marshal the arguments for */
+	if (!purple_signal_has_handlers(signal))
+		return;
+
+	va_start(args, signal);
+	signal_emit_common(signal, args);
+	va_end(args);
+}
+
+void
+purple_signal_emit_direct_vargs(PurpleSignal *signal, va_list args)
+{
+	g_return_if_fail(signal != NULL);
+
+	if (!purple_signal_has_handlers(signal))
+		return;
+
+	signal_emit_common(signal, args);
+}
+
+void *
+purple_signal_emit_direct_return_1(PurpleSignal *signal, ...)
+{
+	void *ret_val;
+	va_list args;
+
+	g_return_val_if_fail(signal != NULL, NULL);
+
+	if (!purple_signal_has_handlers(signal))
+		return NULL;
+
+	va_start(args, signal);
+	ret_val = signal_emit_return_1_common(signal, args);
+	va_end(args);
+
+	return ret_val;
+}
+
+void *
+purple_signal_emit_direct_vargs_return_1(PurpleSignal *signal, va_list args)
+{
+	g_return_val_if_fail(signal != NULL, NULL);
+
+	if (!purple_signal_has_handlers(signal))
+		return NULL;
+
+	return signal_emit_return_1_common(signal, args);
+}
+
 void
 purple_signals_init()
 {
@@ -38,6 +38,14 @@ typedef void (*PurpleCallback)(void);
 typedef void (*PurpleSignalMarshalFunc)(PurpleCallback cb, va_list args,
 									  void *data, void **return_val);
 
+/**
+ * PurpleSignal:
+ *
+ * A signal registered on an instance, as returned by purple_signal_lookup().
+ * Emitting through it skips looking up the instance and signal name.
+ */
+typedef struct _PurpleSignal PurpleSignal;
+
 G_BEGIN_DECLS
 
 /******************************************************************************
@@ -298,6 +306,85 @@ void *purple_signal_emit_return_1(void *instance, const char *signal, ...);
 void *purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 									  va_list args);
 
+/**
+ * purple_signal_lookup:
+ * @instance: The instance the signal is registered to.
+ * @signal:   The signal name.
+ *
+ * Resolves a signal once so that it can be emitted repeatedly with
+ * purple_signal_emit_direct() and friends.  The returned signal is valid
+ * until it is unregistered, so callers should only keep it for as long as
+ * they know the instance is around.
+ *
+ * Returns: (transfer none): The signal, or %NULL if it isn't registered.
+ */
+PurpleSignal *purple_signal_lookup(void *instance, const char *signal);
+
+/**
+ * purple_signal_has_handlers:
+ * @signal: The signal.
+ *
+ * Checks whether emitting a signal would do anything.  Callers can use this
+ * to avoid building arguments that no one will look at.
+ *
+ * Returns: %TRUE if a handler is connected to @signal, or emissions are
+ *          forwarded to D-Bus.
+ */
+gboolean purple_signal_has_handlers(const PurpleSignal *signal);
+
+/**
+ * purple_signal_emit_direct:
+ * @signal: The signal being emitted.
+ * @...:    The arguments to pass to the callbacks.
+ *
+ * Emits a signal resolved by purple_signal_lookup().  If nothing is
+ * connected to the signal, this returns without touching the arguments.
+ *
+ * See purple_signal_emit()
+ */
+void purple_signal_emit_direct(PurpleSignal *signal, ...);
+
+/**
+ * purple_signal_emit_direct_vargs:
+ * @signal: The signal being emitted.
+ * @args:   The arguments list.
+ *
+ * Emits a signal resolved by purple_signal_lookup(), using a va_list of
+ * arguments.
+ *
+ * See purple_signal_emit_vargs()
+ */
+void purple_signal_emit_direct_vargs(PurpleSignal *signal, va_list args);
+
+/**
+ * purple_signal_emit_direct_return_1:
+ * @signal: The signal being emitted.
+ * @...:    The arguments to pass to the callbacks.
+ *
+ * Emits a signal resolved by purple_signal_lookup() and returns the first
+ * non-NULL return value.
+ *
+ * See purple_signal_emit_return_1()
+ *
+ * Returns: The first non-NULL return value
+ */
+void *purple_signal_emit_direct_return_1(PurpleSignal *signal, ...);
+
+/**
+ * purple_signal_emit_direct_vargs_return_1:
+ * @signal: The signal being emitted.
+ * @args:   The arguments list.
+ *
+ * Emits a signal resolved by purple_signal_lookup(), using a va_list of
+ * arguments, and returns the first non-NULL return value.
+ *
+ * See purple_signal_emit_vargs_return_1()
+ *
+ * Returns: The first non-NULL return value
+ */
+void *purple_signal_emit_direct_vargs_return_1(PurpleSignal *signal,
+		va_list args);
+
 /**
  * purple_signals_init:
  *
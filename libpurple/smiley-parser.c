@@ -253,6 +253,7 @@ _purple_smiley_parser_init(void)
 	html_sentry = purple_trie_new();
 	purple_trie_add(html_sentry, "<", NULL);
 	purple_trie_add(html_sentry, ">", NULL);
+	purple_trie_freeze(html_sentry);
 }
 
 void
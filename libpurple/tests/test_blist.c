@@ -0,0 +1,406 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/* Left empty so the buddy list uses its own saving ops. */
+static PurpleBlistUiOps test_blist_ui_ops;
+
+static PurpleAccount *test_blist_account = NULL;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_blist_remove_dir(const gchar *path) {
+	GDir *dir = g_dir_open(path, 0, NULL);
+	const gchar *name;
+
+	if (dir == NULL) {
+		g_unlink(path);
+		return;
+	}
+
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		gchar *child = g_build_filename(path, name, NULL);
+		test_blist_remove_dir(child);
+		g_free(child);
+	}
+	g_dir_close(dir);
+
+	g_rmdir(path);
+}
+
+static gchar *
+test_blist_get_path(const gchar *name) {
+	return g_build_filename(purple_user_dir(), name, NULL);
+}
+
+static gboolean
+test_blist_file_exists(const gchar *name) {
+	gchar *path = test_blist_get_path(name);
+	gboolean exists = g_file_test(path, G_FILE_TEST_EXISTS);
+
+	g_free(path);
+
+	return exists;
+}
+
+/* Saves whatever is pending, just like quitting would, and loads it again. */
+static void
+test_blist_reload(void) {
+	purple_blist_uninit();
+	purple_blist_boot();
+}
+
+/* Starts a test with an empty buddy list and nothing on disk. */
+static void
+test_blist_clear(void) {
+	GDir *dir;
+	const gchar *name;
+
+	purple_blist_uninit();
+
+	dir = g_dir_open(purple_user_dir(), 0, NULL);
+	g_assert_nonnull(dir);
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		if (g_str_has_prefix(name, "blist.")) {
+			gchar *path = test_blist_get_path(name);
+
+			g_unlink(path);
+			g_free(path);
+		}
+	}
+	g_dir_close(dir);
+
+	purple_blist_boot();
+}
+
+/* Returns the number of records in a journal. */
+static guint
+test_blist_count_records(const gchar *name) {
+	gchar *path = test_blist_get_path(name), *contents, *p;
+	guint records = 0;
+
+	g_assert_true(g_file_get_contents(path, &contents, NULL, NULL));
+	for (p = contents; *p != '\0'; p++) {
+		if (*p == '\n')
+			records++;
+	}
+	g_free(contents);
+	g_free(path);
+
+	return records;
+}
+
+static PurpleGroup *
+test_blist_add_group(const gchar *name, PurpleGroup *after) {
+	PurpleGroup *group = purple_group_new(name);
+
+	purple_blist_add_group(group, PURPLE_BLIST_NODE(after));
+
+	return group;
+}
+
+static PurpleBuddy *
+test_blist_add_buddy(const gchar *name, PurpleGroup *group) {
+	PurpleBuddy *buddy = purple_buddy_new(test_blist_account, name, NULL);
+
+	purple_blist_add_buddy(buddy, NULL, group, NULL);
+
+	return buddy;
+}
+
+static PurpleBlistNode *
+test_blist_find_buddy(const gchar *name) {
+	return PURPLE_BLIST_NODE(purple_blist_find_buddy(test_blist_account,
+	                                                 name));
+}
+
+/* Returns the group a buddy is in, or NULL if it's not on the list. */
+static const gchar *
+test_blist_get_group(const gchar *name) {
+	PurpleBuddy *buddy = purple_blist_find_buddy(test_blist_account, name);
+
+	if (buddy == NULL)
+		return NULL;
+
+	return purple_group_get_name(purple_buddy_get_group(buddy));
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_blist_journal_replay(void) {
+	PurpleGroup *friends, *work;
+	PurpleBuddy *carol;
+
+	test_blist_clear();
+
+	friends = test_blist_add_group("Friends", NULL);
+	work = test_blist_add_group("Work", friends);
+	test_blist_add_buddy("alice", friends);
+	test_blist_add_buddy("bob", friends);
+	test_blist_add_buddy("carol", work);
+	purple_blist_node_set_string(test_blist_find_buddy("alice"), "note",
+	                             "first");
+
+	test_blist_reload();
+
+	/* Only the journal was written. */
+	g_assert_false(test_blist_file_exists("blist.xml"));
+	g_assert_true(test_blist_file_exists("blist.journal.0"));
+
+	friends = purple_blist_find_group("Friends");
+	work = purple_blist_find_group("Work");
+	g_assert_nonnull(friends);
+	g_assert_true(PURPLE_BLIST_NODE(friends)->next == PURPLE_BLIST_NODE(work));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("alice"));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("bob"));
+	g_assert_cmpstr("Work", ==, test_blist_get_group("carol"));
+	g_assert_cmpstr("first", ==,
+		purple_blist_node_get_string(test_blist_find_buddy("alice"), "note"));
+
+	/* Change a setting, move a group and a buddy, and remove a buddy. */
+	purple_blist_node_set_string(test_blist_find_buddy("alice"), "note",
+	                             "second");
+	purple_blist_add_group(work, NULL);
+	purple_blist_add_buddy(PURPLE_BUDDY(test_blist_find_buddy("bob")), NULL,
+	                       work, NULL);
+	carol = PURPLE_BUDDY(test_blist_find_buddy("carol"));
+	purple_blist_remove_buddy(carol);
+	test_blist_add_buddy("dave", friends);
+
+	test_blist_reload();
+
+	g_assert_false(test_blist_file_exists("blist.xml"));
+
+	friends = purple_blist_find_group("Friends");
+	work = purple_blist_find_group("Work");
+	g_assert_true(PURPLE_BLIST_NODE(work)->next == PURPLE_BLIST_NODE(friends));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("alice"));
+	g_assert_cmpstr("Work", ==, test_blist_get_group("bob"));
+	g_assert_null(test_blist_get_group("carol"));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("dave"));
+	g_assert_cmpstr("second", ==,
+		purple_blist_node_get_string(test_blist_find_buddy("alice"), "note"));
+}
+
+static void
+test_blist_journal_truncated(void) {
+	PurpleGroup *friends;
+	gchar *path, *contents;
+	gsize length;
+
+	test_blist_clear();
+
+	friends = test_blist_add_group("Friends", NULL);
+	test_blist_add_buddy("alice", friends);
+	test_blist_reload();
+
+	/* Cut the last record short, like a crash in the middle of a write. */
+	test_blist_add_buddy("bob", purple_blist_find_group("Friends"));
+	purple_blist_uninit();
+
+	path = test_blist_get_path("blist.journal.0");
+	g_assert_true(g_file_get_contents(path, &contents, &length, NULL));
+	g_assert_cmpint(length, >, 10);
+	g_assert_true(g_file_set_contents(path, contents, length - 10, NULL));
+	g_free(contents);
+	g_free(path);
+
+	purple_blist_boot();
+
+	/* Everything before the damaged record is still there. */
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("alice"));
+	g_assert_null(test_blist_get_group("bob"));
+
+	/* The damaged journal is replaced instead of being appended to. */
+	test_blist_add_buddy("carol", purple_blist_find_group("Friends"));
+	test_blist_reload();
+
+	g_assert_true(test_blist_file_exists("blist.xml"));
+	g_assert_false(test_blist_file_exists("blist.journal.0"));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("alice"));
+	g_assert_null(test_blist_get_group("bob"));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("carol"));
+}
+
+static void
+test_blist_journal_compact(void) {
+	PurpleGroup *friends, *work;
+
+	test_blist_clear();
+
+	friends = test_blist_add_group("Friends", NULL);
+	work = test_blist_add_group("Work", friends);
+	test_blist_add_buddy("alice", friends);
+	test_blist_add_buddy("bob", work);
+	purple_blist_node_set_int(test_blist_find_buddy("bob"), "count", 1);
+
+	/* A full save folds the journal into a new blist.xml. */
+	purple_blist_schedule_save();
+	test_blist_reload();
+
+	g_assert_true(test_blist_file_exists("blist.xml"));
+	g_assert_false(test_blist_file_exists("blist.journal.0"));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("alice"));
+	g_assert_cmpstr("Work", ==, test_blist_get_group("bob"));
+	g_assert_cmpint(1, ==,
+		purple_blist_node_get_int(test_blist_find_buddy("bob"), "count"));
+
+	/* Later records go to the journal the new snapshot names. */
+	purple_blist_node_set_int(test_blist_find_buddy("bob"), "count", 2);
+	purple_blist_remove_buddy(PURPLE_BUDDY(test_blist_find_buddy("alice")));
+	test_blist_add_buddy("carol", purple_blist_find_group("Friends"));
+
+	test_blist_reload();
+
+	g_assert_true(test_blist_file_exists("blist.journal.1"));
+	friends = purple_blist_find_group("Friends");
+	work = purple_blist_find_group("Work");
+	g_assert_true(PURPLE_BLIST_NODE(friends)->next == PURPLE_BLIST_NODE(work));
+	g_assert_null(test_blist_get_group("alice"));
+	g_assert_cmpstr("Work", ==, test_blist_get_group("bob"));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("carol"));
+	g_assert_cmpint(2, ==,
+		purple_blist_node_get_int(test_blist_find_buddy("bob"), "count"));
+}
+
+static void
+test_blist_journal_compact_async(void) {
+	PurpleGroup *friends;
+
+	test_blist_clear();
+
+	friends = test_blist_add_group("Friends", NULL);
+	test_blist_add_buddy("alice", friends);
+	test_blist_reload();
+
+	/* The next journal is created as soon as the snapshot is started. */
+	purple_blist_schedule_save();
+	while (!test_blist_file_exists("blist.journal.1"))
+		g_main_context_iteration(NULL, TRUE);
+
+	/* Whether or not the snapshot is done yet, this goes to the new
+	 * journal and survives the old one being removed. */
+	purple_blist_node_set_string(test_blist_find_buddy("alice"), "note",
+	                             "changed");
+	while (test_blist_file_exists("blist.journal.0"))
+		g_main_context_iteration(NULL, TRUE);
+
+	g_assert_true(test_blist_file_exists("blist.xml"));
+
+	test_blist_reload();
+
+	g_assert_false(test_blist_file_exists("blist.journal.0"));
+	g_assert_cmpuint(1, ==, test_blist_count_records("blist.journal.1"));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("alice"));
+	g_assert_cmpstr("changed", ==,
+		purple_blist_node_get_string(test_blist_find_buddy("alice"), "note"));
+}
+
+static void
+test_blist_journal_legacy(void) {
+	gchar *path, *contents;
+
+	test_blist_clear();
+	purple_blist_uninit();
+
+	/* A snapshot from before nodes had ids. */
+	path = test_blist_get_path("blist.xml");
+	g_assert_true(g_file_set_contents(path,
+		"<?xml version='1.0' encoding='UTF-8' ?>"
+		"<purple version='1.0'><blist><group name='Friends'><contact>"
+		"<buddy account='journal' proto='" TEST_UI_PROTOCOL_ID "'>"
+		"<name>alice</name></buddy>"
+		"<buddy account='journal' proto='" TEST_UI_PROTOCOL_ID "'>"
+		"<name>bob</name></buddy>"
+		"</contact></group></blist><privacy/></purple>", -1, NULL));
+
+	purple_blist_boot();
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("alice"));
+
+	/* It is rewritten with ids right away... */
+	test_blist_reload();
+	g_assert_true(g_file_get_contents(path, &contents, NULL, NULL));
+	g_assert_nonnull(g_strstr_len(contents, -1, " id="));
+	g_free(contents);
+	g_free(path);
+
+	/* ...so later changes only journal what changed. */
+	purple_blist_node_set_int(test_blist_find_buddy("bob"), "count", 1);
+	test_blist_reload();
+
+	g_assert_cmpuint(1, ==, test_blist_count_records("blist.journal.1"));
+	g_assert_cmpstr("Friends", ==, test_blist_get_group("alice"));
+	g_assert_cmpint(1, ==,
+		purple_blist_node_get_int(test_blist_find_buddy("bob"), "count"));
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gchar *dir;
+	gint res;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	test_ui_protocol_add();
+
+	dir = g_dir_make_tmp("test_blist-XXXXXX", NULL);
+	g_assert_nonnull(dir);
+	purple_util_set_user_dir(dir);
+	purple_prefs_set_bool("/purple/buddies/journal", TRUE);
+	purple_blist_set_ui_ops(&test_blist_ui_ops);
+
+	test_blist_account = purple_account_new("journal", TEST_UI_PROTOCOL_ID);
+	purple_accounts_add(test_blist_account);
+
+	g_test_add_func("/blist/journal/replay",
+	                test_blist_journal_replay);
+	g_test_add_func("/blist/journal/truncated",
+	                test_blist_journal_truncated);
+	g_test_add_func("/blist/journal/compact",
+	                test_blist_journal_compact);
+	g_test_add_func("/blist/journal/compact/async",
+	                test_blist_journal_compact_async);
+	g_test_add_func("/blist/journal/legacy",
+	                test_blist_journal_legacy);
+
+	res = g_test_run();
+
+	test_blist_remove_dir(dir);
+	g_free(dir);
+
+	return res;
+}
@@ -0,0 +1,517 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/******************************************************************************
+ * PurpleConversationUiOps Implementation
+ *****************************************************************************/
+static gint test_purple_conversations_ui_users = 0;
+static gint test_purple_conversations_ui_batches = 0;
+static gint test_purple_conversations_ui_largest = 0;
+static gboolean test_purple_conversations_ui_sorted = TRUE;
+
+static void
+test_purple_conversations_ui_chat_add_users(PurpleChatConversation *chat,
+                                            GList *cbuddies,
+                                            gboolean new_arrivals)
+{
+	GList *l;
+
+	for (l = cbuddies; l != NULL && l->next != NULL; l = l->next) {
+		if (purple_utf8_strcasecmp(purple_chat_user_get_name(l->data),
+		                           purple_chat_user_get_name(l->next->data)) > 0)
+		{
+			test_purple_conversations_ui_sorted = FALSE;
+		}
+	}
+
+	test_purple_conversations_ui_users += g_list_length(cbuddies);
+	test_purple_conversations_ui_largest = MAX(
+		test_purple_conversations_ui_largest, (gint)g_list_length(cbuddies));
+	test_purple_conversations_ui_batches++;
+}
+
+static void
+test_purple_conversations_ui_chat_remove_users(PurpleChatConversation *chat,
+                                               GList *users)
+{
+	test_purple_conversations_ui_users -= g_list_length(users);
+}
+
+static PurpleConversationUiOps test_purple_conversations_ui_ops = {
+	.chat_add_users = test_purple_conversations_ui_chat_add_users,
+	.chat_remove_users = test_purple_conversations_ui_chat_remove_users,
+};
+
+static void
+test_purple_conversations_ui_reset(void) {
+	test_purple_conversations_ui_users = 0;
+	test_purple_conversations_ui_batches = 0;
+	test_purple_conversations_ui_largest = 0;
+	test_purple_conversations_ui_sorted = TRUE;
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static PurpleChatConversation **
+test_purple_conversations_join(PurpleConnection *gc, const gchar *prefix,
+                               gint count)
+{
+	PurpleChatConversation **chats = g_new(PurpleChatConversation *, count);
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		gchar *name = g_strdup_printf("%s%d", prefix, i);
+
+		chats[i] = purple_serv_got_joined_chat(gc, i + 1, name);
+		g_assert_nonnull(chats[i]);
+		g_free(name);
+	}
+
+	return chats;
+}
+
+static void
+test_purple_conversations_leave(PurpleConnection *gc,
+                                PurpleChatConversation **chats, gint count)
+{
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		purple_serv_got_chat_left(gc,
+			purple_chat_conversation_get_id(chats[i]));
+		g_object_unref(chats[i]);
+	}
+
+	g_free(chats);
+}
+
+static void
+test_purple_conversations_users_joined_cb(PurpleChatConversation *chat,
+                                          GList *users, gboolean new_arrivals,
+                                          gint *joined)
+{
+	*joined += g_list_length(users);
+}
+
+static void
+test_purple_conversations_add_roster(PurpleChatConversation *chat,
+                                     const gchar *prefix, gint count)
+{
+	GList *users = NULL, *flags = NULL;
+	gint i;
+
+	for (i = count - 1; i >= 0; i--) {
+		users = g_list_prepend(users, g_strdup_printf("%s%05d", prefix, i));
+		flags = g_list_prepend(flags, GINT_TO_POINTER(PURPLE_CHAT_USER_NONE));
+	}
+
+	purple_chat_conversation_add_users(chat, users, NULL, flags, FALSE);
+
+	g_list_free_full(users, g_free);
+	g_list_free(flags);
+}
+
+/* Sets the history limits, and empties every history so only the test's own
+ * messages count against the budget. */
+static void
+test_purple_conversations_set_history_limits(gint max_messages, gint max_size,
+                                             gint budget)
+{
+	GList *l;
+
+	for (l = purple_conversations_get_all(); l != NULL; l = l->next)
+		purple_conversation_clear_message_history(l->data);
+
+	purple_prefs_set_int("/purple/conversations/history/max_messages",
+	                     max_messages);
+	purple_prefs_set_int("/purple/conversations/history/max_size", max_size);
+	purple_prefs_set_int("/purple/conversations/history/budget", budget);
+}
+
+/* Each message takes a bit less than 1 KiB of history. */
+static void
+test_purple_conversations_chat_in(PurpleConnection *gc, gint id, gint n) {
+	gchar *padding = g_strnfill(746, 'x');
+	gchar *text = g_strdup_printf("%03d:%s", n, padding);
+
+	purple_serv_got_chat_in(gc, id, "someone", PURPLE_MESSAGE_RECV, text,
+	                        time(NULL));
+	g_free(text);
+	g_free(padding);
+}
+
+static guint
+test_purple_conversations_history_length(PurpleChatConversation *chat) {
+	return g_list_length(purple_conversation_get_message_history(
+		PURPLE_CONVERSATION(chat)));
+}
+
+/* Returns the contents of the n-th newest message, without the padding. */
+static gint
+test_purple_conversations_history_nth(PurpleChatConversation *chat, guint n) {
+	GList *history = purple_conversation_get_message_history(
+		PURPLE_CONVERSATION(chat));
+
+	return atoi(purple_message_get_contents(g_list_nth_data(history, n)));
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_purple_conversations_find_chat(void) {
+	PurpleConnection *gc = test_ui_connect("find-chat");
+	PurpleChatConversation **chats;
+	GList *history;
+
+	chats = test_purple_conversations_join(gc, "room", 3);
+
+	g_assert_true(purple_conversations_find_chat(gc, 1) == chats[0]);
+	g_assert_true(purple_conversations_find_chat(gc, 2) == chats[1]);
+	g_assert_true(purple_conversations_find_chat(gc, 3) == chats[2]);
+	g_assert_null(purple_conversations_find_chat(gc, 4));
+
+	/* Changing the id moves the chat in the index. */
+	purple_chat_conversation_set_id(chats[1], 20);
+	g_assert_null(purple_conversations_find_chat(gc, 2));
+	g_assert_true(purple_conversations_find_chat(gc, 20) == chats[1]);
+
+	purple_serv_got_chat_in(gc, 20, "someone", PURPLE_MESSAGE_RECV, "hello",
+	                        time(NULL));
+	history = purple_conversation_get_message_history(
+		PURPLE_CONVERSATION(chats[1]));
+	g_assert_cmpint(1, ==, g_list_length(history));
+
+	/* A chat that was left is still found, but doesn't get messages. */
+	purple_serv_got_chat_left(gc, 20);
+	g_assert_true(purple_conversations_find_chat(gc, 20) == chats[1]);
+
+	purple_serv_got_chat_in(gc, 20, "someone", PURPLE_MESSAGE_RECV, "hello",
+	                        time(NULL));
+	history = purple_conversation_get_message_history(
+		PURPLE_CONVERSATION(chats[1]));
+	g_assert_cmpint(1, ==, g_list_length(history));
+
+	test_purple_conversations_leave(gc, chats, 3);
+}
+
+static void
+test_purple_conversations_add_users(void) {
+	PurpleConnection *gc = test_ui_connect("add-users");
+	PurpleChatConversation **chats;
+	PurpleChatUser *cb;
+	gint joined = 0;
+
+	chats = test_purple_conversations_join(gc, "users", 1);
+	purple_conversation_set_ui_ops(PURPLE_CONVERSATION(chats[0]),
+	                               &test_purple_conversations_ui_ops);
+	test_purple_conversations_ui_reset();
+
+	purple_signal_connect(purple_conversations_get_handle(),
+	                      "chat-users-joined", &joined,
+	                      PURPLE_CALLBACK(test_purple_conversations_users_joined_cb),
+	                      &joined);
+
+	purple_chat_conversation_ignore(chats[0], "@User00002");
+	purple_chat_conversation_ignore(chats[0], "+User00003");
+	g_assert_true(purple_chat_conversation_is_ignored_user(chats[0],
+	                                                        "user00002"));
+	g_assert_true(purple_chat_conversation_is_ignored_user(chats[0],
+	                                                        "@user00002"));
+	g_assert_true(purple_chat_conversation_is_ignored_user(chats[0],
+	                                                        "user00003"));
+	g_assert_false(purple_chat_conversation_is_ignored_user(chats[0],
+	                                                         "user00004"));
+	g_assert_cmpstr("User00002", ==,
+		purple_chat_conversation_get_ignored_user(chats[0], "user00002"));
+
+	/* The roster is in the core right away, but the UI gets it in chunks. */
+	test_purple_conversations_add_roster(chats[0], "user", 1200);
+	g_assert_cmpint(1200, ==, joined);
+	g_assert_cmpint(1200, ==, purple_chat_conversation_get_users_count(chats[0]));
+	g_assert_nonnull(purple_chat_conversation_find_user(chats[0], "user01199"));
+	g_assert_cmpint(0, ==, test_purple_conversations_ui_users);
+
+	while (test_purple_conversations_ui_users == 0)
+		g_main_context_iteration(NULL, TRUE);
+	g_assert_cmpint(1200, >, test_purple_conversations_ui_users);
+
+	/* Changing flags of a user that is still queued doesn't need the UI. */
+	cb = purple_chat_conversation_find_user(chats[0], "user01199");
+	g_assert_cmpstr("user01199", ==, purple_chat_user_get_alias(cb));
+	purple_chat_user_set_flags(cb, PURPLE_CHAT_USER_OP);
+	g_assert_cmpint(PURPLE_CHAT_USER_OP, ==, purple_chat_user_get_flags(cb));
+
+	/* Removing users hands the rest of the queue over first. */
+	purple_chat_conversation_remove_user(chats[0], "user00000", NULL);
+	g_assert_cmpint(1199, ==, test_purple_conversations_ui_users);
+	g_assert_cmpint(1199, ==, purple_chat_conversation_get_users_count(chats[0]));
+	g_assert_null(purple_chat_conversation_find_user(chats[0], "user00000"));
+	g_assert_true(test_purple_conversations_ui_sorted);
+	g_assert_cmpint(500, >=, test_purple_conversations_ui_largest);
+
+	/* New arrivals go to the UI immediately. */
+	purple_chat_conversation_add_user(chats[0], "late", NULL,
+	                                  PURPLE_CHAT_USER_NONE, TRUE);
+	g_assert_cmpint(1201, ==, joined);
+	g_assert_cmpint(1200, ==, test_purple_conversations_ui_users);
+
+	purple_signals_disconnect_by_handle(&joined);
+	purple_conversation_set_ui_ops(PURPLE_CONVERSATION(chats[0]), NULL);
+	test_purple_conversations_leave(gc, chats, 1);
+}
+
+static void
+test_purple_conversations_history_count(void) {
+	PurpleConnection *gc = test_ui_connect("history-count");
+	PurpleChatConversation **chats;
+	PurpleConversation *conv;
+	PurpleMessage *msg;
+	guint first_id;
+	gint i;
+
+	chats = test_purple_conversations_join(gc, "count", 1);
+	conv = PURPLE_CONVERSATION(chats[0]);
+	test_purple_conversations_set_history_limits(3, 0, 0);
+
+	test_purple_conversations_chat_in(gc, 1, 0);
+	msg = purple_conversation_get_message_history(conv)->data;
+	first_id = purple_message_get_id(msg);
+	g_assert_true(purple_message_find_by_id(first_id) == msg);
+
+	for (i = 1; i < 5; i++)
+		test_purple_conversations_chat_in(gc, 1, i);
+
+	g_assert_cmpuint(3, ==, test_purple_conversations_history_length(chats[0]));
+	g_assert_cmpuint(2, ==, purple_conversation_get_evicted_message_count(conv));
+	g_assert_cmpint(4, ==, test_purple_conversations_history_nth(chats[0], 0));
+	g_assert_cmpint(2, ==, test_purple_conversations_history_nth(chats[0], 2));
+
+	/* The id registry doesn't keep dropped messages alive. */
+	g_assert_null(purple_message_find_by_id(first_id));
+	msg = purple_conversation_get_message_history(conv)->data;
+	g_assert_true(purple_message_find_by_id(purple_message_get_id(msg)) == msg);
+
+	/* Lowering the limit applies it right away. */
+	purple_prefs_set_int("/purple/conversations/history/max_messages", 1);
+	g_assert_cmpuint(1, ==, test_purple_conversations_history_length(chats[0]));
+	g_assert_cmpuint(4, ==, purple_conversation_get_evicted_message_count(conv));
+
+	purple_conversation_clear_message_history(conv);
+	g_assert_cmpuint(0, ==, test_purple_conversations_history_length(chats[0]));
+	g_assert_cmpuint(0, ==, purple_conversation_get_evicted_message_count(conv));
+
+	test_purple_conversations_set_history_limits(1000, 1024, 65536);
+	test_purple_conversations_leave(gc, chats, 1);
+}
+
+static void
+test_purple_conversations_history_size(void) {
+	PurpleConnection *gc = test_ui_connect("history-size");
+	PurpleChatConversation **chats;
+	PurpleConversation *conv;
+	gchar *big;
+	gint i;
+
+	chats = test_purple_conversations_join(gc, "size", 1);
+	conv = PURPLE_CONVERSATION(chats[0]);
+	test_purple_conversations_set_history_limits(0, 2, 0);
+
+	for (i = 0; i < 5; i++)
+		test_purple_conversations_chat_in(gc, 1, i);
+
+	g_assert_cmpuint(2, ==, test_purple_conversations_history_length(chats[0]));
+	g_assert_cmpuint(3, ==, purple_conversation_get_evicted_message_count(conv));
+	g_assert_cmpint(4, ==, test_purple_conversations_history_nth(chats[0], 0));
+
+	/* A message larger than the limit still replaces the others. */
+	big = g_strnfill(4096, 'x');
+	purple_serv_got_chat_in(gc, 1, "someone", PURPLE_MESSAGE_RECV, big,
+	                        time(NULL));
+	g_free(big);
+	g_assert_cmpuint(1, ==, test_purple_conversations_history_length(chats[0]));
+	g_assert_cmpuint(5, ==, purple_conversation_get_evicted_message_count(conv));
+
+	test_purple_conversations_set_history_limits(1000, 1024, 65536);
+	test_purple_conversations_leave(gc, chats, 1);
+}
+
+static void
+test_purple_conversations_history_budget(void) {
+	PurpleConnection *gc = test_ui_connect("history-budget");
+	PurpleChatConversation **chats;
+	gint i;
+
+	chats = test_purple_conversations_join(gc, "budget", 2);
+	test_purple_conversations_set_history_limits(0, 0, 3);
+
+	for (i = 0; i < 3; i++)
+		test_purple_conversations_chat_in(gc, 1, i);
+	g_assert_cmpuint(3, ==, test_purple_conversations_history_length(chats[0]));
+
+	/* The least recently active chat pays for the new one... */
+	test_purple_conversations_chat_in(gc, 2, 0);
+	test_purple_conversations_chat_in(gc, 2, 1);
+	g_assert_cmpuint(1, ==, test_purple_conversations_history_length(chats[0]));
+	g_assert_cmpuint(2, ==, test_purple_conversations_history_length(chats[1]));
+	g_assert_cmpint(2, ==, test_purple_conversations_history_nth(chats[0], 0));
+
+	/* ...but keeps its newest message, so the new one pays after that. */
+	test_purple_conversations_chat_in(gc, 2, 2);
+	g_assert_cmpuint(1, ==, test_purple_conversations_history_length(chats[0]));
+	g_assert_cmpuint(2, ==, test_purple_conversations_history_length(chats[1]));
+	g_assert_cmpint(2, ==, test_purple_conversations_history_nth(chats[1], 0));
+	g_assert_cmpuint(2, ==, purple_conversation_get_evicted_message_count(
+		PURPLE_CONVERSATION(chats[0])));
+	g_assert_cmpuint(1, ==, purple_conversation_get_evicted_message_count(
+		PURPLE_CONVERSATION(chats[1])));
+
+	/* Writing to the older chat makes it the most recent one again. */
+	test_purple_conversations_chat_in(gc, 1, 3);
+	g_assert_cmpuint(2, ==, test_purple_conversations_history_length(chats[0]));
+	g_assert_cmpuint(1, ==, test_purple_conversations_history_length(chats[1]));
+
+	test_purple_conversations_set_history_limits(1000, 1024, 65536);
+	test_purple_conversations_leave(gc, chats, 2);
+}
+
+static void
+test_purple_conversations_add_users_performance(void) {
+	const gint counts[] = { 1000, 5000, 20000 };
+	PurpleConnection *gc = test_ui_connect("roster");
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(counts); i++) {
+		PurpleChatConversation **chats;
+		gchar *prefix = g_strdup_printf("roster%u-", i);
+		gdouble add, feed, worst = 0;
+
+		chats = test_purple_conversations_join(gc, prefix, 1);
+		purple_conversation_set_ui_ops(PURPLE_CONVERSATION(chats[0]),
+		                               &test_purple_conversations_ui_ops);
+		test_purple_conversations_ui_reset();
+
+		g_test_timer_start();
+		test_purple_conversations_add_roster(chats[0], "member", counts[i]);
+		add = g_test_timer_elapsed();
+
+		feed = 0;
+		while (test_purple_conversations_ui_users < counts[i]) {
+			gdouble elapsed;
+
+			g_test_timer_start();
+			g_main_context_iteration(NULL, FALSE);
+			elapsed = g_test_timer_elapsed();
+
+			feed += elapsed;
+			worst = MAX(worst, elapsed);
+		}
+
+		g_test_minimized_result(add,
+			"%d users: %.1f ms to join, %.1f ms to feed the UI in %d chunks, "
+			"%.2f ms per main loop iteration at most",
+			counts[i], add * 1e3, feed * 1e3,
+			test_purple_conversations_ui_batches, worst * 1e3);
+
+		purple_conversation_set_ui_ops(PURPLE_CONVERSATION(chats[0]), NULL);
+		test_purple_conversations_leave(gc, chats, 1);
+		g_free(prefix);
+	}
+}
+
+static void
+test_purple_conversations_chat_in_performance(void) {
+	const gint counts[] = { 10, 100, 1000 };
+	const gint messages = 20000;
+	PurpleConnection *gc = test_ui_connect("performance");
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(counts); i++) {
+		PurpleChatConversation **chats;
+		gchar *prefix = g_strdup_printf("bench%u-", i);
+		time_t now = time(NULL);
+		gdouble elapsed;
+		gint j;
+
+		chats = test_purple_conversations_join(gc, prefix, counts[i]);
+
+		g_test_timer_start();
+		for (j = 0; j < messages; j++) {
+			/* Favour the rooms joined last, those used to be found last. */
+			purple_serv_got_chat_in(gc, counts[i] - (j % MIN(counts[i], 10)),
+			                        "someone", PURPLE_MESSAGE_RECV,
+			                        "The quick brown fox jumps over the lazy dog.",
+			                        now);
+		}
+		elapsed = g_test_timer_elapsed();
+
+		g_test_minimized_result(elapsed / messages,
+			"%d rooms: %.2f us per incoming chat message", counts[i],
+			elapsed * 1e6 / messages);
+
+		test_purple_conversations_leave(gc, chats, counts[i]);
+		g_free(prefix);
+	}
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	test_ui_protocol_add();
+
+	/* Keep the messages out of the logs and off the terminal. */
+	purple_prefs_set_bool("/purple/logging/log_chats", FALSE);
+	purple_conversations_set_ui_ops(NULL);
+
+	g_test_add_func("/conversations/find_chat",
+	                test_purple_conversations_find_chat);
+	g_test_add_func("/conversations/add_users",
+	                test_purple_conversations_add_users);
+	g_test_add_func("/conversations/history/count",
+	                test_purple_conversations_history_count);
+	g_test_add_func("/conversations/history/size",
+	                test_purple_conversations_history_size);
+	g_test_add_func("/conversations/history/budget",
+	                test_purple_conversations_history_budget);
+	if (g_test_perf()) {
+		g_test_add_func("/conversations/add_users/performance",
+		                test_purple_conversations_add_users_performance);
+		g_test_add_func("/conversations/chat_in/performance",
+		                test_purple_conversations_chat_in_performance);
+	}
+
+	return g_test_run();
+}
@@ -0,0 +1,754 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/******************************************************************************
+ * Server
+ *****************************************************************************/
+typedef struct {
+	GSocketService *service;
+	guint16 port;
+	gint connections;
+	gint closed;
+
+	GMutex lock;
+	GCond cond;
+	gboolean held;
+} TestPurpleHttpServer;
+
+/* Makes "/hold" and "/partial" wait until test_purple_http_server_release(). */
+static void
+test_purple_http_server_hold(TestPurpleHttpServer *server) {
+	g_mutex_lock(&server->lock);
+	server->held = TRUE;
+	g_mutex_unlock(&server->lock);
+}
+
+static void
+test_purple_http_server_release(TestPurpleHttpServer *server) {
+	g_mutex_lock(&server->lock);
+	server->held = FALSE;
+	g_cond_broadcast(&server->cond);
+	g_mutex_unlock(&server->lock);
+}
+
+static gboolean
+test_purple_http_server_is_held(TestPurpleHttpServer *server) {
+	gboolean held;
+
+	g_mutex_lock(&server->lock);
+	held = server->held;
+	g_mutex_unlock(&server->lock);
+
+	return held;
+}
+
+static void
+test_purple_http_server_wait(TestPurpleHttpServer *server) {
+	g_mutex_lock(&server->lock);
+	while (server->held)
+		g_cond_wait(&server->cond, &server->lock);
+	g_mutex_unlock(&server->lock);
+}
+
+static void
+test_purple_http_fill(gchar *buf, gsize offset, gsize len) {
+	gsize i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = 'a' + (offset + i) % 23;
+}
+
+/* Sends "/big/<n>", "/chunked/<n>" and "/gzip/<n>" bodies of n bytes. The
+ * gzipped one is compressed on the fly and ends with the connection. */
+static gboolean
+test_purple_http_server_send_body(GOutputStream *output, const gchar *path,
+                                  gboolean *closing)
+{
+	gchar buf[65536], *header;
+	gsize len, sent;
+
+	if (g_str_has_prefix(path, "/big/")) {
+		len = g_ascii_strtoull(path + 5, NULL, 10);
+		header = g_strdup_printf("HTTP/1.1 200 OK\r\n"
+		                         "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+		                         "\r\n", len);
+		g_output_stream_write_all(output, header, strlen(header), NULL,
+		                          NULL, NULL);
+		g_free(header);
+
+		for (sent = 0; sent < len; sent += sizeof(buf)) {
+			gsize block = MIN(sizeof(buf), len - sent);
+
+			test_purple_http_fill(buf, sent, block);
+			if (!g_output_stream_write_all(output, buf, block, NULL, NULL,
+			                               NULL))
+			{
+				break;
+			}
+		}
+	} else if (g_str_has_prefix(path, "/chunked/")) {
+		/* Odd chunk sizes, so the lines are split between reads. */
+		const gsize sizes[] = { 1, 4093, 17, 16384, 9000 };
+		guint i = 0;
+
+		len = g_ascii_strtoull(path + 9, NULL, 10);
+		header = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+		g_output_stream_write_all(output, header, strlen(header), NULL,
+		                          NULL, NULL);
+
+		for (sent = 0; sent < len; i++) {
+			gsize block = MIN(sizes[i % G_N_ELEMENTS(sizes)], len - sent);
+			gchar *line = g_strdup_printf("%" G_GSIZE_MODIFIER "x\r\n",
+			                              block);
+
+			g_output_stream_write_all(output, line, strlen(line), NULL,
+			                          NULL, NULL);
+			g_free(line);
+			test_purple_http_fill(buf, sent, block);
+			g_output_stream_write_all(output, buf, block, NULL, NULL, NULL);
+			g_output_stream_write_all(output, "\r\n", 2, NULL, NULL, NULL);
+			sent += block;
+		}
+		g_output_stream_write_all(output, "0\r\n\r\n", 5, NULL, NULL,
+		                          NULL);
+	} else if (g_str_has_prefix(path, "/gzip/")) {
+		GZlibCompressor *compressor;
+		GOutputStream *gzip;
+
+		len = g_ascii_strtoull(path + 6, NULL, 10);
+		header = "HTTP/1.1 200 OK\r\n"
+		         "Content-Encoding: gzip\r\n"
+		         "Connection: close\r\n"
+		         "\r\n";
+		g_output_stream_write_all(output, header, strlen(header), NULL,
+		                          NULL, NULL);
+
+		compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, 1);
+		gzip = g_converter_output_stream_new(output,
+		                                     G_CONVERTER(compressor));
+		g_filter_output_stream_set_close_base_stream(
+			G_FILTER_OUTPUT_STREAM(gzip), FALSE);
+		for (sent = 0; sent < len; sent += sizeof(buf)) {
+			gsize block = MIN(sizeof(buf), len - sent);
+
+			test_purple_http_fill(buf, sent, block);
+			if (!g_output_stream_write_all(gzip, buf, block, NULL, NULL,
+			                               NULL))
+			{
+				break;
+			}
+		}
+		g_output_stream_close(gzip, NULL, NULL);
+		g_object_unref(gzip);
+		g_object_unref(compressor);
+
+		*closing = TRUE;
+	} else {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Answers each request with its path. "/hold" waits for the test to release
+ * it, "/close" closes the connection afterwards and "/partial" sends part of
+ * its body, waits and closes the connection. */
+static gboolean
+test_purple_http_server_run_cb(GThreadedSocketService *service,
+                               GSocketConnection *conn, GObject *source,
+                               gpointer data)
+{
+	TestPurpleHttpServer *server = data;
+	GDataInputStream *input;
+	GOutputStream *output;
+	gchar *line, *path = NULL;
+
+	g_atomic_int_inc(&server->connections);
+
+	input = g_data_input_stream_new(
+		g_io_stream_get_input_stream(G_IO_STREAM(conn)));
+	g_data_input_stream_set_newline_type(input,
+	                                     G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+	output = g_io_stream_get_output_stream(G_IO_STREAM(conn));
+
+	while ((line = g_data_input_stream_read_line(input, NULL, NULL,
+	                                              NULL)) != NULL)
+	{
+		gboolean closing;
+		gchar *response;
+
+		if (path == NULL) {
+			gchar **request = g_strsplit(line, " ", 3);
+
+			path = g_strdup(request[1]);
+			g_strfreev(request);
+			g_free(line);
+			continue;
+		}
+
+		if (*line != '\0') {
+			g_free(line);
+			continue;
+		}
+		g_free(line);
+
+		closing = FALSE;
+		if (test_purple_http_server_send_body(output, path, &closing)) {
+			g_free(path);
+			path = NULL;
+			if (closing)
+				break;
+			continue;
+		}
+
+		if (g_str_equal(path, "/partial")) {
+			const gchar *partial = "HTTP/1.1 200 OK\r\n"
+			                       "Content-Length: 100\r\n"
+			                       "\r\n"
+			                       "0123456789";
+
+			g_output_stream_write_all(output, partial, strlen(partial),
+			                          NULL, NULL, NULL);
+			g_output_stream_flush(output, NULL, NULL);
+			test_purple_http_server_wait(server);
+			break;
+		}
+
+		if (g_str_equal(path, "/hold"))
+			test_purple_http_server_wait(server);
+		closing = g_str_equal(path, "/close");
+
+		response = g_strdup_printf("HTTP/1.1 200 OK\r\n"
+		                           "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+		                           "%s"
+		                           "\r\n"
+		                           "%s",
+		                           strlen(path),
+		                           closing ? "Connection: close\r\n" : "",
+		                           path);
+		g_output_stream_write_all(output, response, strlen(response), NULL,
+		                          NULL, NULL);
+		g_free(response);
+
+		g_free(path);
+		path = NULL;
+
+		if (closing)
+			break;
+	}
+
+	g_free(path);
+	g_object_unref(input);
+
+	/* Let the test see the connection is gone. */
+	g_atomic_int_inc(&server->closed);
+	g_main_context_wakeup(NULL);
+
+	return TRUE;
+}
+
+static TestPurpleHttpServer *
+test_purple_http_server_new(void) {
+	TestPurpleHttpServer *server = g_new0(TestPurpleHttpServer, 1);
+
+	g_mutex_init(&server->lock);
+	g_cond_init(&server->cond);
+
+	server->service = g_threaded_socket_service_new(-1);
+	server->port = g_socket_listener_add_any_inet_port(
+		G_SOCKET_LISTENER(server->service), NULL, NULL);
+	g_assert_cmpint(server->port, !=, 0);
+
+	g_signal_connect(server->service, "run",
+	                 G_CALLBACK(test_purple_http_server_run_cb), server);
+	g_socket_service_start(server->service);
+
+	return server;
+}
+
+static void
+test_purple_http_server_free(TestPurpleHttpServer *server) {
+	test_purple_http_server_release(server);
+	g_socket_service_stop(server->service);
+	g_socket_listener_close(G_SOCKET_LISTENER(server->service));
+	g_object_unref(server->service);
+	g_mutex_clear(&server->lock);
+	g_cond_clear(&server->cond);
+	g_free(server);
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+typedef struct {
+	GPtrArray *bodies;
+	guint running;
+} TestPurpleHttpRequests;
+
+static void
+test_purple_http_response_cb(PurpleHttpConnection *http_conn,
+                             PurpleHttpResponse *response, gpointer data)
+{
+	TestPurpleHttpRequests *requests = data;
+
+	g_assert_true(purple_http_response_is_successful(response));
+	g_ptr_array_add(requests->bodies,
+	                g_strdup(purple_http_response_get_data(response, NULL)));
+	requests->running--;
+}
+
+/* Performs GET requests for all the paths at once and waits for them. A held
+ * server is released once the rest are pipelined behind the first one. */
+static void
+test_purple_http_get_all(PurpleConnection *gc, PurpleHttpKeepalivePool *pool,
+                         TestPurpleHttpServer *server, const gchar **paths,
+                         guint count)
+{
+	TestPurpleHttpRequests requests;
+	guint i;
+
+	requests.bodies = g_ptr_array_new_with_free_func(g_free);
+	requests.running = count;
+
+	for (i = 0; i < count; i++) {
+		PurpleHttpRequest *request;
+
+		request = purple_http_request_new(NULL);
+		purple_http_request_set_url_printf(request, "http://127.0.0.1:%d%s",
+		                                   server->port, paths[i]);
+		if (pool != NULL)
+			purple_http_request_set_keepalive_pool(request, pool);
+		purple_http_request(gc, request, test_purple_http_response_cb,
+		                    &requests);
+		purple_http_request_unref(request);
+	}
+
+	while (requests.running > 0) {
+		if (pool != NULL && test_purple_http_server_is_held(server)) {
+			PurpleHttpKeepaliveStats stats;
+
+			purple_http_keepalive_pool_get_stats(pool, &stats);
+			if (stats.pipelined == count - 1)
+				test_purple_http_server_release(server);
+		}
+
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	/* The responses come in order. */
+	g_assert_cmpint(count, ==, requests.bodies->len);
+	for (i = 0; i < count; i++)
+		g_assert_cmpstr(paths[i], ==, g_ptr_array_index(requests.bodies, i));
+
+	g_ptr_array_free(requests.bodies, TRUE);
+}
+
+typedef struct {
+	PurpleHttpConnection *http_conn;
+	gsize offset;
+	gsize mismatch;
+	guint writes;
+	gboolean pause;
+	gboolean settled;
+	gboolean done;
+} TestPurpleHttpStream;
+
+/* Runs once the read that paused the connection is done with. */
+static gboolean
+test_purple_http_stream_settled_cb(gpointer data) {
+	TestPurpleHttpStream *stream = data;
+
+	stream->settled = TRUE;
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+test_purple_http_stream_resume_cb(gpointer data) {
+	TestPurpleHttpStream *stream = data;
+
+	g_assert_true(purple_http_conn_is_paused(stream->http_conn));
+	stream->settled = FALSE;
+	purple_http_conn_resume(stream->http_conn);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+test_purple_http_stream_writer(PurpleHttpConnection *http_conn,
+                               PurpleHttpResponse *response,
+                               const gchar *buffer, size_t offset,
+                               size_t length, gpointer data)
+{
+	TestPurpleHttpStream *stream = data;
+	gchar expected[16384];
+
+	/* Nothing is read from the socket while paused. */
+	g_assert_false(stream->settled);
+	g_assert_cmpint(offset, ==, stream->offset + length);
+	g_assert_cmpint(length, <=, sizeof(expected));
+
+	test_purple_http_fill(expected, stream->offset, length);
+	if (memcmp(expected, buffer, length) != 0 && stream->mismatch == 0)
+		stream->mismatch = stream->offset + 1;
+
+	stream->offset += length;
+	stream->writes++;
+
+	/* Be a slower consumer than the server now and then. */
+	if (stream->pause && stream->writes % 8 == 0 &&
+	    !purple_http_conn_is_paused(http_conn))
+	{
+		stream->http_conn = http_conn;
+		purple_http_conn_pause(http_conn);
+		g_idle_add_full(G_PRIORITY_HIGH, test_purple_http_stream_settled_cb,
+		                stream, NULL);
+		g_idle_add(test_purple_http_stream_resume_cb, stream);
+	}
+
+	return TRUE;
+}
+
+static void
+test_purple_http_stream_done_cb(PurpleHttpConnection *http_conn,
+                                PurpleHttpResponse *response, gpointer data)
+{
+	TestPurpleHttpStream *stream = data;
+	size_t len;
+
+	g_assert_true(purple_http_response_is_successful(response));
+
+	/* Nothing was kept in memory. */
+	purple_http_response_get_data(response, &len);
+	g_assert_cmpint(0, ==, len);
+
+	stream->done = TRUE;
+}
+
+/* Streams the body at path through the response writer, returns how long it
+ * took. */
+static gdouble
+test_purple_http_stream(PurpleConnection *gc, TestPurpleHttpServer *server,
+                        const gchar *path, gsize len, gboolean pause)
+{
+	TestPurpleHttpStream stream = { NULL, 0, 0, 0, pause, FALSE, FALSE };
+	PurpleHttpRequest *request;
+
+	request = purple_http_request_new(NULL);
+	purple_http_request_set_url_printf(request, "http://127.0.0.1:%d%s",
+	                                   server->port, path);
+	purple_http_request_set_max_len(request, -1);
+	purple_http_request_set_timeout(request, 600);
+	purple_http_request_set_response_writer(request,
+		test_purple_http_stream_writer, &stream);
+
+	g_test_timer_start();
+	purple_http_request(gc, request, test_purple_http_stream_done_cb,
+	                    &stream);
+	purple_http_request_unref(request);
+
+	while (!stream.done)
+		g_main_context_iteration(NULL, TRUE);
+
+	/* Let a pending resume run, while stream is still around. */
+	while (g_main_context_iteration(NULL, FALSE));
+
+	g_assert_cmpint(0, ==, stream.mismatch);
+	g_assert_cmpint(len, ==, stream.offset);
+
+	return g_test_timer_elapsed();
+}
+
+typedef struct {
+	gboolean got_body;
+	gboolean done;
+	gboolean successful;
+} TestPurpleHttpAbort;
+
+static gboolean
+test_purple_http_abort_writer(PurpleHttpConnection *http_conn,
+                              PurpleHttpResponse *response,
+                              const gchar *buffer, size_t offset,
+                              size_t length, gpointer data)
+{
+	TestPurpleHttpAbort *state = data;
+
+	state->got_body = TRUE;
+
+	return TRUE;
+}
+
+static void
+test_purple_http_abort_cb(PurpleHttpConnection *http_conn,
+                          PurpleHttpResponse *response, gpointer data)
+{
+	TestPurpleHttpAbort *state = data;
+
+	state->successful = purple_http_response_is_successful(response);
+	state->done = TRUE;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_purple_http_keepalive_default(void) {
+	const gchar *first[] = { "/first" }, *second[] = { "/second" };
+	PurpleConnection *gc = test_ui_connect("default");
+	TestPurpleHttpServer *server = test_purple_http_server_new();
+	PurpleHttpKeepalivePool *pool = purple_http_keepalive_pool_get_default();
+	PurpleHttpKeepaliveStats before, after;
+
+	g_assert_nonnull(pool);
+	purple_http_keepalive_pool_get_stats(pool, &before);
+
+	/* Requests without a pool of their own share the connection. */
+	test_purple_http_get_all(gc, NULL, server, first, 1);
+	test_purple_http_get_all(gc, NULL, server, second, 1);
+
+	purple_http_keepalive_pool_get_stats(pool, &after);
+	g_assert_cmpint(2, ==, after.requests - before.requests);
+	g_assert_cmpint(1, ==, after.connections - before.connections);
+	g_assert_cmpint(1, ==, after.reused - before.reused);
+	g_assert_cmpint(0, ==, after.handshakes_saved - before.handshakes_saved);
+	g_assert_cmpint(1, ==, g_atomic_int_get(&server->connections));
+
+	test_ui_disconnect(gc);
+	test_purple_http_server_free(server);
+}
+
+static void
+test_purple_http_keepalive_pipelining(void) {
+	const gchar *paths[] = { "/hold", "/a", "/b", "/c" };
+	PurpleConnection *gc = test_ui_connect("pipelining");
+	TestPurpleHttpServer *server = test_purple_http_server_new();
+	PurpleHttpKeepalivePool *pool = purple_http_keepalive_pool_new();
+	PurpleHttpKeepaliveStats stats;
+
+	purple_http_keepalive_pool_set_limit_per_host(pool, 1);
+	purple_http_keepalive_pool_set_pipelining(pool, TRUE);
+
+	test_purple_http_server_hold(server);
+	test_purple_http_get_all(gc, pool, server, paths, G_N_ELEMENTS(paths));
+
+	purple_http_keepalive_pool_get_stats(pool, &stats);
+	g_assert_cmpint(G_N_ELEMENTS(paths), ==, stats.requests);
+	g_assert_cmpint(1, ==, stats.connections);
+	g_assert_cmpint(G_N_ELEMENTS(paths) - 1, ==, stats.reused);
+	g_assert_cmpint(G_N_ELEMENTS(paths) - 1, ==, stats.pipelined);
+	g_assert_cmpint(stats.queue_wait_max, >, 0);
+	g_assert_cmpint(1, ==, g_atomic_int_get(&server->connections));
+
+	purple_http_keepalive_pool_unref(pool);
+	test_ui_disconnect(gc);
+	test_purple_http_server_free(server);
+}
+
+static void
+test_purple_http_keepalive_idle_timeout(void) {
+	const gchar *paths[] = { "/idle" };
+	PurpleConnection *gc = test_ui_connect("idle");
+	TestPurpleHttpServer *server = test_purple_http_server_new();
+	PurpleHttpKeepalivePool *pool = purple_http_keepalive_pool_new();
+	PurpleHttpKeepaliveStats stats;
+
+	purple_http_keepalive_pool_set_idle_timeout(pool, 1);
+
+	test_purple_http_get_all(gc, pool, server, paths, 1);
+
+	/* Wait for the pool to drop the idle connection. */
+	while (g_atomic_int_get(&server->closed) == 0)
+		g_main_context_iteration(NULL, TRUE);
+
+	test_purple_http_get_all(gc, pool, server, paths, 1);
+
+	purple_http_keepalive_pool_get_stats(pool, &stats);
+	g_assert_cmpint(2, ==, stats.connections);
+	g_assert_cmpint(0, ==, stats.reused);
+	g_assert_cmpint(2, ==, g_atomic_int_get(&server->connections));
+
+	purple_http_keepalive_pool_unref(pool);
+	test_ui_disconnect(gc);
+	test_purple_http_server_free(server);
+}
+
+static void
+test_purple_http_keepalive_server_close(void) {
+	const gchar *first[] = { "/close" }, *second[] = { "/second" };
+	PurpleConnection *gc = test_ui_connect("close");
+	TestPurpleHttpServer *server = test_purple_http_server_new();
+	PurpleHttpKeepalivePool *pool = purple_http_keepalive_pool_new();
+	PurpleHttpKeepaliveStats stats;
+
+	/* A connection the server closes isn't reused (or retried). */
+	test_purple_http_get_all(gc, pool, server, first, 1);
+	test_purple_http_get_all(gc, pool, server, second, 1);
+
+	purple_http_keepalive_pool_get_stats(pool, &stats);
+	g_assert_cmpint(2, ==, stats.requests);
+	g_assert_cmpint(2, ==, stats.connections);
+	g_assert_cmpint(0, ==, stats.reused);
+
+	purple_http_keepalive_pool_unref(pool);
+	test_ui_disconnect(gc);
+	test_purple_http_server_free(server);
+}
+
+static void
+test_purple_http_keepalive_pipeline_abort(void) {
+	PurpleConnection *gc = test_ui_connect("abort");
+	TestPurpleHttpServer *server = test_purple_http_server_new();
+	PurpleHttpKeepalivePool *pool = purple_http_keepalive_pool_new();
+	PurpleHttpKeepaliveStats stats;
+	TestPurpleHttpAbort head = { FALSE, FALSE, FALSE };
+	TestPurpleHttpAbort next = { FALSE, FALSE, FALSE };
+	PurpleHttpRequest *request;
+	PurpleHttpConnection *next_conn;
+
+	purple_http_keepalive_pool_set_limit_per_host(pool, 1);
+	purple_http_keepalive_pool_set_pipelining(pool, TRUE);
+	test_purple_http_server_hold(server);
+
+	request = purple_http_request_new(NULL);
+	purple_http_request_set_url_printf(request, "http://127.0.0.1:%d/partial",
+	                                   server->port);
+	purple_http_request_set_keepalive_pool(request, pool);
+	purple_http_request_set_response_writer(request,
+		test_purple_http_abort_writer, &head);
+	purple_http_request(gc, request, test_purple_http_abort_cb, &head);
+	purple_http_request_unref(request);
+
+	request = purple_http_request_new(NULL);
+	purple_http_request_set_url_printf(request, "http://127.0.0.1:%d/next",
+	                                   server->port);
+	purple_http_request_set_keepalive_pool(request, pool);
+	next_conn = purple_http_request(gc, request, test_purple_http_abort_cb,
+	                                &next);
+	purple_http_request_unref(request);
+
+	for (;;) {
+		purple_http_keepalive_pool_get_stats(pool, &stats);
+		if (head.got_body && stats.pipelined == 1)
+			break;
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	/* Dropping the request behind it breaks the connection. Part of the
+	 * first one's body is already out, so it fails instead of being sent
+	 * again. */
+	purple_http_conn_cancel(next_conn);
+	while (!head.done)
+		g_main_context_iteration(NULL, TRUE);
+
+	g_assert_true(next.done);
+	g_assert_false(next.successful);
+	g_assert_false(head.successful);
+
+	purple_http_keepalive_pool_get_stats(pool, &stats);
+	g_assert_cmpint(2, ==, stats.requests);
+	g_assert_cmpint(1, ==, stats.connections);
+	g_assert_cmpint(1, ==, g_atomic_int_get(&server->connections));
+
+	purple_http_keepalive_pool_unref(pool);
+	test_ui_disconnect(gc);
+	test_purple_http_server_free(server);
+}
+
+static void
+test_purple_http_stream_writer_paused(void) {
+	const gchar *paths[] = { "/big/%d", "/chunked/%d", "/gzip/%d" };
+	const gint len = 1024 * 1024 + 3;
+	PurpleConnection *gc = test_ui_connect("stream");
+	TestPurpleHttpServer *server = test_purple_http_server_new();
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(paths); i++) {
+		gchar *path = g_strdup_printf(paths[i], len);
+
+		test_purple_http_stream(gc, server, path, len, TRUE);
+		g_free(path);
+	}
+
+	test_ui_disconnect(gc);
+	test_purple_http_server_free(server);
+}
+
+static void
+test_purple_http_stream_performance(void) {
+	const gchar *paths[] = { "/big/%d", "/chunked/%d", "/gzip/%d" };
+	const gint len = 100 * 1024 * 1024;
+	PurpleConnection *gc = test_ui_connect("performance");
+	TestPurpleHttpServer *server = test_purple_http_server_new();
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(paths); i++) {
+		gchar *path = g_strdup_printf(paths[i], len);
+		gdouble elapsed;
+
+		elapsed = test_purple_http_stream(gc, server, path, len, FALSE);
+		g_test_minimized_result(elapsed, "%s: %.1f MB/s", path,
+		                        len / elapsed / (1024 * 1024));
+		g_free(path);
+	}
+
+	test_ui_disconnect(gc);
+	test_purple_http_server_free(server);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	test_ui_protocol_add();
+
+	g_test_add_func("/http/keepalive/default",
+	                test_purple_http_keepalive_default);
+	g_test_add_func("/http/keepalive/pipelining",
+	                test_purple_http_keepalive_pipelining);
+	g_test_add_func("/http/keepalive/idle-timeout",
+	                test_purple_http_keepalive_idle_timeout);
+	g_test_add_func("/http/keepalive/server-close",
+	                test_purple_http_keepalive_server_close);
+	g_test_add_func("/http/keepalive/pipeline-abort",
+	                test_purple_http_keepalive_pipeline_abort);
+	g_test_add_func("/http/stream/writer-paused",
+	                test_purple_http_stream_writer_paused);
+	if (g_test_perf()) {
+		g_test_add_func("/http/stream/performance",
+		                test_purple_http_stream_performance);
+	}
+
+	return g_test_run();
+}
@@ -0,0 +1,308 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_purple_log_remove_dir(const gchar *path) {
+	GDir *dir = g_dir_open(path, 0, NULL);
+	const gchar *name;
+
+	if (dir == NULL) {
+		g_unlink(path);
+		return;
+	}
+
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		gchar *child = g_build_filename(path, name, NULL);
+		test_purple_log_remove_dir(child);
+		g_free(child);
+	}
+	g_dir_close(dir);
+
+	g_rmdir(path);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_purple_log_close_buffered(void) {
+	PurpleAccount *account;
+	GDateTime *now;
+	PurpleLogCommonLoggerData *data;
+	PurpleLog *log;
+	GList *list;
+	gchar *contents;
+
+	/* Run in a process of its own, so no other test has started the
+	 * writer thread yet. */
+	if (!g_test_subprocess()) {
+		g_test_trap_subprocess(NULL, 0, 0);
+		g_test_trap_assert_passed();
+		return;
+	}
+
+	account = purple_account_new("closer", TEST_UI_PROTOCOL_ID);
+	now = g_date_time_new_now_local();
+
+	/* A short conversation that ends before anything was flushed. */
+	log = purple_log_new(PURPLE_LOG_IM, "short", account, NULL, now);
+	purple_log_write(log, PURPLE_MESSAGE_SEND, "me", now, "goodbye");
+	purple_log_free(log);
+	purple_log_common_sync();
+
+	list = purple_log_get_logs(PURPLE_LOG_IM, "short", account);
+	g_assert_cmpint(1, ==, g_list_length(list));
+
+	data = ((PurpleLog *)list->data)->logger_data;
+	g_assert_true(g_file_get_contents(data->path, &contents, NULL, NULL));
+	g_assert_nonnull(strstr(contents, "<html>"));
+	g_assert_nonnull(strstr(contents, "goodbye"));
+	g_assert_true(g_str_has_suffix(contents, "</body></html>\n"));
+	g_free(contents);
+
+	g_list_free_full(list, (GDestroyNotify)purple_log_free);
+	g_date_time_unref(now);
+	g_object_unref(account);
+}
+
+static void
+test_purple_log_write_order(void) {
+	PurpleAccount *account = purple_account_new("writer", TEST_UI_PROTOCOL_ID);
+	GDateTime *now = g_date_time_new_now_local();
+	PurpleLog *logs[2];
+	gint i, j;
+
+	logs[0] = purple_log_new(PURPLE_LOG_CHAT, "first", account, NULL, now);
+	logs[1] = purple_log_new(PURPLE_LOG_CHAT, "second", account, NULL, now);
+
+	/* Interleave the two logs so both are buffered at the same time. */
+	for (i = 0; i < 1000; i++) {
+		for (j = 0; j < 2; j++) {
+			gchar *msg = g_strdup_printf("message %d", i);
+			purple_log_write(logs[j], PURPLE_MESSAGE_RECV, "someone", now,
+			                 msg);
+			g_free(msg);
+		}
+	}
+
+	purple_log_free(logs[0]);
+	purple_log_free(logs[1]);
+	purple_log_common_sync();
+
+	for (j = 0; j < 2; j++) {
+		GList *list = purple_log_get_logs(PURPLE_LOG_CHAT,
+		                                  j == 0 ? "first" : "second",
+		                                  account);
+		PurpleLogReadFlags flags;
+		const gchar *pos;
+		gchar *text;
+
+		g_assert_cmpint(1, ==, g_list_length(list));
+
+		text = purple_log_read(list->data, &flags);
+		pos = text;
+		for (i = 0; i < 1000; i++) {
+			gchar *msg = g_strdup_printf("message %d<", i);
+			pos = strstr(pos, msg);
+			g_assert_nonnull(pos);
+			g_free(msg);
+		}
+		g_free(text);
+
+		g_list_free_full(list, (GDestroyNotify)purple_log_free);
+	}
+
+	g_date_time_unref(now);
+	g_object_unref(account);
+}
+
+static void
+test_purple_log_catalog(void) {
+	PurpleAccount *account = purple_account_new("catalog", TEST_UI_PROTOCOL_ID);
+	GDateTime *now = g_date_time_new_now_local();
+	PurpleLog *log;
+	GList *list;
+	gint i, size;
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy", account, NULL, now);
+	for (i = 0; i < 3; i++) {
+		purple_log_write(log, PURPLE_MESSAGE_SEND, "me", now, "hello");
+	}
+	g_assert_cmpint(3, ==, purple_log_common_get_message_count(log));
+	purple_log_free(log);
+	purple_log_common_sync();
+
+	list = purple_log_get_logs(PURPLE_LOG_IM, "buddy", account);
+	g_assert_cmpint(1, ==, g_list_length(list));
+
+	/* The catalog's idea of the size matches what ended up on disk. */
+	log = list->data;
+	size = purple_log_get_size(log);
+	g_assert_cmpint(size, >, 0);
+	g_assert_cmpint(size, ==,
+		purple_log_get_total_size(PURPLE_LOG_IM, "buddy", account));
+	g_assert_cmpint(3, ==, purple_log_common_get_message_count(log));
+
+	g_assert_true(purple_log_delete(log));
+	g_list_free_full(list, (GDestroyNotify)purple_log_free);
+	g_assert_cmpint(0, ==, purple_log_common_total_sizer(PURPLE_LOG_IM,
+		"buddy", account, ".html"));
+
+	g_date_time_unref(now);
+	g_object_unref(account);
+}
+
+static void
+test_purple_log_catalog_raw_write(void) {
+	PurpleAccount *account = purple_account_new("raw", TEST_UI_PROTOCOL_ID);
+	GDateTime *now = g_date_time_new_now_local();
+	PurpleLog *log;
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy", account, NULL, now);
+	purple_log_write(log, PURPLE_MESSAGE_SEND, "me", now, "hello");
+	g_assert_cmpint(1, ==, purple_log_common_get_message_count(log));
+
+	/* Raw data may hold any number of messages. */
+	purple_log_common_write(log, "<b>raw</b>\n", -1);
+	g_assert_cmpint(-1, ==, purple_log_common_get_message_count(log));
+
+	purple_log_write(log, PURPLE_MESSAGE_SEND, "me", now, "hello again");
+	g_assert_cmpint(-1, ==, purple_log_common_get_message_count(log));
+
+	purple_log_free(log);
+	g_date_time_unref(now);
+	g_object_unref(account);
+}
+
+static void
+test_purple_log_write_performance(void) {
+	const struct {
+		gint rate;
+		gint conversations;
+	} replays[] = { { 1000, 10 }, { 1000, 100 }, { 5000, 500 } };
+	PurpleAccount *account = purple_account_new("replay", TEST_UI_PROTOCOL_ID);
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(replays); i++) {
+		GDateTime *now = g_date_time_new_now_local();
+		PurpleLog **logs = g_new(PurpleLog *, replays[i].conversations);
+		gdouble total = 0, worst = 0, drain;
+		gint64 start;
+		gint n, msgs = 0;
+
+		for (n = 0; n < replays[i].conversations; n++) {
+			gchar *name = g_strdup_printf("room%d-%d", i, n);
+			logs[n] = purple_log_new(PURPLE_LOG_CHAT, name, account, NULL, now);
+			g_free(name);
+		}
+
+		/* Replay one second of traffic in 10ms slices. */
+		start = g_get_monotonic_time();
+		for (n = 0; n < 100; n++) {
+			gint m;
+
+			for (m = 0; m < replays[i].rate / 100; m++, msgs++) {
+				gdouble elapsed;
+
+				g_test_timer_start();
+				purple_log_write(logs[msgs % replays[i].conversations],
+				                 PURPLE_MESSAGE_RECV, "someone", now,
+				                 "The quick brown fox jumps over the lazy dog.");
+				elapsed = g_test_timer_elapsed();
+
+				total += elapsed;
+				worst = MAX(worst, elapsed);
+			}
+
+			while (g_main_context_iteration(NULL, FALSE));
+			g_usleep(MAX(0, start + (n + 1) * 10000 - g_get_monotonic_time()));
+		}
+
+		g_test_timer_start();
+		for (n = 0; n < replays[i].conversations; n++)
+			purple_log_free(logs[n]);
+		purple_log_common_sync();
+		drain = g_test_timer_elapsed();
+
+		g_test_minimized_result(total / msgs,
+			"%d msgs/s across %d conversations: %.2f us mean, %.2f us max "
+			"per message, %.1f ms to close and sync",
+			replays[i].rate, replays[i].conversations,
+			total * 1e6 / msgs, worst * 1e6, drain * 1e3);
+
+		g_free(logs);
+		g_date_time_unref(now);
+	}
+
+	g_object_unref(account);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gchar *dir;
+	gint res;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	test_ui_protocol_add();
+
+	dir = g_dir_make_tmp("test_log-XXXXXX", NULL);
+	g_assert_nonnull(dir);
+	purple_util_set_user_dir(dir);
+	purple_prefs_set_string("/purple/logging/format", "html");
+
+	g_test_add_func("/log/close/buffered",
+	                test_purple_log_close_buffered);
+	g_test_add_func("/log/write/order",
+	                test_purple_log_write_order);
+	g_test_add_func("/log/catalog",
+	                test_purple_log_catalog);
+	g_test_add_func("/log/catalog/raw-write",
+	                test_purple_log_catalog_raw_write);
+	if (g_test_perf()) {
+		g_test_add_func("/log/write/performance",
+		                test_purple_log_write_performance);
+	}
+
+	res = g_test_run();
+
+	test_purple_log_remove_dir(dir);
+	g_free(dir);
+
+	return res;
+}
@@ -0,0 +1,193 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+static gint test_prefs_handle;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+/* Appends "name=value;" to the GString in data. */
+static void
+test_prefs_record_cb(const char *name, PurplePrefType type, gconstpointer val,
+                     gpointer data)
+{
+	g_string_append_printf(data, "%s=%d;", name, GPOINTER_TO_INT(val));
+}
+
+static guint test_prefs_saves = 0;
+
+static void
+test_prefs_schedule_save(void) {
+	test_prefs_saves++;
+}
+
+/* Only counts saves, everything else is left to libpurple. */
+static PurplePrefsUiOps test_prefs_ui_ops = {
+	.schedule_save = test_prefs_schedule_save,
+};
+
+/* Adds /test/a, /test/b and /test/c, and records when they change. */
+static GString *
+test_prefs_setup(void) {
+	GString *calls = g_string_new(NULL);
+
+	purple_prefs_add_none("/test");
+	purple_prefs_add_int("/test/a", 0);
+	purple_prefs_add_int("/test/b", 0);
+	purple_prefs_add_int("/test/c", 0);
+
+	purple_prefs_connect_callback(&test_prefs_handle, "/test/a",
+	                              test_prefs_record_cb, calls);
+	purple_prefs_connect_callback(&test_prefs_handle, "/test/b",
+	                              test_prefs_record_cb, calls);
+	purple_prefs_connect_callback(&test_prefs_handle, "/test/c",
+	                              test_prefs_record_cb, calls);
+
+	return calls;
+}
+
+static void
+test_prefs_teardown(GString *calls) {
+	purple_prefs_disconnect_by_handle(&test_prefs_handle);
+	purple_prefs_remove("/test");
+	g_string_free(calls, TRUE);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_prefs_transaction_coalesce(void) {
+	GString *calls = test_prefs_setup();
+
+	purple_prefs_begin_transaction();
+	purple_prefs_set_int("/test/b", 1);
+	purple_prefs_set_int("/test/a", 1);
+	purple_prefs_set_int("/test/b", 2);
+	purple_prefs_set_int("/test/b", 3);
+	g_assert_cmpstr("", ==, calls->str);
+
+	/* Once per pref, in the order they first changed, with the last value. */
+	g_assert_cmpint(2, ==, purple_prefs_commit_transaction());
+	g_assert_cmpstr("/test/b=3;/test/a=1;", ==, calls->str);
+
+	/* Outside of a transaction every change calls back right away. */
+	g_string_truncate(calls, 0);
+	purple_prefs_set_int("/test/c", 1);
+	purple_prefs_set_int("/test/c", 2);
+	g_assert_cmpstr("/test/c=1;/test/c=2;", ==, calls->str);
+
+	/* Nothing changed, nothing to call. */
+	g_string_truncate(calls, 0);
+	purple_prefs_begin_transaction();
+	purple_prefs_set_int("/test/c", 2);
+	g_assert_cmpint(0, ==, purple_prefs_commit_transaction());
+	g_assert_cmpstr("", ==, calls->str);
+
+	test_prefs_teardown(calls);
+}
+
+static void
+test_prefs_transaction_nested(void) {
+	GString *calls = test_prefs_setup();
+
+	purple_prefs_begin_transaction();
+	purple_prefs_set_int("/test/a", 1);
+
+	purple_prefs_begin_transaction();
+	purple_prefs_set_int("/test/b", 1);
+	purple_prefs_set_int("/test/a", 2);
+	g_assert_cmpint(0, ==, purple_prefs_commit_transaction());
+	g_assert_cmpstr("", ==, calls->str);
+
+	purple_prefs_set_int("/test/c", 1);
+	g_assert_cmpint(3, ==, purple_prefs_commit_transaction());
+	g_assert_cmpstr("/test/a=2;/test/b=1;/test/c=1;", ==, calls->str);
+
+	test_prefs_teardown(calls);
+}
+
+static void
+test_prefs_transaction_save(void) {
+	GString *calls = test_prefs_setup();
+
+	purple_prefs_set_ui_ops(&test_prefs_ui_ops);
+	test_prefs_saves = 0;
+
+	purple_prefs_set_int("/test/a", 1);
+	purple_prefs_set_int("/test/b", 1);
+	g_assert_cmpint(2, ==, test_prefs_saves);
+
+	test_prefs_saves = 0;
+	purple_prefs_begin_transaction();
+	purple_prefs_set_int("/test/a", 2);
+	purple_prefs_set_int("/test/b", 2);
+	purple_prefs_set_int("/test/c", 2);
+	g_assert_cmpint(0, ==, test_prefs_saves);
+	g_assert_cmpint(3, ==, purple_prefs_commit_transaction());
+	g_assert_cmpint(1, ==, test_prefs_saves);
+
+	purple_prefs_set_ui_ops(NULL);
+
+	test_prefs_teardown(calls);
+}
+
+static void
+test_prefs_transaction_removed(void) {
+	GString *calls = test_prefs_setup();
+
+	purple_prefs_begin_transaction();
+	purple_prefs_set_int("/test/a", 1);
+	purple_prefs_set_int("/test/b", 1);
+	purple_prefs_remove("/test/a");
+	g_assert_cmpint(1, ==, purple_prefs_commit_transaction());
+	g_assert_cmpstr("/test/b=1;", ==, calls->str);
+
+	test_prefs_teardown(calls);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/prefs/transaction/coalesce",
+	                test_prefs_transaction_coalesce);
+	g_test_add_func("/prefs/transaction/nested",
+	                test_prefs_transaction_nested);
+	g_test_add_func("/prefs/transaction/save",
+	                test_prefs_transaction_save);
+	g_test_add_func("/prefs/transaction/removed",
+	                test_prefs_transaction_removed);
+
+	return g_test_run();
+}
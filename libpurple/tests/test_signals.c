@@ -0,0 +1,198 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include "../signals.h"
+
+static gint instance;
+static gint handle;
+
+static void
+test_signals_register(void)
+{
+	purple_signal_register(&instance, "test-void",
+		purple_marshal_VOID__POINTER, G_TYPE_NONE, 1, G_TYPE_POINTER);
+	purple_signal_register(&instance, "test-return",
+		purple_marshal_POINTER__POINTER, G_TYPE_POINTER, 1, G_TYPE_POINTER);
+}
+
+static void
+test_signals_append_cb(GString *str, gpointer data)
+{
+	g_string_append(str, data);
+}
+
+static void
+test_signals_append_vargs_cb(va_list args, gpointer data)
+{
+	GString *str = va_arg(args, GString *);
+
+	g_string_append(str, data);
+}
+
+static gpointer
+test_signals_return_cb(gint *calls, gpointer data)
+{
+	(*calls)++;
+
+	return data;
+}
+
+static void
+test_signals_count_cb(gint *calls, gpointer data)
+{
+	(*calls)++;
+}
+
+static void
+test_signals_direct(void)
+{
+	PurpleSignal *signal;
+	GString *str;
+
+	test_signals_register();
+
+	signal = purple_signal_lookup(&instance, "test-void");
+	g_assert_nonnull(signal);
+	g_assert_false(purple_signal_has_handlers(signal));
+
+	str = g_string_new(NULL);
+
+	/* With no handlers, the arguments aren't even looked at. */
+	purple_signal_emit_direct(signal, NULL);
+
+	purple_signal_connect_priority(&instance, "test-void", &handle,
+		PURPLE_CALLBACK(test_signals_append_cb), "c",
+		PURPLE_SIGNAL_PRIORITY_HIGHEST);
+	purple_signal_connect_vargs(&instance, "test-void", &handle,
+		PURPLE_CALLBACK(test_signals_append_vargs_cb), "b");
+	purple_signal_connect_priority(&instance, "test-void", &handle,
+		PURPLE_CALLBACK(test_signals_append_cb), "a",
+		PURPLE_SIGNAL_PRIORITY_LOWEST);
+	g_assert_true(purple_signal_has_handlers(signal));
+
+	purple_signal_emit_direct(signal, str);
+	g_assert_cmpstr("abc", ==, str->str);
+
+	/* Emitting by name goes to the same handlers. */
+	purple_signal_emit(&instance, "test-void", str);
+	g_assert_cmpstr("abcabc", ==, str->str);
+
+	purple_signals_disconnect_by_handle(&handle);
+	g_assert_false(purple_signal_has_handlers(signal));
+
+	purple_signal_emit_direct(signal, str);
+	g_assert_cmpstr("abcabc", ==, str->str);
+
+	g_string_free(str, TRUE);
+	purple_signals_unregister_by_instance(&instance);
+}
+
+static void
+test_signals_direct_return_1(void)
+{
+	PurpleSignal *signal;
+	gint calls = 0;
+
+	test_signals_register();
+
+	signal = purple_signal_lookup(&instance, "test-return");
+	g_assert_null(purple_signal_emit_direct_return_1(signal, &calls));
+
+	purple_signal_connect_priority(&instance, "test-return", &handle,
+		PURPLE_CALLBACK(test_signals_return_cb), NULL,
+		PURPLE_SIGNAL_PRIORITY_LOWEST);
+	purple_signal_connect(&instance, "test-return", &handle,
+		PURPLE_CALLBACK(test_signals_return_cb), "first");
+	purple_signal_connect_priority(&instance, "test-return", &handle,
+		PURPLE_CALLBACK(test_signals_return_cb), "second",
+		PURPLE_SIGNAL_PRIORITY_HIGHEST);
+
+	/* Handlers after the first non-NULL return value aren't called. */
+	g_assert_cmpstr("first", ==,
+		purple_signal_emit_direct_return_1(signal, &calls));
+	g_assert_cmpint(2, ==, calls);
+
+	purple_signals_unregister_by_instance(&instance);
+}
+
+static void
+test_signals_emit_performance(void)
+{
+	const gint counts[] = { 0, 1, 10 };
+	const gint emits = 1000000;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(counts); i++) {
+		PurpleSignal *signal;
+		gdouble by_name, direct;
+		gint calls = 0, j;
+
+		test_signals_register();
+		signal = purple_signal_lookup(&instance, "test-void");
+
+		/* The same function may only be connected once per handle. */
+		for (j = 0; j < counts[i]; j++) {
+			purple_signal_connect(&instance, "test-void",
+				GINT_TO_POINTER(j + 1),
+				PURPLE_CALLBACK(test_signals_count_cb), NULL);
+		}
+
+		g_test_timer_start();
+		for (j = 0; j < emits; j++)
+			purple_signal_emit(&instance, "test-void", &calls);
+		by_name = g_test_timer_elapsed();
+
+		g_test_timer_start();
+		for (j = 0; j < emits; j++)
+			purple_signal_emit_direct(signal, &calls);
+		direct = g_test_timer_elapsed();
+
+		g_assert_cmpint(2 * emits * counts[i], ==, calls);
+
+		g_test_minimized_result(direct, "%d handlers: %.1f ns by name, "
+			"%.1f ns direct", counts[i], by_name * 1e9 / emits,
+			direct * 1e9 / emits);
+
+		purple_signals_unregister_by_instance(&instance);
+	}
+}
+
+gint
+main(gint argc, gchar **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	purple_signals_init();
+
+	g_test_add_func("/signals/direct",
+	                test_signals_direct);
+	g_test_add_func("/signals/direct/return_1",
+	                test_signals_direct_return_1);
+	if (g_test_perf()) {
+		g_test_add_func("/signals/emit/performance",
+		                test_signals_emit_performance);
+	}
+
+	return g_test_run();
+}
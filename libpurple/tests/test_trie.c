@@ -21,6 +21,7 @@
  */
 
 #include <glib.h>
+#include <string.h>
 
 #include "../trie.h"
 
@@ -339,6 +340,224 @@ test_trie_multi_find(void) {
 	g_slist_free_full(tries, g_object_unref);
 }
 
+static void
+test_trie_prefilter(void)
+{
+	PurpleTrie *few, *many;
+	guint offset;
+
+	/* The first characters of words are looked up differently, when there
+	 * are just a few of them. */
+	few = purple_trie_new();
+	purple_trie_add(few, "ab", (gpointer)0xA1);
+	purple_trie_add(few, "\xc5\x82", (gpointer)0xA2);
+
+	many = purple_trie_new();
+	purple_trie_add(many, "ab", (gpointer)0xB1);
+	purple_trie_add(many, "\xc5\x82", (gpointer)0xB2);
+	purple_trie_add(many, "cd", (gpointer)0xB3);
+	purple_trie_add(many, "ef", (gpointer)0xB4);
+	purple_trie_add(many, "gh", (gpointer)0xB5);
+	purple_trie_add(many, "ij", (gpointer)0xB6);
+
+	/* Let the words land on every position of the aligned blocks. */
+	for (offset = 0; offset < 70; offset++) {
+		gchar *filler, *in, *out, *expected;
+
+		filler = g_strnfill(offset, 'x');
+		in = g_strdup_printf("%sab%s\xc5\x82 a", filler, filler);
+
+		out = purple_trie_replace(few, in,
+			test_trie_replace_cb, (gpointer)1);
+		expected = g_strdup_printf("%s[1:a1]%s[1:a2] a",
+			filler, filler);
+		g_assert_cmpstr(expected, ==, out);
+		g_free(expected);
+		g_free(out);
+
+		out = purple_trie_replace(many, in,
+			test_trie_replace_cb, (gpointer)2);
+		expected = g_strdup_printf("%s[2:b1]%s[2:b2] a",
+			filler, filler);
+		g_assert_cmpstr(expected, ==, out);
+		g_free(expected);
+		g_free(out);
+
+		g_assert_cmpint(2, ==, purple_trie_find(few, in, NULL, NULL));
+		g_assert_cmpint(2, ==, purple_trie_find(many, in, NULL, NULL));
+
+		g_free(filler);
+		g_free(in);
+	}
+
+	g_object_unref(few);
+	g_object_unref(many);
+}
+
+/* A smiley-theme-like set of words: a few common first characters and lots of
+ * distinct suffixes. */
+static gchar *
+test_trie_big_word(guint i)
+{
+	return g_strdup_printf("%c%c%x%c", ":;(<"[i % 4],
+		'a' + (i / 4) % 26, i, ")>:"[i % 3]);
+}
+
+static PurpleTrie *
+test_trie_new_big(PurpleTrieLayout layout, guint count)
+{
+	PurpleTrie *trie;
+	guint i;
+
+	trie = purple_trie_new();
+	purple_trie_set_layout(trie, layout);
+
+	for (i = 0; i < count; i++) {
+		gchar *word = test_trie_big_word(i);
+
+		purple_trie_add(trie, word, GUINT_TO_POINTER(i + 1));
+		g_free(word);
+	}
+
+	g_assert(purple_trie_freeze(trie));
+	g_assert(purple_trie_is_frozen(trie));
+
+	return trie;
+}
+
+static gchar *
+test_trie_big_text(guint count, guint repeat)
+{
+	GString *text;
+	guint i;
+
+	text = g_string_new(NULL);
+	for (i = 0; i < repeat; i++) {
+		gchar *word1 = test_trie_big_word((i * 7) % count);
+		gchar *word2 = test_trie_big_word((i * 13) % count);
+
+		g_string_append_printf(text, "Hi there %s how are you? %s "
+			"(some text, not a smiley) <:", word1, word2);
+
+		g_free(word1);
+		g_free(word2);
+	}
+
+	return g_string_free(text, FALSE);
+}
+
+static gboolean
+test_trie_layout_replace_cb(GString *out, const gchar *word,
+	gpointer word_data, gpointer user_data)
+{
+	g_string_append_printf(out, "[%x]", GPOINTER_TO_UINT(word_data));
+
+	return TRUE;
+}
+
+static void
+test_trie_layout_consistency(void)
+{
+	PurpleTrieLayout layouts[] = { PURPLE_TRIE_LAYOUT_AUTO,
+		PURPLE_TRIE_LAYOUT_DENSE, PURPLE_TRIE_LAYOUT_SPARSE };
+	gchar *text, *expected = NULL;
+	gulong expected_found = 0;
+	guint i;
+
+	text = test_trie_big_text(1000, 200);
+
+	for (i = 0; i < G_N_ELEMENTS(layouts); i++) {
+		PurpleTrie *trie;
+		gchar *out;
+		gulong found;
+
+		trie = test_trie_new_big(layouts[i], 1000);
+		g_assert_cmpint(layouts[i], ==, purple_trie_get_layout(trie));
+
+		out = purple_trie_replace(trie, text,
+			test_trie_layout_replace_cb, NULL);
+		found = purple_trie_find(trie, text, NULL, NULL);
+		g_assert_cmpint(found, >, 0);
+
+		if (expected == NULL) {
+			expected = out;
+			expected_found = found;
+		} else {
+			g_assert_cmpstr(expected, ==, out);
+			g_assert_cmpint(expected_found, ==, found);
+			g_free(out);
+		}
+
+		g_object_unref(trie);
+	}
+
+	g_free(expected);
+	g_free(text);
+}
+
+static void
+test_trie_layout_memory(void)
+{
+	PurpleTrie *dense, *sparse, *automatic;
+	gsize dense_size, sparse_size, auto_size;
+
+	dense = test_trie_new_big(PURPLE_TRIE_LAYOUT_DENSE, 3000);
+	sparse = test_trie_new_big(PURPLE_TRIE_LAYOUT_SPARSE, 3000);
+	automatic = test_trie_new_big(PURPLE_TRIE_LAYOUT_AUTO, 3000);
+
+	dense_size = purple_trie_get_memory_usage(dense);
+	sparse_size = purple_trie_get_memory_usage(sparse);
+	auto_size = purple_trie_get_memory_usage(automatic);
+
+	g_test_message("memory usage for 3000 words: dense=%" G_GSIZE_FORMAT
+		", sparse=%" G_GSIZE_FORMAT ", auto=%" G_GSIZE_FORMAT,
+		dense_size, sparse_size, auto_size);
+
+	g_assert_cmpuint(sparse_size, <=, auto_size);
+	/* The root is the only state with lots of children. */
+	g_assert_cmpuint(auto_size, <=, sparse_size + 256 * sizeof(gpointer));
+	g_assert_cmpuint(auto_size * 10, <, dense_size);
+
+	g_object_unref(dense);
+	g_object_unref(sparse);
+	g_object_unref(automatic);
+}
+
+static void
+test_trie_layout_throughput(void)
+{
+	PurpleTrieLayout layouts[] = { PURPLE_TRIE_LAYOUT_AUTO,
+		PURPLE_TRIE_LAYOUT_DENSE, PURPLE_TRIE_LAYOUT_SPARSE };
+	const gchar *names[] = { "auto", "dense", "sparse" };
+	gchar *text;
+	gsize text_len;
+	guint i, j;
+
+	text = test_trie_big_text(3000, 10000);
+	text_len = strlen(text);
+
+	for (i = 0; i < G_N_ELEMENTS(layouts); i++) {
+		PurpleTrie *trie;
+		gdouble elapsed;
+
+		trie = test_trie_new_big(layouts[i], 3000);
+
+		g_test_timer_start();
+		for (j = 0; j < 10; j++) {
+			g_free(purple_trie_replace(trie, text,
+				test_trie_layout_replace_cb, NULL));
+		}
+		elapsed = g_test_timer_elapsed();
+
+		g_test_minimized_result(elapsed, "%s layout: %.1f MB/s",
+			names[i], 10 * text_len / elapsed / 1000000);
+
+		g_object_unref(trie);
+	}
+
+	g_free(text);
+}
+
 gint
 main(gint argc, gchar **argv) {
 	g_test_init(&argc, &argv, NULL);
@@ -368,5 +587,17 @@ main(gint argc, gchar **argv) {
 	g_test_add_func("/trie/multi_find",
 	                test_trie_multi_find);
 
+	g_test_add_func("/trie/prefilter",
+	                test_trie_prefilter);
+
+	g_test_add_func("/trie/layout/consistency",
+	                test_trie_layout_consistency);
+	g_test_add_func("/trie/layout/memory",
+	                test_trie_layout_memory);
+	if (g_test_perf()) {
+		g_test_add_func("/trie/layout/throughput",
+		                test_trie_layout_throughput);
+	}
+
 	return g_test_run();
 }
@@ -63,6 +63,101 @@ static PurpleCoreUiOps test_core_uiops = {
 	.ui_init = test_ui_init
 };
 
+/*** Protocol ***/
+static GType test_ui_protocol_get_type(void);
+
+typedef struct {
+	PurpleProtocol parent;
+} TestUiProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestUiProtocolClass;
+
+G_DEFINE_TYPE(TestUiProtocol, test_ui_protocol, PURPLE_TYPE_PROTOCOL);
+
+static void
+test_ui_protocol_login(PurpleAccount *account)
+{
+	purple_connection_set_state(purple_account_get_connection(account),
+		PURPLE_CONNECTION_CONNECTED);
+}
+
+static void
+test_ui_protocol_close(PurpleConnection *gc)
+{
+}
+
+static GList *
+test_ui_protocol_status_types(PurpleAccount *account)
+{
+	return NULL;
+}
+
+static const char *
+test_ui_protocol_list_icon(PurpleAccount *account, PurpleBuddy *buddy)
+{
+	return "test";
+}
+
+static void
+test_ui_protocol_init(TestUiProtocol *prpl)
+{
+	PURPLE_PROTOCOL(prpl)->id = TEST_UI_PROTOCOL_ID;
+	PURPLE_PROTOCOL(prpl)->name = "Test";
+	PURPLE_PROTOCOL(prpl)->options = OPT_PROTO_NO_PASSWORD |
+		OPT_PROTO_CHAT_TOPIC;
+}
+
+static void
+test_ui_protocol_class_init(TestUiProtocolClass *klass)
+{
+	PurpleProtocolClass *protocol_class = PURPLE_PROTOCOL_CLASS(klass);
+
+	protocol_class->login = test_ui_protocol_login;
+	protocol_class->close = test_ui_protocol_close;
+	protocol_class->status_types = test_ui_protocol_status_types;
+	protocol_class->list_icon = test_ui_protocol_list_icon;
+}
+
+PurpleProtocol *
+test_ui_protocol_add(void)
+{
+	PurpleProtocol *protocol;
+
+	protocol = purple_protocols_add(test_ui_protocol_get_type(), NULL);
+	g_assert_nonnull(protocol);
+
+	return protocol;
+}
+
+PurpleConnection *
+test_ui_connect(const gchar *username)
+{
+	PurpleAccount *account;
+	PurpleConnection *gc;
+
+	account = purple_account_new(username, TEST_UI_PROTOCOL_ID);
+	purple_account_set_remember_password(account, FALSE);
+	purple_account_set_enabled(account, purple_core_get_ui(), TRUE);
+	purple_account_connect(account);
+
+	gc = purple_account_get_connection(account);
+	g_assert_nonnull(gc);
+	g_assert_true(PURPLE_CONNECTION_IS_CONNECTED(gc));
+
+	return gc;
+}
+
+void
+test_ui_disconnect(PurpleConnection *gc)
+{
+	PurpleAccount *account = purple_connection_get_account(gc);
+
+	purple_account_set_enabled(account, purple_core_get_ui(), FALSE);
+	g_object_unref(account);
+}
+
 void
 test_ui_purple_init(void) {
 #ifndef _WIN32
@@ -24,10 +24,23 @@
 
 #include <glib.h>
 
+#include "purple.h"
+
 G_BEGIN_DECLS
 
+/* The id of the protocol test_ui_protocol_add() registers. */
+#define TEST_UI_PROTOCOL_ID "prpl-test"
+
 void test_ui_purple_init(void);
 
+/* Registers a protocol that connects as soon as it's asked to, and does
+ * nothing else. */
+PurpleProtocol *test_ui_protocol_add(void);
+
+/* Creates an account for that protocol, and connects it. */
+PurpleConnection *test_ui_connect(const gchar *username);
+void test_ui_disconnect(PurpleConnection *gc);
+
 G_END_DECLS
 
 #endif /* PURPLE_TEST_UI_H */
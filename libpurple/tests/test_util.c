@@ -22,7 +22,9 @@
  */
 #include <glib.h>
 
-#include "../util.h"
+#include <purple.h>
+
+#include "test_ui.h"
 
 /******************************************************************************
  * base 16 tests
@@ -542,6 +544,147 @@ test_uri_escape_for_open(void) {
 	g_free(result);
 }
 
+/******************************************************************************
+ * Normalize
+ *****************************************************************************/
+static void
+test_util_normalize_to_buffer(void) {
+	/* U+00E9 decomposes to "e" followed by a combining acute accent */
+	const char *composed = "Caf\xc3\xa9";
+	char a[16], b[16], small[4];
+
+	g_assert_true(purple_normalize_to_buffer(NULL, composed, a, sizeof(a)) == a);
+	g_assert_true(purple_normalize_to_buffer(NULL, "Bob", b, sizeof(b)) == b);
+
+	/* Both results are still around, unlike with purple_normalize(). */
+	g_assert_cmpstr("Cafe\xcc\x81", ==, a);
+	g_assert_cmpstr("Bob", ==, b);
+	g_assert_cmpstr(a, ==, purple_normalize(NULL, composed));
+
+	purple_normalize_to_buffer(NULL, "Alice", small, sizeof(small));
+	g_assert_cmpstr("Ali", ==, small);
+}
+
+/* A protocol that lowercases names, and counts how often it's asked to. */
+#define TEST_UTIL_PROTOCOL_ID "prpl-test-normalize"
+
+static GType test_util_protocol_get_type(void);
+
+typedef struct {
+	PurpleProtocol parent;
+} TestUtilProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestUtilProtocolClass;
+
+static guint test_util_normalize_calls = 0;
+
+static const char *
+test_util_protocol_normalize(const PurpleAccount *account, const char *who) {
+	static char buf[64];
+	gsize i;
+
+	test_util_normalize_calls++;
+
+	for (i = 0; who[i] != '\0' && i < sizeof(buf) - 1; i++)
+		buf[i] = g_ascii_tolower(who[i]);
+	buf[i] = '\0';
+
+	return buf;
+}
+
+static void
+test_util_protocol_login(PurpleAccount *account) {
+}
+
+static void
+test_util_protocol_close(PurpleConnection *gc) {
+}
+
+static GList *
+test_util_protocol_status_types(PurpleAccount *account) {
+	return NULL;
+}
+
+static const char *
+test_util_protocol_list_icon(PurpleAccount *account, PurpleBuddy *buddy) {
+	return "test";
+}
+
+static void
+test_util_protocol_client_iface_init(PurpleProtocolClientIface *client_iface) {
+	client_iface->normalize = test_util_protocol_normalize;
+}
+
+G_DEFINE_TYPE_WITH_CODE(TestUtilProtocol, test_util_protocol,
+                        PURPLE_TYPE_PROTOCOL,
+                        G_IMPLEMENT_INTERFACE(PURPLE_TYPE_PROTOCOL_CLIENT_IFACE,
+                                              test_util_protocol_client_iface_init));
+
+static void
+test_util_protocol_init(TestUtilProtocol *prpl) {
+	PURPLE_PROTOCOL(prpl)->id = TEST_UTIL_PROTOCOL_ID;
+	PURPLE_PROTOCOL(prpl)->name = "Normalize";
+}
+
+static void
+test_util_protocol_class_init(TestUtilProtocolClass *klass) {
+	PurpleProtocolClass *protocol_class = PURPLE_PROTOCOL_CLASS(klass);
+
+	protocol_class->login = test_util_protocol_login;
+	protocol_class->close = test_util_protocol_close;
+	protocol_class->status_types = test_util_protocol_status_types;
+	protocol_class->list_icon = test_util_protocol_list_icon;
+}
+
+static void
+test_util_normalize_to_buffer_cached(void) {
+	PurpleAccount *account, *other;
+	char buf[16];
+
+	purple_protocols_add(test_util_protocol_get_type(), NULL);
+
+	account = purple_account_new("cached", TEST_UTIL_PROTOCOL_ID);
+	other = purple_account_new("other", TEST_UTIL_PROTOCOL_ID);
+
+	g_assert_cmpstr("bob", ==,
+		purple_normalize_to_buffer(account, "Bob", buf, sizeof(buf)));
+	g_assert_cmpint(1, ==, test_util_normalize_calls);
+
+	/* A name that was seen before doesn't go back to the protocol. */
+	g_assert_cmpstr("bob", ==,
+		purple_normalize_to_buffer(account, "Bob", buf, sizeof(buf)));
+	g_assert_cmpstr("bob", ==, purple_normalize(account, "Bob"));
+	g_assert_cmpint(1, ==, test_util_normalize_calls);
+
+	/* Each account has its own cache. */
+	g_assert_cmpstr("bob", ==, purple_normalize(other, "Bob"));
+	g_assert_cmpint(2, ==, test_util_normalize_calls);
+
+	/* Clearing the cache, or a new connection, asks the protocol again. */
+	purple_normalize_clear_cache(account);
+	g_assert_cmpstr("bob", ==, purple_normalize(account, "Bob"));
+	g_assert_cmpint(3, ==, test_util_normalize_calls);
+
+	purple_account_set_connection(account, NULL);
+	g_assert_cmpstr("bob", ==, purple_normalize(account, "Bob"));
+	g_assert_cmpint(4, ==, test_util_normalize_calls);
+
+	/* Results from the old protocol are gone once the account changes to
+	 * one that doesn't have its own normalize function. */
+	purple_account_set_protocol_id(account, "prpl-test-unknown");
+	g_assert_cmpstr("Bob", ==, purple_normalize(account, "Bob"));
+	g_assert_cmpint(4, ==, test_util_normalize_calls);
+
+	/* The other account still has its result. */
+	g_assert_cmpstr("bob", ==, purple_normalize(other, "Bob"));
+	g_assert_cmpint(4, ==, test_util_normalize_calls);
+
+	g_object_unref(account);
+	g_object_unref(other);
+}
+
 /******************************************************************************
  * MANE
  *****************************************************************************/
@@ -549,6 +692,8 @@ gint
 main(gint argc, gchar **argv) {
 	g_test_init(&argc, &argv, NULL);
 
+	test_ui_purple_init();
+
 	g_test_add_func("/util/base/16/encode",
 	                test_util_base_16_encode);
 	g_test_add_func("/util/base/16/decode",
@@ -593,5 +738,10 @@ main(gint argc, gchar **argv) {
 	g_test_add_func("/util/test_uri_escape_for_open",
 	                test_uri_escape_for_open);
 
+	g_test_add_func("/util/normalize/to-buffer",
+	                test_util_normalize_to_buffer);
+	g_test_add_func("/util/normalize/to-buffer/cached",
+	                test_util_normalize_to_buffer_cached);
+
 	return g_test_run();
 }
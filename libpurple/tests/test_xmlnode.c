@@ -21,6 +21,7 @@
  *
  */
 #include <glib.h>
+#include <string.h>
 
 #include "../xmlnode.h"
 
@@ -133,6 +134,133 @@ test_strip_prefixes(void) {
 	purple_xmlnode_free(xml);
 }
 
+static void
+test_xmlnode_pooled(void) {
+	const char *out = "<presence xmlns='jabber:client' from='juliet@example.com/balcony'>"
+		"<show>away</show>"
+		"<status>Be right back</status>"
+		"<c xmlns='http://jabber.org/protocol/caps' node='http://pidgin.im/'/>"
+		"<x xmlns='vcard-temp:x:update'><photo/></x>"
+	"</presence>";
+	PurpleMemoryPool *pool;
+	PurpleXmlNode *presence, *child, *copy;
+	char *str;
+
+	pool = purple_memory_pool_new();
+	presence = purple_xmlnode_new_pooled("presence", pool);
+	g_object_unref(pool);
+	g_assert_true(presence->pool == pool);
+
+	purple_xmlnode_set_namespace(presence, "jabber:client");
+	purple_xmlnode_set_attrib(presence, "from", "juliet@example.com/balcony");
+	purple_xmlnode_set_attrib(presence, "type", "unavailable");
+	purple_xmlnode_remove_attrib(presence, "type");
+
+	child = purple_xmlnode_new_child(presence, "show");
+	g_assert_true(child->pool == pool);
+	purple_xmlnode_insert_data(child, "aw", -1);
+	purple_xmlnode_insert_data(child, "ay", 2);
+
+	child = purple_xmlnode_new_child(presence, "status");
+	purple_xmlnode_insert_data(child, "Be right back", -1);
+
+	child = purple_xmlnode_new_child(presence, "c");
+	purple_xmlnode_set_namespace(child, "http://jabber.org/protocol/caps");
+	purple_xmlnode_set_attrib(child, "node", "http://pidgin.im/");
+
+	/* Regular nodes may be inserted into pooled trees. */
+	child = purple_xmlnode_new("x");
+	purple_xmlnode_set_namespace(child, "vcard-temp:x:update");
+	purple_xmlnode_new_child(child, "photo");
+	purple_xmlnode_insert_child(presence, child);
+
+	str = purple_xmlnode_get_data(purple_xmlnode_get_child(presence, "show"));
+	g_assert_cmpstr("away", ==, str);
+	g_free(str);
+
+	str = purple_xmlnode_to_str(presence, NULL);
+	g_assert_cmpstr(out, ==, str);
+	g_free(str);
+
+	/* Copies of pooled trees are regular ones and outlive the original. */
+	copy = purple_xmlnode_copy(presence);
+	g_assert_null(copy->pool);
+	g_assert_null(purple_xmlnode_get_child(copy, "status")->pool);
+
+	purple_xmlnode_free(purple_xmlnode_get_child(presence, "status"));
+	purple_xmlnode_free(presence);
+
+	str = purple_xmlnode_to_str(copy, NULL);
+	g_assert_cmpstr(out, ==, str);
+	g_free(str);
+	purple_xmlnode_free(copy);
+}
+
+static gboolean
+test_xmlnode_write_cb(const char *data, gsize len, gpointer user_data) {
+	GString *str = user_data;
+
+	g_string_append_len(str, data, len);
+
+	/* stop once the first child's opening tag has been written */
+	return strstr(str->str, "<body") == NULL;
+}
+
+static void
+test_xmlnode_write(void) {
+	const char *body = "a < b && \"c\" > 'd' \x01\x1f\x7f\xc2\x80\xc2\x85\xc2\x9f \xc3\xa9";
+	PurpleXmlNode *message, *child;
+	GString *str, *expected;
+	GOutputStream *stream;
+	char *escaped;
+
+	message = purple_xmlnode_new("message");
+	purple_xmlnode_set_namespace(message, "jabber:client");
+	purple_xmlnode_set_attrib(message, "to", "romeo@example.net");
+	purple_xmlnode_set_attrib(message, "id", "<'&'>");
+	child = purple_xmlnode_new_child(message, "body");
+	purple_xmlnode_insert_data(child, body, -1);
+	child = purple_xmlnode_new_child(message, "active");
+	purple_xmlnode_set_namespace(child, "http://jabber.org/protocol/chatstates");
+
+	escaped = g_markup_escape_text(body, -1);
+	expected = g_string_new("<message xmlns='jabber:client' "
+		"to='romeo@example.net' id='&lt;&apos;&amp;&apos;&gt;'><body>");
+	g_string_append(expected, escaped);
+	g_string_append(expected, "</body>"
+		"<active xmlns='http://jabber.org/protocol/chatstates'/></message>");
+	g_free(escaped);
+
+	/* Appends to whatever is already in the string. */
+	str = g_string_new("<stream>");
+	purple_xmlnode_write_to_string(message, str);
+	g_assert_cmpstr("<stream>", ==, g_string_truncate(str, 8)->str);
+	purple_xmlnode_write_to_string(message, g_string_truncate(str, 0));
+	g_assert_cmpstr(expected->str, ==, str->str);
+
+	escaped = purple_xmlnode_to_str(message, NULL);
+	g_assert_cmpstr(expected->str, ==, escaped);
+	g_free(escaped);
+
+	stream = g_memory_output_stream_new_resizable();
+	g_assert_true(purple_xmlnode_write_to_stream(message, stream, NULL, NULL));
+	g_assert_cmpuint(expected->len, ==, g_memory_output_stream_get_data_size(
+		G_MEMORY_OUTPUT_STREAM(stream)));
+	g_assert_true(memcmp(expected->str, g_memory_output_stream_get_data(
+		G_MEMORY_OUTPUT_STREAM(stream)), expected->len) == 0);
+	g_object_unref(stream);
+
+	/* A sink can stop the output part of the way through. */
+	g_string_truncate(str, 0);
+	g_assert_false(purple_xmlnode_write(message, test_xmlnode_write_cb, str));
+	g_assert_true(g_str_has_prefix(expected->str, str->str));
+	g_assert_cmpuint(str->len, <, expected->len);
+
+	g_string_free(expected, TRUE);
+	g_string_free(str, TRUE);
+	purple_xmlnode_free(message);
+}
+
 gint
 main(gint argc, gchar **argv) {
 	g_test_init(&argc, &argv, NULL);
@@ -143,6 +271,10 @@ main(gint argc, gchar **argv) {
 	                test_xmlnode_prefixes);
 	g_test_add_func("/xmlnode/strip_prefixes",
 	                test_strip_prefixes);
+	g_test_add_func("/xmlnode/pooled",
+	                test_xmlnode_pooled);
+	g_test_add_func("/xmlnode/write",
+	                test_xmlnode_write);
 
 	return g_test_run();
 }
@@ -24,17 +24,25 @@
 
 #include <string.h>
 
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 #include "debug.h"
+#include "enums.h"
 #include "memorypool.h"
 
 #define PURPLE_TRIE_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE((obj), PURPLE_TYPE_TRIE, PurpleTriePrivate))
 
-/* A single internal (that don't have any children) consists
- * of 256 + 4 pointers. That's 1040 bytes on 32-bit machine or 2080 bytes
- * on 64-bit.
+/* A single internal state (that have any children) with a dense transitions
+ * table consists of 256 + 6 pointers. That's 1048 bytes on 32-bit machine or
+ * 2096 bytes on 64-bit. A sparse one needs only 5 bytes (or 9 bytes on 64-bit)
+ * per every child.
  *
- * Thus, in 10500-byte pool block we can hold about 5-10 internal states.
+ * Thus, in 10500-byte pool block we can hold about 5-10 dense internal states.
  * Threshold of 100 states means, we'd need 10-20 "small" blocks before
  * switching to ~1-2 large blocks.
  */
@@ -42,13 +50,37 @@
 #define PURPLE_TRIE_STATES_SMALL_POOL_BLOCK_SIZE 10880
 #define PURPLE_TRIE_STATES_LARGE_POOL_BLOCK_SIZE 102400
 
+/* With PURPLE_TRIE_LAYOUT_AUTO, states having more children than that use
+ * a dense table. Smaller ones are binary-searched in at most 6 steps. */
+#define PURPLE_TRIE_SPARSE_MAX_CHILDREN 32
+
+/* If there are at most that many characters, that can begin a word, they are
+ * looked for with vector instructions. Otherwise, the lookup table is used. */
+#define PURPLE_TRIE_PREFILTER_VECTOR_MAX 4
+
 typedef struct _PurpleTrieRecord PurpleTrieRecord;
 typedef struct _PurpleTrieState PurpleTrieState;
 typedef struct _PurpleTrieRecordList PurpleTrieRecordList;
+typedef struct _PurpleTrieBuildEdge PurpleTrieBuildEdge;
+
+/* The set of characters, that can begin any word. While the search machine is
+ * in the root state, the remaining characters can be skipped at once. */
+typedef struct
+{
+	/* stop[c] is TRUE for the first characters of words and for '\0' */
+	guint8 stop[G_MAXUCHAR + 1];
+
+	/* the first characters (without '\0'), if there are no more than
+	 * PURPLE_TRIE_PREFILTER_VECTOR_MAX of them */
+	guchar bytes[PURPLE_TRIE_PREFILTER_VECTOR_MAX];
+	guint bytes_count;
+} PurpleTriePrefilter;
 
 typedef struct
 {
 	gboolean reset_on_match;
+	PurpleTrieLayout layout;
+	gboolean frozen;
 
 	PurpleMemoryPool *records_str_mempool;
 	PurpleMemoryPool *records_obj_mempool;
@@ -58,6 +90,8 @@ typedef struct
 
 	PurpleMemoryPool *states_mempool;
 	PurpleTrieState *root_state;
+	gsize states_size;
+	PurpleTriePrefilter prefilter;
 } PurpleTriePrivate;
 
 struct _PurpleTrieRecord
@@ -76,14 +110,32 @@ struct _PurpleTrieRecordList
 	gpointer extra_data;
 };
 
+/* Transitions of a state are stored either in a dense table of 256 children
+ * (then children_chars is NULL), or in a sparse array of children_count
+ * children, sorted by the characters in children_chars. Leaves have neither.
+ *
+ * While building the trie, the transitions are kept in the build_edges list
+ * and converted to the final layout afterwards.
+ */
 struct _PurpleTrieState
 {
 	PurpleTrieState *parent;
 	PurpleTrieState **children;
+	guchar *children_chars;
+	guint children_count;
 
 	PurpleTrieState *longest_suffix;
 
 	PurpleTrieRecord *found_word;
+
+	PurpleTrieBuildEdge *build_edges;
+};
+
+struct _PurpleTrieBuildEdge
+{
+	PurpleTrieState *state;
+	PurpleTrieBuildEdge *next;
+	guchar character;
 };
 
 typedef struct
@@ -103,6 +155,7 @@ enum
 {
 	PROP_ZERO,
 	PROP_RESET_ON_MATCH,
+	PROP_LAYOUT,
 	PROP_LAST
 };
 
@@ -191,6 +244,111 @@ purple_record_list_remove(PurpleTrieRecordList *head,
 }
 
 
+/*******************************************************************************
+ * First character prefilter
+ ******************************************************************************/
+
+static void
+purple_trie_prefilter_init(PurpleTriePrefilter *pf)
+{
+	memset(pf, 0, sizeof(PurpleTriePrefilter));
+	pf->stop['\0'] = TRUE;
+}
+
+static void
+purple_trie_prefilter_add(PurpleTriePrefilter *pf, guchar character)
+{
+	g_return_if_fail(character != '\0');
+
+	if (pf->stop[character])
+		return;
+	pf->stop[character] = TRUE;
+
+	if (pf->bytes_count < PURPLE_TRIE_PREFILTER_VECTOR_MAX)
+		pf->bytes[pf->bytes_count] = character;
+	pf->bytes_count++;
+}
+
+static void
+purple_trie_prefilter_merge(PurpleTriePrefilter *pf,
+	const PurpleTriePrefilter *other)
+{
+	guint i;
+
+	for (i = 1; i <= G_MAXUCHAR; i++) {
+		if (other->stop[i])
+			purple_trie_prefilter_add(pf, i);
+	}
+}
+
+/* Returns the pointer to the first character of str, that can begin a word,
+ * or to its terminating '\0', which end points to.
+ *
+ * The vectorized variants only load whole blocks, that lie between str and
+ * end, and look at the rest one character at a time. This way, nothing outside
+ * of the string is read. */
+static const gchar *
+purple_trie_prefilter_skip(const PurpleTriePrefilter *pf, const gchar *str,
+	const gchar *end)
+{
+	const guchar *p = (const guchar *)str;
+
+#if defined(__AVX2__)
+	if (pf->bytes_count <= PURPLE_TRIE_PREFILTER_VECTOR_MAX) {
+		__m256i needles[PURPLE_TRIE_PREFILTER_VECTOR_MAX];
+		guint i;
+
+		for (i = 0; i < pf->bytes_count; i++)
+			needles[i] = _mm256_set1_epi8((gchar)pf->bytes[i]);
+
+		for (; end - (const gchar *)p >= 32; p += 32) {
+			__m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+			__m256i hits = _mm256_setzero_si256();
+			guint32 mask;
+
+			for (i = 0; i < pf->bytes_count; i++) {
+				hits = _mm256_or_si256(hits,
+					_mm256_cmpeq_epi8(chunk, needles[i]));
+			}
+
+			mask = (guint32)_mm256_movemask_epi8(hits);
+			if (mask != 0)
+				return (const gchar *)p + g_bit_nth_lsf(mask, -1);
+		}
+	}
+#elif defined(__SSE2__)
+	if (pf->bytes_count <= PURPLE_TRIE_PREFILTER_VECTOR_MAX) {
+		__m128i needles[PURPLE_TRIE_PREFILTER_VECTOR_MAX];
+		guint i;
+
+		for (i = 0; i < pf->bytes_count; i++)
+			needles[i] = _mm_set1_epi8((gchar)pf->bytes[i]);
+
+		for (; end - (const gchar *)p >= 16; p += 16) {
+			__m128i chunk = _mm_loadu_si128((const __m128i *)p);
+			__m128i hits = _mm_setzero_si128();
+			guint32 mask;
+
+			for (i = 0; i < pf->bytes_count; i++) {
+				hits = _mm_or_si128(hits,
+					_mm_cmpeq_epi8(chunk, needles[i]));
+			}
+
+			mask = (guint32)_mm_movemask_epi8(hits);
+			if (mask != 0)
+				return (const gchar *)p + g_bit_nth_lsf(mask, -1);
+		}
+	}
+#endif
+
+	/* The '\0' at end stops it, if nothing else does. */
+	while (!pf->stop[*p])
+		p++;
+
+	return (const gchar *)p;
+}
+
+
 /*******************************************************************************
  * States management
  ******************************************************************************/
@@ -205,15 +363,19 @@ purple_trie_states_cleanup(PurpleTrie *trie)
 	if (priv->root_state != NULL) {
 		purple_memory_pool_cleanup(priv->states_mempool);
 		priv->root_state = NULL;
+		priv->states_size = 0;
 	}
 }
 
-/* Allocates a state and binds it to the parent. */
+/* Allocates a state and binds it to the parent. The edge is allocated from
+ * the temporary build_mpool, it's needed only until the states are compiled. */
 static PurpleTrieState *
-purple_trie_state_new(PurpleTrie *trie, PurpleTrieState *parent, guchar character)
+purple_trie_state_new(PurpleTrie *trie, PurpleMemoryPool *build_mpool,
+	PurpleTrieState *parent, guchar character)
 {
 	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
 	PurpleTrieState *state;
+	PurpleTrieBuildEdge *edge;
 
 	g_return_val_if_fail(priv != NULL, NULL);
 
@@ -225,31 +387,170 @@ purple_trie_state_new(PurpleTrie *trie, PurpleTrieState *parent, guchar characte
 		return state;
 
 	state->parent = parent;
-	if (parent->children == NULL) {
-		parent->children = purple_memory_pool_alloc0(
-			priv->states_mempool,
-			/* PurpleTrieState *children[G_MAXUCHAR + 1] */
-			256 * sizeof(gpointer),
-			sizeof(gpointer));
-	}
 
-	if (parent->children == NULL) {
+	edge = purple_memory_pool_alloc(build_mpool,
+		sizeof(PurpleTrieBuildEdge), sizeof(gpointer));
+	if (edge == NULL) {
 		purple_memory_pool_free(priv->states_mempool, state);
 		g_warn_if_reached();
 		return NULL;
 	}
 
-	parent->children[character] = state;
+	edge->state = state;
+	edge->character = character;
+	edge->next = parent->build_edges;
+	parent->build_edges = edge;
+	parent->children_count++;
 
 	return state;
 }
 
+/* Looks up a child of a state, that is not compiled yet. */
+static PurpleTrieState *
+purple_trie_state_build_child(PurpleTrieState *state, guchar character)
+{
+	PurpleTrieBuildEdge *edge;
+
+	for (edge = state->build_edges; edge != NULL; edge = edge->next) {
+		if (edge->character == character)
+			return edge->state;
+	}
+
+	return NULL;
+}
+
+static inline PurpleTrieState *
+purple_trie_state_child(const PurpleTrieState *state, guchar character)
+{
+	const guchar *chars = state->children_chars;
+	guint lo, hi;
+
+	/* A dense table or a leaf. */
+	if (chars == NULL) {
+		if (state->children == NULL)
+			return NULL;
+		return state->children[character];
+	}
+
+	lo = 0;
+	hi = state->children_count;
+	while (lo < hi) {
+		guint mid = (lo + hi) / 2;
+
+		if (chars[mid] == character)
+			return state->children[mid];
+		if (chars[mid] < character)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+static gboolean
+purple_trie_state_is_dense(PurpleTrieLayout layout, gboolean is_root,
+	guint children_count)
+{
+	switch (layout) {
+		case PURPLE_TRIE_LAYOUT_DENSE:
+			return TRUE;
+		case PURPLE_TRIE_LAYOUT_SPARSE:
+			return FALSE;
+		default:
+			/* The root is visited for almost every character of
+			 * the text, so it's worth its 256 pointers. */
+			return is_root ||
+				children_count > PURPLE_TRIE_SPARSE_MAX_CHILDREN;
+	}
+}
+
+/* Converts the build_edges lists of all states into their final layout,
+ * visiting them in the breadth-first order. */
+static gboolean
+purple_trie_states_compile(PurpleTrie *trie)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+	GQueue queue = G_QUEUE_INIT;
+	PurpleTrieState *state;
+	PurpleTrieBuildEdge *edge;
+
+	g_return_val_if_fail(priv != NULL, FALSE);
+	g_return_val_if_fail(priv->root_state != NULL, FALSE);
+
+	priv->states_size = 0;
+
+	purple_trie_prefilter_init(&priv->prefilter);
+	for (edge = priv->root_state->build_edges; edge; edge = edge->next)
+		purple_trie_prefilter_add(&priv->prefilter, edge->character);
+
+	g_queue_push_tail(&queue, priv->root_state);
+	while ((state = g_queue_pop_head(&queue)) != NULL) {
+		PurpleTrieState *table[G_MAXUCHAR + 1];
+		guint i, j;
+
+		priv->states_size += sizeof(PurpleTrieState);
+
+		if (state->children_count == 0)
+			continue;
+
+		memset(table, 0, sizeof(table));
+		for (edge = state->build_edges; edge; edge = edge->next) {
+			table[edge->character] = edge->state;
+			g_queue_push_tail(&queue, edge->state);
+		}
+		state->build_edges = NULL;
+
+		if (purple_trie_state_is_dense(priv->layout,
+			state == priv->root_state, state->children_count))
+		{
+			state->children = purple_memory_pool_alloc(
+				priv->states_mempool, sizeof(table),
+				sizeof(gpointer));
+			if (state->children == NULL) {
+				g_queue_clear(&queue);
+				g_warn_if_reached();
+				return FALSE;
+			}
+			memcpy(state->children, table, sizeof(table));
+			priv->states_size += sizeof(table);
+			continue;
+		}
+
+		state->children = purple_memory_pool_alloc(
+			priv->states_mempool,
+			state->children_count * sizeof(gpointer),
+			sizeof(gpointer));
+		state->children_chars = purple_memory_pool_alloc(
+			priv->states_mempool, state->children_count, 1);
+		if (state->children == NULL || state->children_chars == NULL) {
+			g_queue_clear(&queue);
+			g_warn_if_reached();
+			return FALSE;
+		}
+
+		for (i = 0, j = 0; i <= G_MAXUCHAR; i++) {
+			if (table[i] == NULL)
+				continue;
+			state->children_chars[j] = i;
+			state->children[j] = table[i];
+			j++;
+		}
+		g_assert(j == state->children_count);
+
+		priv->states_size += state->children_count *
+			(sizeof(gpointer) + sizeof(guchar));
+	}
+
+	return TRUE;
+}
+
 static gboolean
 purple_trie_states_build(PurpleTrie *trie)
 {
 	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
 	PurpleTrieState *root;
-	PurpleMemoryPool *reclist_mpool;
+	PurpleMemoryPool *build_mpool;
 	PurpleTrieRecordList *reclist, *it;
 	gulong cur_len;
 
@@ -266,14 +567,21 @@ purple_trie_states_build(PurpleTrie *trie)
 			PURPLE_TRIE_STATES_LARGE_POOL_BLOCK_SIZE);
 	}
 
-	priv->root_state = root = purple_trie_state_new(trie, NULL, '\0');
-	g_return_val_if_fail(root != NULL, FALSE);
+	/* build_mpool holds everything, that is not needed after the trie is
+	 * built: the copy of records list and the transitions lists. */
+	build_mpool = purple_memory_pool_new();
+
+	priv->root_state = root = purple_trie_state_new(trie, build_mpool,
+		NULL, '\0');
+	if (root == NULL) {
+		g_object_unref(build_mpool);
+		g_return_val_if_reached(FALSE);
+	}
 	g_assert(root->longest_suffix == NULL);
 
 	/* reclist is a list of words not yet added to the trie. Shorter words
 	 * are removed from the list, when they are fully added to the trie. */
-	reclist_mpool = purple_memory_pool_new();
-	reclist = purple_record_list_copy(reclist_mpool, priv->records);
+	reclist = purple_record_list_copy(build_mpool, priv->records);
 
 	/* extra_data on every element of reclist will be a pointer to a trie
 	 * node -- the prefix of the word with len of cur_len */
@@ -289,21 +597,24 @@ purple_trie_states_build(PurpleTrie *trie)
 			PurpleTrieRecord *rec = it->rec;
 			guchar character = rec->word[cur_len];
 			PurpleTrieState *prefix = it->extra_data;
+			PurpleTrieState *child;
 			PurpleTrieState *lon_suf_parent;
 
 			g_assert(character != '\0');
 
-			if (prefix->children && prefix->children[character]) {
+			child = purple_trie_state_build_child(prefix, character);
+			if (child != NULL) {
 				/* Word's prefix is already in the trie, added
 				 * by the other word. */
-				prefix = prefix->children[character];
+				prefix = child;
 			} else {
 				/* We need to create a new branch of trie. */
-				prefix = purple_trie_state_new(trie, prefix,
-					character);
+				prefix = purple_trie_state_new(trie,
+					build_mpool, prefix, character);
 				if (!prefix) {
 					g_warn_if_reached();
-					g_object_unref(reclist_mpool);
+					g_object_unref(build_mpool);
+					purple_trie_states_cleanup(trie);
 					return FALSE;
 				}
 			}
@@ -333,11 +644,10 @@ purple_trie_states_build(PurpleTrie *trie)
 				continue;
 			lon_suf_parent = prefix->parent->longest_suffix;
 			while (lon_suf_parent) {
-				if (lon_suf_parent->children &&
-					lon_suf_parent->children[character])
-				{
-					prefix->longest_suffix = lon_suf_parent->
-						children[character];
+				child = purple_trie_state_build_child(
+					lon_suf_parent, character);
+				if (child != NULL) {
+					prefix->longest_suffix = child;
 					break;
 				}
 				lon_suf_parent = lon_suf_parent->longest_suffix;
@@ -351,7 +661,13 @@ purple_trie_states_build(PurpleTrie *trie)
 		}
 	}
 
-	g_object_unref(reclist_mpool);
+	if (!purple_trie_states_compile(trie)) {
+		g_object_unref(build_mpool);
+		purple_trie_states_cleanup(trie);
+		return FALSE;
+	}
+
+	g_object_unref(build_mpool);
 
 	return TRUE;
 }
@@ -367,8 +683,11 @@ purple_trie_advance(PurpleTrieMachine *m, const guchar character)
 	while (TRUE) {
 		/* Perfect fit - next character is the same, as the child of the
 		 * prefix we reached so far. */
-		if (m->state->children && m->state->children[character]) {
-			m->state = m->state->children[character];
+		PurpleTrieState *child =
+			purple_trie_state_child(m->state, character);
+
+		if (child != NULL) {
+			m->state = child;
 			break;
 		}
 
@@ -381,6 +700,19 @@ purple_trie_advance(PurpleTrieMachine *m, const guchar character)
 	}
 }
 
+static gboolean
+purple_trie_machines_at_root(const PurpleTrieMachine *machines, guint count)
+{
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		if (machines[i].state != machines[i].root_state)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 static gboolean
 purple_trie_replace_do_replacement(PurpleTrieMachine *m, GString *out)
 {
@@ -439,6 +771,7 @@ purple_trie_replace(PurpleTrie *trie, const gchar *src,
 	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
 	PurpleTrieMachine machine;
 	GString *out;
+	const gchar *end;
 	gsize i;
 
 	if (src == NULL)
@@ -455,12 +788,26 @@ purple_trie_replace(PurpleTrie *trie, const gchar *src,
 	machine.replace_cb = replace_cb;
 	machine.user_data = user_data;
 
+	end = src + strlen(src);
 	out = g_string_new(NULL);
 	i = 0;
 	while (src[i] != '\0') {
-		guchar character = src[i++];
+		guchar character;
 		gboolean was_replaced;
 
+		/* Nothing is matched so far, so we can copy all characters,
+		 * that don't begin any word, at once. */
+		if (machine.state == machine.root_state) {
+			const gchar *next = purple_trie_prefilter_skip(
+				&priv->prefilter, src + i, end);
+
+			g_string_append_len(out, src + i, next - (src + i));
+			i = next - src;
+			if (src[i] == '\0')
+				break;
+		}
+
+		character = src[i++];
 		purple_trie_advance(&machine, character);
 		was_replaced = purple_trie_replace_do_replacement(&machine, out);
 
@@ -479,7 +826,9 @@ purple_trie_multi_replace(const GSList *tries, const gchar *src,
 {
 	guint tries_count, m_idx;
 	PurpleTrieMachine *machines;
+	PurpleTriePrefilter prefilter;
 	GString *out;
+	const gchar *end;
 	gsize i;
 
 	if (src == NULL)
@@ -493,6 +842,7 @@ purple_trie_multi_replace(const GSList *tries, const gchar *src,
 
 	/* Initialize all machines. */
 	machines = g_new(PurpleTrieMachine, tries_count);
+	purple_trie_prefilter_init(&prefilter);
 	for (i = 0; i < tries_count; i++, tries = tries->next) {
 		PurpleTrie *trie = tries->data;
 		PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
@@ -504,6 +854,7 @@ purple_trie_multi_replace(const GSList *tries, const gchar *src,
 		}
 
 		purple_trie_states_build(trie);
+		purple_trie_prefilter_merge(&prefilter, &priv->prefilter);
 
 		machines[i].state = priv->root_state;
 		machines[i].root_state = priv->root_state;
@@ -512,12 +863,26 @@ purple_trie_multi_replace(const GSList *tries, const gchar *src,
 		machines[i].user_data = user_data;
 	}
 
+	end = src + strlen(src);
 	out = g_string_new(NULL);
 	i = 0;
 	while (src[i] != '\0') {
-		guchar character = src[i++];
+		guchar character;
 		gboolean was_replaced = FALSE;
 
+		/* see purple_trie_replace */
+		if (purple_trie_machines_at_root(machines, tries_count)) {
+			const gchar *next = purple_trie_prefilter_skip(
+				&prefilter, src + i, end);
+
+			g_string_append_len(out, src + i, next - (src + i));
+			i = next - src;
+			if (src[i] == '\0')
+				break;
+		}
+
+		character = src[i++];
+
 		/* Advance every machine and possibly perform a replacement. */
 		for (m_idx = 0; m_idx < tries_count; m_idx++) {
 			purple_trie_advance(&machines[m_idx], character);
@@ -552,6 +917,7 @@ purple_trie_find(PurpleTrie *trie, const gchar *src,
 	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
 	PurpleTrieMachine machine;
 	gulong found_count = 0;
+	const gchar *end;
 	gsize i;
 
 	if (src == NULL)
@@ -567,11 +933,21 @@ purple_trie_find(PurpleTrie *trie, const gchar *src,
 	machine.find_cb = find_cb;
 	machine.user_data = user_data;
 
+	end = src + strlen(src);
 	i = 0;
 	while (src[i] != '\0') {
-		guchar character = src[i++];
+		guchar character;
 		gboolean was_found;
 
+		/* see purple_trie_replace */
+		if (machine.state == machine.root_state) {
+			i = purple_trie_prefilter_skip(&priv->prefilter,
+				src + i, end) - src;
+			if (src[i] == '\0')
+				break;
+		}
+
+		character = src[i++];
 		purple_trie_advance(&machine, character);
 
 		was_found = purple_trie_find_do_discovery(&machine);
@@ -589,7 +965,9 @@ purple_trie_multi_find(const GSList *tries, const gchar *src,
 {
 	guint tries_count, m_idx;
 	PurpleTrieMachine *machines;
+	PurpleTriePrefilter prefilter;
 	gulong found_count = 0;
+	const gchar *end;
 	gsize i;
 
 	if (src == NULL)
@@ -601,6 +979,7 @@ purple_trie_multi_find(const GSList *tries, const gchar *src,
 
 	/* Initialize all machines. */
 	machines = g_new(PurpleTrieMachine, tries_count);
+	purple_trie_prefilter_init(&prefilter);
 	for (i = 0; i < tries_count; i++, tries = tries->next) {
 		PurpleTrie *trie = tries->data;
 		PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
@@ -612,6 +991,7 @@ purple_trie_multi_find(const GSList *tries, const gchar *src,
 		}
 
 		purple_trie_states_build(trie);
+		purple_trie_prefilter_merge(&prefilter, &priv->prefilter);
 
 		machines[i].state = priv->root_state;
 		machines[i].root_state = priv->root_state;
@@ -620,11 +1000,22 @@ purple_trie_multi_find(const GSList *tries, const gchar *src,
 		machines[i].user_data = user_data;
 	}
 
+	end = src + strlen(src);
 	i = 0;
 	while (src[i] != '\0') {
-		guchar character = src[i++];
+		guchar character;
 		gboolean was_found = FALSE;
 
+		/* see purple_trie_replace */
+		if (purple_trie_machines_at_root(machines, tries_count)) {
+			i = purple_trie_prefilter_skip(&prefilter, src + i,
+				end) - src;
+			if (src[i] == '\0')
+				break;
+		}
+
+		character = src[i++];
+
 		/* Advance every machine and possibly perform a replacement. */
 		for (m_idx = 0; m_idx < tries_count; m_idx++) {
 			purple_trie_advance(&machines[m_idx], character);
@@ -663,6 +1054,7 @@ purple_trie_add(PurpleTrie *trie, const gchar *word, gpointer data)
 	PurpleTrieRecord *rec;
 
 	g_return_val_if_fail(priv != NULL, FALSE);
+	g_return_val_if_fail(!priv->frozen, FALSE);
 	g_return_val_if_fail(word != NULL, FALSE);
 	g_return_val_if_fail(word[0] != '\0', FALSE);
 
@@ -698,6 +1090,7 @@ purple_trie_remove(PurpleTrie *trie, const gchar *word)
 	PurpleTrieRecordList *it;
 
 	g_return_if_fail(priv != NULL);
+	g_return_if_fail(!priv->frozen);
 	g_return_if_fail(word != NULL);
 	g_return_if_fail(word[0] != '\0');
 
@@ -753,6 +1146,72 @@ purple_trie_set_reset_on_match(PurpleTrie *trie, gboolean reset)
 	g_object_notify_by_pspec(G_OBJECT(trie), properties[PROP_RESET_ON_MATCH]);
 }
 
+PurpleTrieLayout
+purple_trie_get_layout(PurpleTrie *trie)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+
+	g_return_val_if_fail(priv, PURPLE_TRIE_LAYOUT_AUTO);
+
+	return priv->layout;
+}
+
+void
+purple_trie_set_layout(PurpleTrie *trie, PurpleTrieLayout layout)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+
+	g_return_if_fail(priv);
+	g_return_if_fail(!priv->frozen);
+
+	if (priv->layout == layout)
+		return;
+
+	/* see purple_trie_add */
+	purple_trie_states_cleanup(trie);
+
+	priv->layout = layout;
+	g_object_notify_by_pspec(G_OBJECT(trie), properties[PROP_LAYOUT]);
+}
+
+gboolean
+purple_trie_freeze(PurpleTrie *trie)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+
+	g_return_val_if_fail(priv, FALSE);
+
+	if (!purple_trie_states_build(trie))
+		return FALSE;
+
+	priv->frozen = TRUE;
+
+	return TRUE;
+}
+
+gboolean
+purple_trie_is_frozen(PurpleTrie *trie)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+
+	g_return_val_if_fail(priv, FALSE);
+
+	return priv->frozen;
+}
+
+gsize
+purple_trie_get_memory_usage(PurpleTrie *trie)
+{
+	PurpleTriePrivate *priv = PURPLE_TRIE_GET_PRIVATE(trie);
+
+	g_return_val_if_fail(priv, 0);
+
+	if (!purple_trie_states_build(trie))
+		return 0;
+
+	return priv->states_size;
+}
+
 /*******************************************************************************
  * Object stuff
  ******************************************************************************/
@@ -802,6 +1261,9 @@ purple_trie_get_property(GObject *obj, guint param_id, GValue *value,
 		case PROP_RESET_ON_MATCH:
 			g_value_set_boolean(value, priv->reset_on_match);
 			break;
+		case PROP_LAYOUT:
+			g_value_set_enum(value, priv->layout);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -818,6 +1280,9 @@ purple_trie_set_property(GObject *obj, guint param_id,
 		case PROP_RESET_ON_MATCH:
 			priv->reset_on_match = g_value_get_boolean(value);
 			break;
+		case PROP_LAYOUT:
+			purple_trie_set_layout(trie, g_value_get_enum(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -845,6 +1310,11 @@ purple_trie_class_init(PurpleTrieClass *klass)
 		"you perform only find operations.", TRUE,
 		G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
 
+	properties[PROP_LAYOUT] = g_param_spec_enum("layout", "Layout",
+		"The memory layout of the trie's internal nodes.",
+		PURPLE_TYPE_TRIE_LAYOUT, PURPLE_TRIE_LAYOUT_AUTO,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
+
 	g_object_class_install_properties(obj_class, PROP_LAST, properties);
 }
 
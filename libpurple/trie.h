@@ -41,12 +41,15 @@
  * a trie and is always <literal>O(n)</literal>, where <literal>n</literal> is
  * the size of a text.
  *
- * Its main drawback is a significant memory usage - every internal trie node
- * needs about 1kB of memory on 32-bit machine and 2kB on 64-bit. Fortunately,
- * the trie grows slower when more words (with common prefixes) are added.
+ * Every internal trie node stores its transitions in one of two layouts (see
+ * #PurpleTrieLayout): a dense table of 256 pointers (about 1kB of memory on
+ * 32-bit machine and 2kB on 64-bit), or a sorted list of the existing edges
+ * only. By default, the dense table is used for the root and for nodes with
+ * lots of children, while the remaining ones are kept sparse.
  * We could avoid invalidating the whole tree when altering it, but it would
  * require figuring out, how to update <literal>longest_suffix</literal> fields
- * in satisfying time.
+ * in satisfying time. If the set of words doesn't change after it's loaded,
+ * see #purple_trie_freeze.
  */
 
 #include <glib-object.h>
@@ -66,6 +69,24 @@
 typedef struct _PurpleTrie PurpleTrie;
 typedef struct _PurpleTrieClass PurpleTrieClass;
 
+/**
+ * PurpleTrieLayout:
+ * @PURPLE_TRIE_LAYOUT_AUTO: pick the layout for every node, depending on the
+ *                           number of its children.
+ * @PURPLE_TRIE_LAYOUT_DENSE: every internal node uses a 256-entry table.
+ *                            It's the fastest one, but takes a lot of memory.
+ * @PURPLE_TRIE_LAYOUT_SPARSE: every internal node keeps a sorted array of its
+ *                             children only.
+ *
+ * The memory layout of the trie's internal nodes.
+ */
+typedef enum
+{
+	PURPLE_TRIE_LAYOUT_AUTO = 0,
+	PURPLE_TRIE_LAYOUT_DENSE,
+	PURPLE_TRIE_LAYOUT_SPARSE
+} PurpleTrieLayout;
+
 /**
  * PurpleTrie:
  *
@@ -180,6 +201,71 @@ purple_trie_get_reset_on_match(PurpleTrie *trie);
 void
 purple_trie_set_reset_on_match(PurpleTrie *trie, gboolean reset);
 
+/**
+ * purple_trie_get_layout:
+ * @trie: the trie.
+ *
+ * Returns the memory layout used for the trie's internal nodes.
+ *
+ * Returns: the layout of @trie.
+ */
+PurpleTrieLayout
+purple_trie_get_layout(PurpleTrie *trie);
+
+/**
+ * purple_trie_set_layout:
+ * @trie: the trie.
+ * @layout: the layout.
+ *
+ * Sets the memory layout used for the trie's internal nodes. The default,
+ * #PURPLE_TRIE_LAYOUT_AUTO, should fit most of the use cases.
+ *
+ * Changing the layout invalidates the trie's internal structure, just like
+ * altering its contents. It can't be done for frozen tries.
+ */
+void
+purple_trie_set_layout(PurpleTrie *trie, PurpleTrieLayout layout);
+
+/**
+ * purple_trie_freeze:
+ * @trie: the trie.
+ *
+ * Builds the trie's internal structure immediately and makes its contents
+ * read-only. It's intended for tries, that are filled once (like smiley
+ * themes) and then searched many times: the first search doesn't pay for
+ * building it, and no later modification could invalidate it.
+ *
+ * Subsequent calls to #purple_trie_add and #purple_trie_remove will fail.
+ *
+ * Returns: %TRUE if succeeded, %FALSE otherwise.
+ */
+gboolean
+purple_trie_freeze(PurpleTrie *trie);
+
+/**
+ * purple_trie_is_frozen:
+ * @trie: the trie.
+ *
+ * Checks, if the trie was frozen with #purple_trie_freeze.
+ *
+ * Returns: %TRUE, if @trie is frozen, %FALSE otherwise.
+ */
+gboolean
+purple_trie_is_frozen(PurpleTrie *trie);
+
+/**
+ * purple_trie_get_memory_usage:
+ * @trie: the trie.
+ *
+ * Returns the amount of memory taken by the trie's internal structure (its
+ * nodes and their transitions), building it if necessary. The stored words
+ * are not counted in.
+ *
+ * Returns: the size of the internal structure of @trie, in bytes.
+ */
+gsize
+purple_trie_get_memory_usage(PurpleTrie *trie);
+
 /**
  * purple_trie_add:
  * @trie: the trie.
@@ -187,7 +273,7 @@ purple_trie_set_reset_on_match(PurpleTrie *trie, gboolean reset);
  * @data: the word-related data (may be %NULL).
  *
  * Adds a word to the trie. Current implementation doesn't allow for duplicates,
- * so please avoid adding those.
+ * so please avoid adding those. Words can't be added to a frozen trie.
  *
  * Please note, that altering a trie invalidates its internal structure, so by
  * the occasion of next search, it will be rebuilt. It's done in
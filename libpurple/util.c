@@ -3469,14 +3469,27 @@ purple_strequal(const gchar *left, const gchar *right)
 	return (g_strcmp0(left, right) == 0);
 }
 
-const char *
-purple_normalize(const PurpleAccount *account, const char *str)
+/* Normalizing a name calls into the protocol and does Unicode normalization,
+ * and the same few thousand names get looked up over and over, so each
+ * account remembers the results for a bounded number of names. */
+#define PURPLE_NORMALIZE_CACHE_SIZE 4096
+
+static GQuark
+purple_normalize_cache_quark(void)
 {
-	const char *ret = NULL;
-	static char buf[BUF_LEN];
+	static GQuark quark = 0;
 
-	/* This should prevent a crash if purple_normalize gets called with NULL str, see #10115 */
-	g_return_val_if_fail(str != NULL, "");
+	if (quark == 0)
+		quark = g_quark_from_static_string("purple-normalize-cache");
+
+	return quark;
+}
+
+static const char *
+purple_normalize_uncached(const PurpleAccount *account, const char *str,
+		char *buf, gsize buf_len)
+{
+	const char *ret = NULL;
 
 	if (account != NULL)
 	{
@@ -3492,7 +3505,7 @@ purple_normalize(const PurpleAccount *account, const char *str)
 		char *tmp;
 
 		tmp = g_utf8_normalize(str, -1, G_NORMALIZE_DEFAULT);
-		g_snprintf(buf, sizeof(buf), "%s", tmp);
+		g_snprintf(buf, buf_len, "%s", tmp);
 		g_free(tmp);
 
 		ret = buf;
@@ -3501,6 +3514,71 @@ purple_normalize(const PurpleAccount *account, const char *str)
 	return ret;
 }
 
+const char *
+purple_normalize_to_buffer(const PurpleAccount *account, const char *str,
+		char *buf, gsize buf_len)
+{
+	GHashTable *cache = NULL;
+	const char *ret;
+
+	g_return_val_if_fail(str != NULL, NULL);
+	g_return_val_if_fail(buf != NULL && buf_len > 0, NULL);
+
+	if (account != NULL) {
+		cache = g_object_get_qdata(G_OBJECT(account),
+				purple_normalize_cache_quark());
+
+		if (cache != NULL && (ret = g_hash_table_lookup(cache, str)) != NULL) {
+			g_strlcpy(buf, ret, buf_len);
+			return buf;
+		}
+	}
+
+	ret = purple_normalize_uncached(account, str, buf, buf_len);
+	if (ret != buf)
+		g_strlcpy(buf, ret, buf_len);
+
+	if (account != NULL) {
+		if (cache == NULL) {
+			cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+					g_free, g_free);
+			g_object_set_qdata_full(G_OBJECT(account),
+					purple_normalize_cache_quark(), cache,
+					(GDestroyNotify)g_hash_table_destroy);
+		} else if (g_hash_table_size(cache) >= PURPLE_NORMALIZE_CACHE_SIZE) {
+			g_hash_table_remove_all(cache);
+		}
+
+		g_hash_table_insert(cache, g_strdup(str), g_strdup(buf));
+	}
+
+	return buf;
+}
+
+void
+purple_normalize_clear_cache(const PurpleAccount *account)
+{
+	GHashTable *cache;
+
+	g_return_if_fail(PURPLE_IS_ACCOUNT(account));
+
+	cache = g_object_get_qdata(G_OBJECT(account),
+			purple_normalize_cache_quark());
+	if (cache != NULL)
+		g_hash_table_remove_all(cache);
+}
+
+const char *
+purple_normalize(const PurpleAccount *account, const char *str)
+{
+	static char buf[BUF_LEN];
+
+	/* This should prevent a crash if purple_normalize gets called with NULL str, see #10115 */
+	g_return_val_if_fail(str != NULL, "");
+
+	return purple_normalize_to_buffer(account, str, buf, sizeof(buf));
+}
+
 /*
  * You probably don't want to call this directly, it is
  * mainly for use as a protocol callback function.  See the
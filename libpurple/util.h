@@ -968,12 +968,43 @@ gboolean purple_strequal(const gchar *left, const gchar *right);
  * The returned string will point to a static buffer, so if the
  * string is intended to be kept long-term, you <emphasis>must</emphasis>
  * g_strdup() it. Also, calling normalize() twice in the same line
- * will lead to problems.
+ * will lead to problems.  See purple_normalize_to_buffer() for a
+ * reentrant version.
  *
  * Returns: A pointer to the normalized version stored in a static buffer.
  */
 const char *purple_normalize(const PurpleAccount *account, const char *str);
 
+/**
+ * purple_normalize_to_buffer:
+ * @account: The account the string belongs to, or NULL if you do
+ *           not know the account.
+ * @str:     The string to normalize.
+ * @buf:     The buffer to write the normalized string to.
+ * @buf_len: The size of @buf.  The result is truncated to fit.
+ *
+ * Normalizes a string like purple_normalize(), but writes the result to a
+ * buffer owned by the caller.
+ *
+ * Results are cached per account, so normalizing a name that has been seen
+ * recently doesn't call into the protocol or allocate any memory.
+ *
+ * Returns: @buf.
+ */
+const char *purple_normalize_to_buffer(const PurpleAccount *account,
+		const char *str, char *buf, gsize buf_len);
+
+/**
+ * purple_normalize_clear_cache:
+ * @account: The account.
+ *
+ * Forgets the names normalized for an account.  Protocols whose
+ * normalization depends on the state of the connection (for example, which
+ * chats are joined) must call this when that state changes.  The cache is
+ * cleared automatically when the account's connection changes.
+ */
+void purple_normalize_clear_cache(const PurpleAccount *account);
+
 /**
  * purple_normalize_nocase:
  * @account:  The account the string belongs to.
@@ -42,12 +42,84 @@
 # define NEWLINE_S "\n"
 #endif
 
+/* Names and namespaces of pooled nodes are shared between all trees, but we
+ * don't let the remote side grow this table without bounds. */
+#define PURPLE_XMLNODE_INTERNED_MAX 4096
+
+static GHashTable *interned_names = NULL;
+
+static const char *
+intern_name(const char *name)
+{
+	char *interned;
+
+	if (interned_names == NULL) {
+		interned_names = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, NULL);
+	}
+
+	interned = g_hash_table_lookup(interned_names, name);
+	if (interned != NULL)
+		return interned;
+
+	if (g_hash_table_size(interned_names) >= PURPLE_XMLNODE_INTERNED_MAX)
+		return NULL;
+
+	interned = g_strdup(name);
+	g_hash_table_insert(interned_names, interned, interned);
+
+	return interned;
+}
+
+/* Copies a name, namespace or prefix for the node. */
+static char *
+node_name_dup(const PurpleXmlNode *node, const char *name)
+{
+	const char *interned;
+
+	if (node->pool == NULL)
+		return g_strdup(name);
+	if (name == NULL)
+		return NULL;
+
+	interned = intern_name(name);
+	if (interned != NULL)
+		return (char *)interned;
+
+	return purple_memory_pool_strdup(node->pool, name);
+}
+
+static char *
+node_strdup(const PurpleXmlNode *node, const char *str)
+{
+	if (node->pool == NULL)
+		return g_strdup(str);
+
+	return purple_memory_pool_strdup(node->pool, str);
+}
+
+static void
+node_strfree(const PurpleXmlNode *node, char *str)
+{
+	/* Pooled strings are released along with the whole tree. */
+	if (node->pool == NULL)
+		g_free(str);
+}
+
 static PurpleXmlNode*
-new_node(const char *name, PurpleXmlNodeType type)
+new_node(const char *name, PurpleXmlNodeType type, PurpleMemoryPool *pool)
 {
-	PurpleXmlNode *node = g_new0(PurpleXmlNode, 1);
+	PurpleXmlNode *node;
 
-	node->name = g_strdup(name);
+	if (pool == NULL) {
+		node = g_new0(PurpleXmlNode, 1);
+	} else {
+		node = purple_memory_pool_alloc0(pool, sizeof(PurpleXmlNode),
+			sizeof(gpointer));
+		node->pool = pool;
+	}
+
+	node->name = node_name_dup(node, name);
 	node->type = type;
 
 //	PURPLE_DBUS_REGISTER_POINTER(node, PurpleXmlNode);
@@ -60,7 +132,21 @@ purple_xmlnode_new(const char *name)
 {
 	g_return_val_if_fail(name != NULL && *name != '\0', NULL);
 
-	return new_node(name, PURPLE_XMLNODE_TYPE_TAG);
+	return new_node(name, PURPLE_XMLNODE_TYPE_TAG, NULL);
+}
+
+PurpleXmlNode *
+purple_xmlnode_new_pooled(const char *name, PurpleMemoryPool *pool)
+{
+	PurpleXmlNode *node;
+
+	g_return_val_if_fail(name != NULL && *name != '\0', NULL);
+	g_return_val_if_fail(PURPLE_IS_MEMORY_POOL(pool), NULL);
+
+	node = new_node(name, PURPLE_XMLNODE_TYPE_TAG, pool);
+	g_object_ref(pool);
+
+	return node;
 }
 
 PurpleXmlNode *
@@ -71,7 +157,7 @@ purple_xmlnode_new_child(PurpleXmlNode *parent, const char *name)
 	g_return_val_if_fail(parent != NULL, NULL);
 	g_return_val_if_fail(name != NULL && *name != '\0', NULL);
 
-	node = new_node(name, PURPLE_XMLNODE_TYPE_TAG);
+	node = new_node(name, PURPLE_XMLNODE_TYPE_TAG, parent->pool);
 
 	purple_xmlnode_insert_child(parent, node);
 
@@ -107,9 +193,15 @@ purple_xmlnode_insert_data(PurpleXmlNode *node, const char *data, gssize size)
 
 	real_size = size == -1 ? strlen(data) : (gsize)size;
 
-	child = new_node(NULL, PURPLE_XMLNODE_TYPE_DATA);
+	child = new_node(NULL, PURPLE_XMLNODE_TYPE_DATA, node->pool);
 
-	child->data = g_memdup(data, real_size);
+	if (child->pool == NULL) {
+		child->data = g_memdup(data, real_size);
+	} else {
+		child->data = purple_memory_pool_alloc(child->pool, real_size,
+			sizeof(gchar));
+		memcpy(child->data, data, real_size);
+	}
 	child->data_sz = real_size;
 
 	purple_xmlnode_insert_child(node, child);
@@ -196,11 +288,11 @@ purple_xmlnode_set_attrib_full(PurpleXmlNode *node, const char *attr, const char
 	g_return_if_fail(value != NULL);
 
 	purple_xmlnode_remove_attrib_with_namespace(node, attr, xmlns);
-	attrib_node = new_node(attr, PURPLE_XMLNODE_TYPE_ATTRIB);
+	attrib_node = new_node(attr, PURPLE_XMLNODE_TYPE_ATTRIB, node->pool);
 
-	attrib_node->data = g_strdup(value);
-	attrib_node->xmlns = g_strdup(xmlns);
-	attrib_node->prefix = g_strdup(prefix);
+	attrib_node->data = node_strdup(attrib_node, value);
+	attrib_node->xmlns = node_name_dup(attrib_node, xmlns);
+	attrib_node->prefix = node_name_dup(attrib_node, prefix);
 
 	purple_xmlnode_insert_child(node, attrib_node);
 }
@@ -249,14 +341,14 @@ void purple_xmlnode_set_namespace(PurpleXmlNode *node, const char *xmlns)
 	g_return_if_fail(node != NULL);
 
 	tmp = node->xmlns;
-	node->xmlns = g_strdup(xmlns);
+	node->xmlns = node_name_dup(node, xmlns);
 
 	if (node->namespace_map) {
 		g_hash_table_insert(node->namespace_map,
 			g_strdup(""), g_strdup(xmlns));
 	}
 
-	g_free(tmp);
+	node_strfree(node, tmp);
 }
 
 const char *purple_xmlnode_get_namespace(const PurpleXmlNode *node)
@@ -296,8 +388,8 @@ void purple_xmlnode_set_prefix(PurpleXmlNode *node, const char *prefix)
 {
 	g_return_if_fail(node != NULL);
 
-	g_free(node->prefix);
-	node->prefix = g_strdup(prefix);
+	node_strfree(node, node->prefix);
+	node->prefix = node_name_dup(node, prefix);
 }
 
 const char *purple_xmlnode_get_prefix(const PurpleXmlNode *node)
@@ -363,9 +455,14 @@ void
 purple_xmlnode_free(PurpleXmlNode *node)
 {
 	PurpleXmlNode *x, *y;
+	gboolean owns_pool;
 
 	g_return_if_fail(node != NULL);
 
+	/* The root of a pooled tree holds the reference to its pool. */
+	owns_pool = node->pool != NULL && (node->parent == NULL ||
+		node->parent->pool != node->pool);
+
 	/* if we're part of a tree, remove ourselves from the tree first */
 	if(NULL != node->parent) {
 		if(node->parent->child == node) {
@@ -393,15 +490,22 @@ purple_xmlnode_free(PurpleXmlNode *node)
 		x = y;
 	}
 
+	if(node->namespace_map)
+		g_hash_table_destroy(node->namespace_map);
+
+	/* pooled nodes are released along with the whole tree */
+	if (node->pool != NULL) {
+		if (owns_pool)
+			g_object_unref(node->pool);
+		return;
+	}
+
 	/* now dispose of ourselves */
 	g_free(node->name);
 	g_free(node->data);
 	g_free(node->xmlns);
 	g_free(node->prefix);
 
-	if(node->namespace_map)
-		g_hash_table_destroy(node->namespace_map);
-
 //	PURPLE_DBUS_UNREGISTER_POINTER(node);
 	g_free(node);
 }
@@ -481,45 +585,158 @@ purple_xmlnode_get_data_unescaped(const PurpleXmlNode *node)
 	return unescaped;
 }
 
+/* Serialization goes through a PurpleXmlNodeWriteFunc so that callers can
+ * have the markup written straight to wherever it ends up, rather than into
+ * a string that then has to be copied again. */
+typedef struct {
+	PurpleXmlNodeWriteFunc func;
+	gpointer user_data;
+	gboolean error;
+} PurpleXmlNodeWriter;
+
 static void
-purple_xmlnode_to_str_foreach_append_ns(const char *key, const char *value,
-	GString *buf)
+purple_xmlnode_writer_write(PurpleXmlNodeWriter *writer, const char *data,
+		gsize len)
+{
+	if (writer->error || len == 0)
+		return;
+
+	if (!writer->func(data, len, writer->user_data))
+		writer->error = TRUE;
+}
+
+static void
+purple_xmlnode_writer_puts(PurpleXmlNodeWriter *writer, const char *str)
+{
+	purple_xmlnode_writer_write(writer, str, strlen(str));
+}
+
+static void
+purple_xmlnode_writer_tabs(PurpleXmlNodeWriter *writer, int depth)
+{
+	static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+	while (depth > 0) {
+		int count = MIN(depth, (int)sizeof(tabs) - 1);
+		purple_xmlnode_writer_write(writer, tabs, count);
+		depth -= count;
+	}
+}
+
+/* Escapes exactly what g_markup_escape_text() would, but writes runs of
+ * unescaped text directly from the source instead of building a new string. */
+static void
+purple_xmlnode_writer_escape(PurpleXmlNodeWriter *writer, const char *text,
+		gssize length)
+{
+	const char *p, *run, *end;
+	char entity[16];
+
+	if (text == NULL)
+		return;
+	if (length < 0)
+		length = strlen(text);
+
+	run = p = text;
+	end = text + length;
+
+	while (p < end) {
+		const char *replacement = NULL;
+		guchar c = *p;
+		int skip = 1;
+
+		switch (c) {
+			case '&':
+				replacement = "&amp;";
+				break;
+			case '<':
+				replacement = "&lt;";
+				break;
+			case '>':
+				replacement = "&gt;";
+				break;
+			case '\'':
+				replacement = "&apos;";
+				break;
+			case '"':
+				replacement = "&quot;";
+				break;
+			default:
+				if ((c >= 0x1 && c <= 0x8) || c == 0xb || c == 0xc ||
+						(c >= 0xe && c <= 0x1f) || c == 0x7f) {
+					g_snprintf(entity, sizeof(entity), "&#x%x;", c);
+					replacement = entity;
+				} else if (c == 0xc2 && p + 1 < end &&
+						(guchar)p[1] >= 0x80 && (guchar)p[1] <= 0x9f &&
+						(guchar)p[1] != 0x85) {
+					/* C1 control characters, except for NEL */
+					g_snprintf(entity, sizeof(entity), "&#x%x;",
+						(guchar)p[1]);
+					replacement = entity;
+					skip = 2;
+				}
+				break;
+		}
+
+		if (replacement) {
+			purple_xmlnode_writer_write(writer, run, p - run);
+			purple_xmlnode_writer_puts(writer, replacement);
+			run = p + skip;
+		}
+		p += skip;
+	}
+
+	purple_xmlnode_writer_write(writer, run, p - run);
+}
+
+static void
+purple_xmlnode_writer_name(PurpleXmlNodeWriter *writer, const char *prefix,
+		const char *name)
+{
+	if (prefix) {
+		purple_xmlnode_writer_puts(writer, prefix);
+		purple_xmlnode_writer_write(writer, ":", 1);
+	}
+	purple_xmlnode_writer_escape(writer, name, -1);
+}
+
+static void
+purple_xmlnode_writer_foreach_ns(const char *key, const char *value,
+	PurpleXmlNodeWriter *writer)
 {
 	if (*key) {
-		g_string_append_printf(buf, " xmlns:%s='%s'", key, value);
+		purple_xmlnode_writer_puts(writer, " xmlns:");
+		purple_xmlnode_writer_puts(writer, key);
+		purple_xmlnode_writer_puts(writer, "='");
 	} else {
-		g_string_append_printf(buf, " xmlns='%s'", value);
+		purple_xmlnode_writer_puts(writer, " xmlns='");
 	}
+	purple_xmlnode_writer_puts(writer, value);
+	purple_xmlnode_writer_write(writer, "'", 1);
 }
 
-static char *
-purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean formatting, int depth)
+static void
+purple_xmlnode_write_helper(const PurpleXmlNode *node,
+		PurpleXmlNodeWriter *writer, gboolean formatting, int depth)
 {
-	GString *text = g_string_new("");
 	const char *prefix;
 	const PurpleXmlNode *c;
-	char *node_name, *esc, *esc2, *tab = NULL;
 	gboolean need_end = FALSE, pretty = formatting;
 
-	g_return_val_if_fail(node != NULL, NULL);
+	if (writer->error)
+		return;
 
-	if(pretty && depth) {
-		tab = g_strnfill(depth, '\t');
-		text = g_string_append(text, tab);
-	}
+	if (pretty)
+		purple_xmlnode_writer_tabs(writer, depth);
 
-	node_name = g_markup_escape_text(node->name, -1);
 	prefix = purple_xmlnode_get_prefix(node);
 
-	if (prefix) {
-		g_string_append_printf(text, "<%s:%s", prefix, node_name);
-	} else {
-		g_string_append_printf(text, "<%s", node_name);
-	}
+	purple_xmlnode_writer_write(writer, "<", 1);
+	purple_xmlnode_writer_name(writer, prefix, node->name);
 
 	if (node->namespace_map) {
 		g_hash_table_foreach(node->namespace_map,
-			(GHFunc)purple_xmlnode_to_str_foreach_append_ns, text);
+			(GHFunc)purple_xmlnode_writer_foreach_ns, writer);
 	} else {
 		/* Figure out if this node has a different default namespace from parent */
 		const char *xmlns = NULL;
@@ -533,24 +750,20 @@ purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean forma
 			parent_xmlns = purple_xmlnode_get_default_namespace(node->parent);
 		if (!purple_strequal(xmlns, parent_xmlns))
 		{
-			char *escaped_xmlns = g_markup_escape_text(xmlns, -1);
-			g_string_append_printf(text, " xmlns='%s'", escaped_xmlns);
-			g_free(escaped_xmlns);
+			purple_xmlnode_writer_puts(writer, " xmlns='");
+			purple_xmlnode_writer_escape(writer, xmlns, -1);
+			purple_xmlnode_writer_write(writer, "'", 1);
 		}
 	}
 	for(c = node->child; c; c = c->next)
 	{
 		if(c->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
-			const char *aprefix = purple_xmlnode_get_prefix(c);
-			esc = g_markup_escape_text(c->name, -1);
-			esc2 = g_markup_escape_text(c->data, -1);
-			if (aprefix) {
-				g_string_append_printf(text, " %s:%s='%s'", aprefix, esc, esc2);
-			} else {
-				g_string_append_printf(text, " %s='%s'", esc, esc2);
-			}
-			g_free(esc);
-			g_free(esc2);
+			purple_xmlnode_writer_write(writer, " ", 1);
+			purple_xmlnode_writer_name(writer,
+				purple_xmlnode_get_prefix(c), c->name);
+			purple_xmlnode_writer_write(writer, "='", 2);
+			purple_xmlnode_writer_escape(writer, c->data, -1);
+			purple_xmlnode_writer_write(writer, "'", 1);
 		} else if(c->type == PURPLE_XMLNODE_TYPE_TAG || c->type == PURPLE_XMLNODE_TYPE_DATA) {
 			if(c->type == PURPLE_XMLNODE_TYPE_DATA)
 				pretty = FALSE;
@@ -559,36 +772,172 @@ purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean forma
 	}
 
 	if(need_end) {
-		g_string_append_printf(text, ">%s", pretty ? NEWLINE_S : "");
+		purple_xmlnode_writer_write(writer, ">", 1);
+		if (pretty)
+			purple_xmlnode_writer_puts(writer, NEWLINE_S);
 
 		for(c = node->child; c; c = c->next)
 		{
 			if(c->type == PURPLE_XMLNODE_TYPE_TAG) {
-				int esc_len;
-				esc = purple_xmlnode_to_str_helper(c, &esc_len, pretty, depth+1);
-				text = g_string_append_len(text, esc, esc_len);
-				g_free(esc);
+				purple_xmlnode_write_helper(c, writer, pretty, depth+1);
 			} else if(c->type == PURPLE_XMLNODE_TYPE_DATA && c->data_sz > 0) {
-				esc = g_markup_escape_text(c->data, c->data_sz);
-				text = g_string_append(text, esc);
-				g_free(esc);
+				purple_xmlnode_writer_escape(writer, c->data, c->data_sz);
 			}
 		}
 
-		if(tab && pretty)
-			text = g_string_append(text, tab);
-		if (prefix) {
-			g_string_append_printf(text, "</%s:%s>%s", prefix, node_name, formatting ? NEWLINE_S : "");
-		} else {
-			g_string_append_printf(text, "</%s>%s", node_name, formatting ? NEWLINE_S : "");
-		}
+		if(pretty)
+			purple_xmlnode_writer_tabs(writer, depth);
+		purple_xmlnode_writer_write(writer, "</", 2);
+		purple_xmlnode_writer_name(writer, prefix, node->name);
+		purple_xmlnode_writer_write(writer, ">", 1);
 	} else {
-		g_string_append_printf(text, "/>%s", formatting ? NEWLINE_S : "");
+		purple_xmlnode_writer_write(writer, "/>", 2);
+	}
+
+	if (formatting)
+		purple_xmlnode_writer_puts(writer, NEWLINE_S);
+}
+
+gboolean
+purple_xmlnode_write(const PurpleXmlNode *node, PurpleXmlNodeWriteFunc func,
+		gpointer user_data)
+{
+	PurpleXmlNodeWriter writer;
+
+	g_return_val_if_fail(node != NULL, FALSE);
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	writer.func = func;
+	writer.user_data = user_data;
+	writer.error = FALSE;
+
+	purple_xmlnode_write_helper(node, &writer, FALSE, 0);
+
+	return !writer.error;
+}
+
+static gboolean
+purple_xmlnode_string_write_cb(const char *data, gsize len, gpointer user_data)
+{
+	g_string_append_len(user_data, data, len);
+
+	return TRUE;
+}
+
+void
+purple_xmlnode_write_to_string(const PurpleXmlNode *node, GString *str)
+{
+	g_return_if_fail(str != NULL);
+
+	purple_xmlnode_write(node, purple_xmlnode_string_write_cb, str);
+}
+
+static gboolean
+purple_xmlnode_circular_buffer_write_cb(const char *data, gsize len,
+		gpointer user_data)
+{
+	purple_circular_buffer_append(user_data, data, len);
+
+	return TRUE;
+}
+
+void
+purple_xmlnode_write_to_circular_buffer(const PurpleXmlNode *node,
+		PurpleCircularBuffer *buffer)
+{
+	g_return_if_fail(PURPLE_IS_CIRCULAR_BUFFER(buffer));
+
+	purple_xmlnode_write(node, purple_xmlnode_circular_buffer_write_cb,
+		buffer);
+}
+
+/* Most of the writes are a handful of bytes, so they're gathered up here
+ * instead of each one going to the stream. */
+#define PURPLE_XMLNODE_STREAM_BUFFER_SIZE 4096
+
+typedef struct {
+	GOutputStream *stream;
+	GCancellable *cancellable;
+	GError **error;
+	gsize len;
+	char buf[PURPLE_XMLNODE_STREAM_BUFFER_SIZE];
+} PurpleXmlNodeStreamSink;
+
+static gboolean
+purple_xmlnode_stream_flush(PurpleXmlNodeStreamSink *sink)
+{
+	gboolean ret = TRUE;
+
+	if (sink->len > 0) {
+		ret = g_output_stream_write_all(sink->stream, sink->buf,
+			sink->len, NULL, sink->cancellable, sink->error);
+		sink->len = 0;
 	}
 
-	g_free(node_name);
+	return ret;
+}
+
+static gboolean
+purple_xmlnode_stream_write_cb(const char *data, gsize len, gpointer user_data)
+{
+	PurpleXmlNodeStreamSink *sink = user_data;
+
+	if (sink->len + len > sizeof(sink->buf)) {
+		if (!purple_xmlnode_stream_flush(sink))
+			return FALSE;
+
+		/* Large chunks of data don't need to be copied at all */
+		if (len > sizeof(sink->buf)) {
+			return g_output_stream_write_all(sink->stream, data, len,
+				NULL, sink->cancellable, sink->error);
+		}
+	}
+
+	memcpy(sink->buf + sink->len, data, len);
+	sink->len += len;
+
+	return TRUE;
+}
+
+gboolean
+purple_xmlnode_write_to_stream(const PurpleXmlNode *node,
+		GOutputStream *stream, GCancellable *cancellable, GError **error)
+{
+	PurpleXmlNodeStreamSink *sink;
+	gboolean ret;
+
+	g_return_val_if_fail(node != NULL, FALSE);
+	g_return_val_if_fail(G_IS_OUTPUT_STREAM(stream), FALSE);
+
+	sink = g_new(PurpleXmlNodeStreamSink, 1);
+	sink->stream = stream;
+	sink->cancellable = cancellable;
+	sink->error = error;
+	sink->len = 0;
+
+	ret = purple_xmlnode_write(node, purple_xmlnode_stream_write_cb, sink) &&
+		purple_xmlnode_stream_flush(sink);
+
+	g_free(sink);
+
+	return ret;
+}
+
+static char *
+purple_xmlnode_to_str_helper(const PurpleXmlNode *node, int *len, gboolean formatting, int depth)
+{
+	GString *text;
+	PurpleXmlNodeWriter writer;
+
+	g_return_val_if_fail(node != NULL, NULL);
+
+	text = g_string_sized_new(256);
+
+	writer.func = purple_xmlnode_string_write_cb;
+	writer.user_data = text;
+	writer.error = FALSE;
 
-	g_free(tab);
+	purple_xmlnode_write_helper(node, &writer, formatting, depth);
 
 	if(len)
 		*len = text->len;
@@ -895,7 +1244,7 @@ purple_xmlnode_copy(const PurpleXmlNode *src)
 
 	g_return_val_if_fail(src != NULL, NULL);
 
-	ret = new_node(src->name, src->type);
+	ret = new_node(src->name, src->type, NULL);
 	ret->xmlns = g_strdup(src->xmlns);
 	if (src->data) {
 		if (src->data_sz) {
@@ -30,6 +30,10 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
+
+#include "circularbuffer.h"
+#include "memorypool.h"
 
 #define PURPLE_TYPE_XMLNODE  (purple_xmlnode_get_type())
 
@@ -62,6 +66,8 @@ typedef enum
  * @next:          The next node or %NULL.
  * @prefix:        The namespace prefix if any.
  * @namespace_map: The namespace map.
+ * @pool:          The memory pool the node is allocated from, or %NULL.
+ *                 See purple_xmlnode_new_pooled().
  *
  * An PurpleXmlNode.
  */
@@ -79,6 +85,7 @@ struct _PurpleXmlNode
 	PurpleXmlNode *next;
 	char *prefix;
 	GHashTable *namespace_map;
+	PurpleMemoryPool *pool;
 };
 
 G_BEGIN_DECLS
@@ -100,6 +107,27 @@ GType purple_xmlnode_get_type(void);
  */
 PurpleXmlNode *purple_xmlnode_new(const char *name);
 
+/**
+ * purple_xmlnode_new_pooled:
+ * @name: The name of the node.
+ * @pool: The memory pool to allocate the tree from.
+ *
+ * Creates a new PurpleXmlNode, being the root of a pooled tree. All of its
+ * descendants (children, attributes and data) are allocated from @pool, and
+ * their names and namespaces are interned. Freeing the root with
+ * purple_xmlnode_free() releases the whole tree at once.
+ *
+ * It's intended for short-lived trees, like received stanzas. The nodes of
+ * a pooled tree must not be moved to other trees (use purple_xmlnode_copy()
+ * instead), and their strings must not be freed or replaced directly.
+ *
+ * The tree keeps a reference to @pool, so you may unref it right after
+ * creating the node.
+ *
+ * Returns: The new node.
+ */
+PurpleXmlNode *purple_xmlnode_new_pooled(const char *name, PurpleMemoryPool *pool);
+
 /**
  * purple_xmlnode_new_child:
  * @parent: The parent node.
@@ -372,6 +400,74 @@ char *purple_xmlnode_to_str(const PurpleXmlNode *node, int *len);
  */
 char *purple_xmlnode_to_formatted_str(const PurpleXmlNode *node, int *len);
 
+/**
+ * PurpleXmlNodeWriteFunc:
+ * @data:      A chunk of serialized XML.  It is not NUL-terminated and is
+ *             only valid for the duration of the call.
+ * @len:       The length of @data.
+ * @user_data: The data passed to purple_xmlnode_write().
+ *
+ * A sink for purple_xmlnode_write().  A node is written as many small
+ * chunks, in order.
+ *
+ * Returns: %TRUE to continue writing, or %FALSE to stop.
+ */
+typedef gboolean (*PurpleXmlNodeWriteFunc)(const char *data, gsize len,
+		gpointer user_data);
+
+/**
+ * purple_xmlnode_write:
+ * @node:      The starting node to output.
+ * @func:      The function to write the XML to.
+ * @user_data: User data to pass to @func.
+ *
+ * Serializes a node the same way as purple_xmlnode_to_str(), but passes the
+ * XML to @func as it is generated instead of building a string.  Character
+ * data and attribute values are escaped on the fly, so unescaped runs are
+ * passed straight from the node.
+ *
+ * Returns: %TRUE if the whole node was written, or %FALSE if @func stopped
+ *          the output.
+ */
+gboolean purple_xmlnode_write(const PurpleXmlNode *node,
+		PurpleXmlNodeWriteFunc func, gpointer user_data);
+
+/**
+ * purple_xmlnode_write_to_string:
+ * @node: The starting node to output.
+ * @str:  The string to append the XML to.
+ *
+ * Appends the XML of a node to an existing string, which lets callers reuse
+ * a buffer between nodes.
+ */
+void purple_xmlnode_write_to_string(const PurpleXmlNode *node, GString *str);
+
+/**
+ * purple_xmlnode_write_to_circular_buffer:
+ * @node:   The starting node to output.
+ * @buffer: The buffer to append the XML to.
+ *
+ * Appends the XML of a node to a circular buffer.
+ */
+void purple_xmlnode_write_to_circular_buffer(const PurpleXmlNode *node,
+		PurpleCircularBuffer *buffer);
+
+/**
+ * purple_xmlnode_write_to_stream:
+ * @node:        The starting node to output.
+ * @stream:      The stream to write the XML to.
+ * @cancellable: (nullable): A #GCancellable, or %NULL.
+ * @error:       (out) (optional): Return location for a #GError, or %NULL.
+ *
+ * Writes the XML of a node to an output stream, blocking until it has all
+ * been written.  Small pieces are gathered into a fixed buffer before being
+ * handed to @stream.
+ *
+ * Returns: %TRUE on success, or %FALSE if writing to @stream failed.
+ */
+gboolean purple_xmlnode_write_to_stream(const PurpleXmlNode *node,
+		GOutputStream *stream, GCancellable *cancellable, GError **error);
+
 /**
  * purple_xmlnode_from_str:
  * @str:  The string of xml.
@@ -390,7 +486,8 @@ PurpleXmlNode *purple_xmlnode_from_str(const char *str, gssize size);
  * purple_xmlnode_copy:
  * @src: The node to copy.
  *
- * Creates a new node from the source node.
+ * Creates a new node from the source node. The copy of a pooled node is not
+ * pooled.
  *
  * Returns: A new copy of the src node.
  */
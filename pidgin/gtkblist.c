@@ -145,6 +145,20 @@ static GdkVisibilityState gtk_blist_visibility = GDK_VISIBILITY_UNOBSCURED;
 static gboolean gtk_blist_focused = FALSE;
 static gboolean editing_blist = FALSE;
 
+/* How often queued updates are applied, in milliseconds; about once
+ * per frame. */
+#define UPDATE_BATCH_INTERVAL 16
+
+static struct {
+	GQueue queue;           /* Nodes waiting to be updated, with a ref */
+	GHashTable *queued;     /* Node -> its link in queue */
+	GHashTable *deferred;   /* Nodes that can't be seen yet, with a ref */
+	guint timeout;
+	gboolean check_visible;
+	guint requested;
+	guint coalesced;
+} blist_updates = { G_QUEUE_INIT, NULL, NULL, 0, FALSE, 0, 0 };
+
 static GList *pidgin_blist_sort_methods = NULL;
 static struct _PidginBlistSortMethod *current_sort_method = NULL;
 static void sort_method_none(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter);
@@ -152,6 +166,11 @@ static void sort_method_none(PurpleBlistNode *node, PurpleBuddyList *blist, GtkT
 static void sort_method_alphabetical(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter);
 static void sort_method_status(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter);
 static void sort_method_log_activity(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter);
+static GCompareDataFunc sort_method_get_compare(void);
+static void sort_index_remove(PurpleBlistNode *node);
+static void sort_index_clear(PurpleBlistNode *gnode);
+static void sort_index_rebuild(PurpleBlistNode *gnode);
+static gboolean sort_index_is_current(PurpleBlistNode *node);
 static guint sort_merge_id;
 static GtkActionGroup *sort_action_group = NULL;
 
@@ -162,6 +181,11 @@ static gboolean pidgin_blist_refresh_timer(PurpleBuddyList *list);
 static void pidgin_blist_update_buddy(PurpleBuddyList *list, PurpleBlistNode *node, gboolean status_change);
 static void pidgin_blist_selection_changed(GtkTreeSelection *selection, gpointer data);
 static void pidgin_blist_update(PurpleBuddyList *list, PurpleBlistNode *node);
+static void pidgin_blist_queue_update(PurpleBuddyList *list, PurpleBlistNode *node);
+static void pidgin_blist_unqueue_update(PurpleBlistNode *node);
+static void pidgin_blist_undefer_group(PurpleBlistNode *gnode);
+static void pidgin_blist_clear_updates(void);
+static void pidgin_blist_visible_rows_changed_cb(GtkAdjustment *adjustment, gpointer data);
 static void pidgin_blist_update_group(PurpleBuddyList *list, PurpleBlistNode *node);
 static void pidgin_blist_update_contact(PurpleBuddyList *list, PurpleBlistNode *node);
 static char *pidgin_get_tooltip_text(PurpleBlistNode *node, gboolean full);
@@ -187,6 +211,17 @@ typedef struct _pidgin_blist_node {
 		PurpleConversation *conv;
 		PidginBlistNodeFlags flags;
 	} conv;
+
+	/* Sort index, see sort_index_insert(). Groups own the sequence of
+	 * their sorted children; contacts and chats keep their keys and their
+	 * place in it. */
+	GSequence *sorted;
+	GSequenceIter *sort_iter;
+	gchar *sort_key;
+	gint sort_score;
+	gint sort_presence;
+	time_t sort_idle;
+	guint sort_order;
 } PidginBlistNode;
 
 /***************************************************
@@ -1177,6 +1212,7 @@ static void gtk_blist_row_expanded_cb(GtkTreeView *tv, GtkTreeIter *iter, GtkTre
 		g_free(title);
 
 		purple_blist_node_set_bool(node, "collapsed", FALSE);
+		pidgin_blist_undefer_group(node);
 		pidgin_blist_tooltip_destroy();
 	}
 }
@@ -4504,7 +4540,7 @@ static gboolean pidgin_blist_refresh_timer(PurpleBuddyList *list)
 
 				if (buddy &&
 						purple_presence_is_idle(purple_buddy_get_presence(buddy)))
-					pidgin_blist_update_contact(list, PURPLE_BLIST_NODE(buddy));
+					pidgin_blist_queue_update(list, cnode);
 			}
 		}
 	}
@@ -4523,6 +4559,13 @@ static void pidgin_blist_hide_node(PurpleBuddyList *list, PurpleBlistNode *node,
 
 	if(gtkblist->selected_node == node)
 		gtkblist->selected_node = NULL;
+
+	/* Removing a group's row takes its children with it. */
+	if (PURPLE_IS_GROUP(node))
+		sort_index_clear(node);
+	else
+		sort_index_remove(node);
+
 	if (get_iter_from_node(node, &iter)) {
 		gtk_tree_store_remove(gtkblist->treemodel, &iter);
 		if(update && (PURPLE_IS_CONTACT(node) ||
@@ -5991,6 +6034,12 @@ static void pidgin_blist_show(PurpleBuddyList *list)
 		pidgin_make_scrollable(gtkblist->treeview, GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC, GTK_SHADOW_NONE, -1, -1),
 		TRUE, TRUE, 0);
 
+	/* Rows set aside while scrolled away are caught up when they show. */
+	g_signal_connect(gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(gtkblist->treeview)),
+			"value-changed", G_CALLBACK(pidgin_blist_visible_rows_changed_cb), NULL);
+	g_signal_connect(gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(gtkblist->treeview)),
+			"changed", G_CALLBACK(pidgin_blist_visible_rows_changed_cb), NULL);
+
 	sep = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
 	gtk_box_pack_start(GTK_BOX(gtkblist->vbox), sep, FALSE, FALSE, 0);
 
@@ -6132,6 +6181,19 @@ static void redo_buddy_list(PurpleBuddyList *list, gboolean remove, gboolean rer
 	if(!gtkblist || !gtkblist->treeview)
 		return;
 
+	/* Everything is about to be updated anyway. */
+	pidgin_blist_clear_updates();
+
+	/* Sort every group once up front, so the updates below find their
+	 * nodes already in place instead of moving them one at a time.
+	 */
+	if (!remove && sort_method_get_compare() != NULL) {
+		for (node = list->root; node; node = node->next) {
+			if (PURPLE_IS_GROUP(node))
+				sort_index_rebuild(node);
+		}
+	}
+
 	node = list->root;
 
 	while (node)
@@ -6204,6 +6266,7 @@ static void pidgin_blist_remove(PurpleBuddyList *list, PurpleBlistNode *node)
 
 	purple_request_close_with_handle(node);
 
+	pidgin_blist_unqueue_update(node);
 	pidgin_blist_hide_node(list, node, TRUE);
 
 	if(node->parent)
@@ -6223,6 +6286,7 @@ static void pidgin_blist_remove(PurpleBuddyList *list, PurpleBlistNode *node)
 			g_source_remove(gtknode->recent_signonoff_timer);
 
 		purple_signals_disconnect_by_handle(gtknode);
+		g_free(gtknode->sort_key);
 		g_free(gtknode);
 		purple_blist_node_set_ui_data(node, NULL);
 	}
@@ -6290,6 +6354,8 @@ static gboolean insert_node(PurpleBuddyList *list, PurpleBlistNode *node, GtkTre
 		sort_method_none(node, list, parent_iter, curptr, iter);
 	}
 
+	/* The sort method may have had to create it. */
+	gtknode = purple_blist_node_get_ui_data(node);
 	if(gtknode != NULL) {
 		gtk_tree_row_reference_free(gtknode->row);
 	} else {
@@ -6868,9 +6934,328 @@ static void pidgin_blist_update(PurpleBuddyList *list, PurpleBlistNode *node)
 		pidgin_blist_update_chat(list, node);
 }
 
+/*********************************************************************
+ * Coalesced updates                                                 *
+ *********************************************************************/
+
+/* Updates coming in from libpurple are queued and applied in batches,
+ * at most once per UPDATE_BATCH_INTERVAL.  A node that changes several
+ * times before then is only redrawn once.  Nodes that can't be seen,
+ * because their group is collapsed or their row is scrolled away, are
+ * set aside until they can be. */
+static gboolean
+pidgin_blist_is_deferrable(PurpleBlistNode *node, GtkTreePath *start,
+		GtkTreePath *end)
+{
+	PurpleBlistNode *gnode, *rnode;
+	PidginBlistNode *gtknode;
+	GtkTreePath *path;
+	gboolean offscreen;
+
+	if (PURPLE_IS_BUDDY(node))
+		gnode = node->parent ? node->parent->parent : NULL;
+	else if (PURPLE_IS_CONTACT(node) || PURPLE_IS_CHAT(node))
+		gnode = node->parent;
+	else
+		return FALSE;
+
+	if (gnode == NULL)
+		return FALSE;
+
+	/* Nodes that have no row yet get one right away. GTK won't expand a
+	 * group without child rows, and expanding it is what brings the
+	 * deferred nodes back. */
+	rnode = node;
+	gtknode = purple_blist_node_get_ui_data(rnode);
+	if ((gtknode == NULL || gtknode->row == NULL) && PURPLE_IS_BUDDY(node)) {
+		rnode = node->parent;
+		gtknode = purple_blist_node_get_ui_data(rnode);
+	}
+	if (gtknode == NULL || gtknode->row == NULL)
+		return FALSE;
+
+	/* Only hold back rows that won't move: an alias or presence change
+	 * can bring a row into view, or leave it out of place once its group
+	 * is expanded. */
+	if (!sort_index_is_current(PURPLE_IS_BUDDY(node) ? node->parent : node))
+		return FALSE;
+
+	/* Nothing under a collapsed group shows until it's expanded. */
+	if (purple_blist_node_get_bool(gnode, "collapsed"))
+		return TRUE;
+
+	if (start == NULL)
+		return FALSE;
+
+	if ((path = gtk_tree_row_reference_get_path(gtknode->row)) == NULL)
+		return FALSE;
+
+	offscreen = gtk_tree_path_compare(path, start) < 0 ||
+			gtk_tree_path_compare(path, end) > 0;
+	gtk_tree_path_free(path);
+
+	return offscreen;
+}
+
+static void
+pidgin_blist_undefer_update(PurpleBlistNode *node)
+{
+	if (!g_hash_table_contains(blist_updates.deferred, node))
+		return;
+
+	/* The queue takes over the deferred set's reference. */
+	g_hash_table_steal(blist_updates.deferred, node);
+	g_queue_push_tail(&blist_updates.queue, node);
+	g_hash_table_insert(blist_updates.queued, node,
+			g_queue_peek_tail_link(&blist_updates.queue));
+}
+
+/* Steps to the row drawn below iter, like the keyboard would. */
+static gboolean
+pidgin_blist_next_shown_row(GtkTreeModel *model, GtkTreeView *tv,
+		GtkTreeIter *iter)
+{
+	GtkTreeIter next, parent;
+	GtkTreePath *path = gtk_tree_model_get_path(model, iter);
+	gboolean expanded = gtk_tree_view_row_expanded(tv, path);
+
+	gtk_tree_path_free(path);
+
+	if (expanded && gtk_tree_model_iter_children(model, &next, iter)) {
+		*iter = next;
+		return TRUE;
+	}
+
+	for (;;) {
+		next = *iter;
+		if (gtk_tree_model_iter_next(model, &next)) {
+			*iter = next;
+			return TRUE;
+		}
+		if (!gtk_tree_model_iter_parent(model, &parent, iter))
+			return FALSE;
+		*iter = parent;
+	}
+}
+
+/* Moves the deferred nodes that have scrolled into view back into the
+ * queue.  Only the handful of rows on screen are looked at. */
+static void
+pidgin_blist_undefer_visible(void)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(gtkblist->treemodel);
+	GtkTreeView *tv = GTK_TREE_VIEW(gtkblist->treeview);
+	GtkTreePath *start, *end, *path;
+	GtkTreeIter iter;
+	gboolean done = FALSE;
+
+	if (!gtk_tree_view_get_visible_range(tv, &start, &end))
+		return;
+
+	if (!gtk_tree_model_get_iter(model, &iter, start))
+		done = TRUE;
+
+	while (!done) {
+		PurpleBlistNode *node, *bnode;
+
+		gtk_tree_model_get(model, &iter, NODE_COLUMN, &node, -1);
+		if (node != NULL) {
+			pidgin_blist_undefer_update(node);
+			if (PURPLE_IS_CONTACT(node)) {
+				for (bnode = node->child; bnode; bnode = bnode->next)
+					pidgin_blist_undefer_update(bnode);
+			}
+		}
+
+		if (!pidgin_blist_next_shown_row(model, tv, &iter))
+			break;
+
+		path = gtk_tree_model_get_path(model, &iter);
+		done = gtk_tree_path_compare(path, end) > 0;
+		gtk_tree_path_free(path);
+	}
+
+	gtk_tree_path_free(start);
+	gtk_tree_path_free(end);
+}
+
+static gboolean
+pidgin_blist_apply_updates_cb(gpointer data)
+{
+	GtkTreePath *start = NULL, *end = NULL;
+	PurpleBlistNode *node;
+	guint applied = 0, deferred = 0;
+
+	blist_updates.timeout = 0;
+
+	if (gtkblist == NULL || gtkblist->treeview == NULL)
+		return FALSE;
+
+	if (blist_updates.check_visible) {
+		blist_updates.check_visible = FALSE;
+		pidgin_blist_undefer_visible();
+	}
+
+	gtk_tree_view_get_visible_range(GTK_TREE_VIEW(gtkblist->treeview),
+			&start, &end);
+
+	while ((node = g_queue_pop_head(&blist_updates.queue)) != NULL) {
+		g_hash_table_remove(blist_updates.queued, node);
+
+		if (pidgin_blist_is_deferrable(node, start, end)) {
+			/* Keep the group's counts right in the meantime. */
+			pidgin_blist_update_group(NULL, node);
+			g_hash_table_add(blist_updates.deferred, node);
+			deferred++;
+			continue;
+		}
+
+		pidgin_blist_update(NULL, node);
+		g_object_unref(node);
+		applied++;
+	}
+
+	gtk_tree_path_free(start);
+	gtk_tree_path_free(end);
+
+	if (blist_updates.coalesced > 0 || deferred > 0) {
+		purple_debug_misc("gtkblist",
+				"Applied %u of %u buddy list updates (%u coalesced, "
+				"%u deferred, %u waiting)\n", applied,
+				blist_updates.requested, blist_updates.coalesced, deferred,
+				g_hash_table_size(blist_updates.deferred));
+	}
+	blist_updates.requested = 0;
+	blist_updates.coalesced = 0;
+
+	return FALSE;
+}
+
+static void
+pidgin_blist_schedule_updates(void)
+{
+	if (blist_updates.timeout == 0) {
+		blist_updates.timeout = g_timeout_add(UPDATE_BATCH_INTERVAL,
+				pidgin_blist_apply_updates_cb, NULL);
+	}
+}
+
+static void
+pidgin_blist_queue_update(PurpleBuddyList *list, PurpleBlistNode *node)
+{
+	if (list)
+		gtkblist = PIDGIN_BLIST(list);
+	if (!gtkblist || !gtkblist->treeview || !node)
+		return;
+
+	if (blist_updates.queued == NULL) {
+		blist_updates.queued = g_hash_table_new(NULL, NULL);
+		blist_updates.deferred = g_hash_table_new_full(NULL, NULL,
+				g_object_unref, NULL);
+	}
+
+	blist_updates.requested++;
+
+	if (g_hash_table_contains(blist_updates.queued, node)) {
+		blist_updates.coalesced++;
+		return;
+	}
+
+	/* A newer change supersedes the one that was set aside. */
+	if (g_hash_table_contains(blist_updates.deferred, node)) {
+		blist_updates.coalesced++;
+		pidgin_blist_undefer_update(node);
+	} else {
+		g_queue_push_tail(&blist_updates.queue, g_object_ref(node));
+		g_hash_table_insert(blist_updates.queued, node,
+				g_queue_peek_tail_link(&blist_updates.queue));
+	}
+
+	pidgin_blist_schedule_updates();
+}
+
+/* Forgets any pending update for node, e.g. because it's going away. */
+static void
+pidgin_blist_unqueue_update(PurpleBlistNode *node)
+{
+	GList *link;
+
+	if (blist_updates.queued == NULL)
+		return;
+
+	if ((link = g_hash_table_lookup(blist_updates.queued, node)) != NULL) {
+		g_hash_table_remove(blist_updates.queued, node);
+		g_queue_delete_link(&blist_updates.queue, link);
+		g_object_unref(node);
+	}
+
+	g_hash_table_remove(blist_updates.deferred, node);
+}
+
+/* Drops every pending update; used when the whole list is redone. */
+static void
+pidgin_blist_clear_updates(void)
+{
+	if (blist_updates.timeout) {
+		g_source_remove(blist_updates.timeout);
+		blist_updates.timeout = 0;
+	}
+
+	if (blist_updates.queued == NULL)
+		return;
+
+	g_queue_foreach(&blist_updates.queue, (GFunc)g_object_unref, NULL);
+	g_queue_clear(&blist_updates.queue);
+	g_hash_table_remove_all(blist_updates.queued);
+	g_hash_table_remove_all(blist_updates.deferred);
+	blist_updates.requested = 0;
+	blist_updates.coalesced = 0;
+}
+
+/* Brings the nodes held back in a group up to date once it's expanded. */
+static void
+pidgin_blist_undefer_group(PurpleBlistNode *gnode)
+{
+	GHashTableIter iter;
+	PurpleBlistNode *node;
+	GList *nodes = NULL, *l;
+
+	if (blist_updates.deferred == NULL)
+		return;
+
+	g_hash_table_iter_init(&iter, blist_updates.deferred);
+	while (g_hash_table_iter_next(&iter, (gpointer *)&node, NULL)) {
+		PurpleBlistNode *parent = PURPLE_IS_BUDDY(node) && node->parent ?
+			node->parent->parent : node->parent;
+
+		if (parent == gnode)
+			nodes = g_list_prepend(nodes, node);
+	}
+
+	for (l = nodes; l; l = l->next)
+		pidgin_blist_undefer_update(l->data);
+	g_list_free(nodes);
+
+	if (nodes != NULL)
+		pidgin_blist_schedule_updates();
+}
+
+static void
+pidgin_blist_visible_rows_changed_cb(GtkAdjustment *adjustment, gpointer data)
+{
+	if (blist_updates.deferred == NULL ||
+			g_hash_table_size(blist_updates.deferred) == 0)
+		return;
+
+	/* Don't walk the rows from here, this fires for every row added. */
+	blist_updates.check_visible = TRUE;
+	pidgin_blist_schedule_updates();
+}
+
 static void pidgin_blist_destroy(PurpleBuddyList *list)
 {
 	PidginBuddyListPrivate *priv;
+	PurpleBlistNode *gnode;
 
 	if (!list || !list->ui_data)
 		return;
@@ -6893,7 +7278,12 @@ static void pidgin_blist_destroy(PurpleBuddyList *list)
 	gtkblist->refresh_timer = 0;
 	gtkblist->timeout = 0;
 	gtkblist->drag_timeout = 0;
+	pidgin_blist_clear_updates();
 	gtkblist->window = gtkblist->vbox = gtkblist->treeview = NULL;
+	for (gnode = list->root; gnode; gnode = gnode->next) {
+		if (PURPLE_IS_GROUP(gnode))
+			sort_index_clear(gnode);
+	}
 	g_object_unref(G_OBJECT(gtkblist->treemodel));
 	gtkblist->treemodel = NULL;
 	g_object_unref(G_OBJECT(gtkblist->ui));
@@ -7409,7 +7799,7 @@ static PurpleBlistUiOps blist_ui_ops =
 	pidgin_blist_new_list,
 	pidgin_blist_new_node,
 	pidgin_blist_show,
-	pidgin_blist_update,
+	pidgin_blist_queue_update,
 	pidgin_blist_remove,
 	pidgin_blist_destroy,
 	pidgin_blist_set_visible,
@@ -7661,6 +8051,18 @@ void pidgin_blist_sort_method_set(const char *id){
 		pidgin_blist_sort_method_set("none");
 		return;
 	}
+
+	/* The indexes are ordered by the old method. */
+	if (purple_blist_get_buddy_list() != NULL) {
+		PurpleBlistNode *gnode;
+
+		for (gnode = purple_blist_get_buddy_list()->root; gnode;
+				gnode = gnode->next) {
+			if (PURPLE_IS_GROUP(gnode))
+				sort_index_clear(gnode);
+		}
+	}
+
 	if (purple_strequal(id, "none")) {
 		redo_buddy_list(purple_blist_get_buddy_list(), TRUE, FALSE);
 	} else {
@@ -7691,233 +8093,422 @@ static void sort_method_none(PurpleBlistNode *node, PurpleBuddyList *blist, GtkT
 			sibling ? &sibling_iter : NULL);
 }
 
-static void sort_method_alphabetical(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+/* Each group keeps its shown contacts and chats in a GSequence ordered by
+ * the current sort method, with the keys each comparison needs computed
+ * once per update instead of once per comparison.  Finding a node's place
+ * is then a binary search, and its successor in the sequence tells us
+ * where its row belongs. */
+
+static gchar *
+sort_key_new(const char *name)
 {
-	GtkTreeIter more_z;
+	gchar *folded, *key;
 
-	const char *my_name;
+	if (name == NULL || !g_utf8_validate(name, -1, NULL))
+		return g_strdup("");
 
-	if(PURPLE_IS_CONTACT(node)) {
-		my_name = purple_contact_get_alias((PurpleContact*)node);
-	} else if(PURPLE_IS_CHAT(node)) {
-		my_name = purple_chat_get_name((PurpleChat*)node);
-	} else {
-		sort_method_none(node, blist, groupiter, cur, iter);
-		return;
-	}
+	folded = g_utf8_casefold(name, -1);
+	key = g_utf8_collate_key(folded, -1);
+	g_free(folded);
 
-	if (!gtk_tree_model_iter_children(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, &groupiter)) {
-		gtk_tree_store_insert(gtkblist->treemodel, iter, &groupiter, 0);
-		return;
-	}
+	return key;
+}
 
-	do {
-		PurpleBlistNode *n;
-		const char *this_name;
-		int cmp;
+/* Sort ranks for the status sort: no priority buddy, offline, online. */
+enum {
+	SORT_PRESENCE_NONE,
+	SORT_PRESENCE_OFFLINE,
+	SORT_PRESENCE_ONLINE
+};
 
-		gtk_tree_model_get(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, NODE_COLUMN, &n, -1);
+static void
+sort_index_update_keys(PurpleBlistNode *node, PidginBlistNode *gtknode)
+{
+	static guint sort_order_next = 0;
 
-		if(PURPLE_IS_CONTACT(n)) {
-			this_name = purple_contact_get_alias((PurpleContact*)n);
-		} else if(PURPLE_IS_CHAT(n)) {
-			this_name = purple_chat_get_name((PurpleChat*)n);
-		} else {
-			this_name = NULL;
-		}
+	g_free(gtknode->sort_key);
+	gtknode->sort_score = 0;
+	gtknode->sort_presence = SORT_PRESENCE_NONE;
+	gtknode->sort_idle = 0;
 
-		cmp = purple_utf8_strcasecmp(my_name, this_name);
+	if (PURPLE_IS_CONTACT(node)) {
+		gtknode->sort_key = sort_key_new(
+				purple_contact_get_alias(PURPLE_CONTACT(node)));
+
+		if (current_sort_method->func == sort_method_status) {
+			PurpleBuddy *buddy = purple_contact_get_priority_buddy(
+					PURPLE_CONTACT(node));
+			PurplePresence *presence =
+				buddy ? purple_buddy_get_presence(buddy) : NULL;
+
+			/* The presence may change while the node sits in the
+			 * index, so take what the comparison needs now. */
+			if (presence != NULL) {
+				gtknode->sort_presence =
+					purple_presence_is_online(presence) ?
+					SORT_PRESENCE_ONLINE : SORT_PRESENCE_OFFLINE;
+				gtknode->sort_score =
+					purple_buddy_presence_compute_score(
+						PURPLE_BUDDY_PRESENCE(presence));
+				if (purple_presence_is_idle(presence))
+					gtknode->sort_idle =
+						purple_presence_get_idle_time(presence);
+			}
+		} else if (current_sort_method->func == sort_method_log_activity) {
+			PurpleBlistNode *n;
 
-		if(this_name && (cmp < 0 || (cmp == 0 && node < n))) {
-			if(cur) {
-				gtk_tree_store_move_before(gtkblist->treemodel, cur, &more_z);
-				*iter = *cur;
-				return;
-			} else {
-				gtk_tree_store_insert_before(gtkblist->treemodel, iter,
-						&groupiter, &more_z);
-				return;
+			for (n = node->child; n; n = n->next) {
+				PurpleBuddy *buddy = PURPLE_BUDDY(n);
+
+				gtknode->sort_score += purple_log_get_activity_score(
+						PURPLE_LOG_IM, purple_buddy_get_name(buddy),
+						purple_buddy_get_account(buddy));
 			}
 		}
-	} while (gtk_tree_model_iter_next (GTK_TREE_MODEL(gtkblist->treemodel), &more_z));
-
-	if(cur) {
-		gtk_tree_store_move_before(gtkblist->treemodel, cur, NULL);
-		*iter = *cur;
-		return;
 	} else {
-		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
-		return;
+		gtknode->sort_key = sort_key_new(
+				purple_chat_get_name(PURPLE_CHAT(node)));
 	}
+
+	if (gtknode->sort_order == 0)
+		gtknode->sort_order = ++sort_order_next;
 }
 
-static void sort_method_status(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+static gint
+sort_compare_names(PurpleBlistNode *a, PurpleBlistNode *b)
 {
-	GtkTreeIter more_z;
+	PidginBlistNode *gtka = purple_blist_node_get_ui_data(a);
+	PidginBlistNode *gtkb = purple_blist_node_get_ui_data(b);
+	gint cmp = strcmp(gtka->sort_key, gtkb->sort_key);
 
-	PurpleBuddy *my_buddy, *this_buddy;
+	if (cmp != 0)
+		return cmp;
 
-	if(PURPLE_IS_CONTACT(node)) {
-		my_buddy = purple_contact_get_priority_buddy((PurpleContact*)node);
-	} else if(PURPLE_IS_CHAT(node)) {
-		if (cur != NULL) {
-			*iter = *cur;
-			return;
-		}
+	return (a < b) ? -1 : (a > b);
+}
 
-		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
-		return;
-	} else {
-		sort_method_alphabetical(node, blist, groupiter, cur, iter);
-		return;
+static gint
+sort_compare_alphabetical(gconstpointer a, gconstpointer b, gpointer data)
+{
+	return sort_compare_names((PurpleBlistNode *)a, (PurpleBlistNode *)b);
+}
+
+static gint
+sort_compare_added(PurpleBlistNode *a, PurpleBlistNode *b)
+{
+	PidginBlistNode *gtka = purple_blist_node_get_ui_data(a);
+	PidginBlistNode *gtkb = purple_blist_node_get_ui_data(b);
+
+	return (gtka->sort_order < gtkb->sort_order) ? -1 :
+		(gtka->sort_order > gtkb->sort_order);
+}
+
+static gint
+sort_compare_status(gconstpointer a, gconstpointer b, gpointer data)
+{
+	PurpleBlistNode *na = (PurpleBlistNode *)a, *nb = (PurpleBlistNode *)b;
+	PidginBlistNode *gtka, *gtkb;
+
+	/* Chats go after all contacts, in the order they were added. */
+	if (!PURPLE_IS_CONTACT(na) || !PURPLE_IS_CONTACT(nb)) {
+		if (PURPLE_IS_CONTACT(na))
+			return -1;
+		if (PURPLE_IS_CONTACT(nb))
+			return 1;
+		return sort_compare_added(na, nb);
 	}
 
+	/* Same ranking as purple_buddy_presence_compare(), but on the values
+	 * cached by sort_index_update_keys(), with longer idle times simply
+	 * going later so the order stays total. */
+	gtka = purple_blist_node_get_ui_data(na);
+	gtkb = purple_blist_node_get_ui_data(nb);
+	if (gtka->sort_presence != gtkb->sort_presence)
+		return (gtka->sort_presence > gtkb->sort_presence) ? -1 : 1;
+	if (gtka->sort_score != gtkb->sort_score)
+		return (gtka->sort_score > gtkb->sort_score) ? -1 : 1;
+	if (gtka->sort_idle != gtkb->sort_idle) {
+		if (gtka->sort_idle == 0 || gtkb->sort_idle == 0)
+			return (gtka->sort_idle == 0) ? -1 : 1;
+		return (gtka->sort_idle > gtkb->sort_idle) ? -1 : 1;
+	}
 
-	if (!gtk_tree_model_iter_children(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, &groupiter)) {
-		gtk_tree_store_insert(gtkblist->treemodel, iter, &groupiter, 0);
-		return;
+	return sort_compare_names(na, nb);
+}
+
+static gint
+sort_compare_log_activity(gconstpointer a, gconstpointer b, gpointer data)
+{
+	PurpleBlistNode *na = (PurpleBlistNode *)a, *nb = (PurpleBlistNode *)b;
+	PidginBlistNode *gtka, *gtkb;
+
+	if (!PURPLE_IS_CONTACT(na) || !PURPLE_IS_CONTACT(nb)) {
+		if (PURPLE_IS_CONTACT(na))
+			return -1;
+		if (PURPLE_IS_CONTACT(nb))
+			return 1;
+		return sort_compare_added(na, nb);
 	}
 
-	do {
-		PurpleBlistNode *n;
-		gint name_cmp;
-		gint presence_cmp;
+	gtka = purple_blist_node_get_ui_data(na);
+	gtkb = purple_blist_node_get_ui_data(nb);
+	if (gtka->sort_score != gtkb->sort_score)
+		return (gtka->sort_score > gtkb->sort_score) ? -1 : 1;
 
-		gtk_tree_model_get(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, NODE_COLUMN, &n, -1);
+	return sort_compare_names(na, nb);
+}
 
-		if(PURPLE_IS_CONTACT(n)) {
-			this_buddy = purple_contact_get_priority_buddy((PurpleContact*)n);
-		} else {
-			this_buddy = NULL;
-		}
+static GCompareDataFunc
+sort_method_get_compare(void)
+{
+	if (current_sort_method == NULL)
+		return NULL;
+	if (current_sort_method->func == sort_method_alphabetical)
+		return sort_compare_alphabetical;
+	if (current_sort_method->func == sort_method_status)
+		return sort_compare_status;
+	if (current_sort_method->func == sort_method_log_activity)
+		return sort_compare_log_activity;
 
-		name_cmp = purple_utf8_strcasecmp(
-			purple_contact_get_alias(purple_buddy_get_contact(my_buddy)),
-			(this_buddy
-			 ? purple_contact_get_alias(purple_buddy_get_contact(this_buddy))
-			 : NULL));
+	return NULL;
+}
 
-		presence_cmp = purple_buddy_presence_compare(
-			PURPLE_BUDDY_PRESENCE(purple_buddy_get_presence(my_buddy)),
-			this_buddy ? PURPLE_BUDDY_PRESENCE(purple_buddy_get_presence(this_buddy)) : NULL);
+static void
+sort_index_remove(PurpleBlistNode *node)
+{
+	PidginBlistNode *gtknode = purple_blist_node_get_ui_data(node);
 
-		if (this_buddy == NULL ||
-			(presence_cmp < 0 ||
-			 (presence_cmp == 0 &&
-			  (name_cmp < 0 || (name_cmp == 0 && node < n)))))
-		{
-			if (cur != NULL)
-			{
-				gtk_tree_store_move_before(gtkblist->treemodel, cur, &more_z);
-				*iter = *cur;
-				return;
-			}
-			else
-			{
-				gtk_tree_store_insert_before(gtkblist->treemodel, iter,
-											 &groupiter, &more_z);
-				return;
-			}
-		}
+	if (gtknode && gtknode->sort_iter) {
+		g_sequence_remove(gtknode->sort_iter);
+		gtknode->sort_iter = NULL;
 	}
-	while (gtk_tree_model_iter_next(GTK_TREE_MODEL(gtkblist->treemodel),
-									&more_z));
+}
 
-	if (cur) {
-		gtk_tree_store_move_before(gtkblist->treemodel, cur, NULL);
-		*iter = *cur;
-		return;
-	} else {
-		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
+/* Whether node's place in the index still matches what its keys would be
+ * now, i.e. whether updating it would leave its row where it is. */
+static gboolean
+sort_index_is_current(PurpleBlistNode *node)
+{
+	PidginBlistNode *gtknode = purple_blist_node_get_ui_data(node);
+	PidginBlistNode keys;
+	gboolean current;
+
+	if (current_sort_method == NULL ||
+			current_sort_method->func == sort_method_none)
+		return TRUE;
+
+	if (gtknode == NULL || gtknode->sort_iter == NULL ||
+			(!PURPLE_IS_CONTACT(node) && !PURPLE_IS_CHAT(node)))
+		return FALSE;
+
+	memset(&keys, 0, sizeof(keys));
+	keys.sort_order = gtknode->sort_order;
+	sort_index_update_keys(node, &keys);
+
+	current = strcmp(keys.sort_key, gtknode->sort_key) == 0 &&
+			keys.sort_score == gtknode->sort_score &&
+			keys.sort_presence == gtknode->sort_presence &&
+			keys.sort_idle == gtknode->sort_idle;
+	g_free(keys.sort_key);
+
+	return current;
+}
+
+static void
+sort_index_clear(PurpleBlistNode *gnode)
+{
+	PidginBlistNode *gtkgroup = purple_blist_node_get_ui_data(gnode);
+	GSequenceIter *it;
+
+	if (!gtkgroup || !gtkgroup->sorted)
 		return;
+
+	for (it = g_sequence_get_begin_iter(gtkgroup->sorted);
+			!g_sequence_iter_is_end(it); it = g_sequence_iter_next(it)) {
+		PidginBlistNode *gtknode =
+			purple_blist_node_get_ui_data(g_sequence_get(it));
+
+		gtknode->sort_iter = NULL;
 	}
+
+	g_sequence_free(gtkgroup->sorted);
+	gtkgroup->sorted = NULL;
 }
 
-static void sort_method_log_activity(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+typedef struct {
+	PurpleBlistNode *node;
+	gint pos;
+} SortIndexEntry;
+
+static gint
+sort_index_entry_compare(gconstpointer a, gconstpointer b, gpointer data)
 {
-	GtkTreeIter more_z;
+	GCompareDataFunc compare = data;
 
-	int activity_score = 0, this_log_activity_score = 0;
-	const char *buddy_name, *this_buddy_name;
+	return compare(((const SortIndexEntry *)a)->node,
+			((const SortIndexEntry *)b)->node, NULL);
+}
 
-	if(cur && (gtk_tree_model_iter_n_children(GTK_TREE_MODEL(gtkblist->treemodel), &groupiter) == 1)) {
-		*iter = *cur;
+/* Sorts a group's rows in one go and rebuilds its index to match. */
+static void
+sort_index_rebuild(PurpleBlistNode *gnode)
+{
+	GCompareDataFunc compare = sort_method_get_compare();
+	PidginBlistNode *gtkgroup;
+	GtkTreeModel *model = GTK_TREE_MODEL(gtkblist->treemodel);
+	GtkTreeIter groupiter, iter;
+	GArray *entries;
+	gint *new_order;
+	guint i;
+
+	sort_index_clear(gnode);
+
+	if (!get_iter_from_node(gnode, &groupiter) ||
+			!gtk_tree_model_iter_children(model, &iter, &groupiter))
 		return;
-	}
 
-	if(PURPLE_IS_CONTACT(node)) {
-		PurpleBlistNode *n;
-		PurpleBuddy *buddy;
-		for (n = node->child; n; n = n->next) {
-			buddy = (PurpleBuddy*)n;
-			activity_score += purple_log_get_activity_score(PURPLE_LOG_IM, purple_buddy_get_name(buddy), purple_buddy_get_account(buddy));
-		}
-		buddy_name = purple_contact_get_alias((PurpleContact*)node);
-	} else if(PURPLE_IS_CHAT(node)) {
-		/* we don't have a reliable way of getting the log filename
-		 * from the chat info in the blist, yet */
-		if (cur != NULL) {
-			*iter = *cur;
+	entries = g_array_new(FALSE, FALSE, sizeof(SortIndexEntry));
+	do {
+		SortIndexEntry entry;
+
+		gtk_tree_model_get(model, &iter, NODE_COLUMN, &entry.node, -1);
+		if (entry.node == NULL) {
+			/* Not filled in yet, leave this group alone. */
+			g_array_free(entries, TRUE);
 			return;
 		}
+		entry.pos = entries->len;
+		sort_index_update_keys(entry.node,
+				purple_blist_node_get_ui_data(entry.node));
+		g_array_append_val(entries, entry);
+	} while (gtk_tree_model_iter_next(model, &iter));
 
-		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
-		return;
-	} else {
-		sort_method_none(node, blist, groupiter, cur, iter);
-		return;
-	}
+	g_array_sort_with_data(entries, sort_index_entry_compare, compare);
 
+	gtkgroup = purple_blist_node_get_ui_data(gnode);
+	gtkgroup->sorted = g_sequence_new(NULL);
+	new_order = g_new(gint, entries->len);
+	for (i = 0; i < entries->len; i++) {
+		SortIndexEntry *entry = &g_array_index(entries, SortIndexEntry, i);
+		PidginBlistNode *gtknode = purple_blist_node_get_ui_data(entry->node);
 
-	if (!gtk_tree_model_iter_children(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, &groupiter)) {
-		gtk_tree_store_insert(gtkblist->treemodel, iter, &groupiter, 0);
-		return;
+		gtknode->sort_iter = g_sequence_append(gtkgroup->sorted, entry->node);
+		new_order[i] = entry->pos;
 	}
 
-	do {
-		PurpleBlistNode *n;
-		PurpleBlistNode *n2;
-		PurpleBuddy *buddy;
-		int cmp;
+	gtk_tree_store_reorder(gtkblist->treemodel, &groupiter, new_order);
 
-		gtk_tree_model_get(GTK_TREE_MODEL(gtkblist->treemodel), &more_z, NODE_COLUMN, &n, -1);
-		this_log_activity_score = 0;
+	g_free(new_order);
+	g_array_free(entries, TRUE);
+}
 
-		if(PURPLE_IS_CONTACT(n)) {
-			for (n2 = n->child; n2; n2 = n2->next) {
-				buddy = (PurpleBuddy*)n2;
-				this_log_activity_score += purple_log_get_activity_score(PURPLE_LOG_IM, purple_buddy_get_name(buddy), purple_buddy_get_account(buddy));
-			}
-			this_buddy_name = purple_contact_get_alias((PurpleContact*)n);
-		} else {
-			this_buddy_name = NULL;
+static void
+sort_index_insert(PurpleBlistNode *node, GtkTreeIter groupiter,
+		GtkTreeIter *cur, GtkTreeIter *iter)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(gtkblist->treemodel);
+	PidginBlistNode *gtkgroup, *gtknode;
+	GSequenceIter *it;
+	GtkTreeIter next;
+	gboolean found = FALSE;
+
+	gtknode = purple_blist_node_get_ui_data(node);
+	if (gtknode == NULL) {
+		pidgin_blist_new_node(node);
+		gtknode = purple_blist_node_get_ui_data(node);
+	}
+	gtkgroup = purple_blist_node_get_ui_data(node->parent);
+	if (gtkgroup->sorted == NULL)
+		gtkgroup->sorted = g_sequence_new(NULL);
+
+	sort_index_remove(node);
+	sort_index_update_keys(node, gtknode);
+	gtknode->sort_iter = g_sequence_insert_sorted(gtkgroup->sorted, node,
+			sort_method_get_compare(), NULL);
+
+	for (it = g_sequence_iter_next(gtknode->sort_iter);
+			!g_sequence_iter_is_end(it); it = g_sequence_iter_next(it)) {
+		if (get_iter_from_node(g_sequence_get(it), &next)) {
+			found = TRUE;
+			break;
 		}
+	}
 
-		cmp = purple_utf8_strcasecmp(buddy_name, this_buddy_name);
+	if (cur != NULL) {
+		GtkTreeIter after = *cur;
+		gboolean has_next = gtk_tree_model_iter_next(model, &after);
 
-		if (!PURPLE_IS_CONTACT(n) || activity_score > this_log_activity_score ||
-				((activity_score == this_log_activity_score) &&
-				 (cmp < 0 || (cmp == 0 && node < n)))) {
-			if (cur != NULL) {
-				gtk_tree_store_move_before(gtkblist->treemodel, cur, &more_z);
-				*iter = *cur;
-				return;
-			} else {
-				gtk_tree_store_insert_before(gtkblist->treemodel, iter,
-						&groupiter, &more_z);
+		*iter = *cur;
+
+		/* Most updates don't change the order, so don't move the row
+		 * unless it actually has to. */
+		if (found && has_next) {
+			PurpleBlistNode *n;
+
+			gtk_tree_model_get(model, &after, NODE_COLUMN, &n, -1);
+			if (n == g_sequence_get(it))
 				return;
-			}
+		} else if (!found && !has_next) {
+			return;
 		}
-	} while (gtk_tree_model_iter_next (GTK_TREE_MODEL(gtkblist->treemodel), &more_z));
 
-	if (cur != NULL) {
-		gtk_tree_store_move_before(gtkblist->treemodel, cur, NULL);
+		gtk_tree_store_move_before(gtkblist->treemodel, cur,
+				found ? &next : NULL);
 		*iter = *cur;
-		return;
+	} else if (found) {
+		gtk_tree_store_insert_before(gtkblist->treemodel, iter,
+				&groupiter, &next);
 	} else {
 		gtk_tree_store_append(gtkblist->treemodel, iter, &groupiter);
+	}
+}
+
+static void sort_method_alphabetical(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+{
+	if(!PURPLE_IS_CONTACT(node) && !PURPLE_IS_CHAT(node)) {
+		sort_method_none(node, blist, groupiter, cur, iter);
 		return;
 	}
+
+	sort_index_insert(node, groupiter, cur, iter);
+}
+
+static void sort_method_status(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+{
+	if(PURPLE_IS_CHAT(node)) {
+		PidginBlistNode *gtknode = purple_blist_node_get_ui_data(node);
+
+		/* Chats don't have a status to sort by, so leave them where
+		 * they are. */
+		if (cur != NULL && gtknode != NULL && gtknode->sort_iter != NULL) {
+			*iter = *cur;
+			return;
+		}
+	} else if(!PURPLE_IS_CONTACT(node)) {
+		sort_method_alphabetical(node, blist, groupiter, cur, iter);
+		return;
+	}
+
+	sort_index_insert(node, groupiter, cur, iter);
+}
+
+static void sort_method_log_activity(PurpleBlistNode *node, PurpleBuddyList *blist, GtkTreeIter groupiter, GtkTreeIter *cur, GtkTreeIter *iter)
+{
+	if(PURPLE_IS_CHAT(node)) {
+		PidginBlistNode *gtknode = purple_blist_node_get_ui_data(node);
+
+		/* we don't have a reliable way of getting the log filename
+		 * from the chat info in the blist, yet */
+		if (cur != NULL && gtknode != NULL && gtknode->sort_iter != NULL) {
+			*iter = *cur;
+			return;
+		}
+	} else if(!PURPLE_IS_CONTACT(node)) {
+		sort_method_none(node, blist, groupiter, cur, iter);
+		return;
+	}
+
+	sort_index_insert(node, groupiter, cur, iter);
 }
 
 static void
@@ -75,6 +75,10 @@
 
 #define ADD_MESSAGE_HISTORY_AT_ONCE 100
 
+/* How many messages the conversation pane keeps in its document. Older
+ * ones are put back as the user scrolls up to them. */
+#define SCROLLBACK_LIMIT 500
+
 /*
  * A GTK+ Instant Message pane.
  */
@@ -5623,6 +5627,8 @@ setup_common_pane(PidginConversation *gtkconv)
 	/* Setup the webkit widget */
 	frame = pidgin_create_webview(FALSE, &gtkconv->webview, &webview_sw);
 	g_object_set(G_OBJECT(gtkconv->webview), "expand", TRUE, NULL);
+	pidgin_webview_set_scrollback_limit(PIDGIN_WEBVIEW(gtkconv->webview),
+	                                    "Chat", SCROLLBACK_LIMIT);
 	_pidgin_widget_set_accessible_name(frame, "Conversation Pane");
 
 	load_conv_theme(gtkconv);
@@ -6187,6 +6193,7 @@ pidgin_conv_destroy(PurpleConversation *conv)
 	if (gtkconv->attach_timer) {
 		g_source_remove(gtkconv->attach_timer);
 	}
+	g_list_free_full(gtkconv->attach_current, g_object_unref);
 
 	g_array_unref(gtkconv->nick_colors);
 
@@ -7117,10 +7124,16 @@ pidgin_conv_chat_add_users(PurpleChatConversation *chat, GList *cbuddies, gboole
 	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(ls),  GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
 										 GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID);
 
-	l = cbuddies;
-	while (l != NULL) {
+	for (l = cbuddies; l != NULL; l = l->next) {
+		GtkTreeRowReference *ref = purple_chat_user_get_ui_data(l->data);
+
+		/* Attaching the conversation adds everyone, including users the
+		 * core is still going to hand over in batches. */
+		if (ref != NULL && gtk_tree_row_reference_valid(ref) &&
+				gtk_tree_row_reference_get_model(ref) == GTK_TREE_MODEL(ls))
+			continue;
+
 		add_chat_user_common(chat, (PurpleChatUser *)l->data, NULL);
-		l = l->next;
 	}
 
 	/* Currently GTK+ maintains our sorted list after it's in the tree.
@@ -8525,11 +8538,8 @@ add_message_history_to_gtkconv(gpointer data)
 		}
 		/* XXX: should it be gtkconv->active_conv? */
 		pidgin_conv_write_conv(gtkconv->active_conv, msg);
-		if (im) {
-			gtkconv->attach_current = g_list_delete_link(gtkconv->attach_current, gtkconv->attach_current);
-		} else {
-			gtkconv->attach_current = gtkconv->attach_current->prev;
-		}
+		gtkconv->attach_current = g_list_delete_link(gtkconv->attach_current, gtkconv->attach_current);
+		g_object_unref(msg);
 		count++;
 	}
 	gtkconv->attach_timer = timer;
@@ -8611,21 +8621,24 @@ gboolean pidgin_conv_attach_to_conversation(PurpleConversation *conv)
 
 	list = purple_conversation_get_message_history(conv);
 	if (list) {
+		/* The history may be trimmed while we're adding it, so hold on
+		 * to the messages until they're written. */
+		list = g_list_copy_deep(list, (GCopyFunc)g_object_ref, NULL);
 		if (PURPLE_IS_IM_CONVERSATION(conv)) {
 			GList *convs;
-			list = g_list_copy(list);
 			for (convs = purple_conversations_get_ims(); convs; convs = convs->next)
 				if (convs->data != conv &&
 						pidgin_conv_find_gtkconv(convs->data) == gtkconv) {
 					pidgin_conv_attach(convs->data);
-					list = g_list_concat(list, g_list_copy(purple_conversation_get_message_history(convs->data)));
+					list = g_list_concat(list, g_list_copy_deep(purple_conversation_get_message_history(convs->data),
+							(GCopyFunc)g_object_ref, NULL));
 				}
 			list = g_list_sort(list, message_compare);
-			gtkconv->attach_current = list;
-			list = g_list_last(list);
-		} else if (PURPLE_IS_CHAT_CONVERSATION(conv)) {
-			gtkconv->attach_current = g_list_last(list);
+		} else {
+			list = g_list_reverse(list);
 		}
+		gtkconv->attach_current = list;
+		list = g_list_last(list);
 
 		g_object_set_data(G_OBJECT(gtkconv->entry), "attach-start-time",
 			GINT_TO_POINTER(purple_message_get_time(list->data)));
@@ -44,6 +44,7 @@
 #define MAX_SCROLL_TIME 0.4 /* seconds */
 #define SCROLL_DELAY 33 /* milliseconds */
 #define PIDGIN_WEBVIEW_MAX_PROCESS_TIME 100000 /* microseconds */
+#define PIDGIN_WEBVIEW_SCROLLBACK_CHUNK 50 /* elements restored at a time */
 
 #define PIDGIN_WEBVIEW_GET_PRIVATE(obj) \
 	(G_TYPE_INSTANCE_GET_PRIVATE((obj), PIDGIN_TYPE_WEBVIEW, PidginWebViewPriv))
@@ -98,6 +99,11 @@ typedef struct _PidginWebViewPriv {
 	GQueue *load_queue;
 	guint loader;
 
+	/* Scrollback, see pidgin_webview_set_scrollback_limit() */
+	char *scrollback_container;
+	guint scrollback_limit;
+	GQueue *scrollback;
+
 	/* Scroll adjustments */
 	GtkAdjustment *vadj;
 	gboolean autoscroll;
@@ -275,6 +281,35 @@ process_load_queue_element(PidginWebView *webview)
 	type = GPOINTER_TO_INT(g_queue_pop_head(priv->load_queue));
 	str = g_queue_pop_head(priv->load_queue);
 
+	/* Merge everything of the same type that's waiting behind it, so a
+	 * burst of messages costs one DOM insert or one script run. */
+	if (!g_queue_is_empty(priv->load_queue) &&
+	    GPOINTER_TO_INT(g_queue_peek_head(priv->load_queue)) == type) {
+		GString *batch = g_string_new(NULL);
+
+		do {
+			if (type == LOAD_JS) {
+				/* Keep one failing script from stopping the rest,
+				 * but still report it like an unbatched one. */
+				g_string_append_printf(batch,
+				                       "try {\n%s\n} catch (e) { console.error(e); }\n",
+				                       str);
+			} else {
+				g_string_append(batch, str);
+			}
+			g_free(str);
+
+			if (g_queue_is_empty(priv->load_queue) ||
+			    GPOINTER_TO_INT(g_queue_peek_head(priv->load_queue)) != type)
+				break;
+
+			g_queue_pop_head(priv->load_queue);
+			str = g_queue_pop_head(priv->load_queue);
+		} while (TRUE);
+
+		str = g_string_free(batch, FALSE);
+	}
+
 	switch (type) {
 		case LOAD_HTML:
 			doc = webkit_web_view_get_dom_document(WEBKIT_WEB_VIEW(webview));
@@ -331,6 +366,120 @@ process_load_queue_element(PidginWebView *webview)
 	g_free(str);
 }
 
+static WebKitDOMElement *
+webview_get_scrollback_container(PidginWebView *webview)
+{
+	PidginWebViewPriv *priv = PIDGIN_WEBVIEW_GET_PRIVATE(webview);
+	WebKitDOMDocument *doc;
+
+	doc = webkit_web_view_get_dom_document(WEBKIT_WEB_VIEW(webview));
+	if (doc == NULL)
+		return NULL;
+
+	if (priv->scrollback_container != NULL)
+		return webkit_dom_document_get_element_by_id(doc,
+		                                             priv->scrollback_container);
+
+	return WEBKIT_DOM_ELEMENT(webkit_dom_document_get_body(doc));
+}
+
+/* Takes the oldest elements out of the document once there are more than
+ * the limit, keeping their markup so they can be put back. */
+static void
+webview_prune_scrollback(PidginWebView *webview)
+{
+	PidginWebViewPriv *priv = PIDGIN_WEBVIEW_GET_PRIVATE(webview);
+	WebKitDOMElement *container;
+	gulong count;
+
+	/* Don't pull the text out from under someone reading it. */
+	if (priv->vadj && gtk_adjustment_get_value(priv->vadj) <
+	                  (gtk_adjustment_get_upper(priv->vadj) -
+	                   1.5*gtk_adjustment_get_page_size(priv->vadj)))
+		return;
+
+	container = webview_get_scrollback_container(webview);
+	if (container == NULL)
+		return;
+
+	count = webkit_dom_element_get_child_element_count(container);
+	for (; count > priv->scrollback_limit; count--) {
+		WebKitDOMElement *first;
+
+		first = webkit_dom_element_get_first_element_child(container);
+		if (!WEBKIT_DOM_IS_HTML_ELEMENT(first))
+			break;
+
+		g_queue_push_tail(priv->scrollback,
+			webkit_dom_html_element_get_outer_html(
+				WEBKIT_DOM_HTML_ELEMENT(first)));
+		webkit_dom_node_remove_child(WEBKIT_DOM_NODE(container),
+		                             WEBKIT_DOM_NODE(first), NULL);
+	}
+}
+
+/* Puts back the most recently pruned elements, keeping the view where it
+ * was. */
+static void
+webview_restore_scrollback(PidginWebView *webview)
+{
+	PidginWebViewPriv *priv = PIDGIN_WEBVIEW_GET_PRIVATE(webview);
+	WebKitDOMDocument *doc;
+	WebKitDOMElement *container, *body;
+	GString *html;
+	glong before, after;
+	int i;
+
+	container = webview_get_scrollback_container(webview);
+	if (container == NULL || !WEBKIT_DOM_IS_HTML_ELEMENT(container))
+		return;
+
+	doc = webkit_web_view_get_dom_document(WEBKIT_WEB_VIEW(webview));
+	if (doc == NULL)
+		return;
+	body = WEBKIT_DOM_ELEMENT(webkit_dom_document_get_body(doc));
+	if (body == NULL)
+		return;
+
+	html = g_string_new(NULL);
+	for (i = 0; i < PIDGIN_WEBVIEW_SCROLLBACK_CHUNK &&
+	            !g_queue_is_empty(priv->scrollback); i++) {
+		char *markup = g_queue_pop_tail(priv->scrollback);
+		g_string_prepend(html, markup);
+		g_free(markup);
+	}
+
+	before = webkit_dom_element_get_scroll_height(body);
+	webkit_dom_html_element_insert_adjacent_html(
+		WEBKIT_DOM_HTML_ELEMENT(container), "afterbegin", html->str, NULL);
+	after = webkit_dom_element_get_scroll_height(body);
+
+	gtk_adjustment_set_value(priv->vadj,
+		gtk_adjustment_get_value(priv->vadj) + (after - before));
+
+	g_string_free(html, TRUE);
+}
+
+static void
+webview_vadj_value_changed(GtkAdjustment *vadj, PidginWebView *webview)
+{
+	PidginWebViewPriv *priv = PIDGIN_WEBVIEW_GET_PRIVATE(webview);
+
+	if (g_queue_is_empty(priv->scrollback))
+		return;
+
+	if (gtk_adjustment_get_value(vadj) <= gtk_adjustment_get_lower(vadj) +
+	                                      0.5*gtk_adjustment_get_page_size(vadj))
+		webview_restore_scrollback(webview);
+}
+
+static void
+webview_clear_scrollback(PidginWebViewPriv *priv)
+{
+	while (!g_queue_is_empty(priv->scrollback))
+		g_free(g_queue_pop_head(priv->scrollback));
+}
+
 static gboolean
 process_load_queue(PidginWebView *webview)
 {
@@ -354,6 +503,9 @@ process_load_queue(PidginWebView *webview)
 			break;
 	}
 
+	if (priv->scrollback_limit > 0)
+		webview_prune_scrollback(webview);
+
 	if (g_queue_is_empty(priv->load_queue)) {
 		priv->loader = 0;
 		return FALSE;
@@ -369,6 +521,9 @@ webview_load_started(WebKitWebView *webview, WebKitWebFrame *frame,
 
 	/* is there a better way to test for is_loading? */
 	priv->is_loading = TRUE;
+
+	/* The old document and everything pruned from it are gone. */
+	webview_clear_scrollback(priv);
 }
 
 static void
@@ -1216,6 +1371,10 @@ pidgin_webview_finalize(GObject *webview)
 	}
 	g_queue_free(priv->load_queue);
 
+	webview_clear_scrollback(priv);
+	g_queue_free(priv->scrollback);
+	g_free(priv->scrollback_container);
+
 	if (--globally_loaded_images_refcnt == 0) {
 		g_assert(globally_loaded_images != NULL);
 		g_hash_table_destroy(globally_loaded_images);
@@ -1451,6 +1610,7 @@ pidgin_webview_init(PidginWebView *webview, gpointer userdata)
 	WebKitWebInspector *inspector;
 
 	priv->load_queue = g_queue_new();
+	priv->scrollback = g_queue_new();
 
 	g_signal_connect(G_OBJECT(webview), "button-press-event",
 	                 G_CALLBACK(webview_button_pressed), NULL);
@@ -1607,7 +1767,28 @@ pidgin_webview_set_vadjustment(PidginWebView *webview, GtkAdjustment *vadj)
 	g_return_if_fail(webview != NULL);
 
 	priv = PIDGIN_WEBVIEW_GET_PRIVATE(webview);
+	if (priv->vadj != NULL) {
+		g_signal_handlers_disconnect_by_func(G_OBJECT(priv->vadj),
+			G_CALLBACK(webview_vadj_value_changed), webview);
+	}
 	priv->vadj = vadj;
+
+	g_signal_connect_object(G_OBJECT(vadj), "value-changed",
+	                        G_CALLBACK(webview_vadj_value_changed), webview, 0);
+}
+
+void
+pidgin_webview_set_scrollback_limit(PidginWebView *webview,
+                                    const char *container, guint limit)
+{
+	PidginWebViewPriv *priv;
+
+	g_return_if_fail(webview != NULL);
+
+	priv = PIDGIN_WEBVIEW_GET_PRIVATE(webview);
+	g_free(priv->scrollback_container);
+	priv->scrollback_container = g_strdup(container);
+	priv->scrollback_limit = limit;
 }
 
 void
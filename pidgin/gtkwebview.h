@@ -135,7 +135,9 @@ GtkWidget *pidgin_webview_new(gboolean editable);
  * @markup:  The html markup to append
  *
  * A very basic routine to append html, which can be considered
- * equivalent to a "document.write" using JavaScript.
+ * equivalent to a "document.write" using JavaScript. Markup appended back
+ * to back is inserted in one go, and reported by a single
+ * #PidginWebView::html-appended.
  */
 void pidgin_webview_append_html(PidginWebView *webview, const char *markup);
 
@@ -169,7 +171,8 @@ void pidgin_webview_load_html_string_with_selection(PidginWebView *webview, cons
  * loads completely. We also guarantee that the scripts are executed
  * in the order they are called here. This is useful to avoid race
  * conditions when calling JS functions immediately after opening the
- * page.
+ * page. Scripts that are queued back to back are run together in one
+ * go; an exception thrown by one of them doesn't stop the others.
  */
 void pidgin_webview_safe_execute_script(PidginWebView *webview, const char *script);
 
@@ -193,6 +196,24 @@ char *pidgin_webview_quote_js_string(const char *str);
  */
 void pidgin_webview_set_vadjustment(PidginWebView *webview, GtkAdjustment *vadj);
 
+/**
+ * pidgin_webview_set_scrollback_limit:
+ * @webview:   The PidginWebView object
+ * @container: (nullable): The id of the element content is appended to, or
+ *             %NULL for the document body
+ * @limit:     The number of child elements to keep, or 0 for no limit
+ *
+ * Limits how much appended content is kept in the document. Once the view
+ * is scrolled to the end, the oldest children of @container beyond @limit
+ * are taken out of the document, and they are put back a few at a time
+ * when the view is scrolled back up to the top. Loading a new document
+ * discards them.
+ *
+ * This needs the adjustment set by pidgin_webview_set_vadjustment().
+ */
+void pidgin_webview_set_scrollback_limit(PidginWebView *webview,
+		const char *container, guint limit);
+
 /**
  * pidgin_webview_scroll_to_end:
  * @webview: The PidginWebView object